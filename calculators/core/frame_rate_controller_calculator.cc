@@ -0,0 +1,150 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/port/status.h"
+#include "myMediapipe/calculators/core/frame_rate_controller_calculator.pb.h"
+
+namespace mediapipe {
+
+namespace {
+constexpr char kImageTag[] = "IMAGE";
+constexpr char kFullRateTag[] = "FULL_RATE";
+constexpr char kClearTag[] = "CLEAR";
+
+int64 FrameIntervalUs(double fps) {
+  // 10% of slack, so camera jitter doesn't make a 10fps limit drop to 7.5
+  return fps > 0 ? static_cast<int64>(0.9 * 1e6 / fps) : 0;
+}
+}  // namespace
+
+// Drops input frames to a low rate until a gesture that needs the full
+// rate is picked by gestureAutomatonCalculator.
+//
+// Fixed and transition gestures work at a few fps while moving and writing
+// gestures follow the hand; running the whole graph at full rate only
+// while the latter are latched saves most of the CPU of an idle unit.
+// Placed before the FlowLimiterCalculator, the dropped frames never reach
+// the models.
+//
+// Input:
+//   IMAGE: frames of any type.
+//   FULL_RATE: one or more bool latch flags of gestureAutomatonCalculator,
+//     ie LATCH_MOVING and LATCH_WRITING; a true switches to full_fps.
+//     Back edges.
+//   CLEAR: gesture_clear of gestureAutomatonCalculator, switches
+//     back to idle_fps after full_rate_hold_s. Back edge.
+//
+// Output:
+//   IMAGE: the frames let through.
+//
+// Example config:
+// node {
+//   calculator: "FrameRateControllerCalculator"
+//   input_stream: "IMAGE:input_video"
+//   input_stream: "FULL_RATE:0:moving_gesture_flag"
+//   input_stream: "FULL_RATE:1:writing_gesture_flag"
+//   input_stream: "CLEAR:gesture_clear"
+//   input_stream_info: { tag_index: "FULL_RATE:0" back_edge: true }
+//   input_stream_info: { tag_index: "FULL_RATE:1" back_edge: true }
+//   input_stream_info: { tag_index: "CLEAR" back_edge: true }
+//   output_stream: "IMAGE:rate_controlled_input_video"
+//   options: {
+//     [mediapipe.FrameRateControllerCalculatorOptions.ext] {
+//       idle_fps: 10
+//     }
+//   }
+// }
+class FrameRateControllerCalculator : public CalculatorBase {
+ public:
+  static ::mediapipe::Status GetContract(CalculatorContract* cc);
+  ::mediapipe::Status Open(CalculatorContext* cc) override;
+  ::mediapipe::Status Process(CalculatorContext* cc) override;
+
+ private:
+  FrameRateControllerCalculatorOptions options_;
+  int64 idle_interval_us_ = 0;
+  int64 full_interval_us_ = 0;
+  bool full_rate_ = false;
+  Timestamp full_rate_until_ = Timestamp::Unset();
+  Timestamp last_frame_ = Timestamp::Unset();
+  Counter* dropped_counter_ = nullptr;
+};
+REGISTER_CALCULATOR(FrameRateControllerCalculator);
+
+::mediapipe::Status FrameRateControllerCalculator::GetContract(
+    CalculatorContract* cc) {
+  RET_CHECK(cc->Inputs().HasTag(kImageTag));
+  RET_CHECK(cc->Outputs().HasTag(kImageTag));
+  cc->Inputs().Tag(kImageTag).SetAny();
+  cc->Outputs().Tag(kImageTag).SetSameAs(&cc->Inputs().Tag(kImageTag));
+  for (CollectionItemId id = cc->Inputs().BeginId(kFullRateTag);
+       id < cc->Inputs().EndId(kFullRateTag); ++id) {
+    cc->Inputs().Get(id).Set<bool>();
+  }
+  if (cc->Inputs().HasTag(kClearTag)) {
+    cc->Inputs().Tag(kClearTag).Set<bool>();
+  }
+  // The feedback streams are behind the frames, as in FlowLimiterCalculator
+  cc->SetInputStreamHandler("ImmediateInputStreamHandler");
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status FrameRateControllerCalculator::Open(
+    CalculatorContext* cc) {
+  options_ = cc->Options<FrameRateControllerCalculatorOptions>();
+  RET_CHECK_GT(options_.idle_fps(), 0);
+  RET_CHECK_GE(options_.full_fps(), 0);
+  idle_interval_us_ = FrameIntervalUs(options_.idle_fps());
+  full_interval_us_ = FrameIntervalUs(options_.full_fps());
+  dropped_counter_ = cc->GetCounter(cc->NodeName() + "_dropped_frames");
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status FrameRateControllerCalculator::Process(
+    CalculatorContext* cc) {
+  for (CollectionItemId id = cc->Inputs().BeginId(kFullRateTag);
+       id < cc->Inputs().EndId(kFullRateTag); ++id) {
+    const auto& latch = cc->Inputs().Get(id);
+    if (!latch.IsEmpty() && latch.Get<bool>()) full_rate_ = true;
+  }
+  if (cc->Inputs().HasTag(kClearTag) &&
+      !cc->Inputs().Tag(kClearTag).IsEmpty() && full_rate_) {
+    full_rate_ = false;
+    full_rate_until_ =
+        cc->Inputs().Tag(kClearTag).Value().Timestamp() +
+        TimestampDiff(options_.full_rate_hold_s() *
+                      Timestamp::kTimestampUnitsPerSecond);
+  }
+
+  const auto& image = cc->Inputs().Tag(kImageTag);
+  if (image.IsEmpty()) return ::mediapipe::OkStatus();
+  const Timestamp timestamp = image.Value().Timestamp();
+  const bool full = full_rate_ || (full_rate_until_ != Timestamp::Unset() &&
+                                   timestamp < full_rate_until_);
+  const int64 interval_us = full ? full_interval_us_ : idle_interval_us_;
+  if (last_frame_ != Timestamp::Unset() &&
+      (timestamp - last_frame_).Value() < interval_us) {
+    dropped_counter_->Increment();
+    cc->Outputs().Tag(kImageTag).SetNextTimestampBound(
+        timestamp.NextAllowedInStream());
+    return ::mediapipe::OkStatus();
+  }
+  last_frame_ = timestamp;
+  cc->Outputs().Tag(kImageTag).AddPacket(image.Value());
+  return ::mediapipe::OkStatus();
+}
+
+}  // namespace mediapipe
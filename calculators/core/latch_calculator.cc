@@ -51,6 +51,10 @@ std::string ToString(LatchState state) {
 // in its state, and will remain doing so until a false is received
 // Optional RESET input, used to disable flowing when a true is received
 //
+// While closed the packets are dropped but the timestamp bounds of the data
+// outputs still advance, so the nodes downstream settle the frame right
+// away instead of waiting on their next packet.
+//
 // Takes multiple data input streams ,
 // as well as an optional STATE_CHANGE stream which downstream
 // calculators can use to respond to state-change events.
@@ -138,9 +142,8 @@ class LatchCalculator : public CalculatorBase {
     }
     last_latch_state_ = new_latch_state;
 
-    if (!latched) {
-      return ::mediapipe::OkStatus();
-    }
+    // SetOffset(0) already moves the output bounds past the dropped frames
+    if (!latched) return ::mediapipe::OkStatus();
 
     // Process data streams.
     for (int i = 0; i < num_data_streams_; ++i) {
@@ -155,7 +158,7 @@ class LatchCalculator : public CalculatorBase {
  private:
   LatchState last_latch_state_ = LATCH_UNINITIALIZED;
   int num_data_streams_;
-  bool latched;
+  bool latched = false;
   
 };
 REGISTER_CALCULATOR(LatchCalculator);
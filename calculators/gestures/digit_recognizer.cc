@@ -0,0 +1,109 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myMediapipe/calculators/gestures/digit_recognizer.h"
+
+#include <algorithm>
+
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "myMediapipe/calculators/tflite/model_cache.h"
+#include "myMediapipe/calculators/tflite/quantization.h"
+#include "myMediapipe/calculators/util/class_scores.h"
+#include "tensorflow/lite/kernels/register.h"
+
+namespace mediapipe {
+
+namespace {
+
+constexpr int kImagePixels =
+    StrokeRaster::kImageSize * StrokeRaster::kImageSize;
+
+}  // namespace
+
+::mediapipe::Status DigitRecognizer::Load(const std::string& model_path) {
+  ASSIGN_OR_RETURN(model_, model_cache::GetModel(model_path));
+
+  tflite::ops::builtin::BuiltinOpResolver op_resolver;
+  tflite::InterpreterBuilder(*model_, op_resolver)(&interpreter_);
+  RET_CHECK(interpreter_) << "Failed to build the interpreter.";
+  interpreter_->SetNumThreads(1);
+  RET_CHECK_EQ(interpreter_->AllocateTensors(), kTfLiteOk);
+
+  const TfLiteTensor* input = interpreter_->input_tensor(0);
+  RET_CHECK(input->type == kTfLiteFloat32 || input->type == kTfLiteUInt8 ||
+            input->type == kTfLiteInt8)
+      << "Unsupported digit model input type " << input->type;
+  int input_size = 1;
+  for (int i = 0; i < input->dims->size; ++i) {
+    input_size *= input->dims->data[i];
+  }
+  RET_CHECK_EQ(input_size, kImagePixels)
+      << "The digit model has to take a single 28x28 image.";
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status DigitRecognizer::Recognize(
+    const TrajectoryBuffer& trajectory, int* digit, float* score) {
+  RET_CHECK(interpreter_) << "No digit model loaded.";
+
+  raster_.Draw(trajectory);
+  TfLiteTensor* input = interpreter_->input_tensor(0);
+  switch (input->type) {
+    case kTfLiteUInt8:
+      QuantizeImage<uint8>(input);
+      break;
+    case kTfLiteInt8:
+      QuantizeImage<int8>(input);
+      break;
+    default:
+      std::copy(raster_.image(), raster_.image() + kImagePixels,
+                interpreter_->typed_input_tensor<float>(0));
+  }
+  RET_CHECK_EQ(interpreter_->Invoke(), kTfLiteOk);
+
+  const TfLiteTensor* output = interpreter_->output_tensor(0);
+  const int num_digits = output->dims->data[output->dims->size - 1];
+  RET_CHECK_GT(num_digits, 0);
+  switch (output->type) {
+    case kTfLiteUInt8:
+      *digit = class_scores::ArgMax(output->data.uint8, num_digits);
+      *score = quantization::Dequantize(output->data.uint8[*digit],
+                                        output->params.scale,
+                                        output->params.zero_point);
+      break;
+    case kTfLiteInt8:
+      *digit = class_scores::ArgMax(output->data.int8, num_digits);
+      *score = quantization::Dequantize(output->data.int8[*digit],
+                                        output->params.scale,
+                                        output->params.zero_point);
+      break;
+    default:
+      *digit = class_scores::ArgMax(output->data.f, num_digits);
+      *score = output->data.f[*digit];
+  }
+  return ::mediapipe::OkStatus();
+}
+
+template <typename T>
+void DigitRecognizer::QuantizeImage(TfLiteTensor* input) {
+  T* pixels = reinterpret_cast<T*>(input->data.raw);
+  const float* image = raster_.image();
+  for (int i = 0; i < kImagePixels; ++i) {
+    pixels[i] = quantization::Quantize<T>(image[i], input->params.scale,
+                                          input->params.zero_point);
+  }
+}
+
+}  // namespace mediapipe
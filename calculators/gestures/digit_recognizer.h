@@ -0,0 +1,55 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_CALCULATORS_GESTURES_DIGIT_RECOGNIZER_H_
+#define MYMEDIAPIPE_CALCULATORS_GESTURES_DIGIT_RECOGNIZER_H_
+
+#include <memory>
+#include <string>
+
+#include "mediapipe/framework/port/status.h"
+#include "myMediapipe/calculators/gestures/stroke_raster.h"
+#include "myMediapipe/calculators/gestures/trajectory_buffer.h"
+#include "tensorflow/lite/interpreter.h"
+#include "tensorflow/lite/model.h"
+
+namespace mediapipe {
+
+// Recognizes the digit drawn by a writing gesture. The trajectory is drawn
+// as a 28x28 MNIST like image (see StrokeRaster) and fed to a float or
+// quantized TfLite model with a {1,28,28,1} input and one score per digit,
+// ie the one of projects/dynamicGestures/train_digit_model.py. The model
+// is shared with the other graphs of the process through model_cache.
+class DigitRecognizer {
+ public:
+  ::mediapipe::Status Load(const std::string& model_path);
+  bool loaded() const { return interpreter_ != nullptr; }
+
+  // Best digit of the drawing and its score in [0,1]
+  ::mediapipe::Status Recognize(const TrajectoryBuffer& trajectory,
+                                int* digit, float* score);
+
+ private:
+  template <typename T>
+  void QuantizeImage(TfLiteTensor* input);
+
+  StrokeRaster raster_;
+  // Shared with the other graphs, outlives interpreter_
+  std::shared_ptr<const tflite::FlatBufferModel> model_;
+  std::unique_ptr<tflite::Interpreter> interpreter_;
+};
+
+}  // namespace mediapipe
+
+#endif  // MYMEDIAPIPE_CALCULATORS_GESTURES_DIGIT_RECOGNIZER_H_
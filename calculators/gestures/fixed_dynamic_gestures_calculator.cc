@@ -13,15 +13,23 @@
 // limitations under the License.
 
 //#include <memory>
+#include <algorithm>
+#include <utility>
 
 #include "myMediapipe/calculators/gestures/fixed_dynamic_gestures_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
+#include "myMediapipe/calculators/util/calculator_stats.h"
 #include "mediapipe/framework/formats/detection.pb.h"
 #include "mediapipe/framework/formats/landmark.pb.h"
 #include "myMediapipe/framework/formats/angles.pb.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
 #include "mediapipe/framework/port/ret_check.h"
 #include "myMediapipe/framework/formats/mqtt_message.pb.h"
+#include "myMediapipe/calculators/gestures/gesture_dispatch.h"
+#include "myMediapipe/calculators/gestures/multi_hand.h"
+#include "myMediapipe/calculators/gestures/reloadable_table.h"
 #include <string>
+#include <unordered_map>
 
 namespace mediapipe {
 
@@ -40,6 +48,32 @@ typedef std::vector<Angle> Angles;
 typedef std::vector<NormalizedLandmark> Landmarks;
 typedef std::vector<Mqtt_Message> MqttMessages;
 
+// Message sent while the angle is within [angle_limit_neg, angle_limit_pos]
+struct AngleCommand {
+  float angle_limit_pos;
+  float angle_limit_neg;
+  Mqtt_Message message;
+};
+
+// Flat copy of a fixedActionMap, messages are built once at Open
+struct FixedAction {
+  int start_action;
+  // Whether the message depends on the angle of landmark_id
+  bool has_landmark_id;
+  int landmark_id;
+  int angle_number;
+  float time_between_actions;
+  bool auto_repeat;
+  std::vector<AngleCommand> angle_commands;
+  // Sent when the action has no landmark_id
+  Mqtt_Message message;
+};
+
+// Action in progress for one hand
+struct HandState {
+  const FixedAction* currentAction = nullptr;
+  LastGesture lastGesture = {};
+};
 
 
 constexpr char kDetectionTag[] = "DETECTIONS";
@@ -48,26 +82,73 @@ constexpr char kAnglesTag[] = "ANGLES";
 constexpr char kFlagTag[] = "FLAG";
 constexpr char kMqttMessageTag[] = "MQTT_MESSAGE";
  
-void clear(fixedActionMap &currentAction,
+void clear(const FixedAction* &currentAction,
            LastGesture& lastGesture) {
   
-  currentAction.Clear();
+  currentAction = nullptr;
   lastGesture = (struct LastGesture){0};
 }
 
 void setLastGesture(LastGesture& lastGesture,
-                    fixedActionMap currentAction,
+                    const FixedAction& currentAction,
                     decltype(Timestamp().Seconds()) lastGestureTime){
   
-  lastGesture.start_action= currentAction.start_action();
+  lastGesture.start_action= currentAction.start_action;
   lastGesture.time=lastGestureTime;
   lastGesture.notEmpty= true;
 }
 
-decltype(Angle().angle1()) getAngle(int angleNumber, int lmId, const Angles angles){
+// handOffset is the position of the hand angles, see multi_hand.h
+decltype(Angle().angle1()) getAngle(int angleNumber, int lmId, int handOffset,
+                                    const Angles& angles){
   // TODO: replace this literal (by changing the field angle in Angle message to repeated)
-  if(angleNumber==1) return angles[lmId].angle1();
-  else return angles[lmId].angle2();
+  if(angleNumber==1) return angles[handOffset + lmId].angle1();
+  else return angles[handOffset + lmId].angle2();
+}
+
+typedef gesture_dispatch::DispatchTable<FixedAction> ActionsMap;
+
+::mediapipe::Status BuildActionsMap(
+    const fixedDynamicGesturesCalculatorOptions& options,
+    ActionsMap* actionsMap) {
+  for (const auto& act_ : options.fixed_actions_map()) {
+    FixedAction action;
+    action.start_action = act_.start_action();
+    action.has_landmark_id = act_.has_landmark_id();
+    action.landmark_id = act_.landmark_id();
+    action.angle_number = act_.angle_number();
+    action.time_between_actions = act_.time_between_actions();
+    action.auto_repeat = act_.auto_repeat();
+    if (action.has_landmark_id) {
+      RET_CHECK(act_.has_angle_number())
+        << "angle_number not provided";
+      RET_CHECK_EQ(act_.angle_limits().size(), act_.mqtt_message().size())
+        << "Command should have the same number of entries as angle_limits";
+      for (int i = 0; i < act_.angle_limits().size(); i++) {
+        AngleCommand command;
+        command.angle_limit_pos = act_.angle_limits(i).angle_limit_pos();
+        command.angle_limit_neg = act_.angle_limits(i).angle_limit_neg();
+        command.message.set_topic(act_.mqtt_message(i).topic());
+        command.message.set_payload(act_.mqtt_message(i).payload());
+        action.angle_commands.emplace_back(std::move(command));
+      }
+    } else {
+      RET_CHECK_GE(act_.mqtt_message().size(), 1)
+        << "mqtt_message not provided";
+      action.message.set_topic(act_.mqtt_message(0).topic());
+      action.message.set_payload(act_.mqtt_message(0).payload());
+    }
+    actionsMap->Add(action.start_action, std::move(action));
+  }
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status ParseActionsMap(const std::string& contents,
+                                    ActionsMap* actionsMap) {
+  fixedDynamicGesturesCalculatorOptions options;
+  RET_CHECK(ParseTextProto(contents, &options))
+      << "Not a fixedDynamicGesturesCalculatorOptions";
+  return BuildActionsMap(options, actionsMap);
 }
 
 }  // namespace
@@ -77,9 +158,19 @@ decltype(Angle().angle1()) getAngle(int angleNumber, int lmId, const Angles angl
 // fixed gesture used in momentary actions,
 //          ie mute while the gesture is present 
 
+// Each detection is tracked by its hand (detection_id), the angles of
+// hand N are taken from [N*21, N*21+21) of the angles vector. The ids are
+// positional (see multi_hand.h), every hand is expired on every frame, so
+// a hand that leaves mid action times out even without detections. A held
+// gesture fires once, then repeats every time_between_actions with
+// auto_repeat, until fixed_time_out_s after its last message.
+//
+// With actions_map_file the actions map is read from that file and
+// reloaded when it changes; the actions in progress are dropped.
+//
 // Input:
 //  LANDMARKS: used actions requiering hand location
-//  DETECTION: the current detected static gesture.
+//  DETECTION: the current detected static gesture of each hand.
 //  ANGLES;
 //
 // Output:
@@ -127,17 +218,25 @@ class fixedDynamicGesturesCalculator : public CalculatorBase {
   ::mediapipe::Status Process(CalculatorContext* cc) override;
   
   private:
-  ::mediapipe::Status executeAction(fixedActionMap& currentAction,
+  ::mediapipe::Status ProcessHand(const int32 label_id, const int handOffset,
+                                  HandState& hand, const Angles& angles,
+                                  CalculatorContext* cc);
+  void executeAction(const FixedAction* &currentAction,
                                     LastGesture& lastGesture,
                                     decltype(Timestamp().Seconds()) GestureTime,
-                                    const Angles angles,
+                                    const int handOffset,
+                                    const Angles& angles,
                                     CalculatorContext* cc);
   
   ::mediapipe::fixedDynamicGesturesCalculatorOptions options_;
-  fixedActionMap currentAction;
-  LastGesture lastGesture;
+  std::unordered_map<int, HandState> hands;
+  // start_action -> action
+  ReloadableTable<ActionsMap> actionsMap;
   MqttMessages mqttMessages;
   
+  // Shared by every FLAG packet, so idle frames don't allocate
+  Packet flagPacket_;
+  calculator_stats::NodeStats* stats_ = nullptr;
 };
 REGISTER_CALCULATOR(fixedDynamicGesturesCalculator);
 
@@ -170,30 +269,79 @@ REGISTER_CALCULATOR(fixedDynamicGesturesCalculator);
 ::mediapipe::Status fixedDynamicGesturesCalculator::Open(
     CalculatorContext* cc) {
   cc->SetOffset(TimestampDiff(0));
+  stats_ = calculator_stats::ForNode(cc->NodeName());
+  flagPacket_ = MakePacket<bool>(true);
   options_ = cc->Options<::mediapipe::fixedDynamicGesturesCalculatorOptions>();
   RET_CHECK_GE(options_.fixed_actions_map_size(),0) 
     << "You should at least provide one action map";
-  return ::mediapipe::OkStatus();
+
+  if (options_.has_actions_map_file()) {
+    return actionsMap.Watch(options_.actions_map_file(),
+                            absl::Seconds(options_.reload_interval_s()),
+                            ParseActionsMap);
+  }
+  return BuildActionsMap(options_, actionsMap.mutable_table());
 }
 
 ::mediapipe::Status fixedDynamicGesturesCalculator::Process(
     CalculatorContext* cc) {
-      
-  RET_CHECK(!cc->Inputs().Tag(kDetectionTag).IsEmpty());
-  const auto& input_detections =
-        cc->Inputs().Tag(kDetectionTag).Get<Detections>();
-  const auto& input_detection = input_detections.back();
-  const int32 label_id = input_detection.label_id().Get(0);
-  
-  RET_CHECK(!cc->Inputs().Tag(kNormLandmarksTag).IsEmpty());
-  const auto &landmarks = cc->Inputs()
-                              .Tag(kNormLandmarksTag)
-                              .Get<std::vector<NormalizedLandmark>>();
-  RET_CHECK(!cc->Inputs().Tag(kAnglesTag).IsEmpty());
-  const auto &angles = cc->Inputs()
-                              .Tag(kAnglesTag)
-                              .Get<std::vector<Angle>>();
-  
+  calculator_stats::ScopedProcessTimer timer(stats_);
+  // The hands point into the previous map
+  if (actionsMap.Refresh()) hands.clear();
+
+  if (!cc->Inputs().Tag(kDetectionTag).IsEmpty()) {
+    const auto& input_detections =
+          cc->Inputs().Tag(kDetectionTag).Get<Detections>();
+
+    RET_CHECK(!cc->Inputs().Tag(kNormLandmarksTag).IsEmpty());
+    RET_CHECK(!cc->Inputs().Tag(kAnglesTag).IsEmpty());
+    const auto &angles = cc->Inputs()
+                                .Tag(kAnglesTag)
+                                .Get<std::vector<Angle>>();
+
+    for (const auto& input_detection : input_detections) {
+      const int hand_id = multi_hand::HandId(input_detection);
+      RET_CHECK(multi_hand::HasHand(hand_id, angles.size()))
+          << "No angles for hand " << hand_id;
+      MP_RETURN_IF_ERROR(ProcessHand(input_detection.label_id().Get(0),
+                                     multi_hand::HandOffset(hand_id),
+                                     hands[hand_id], angles, cc));
+    }
+  }
+
+  // executeAction always leaves currentAction empty, the last gesture is
+  // what paces the repeats, so a hand is kept until it times out
+  const auto now = cc->InputTimestamp().Seconds();
+  multi_hand::EraseHandsIf(&hands, [&](const HandState& hand) {
+    return !hand.lastGesture.notEmpty ||
+           now - hand.lastGesture.time >= options_.fixed_time_out_s();
+  });
+
+  if(!mqttMessages.empty()){
+    cc->Outputs().Tag(kMqttMessageTag)
+        .Add(new MqttMessages(std::move(mqttMessages)),
+             cc->InputTimestamp().NextAllowedInStream());
+    mqttMessages.clear();
+  }
+
+  const bool busy =
+      std::any_of(hands.begin(), hands.end(), [](const auto& hand) {
+        return hand.second.currentAction != nullptr;
+      });
+  if(!busy) 
+     cc->Outputs().Tag(kFlagTag)
+      .AddPacket(flagPacket_.At(
+          cc->InputTimestamp().NextAllowedInStream()));
+
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status fixedDynamicGesturesCalculator::ProcessHand(
+    const int32 label_id, const int handOffset, HandState& hand,
+    const Angles& angles, CalculatorContext* cc) {
+  const FixedAction* &currentAction = hand.currentAction;
+  LastGesture& lastGesture = hand.lastGesture;
+
   // std::cout << "\n\t\t dbg:" << std::to_string(lastGesture.notEmpty)
   //           << "\t :" << std::to_string(lastGesture.start_action)
   //           << "\t :" << std::to_string(lastGesture.start_action)
@@ -202,29 +350,19 @@ REGISTER_CALCULATOR(fixedDynamicGesturesCalculator);
      (lastGesture.start_action!=label_id))
     clear(currentAction, lastGesture);
   
-  if (!currentAction.IsInitialized()){
-    for(auto act_ : options_.fixed_actions_map()){
-      if(act_.start_action()==label_id){
-        currentAction = act_;
-        if(currentAction.has_landmark_id()){ 
-          RET_CHECK(currentAction.has_angle_number())
-            << "angle_number not provided";
-           RET_CHECK_EQ(currentAction.angle_limits().size(),currentAction.mqtt_message().size())
-             << "Command should have the same number of entries as angle_limits";
-        }
-      } 
-    }
+  if (currentAction == nullptr){
+    currentAction = actionsMap.get().Find(label_id);
     //no gesture found 
-    if(!currentAction.IsInitialized()){
+    if(currentAction == nullptr){
       clear(currentAction, lastGesture);
     }
   }
-  if (currentAction.IsInitialized()){
+  if (currentAction != nullptr){
 
     //  std::cout << "\n !!Gesture:" << std::to_string(label_id)
-    //              << "\t :" << std::to_string(currentAction.start_action())
-    //              << "\t :" << std::to_string(currentAction.time_between_actions())
-    //              << "\t :" << std::to_string(currentAction.auto_repeat())
+    //              << "\t :" << std::to_string(currentAction->start_action)
+    //              << "\t :" << std::to_string(currentAction->time_between_actions)
+    //              << "\t :" << std::to_string(currentAction->auto_repeat)
     //              << "\t angle :" << std::to_string(angles[0].angle1())
                  
     //              << "\t :" << std::to_string(cc->InputTimestamp().Seconds())
@@ -236,17 +374,17 @@ REGISTER_CALCULATOR(fixedDynamicGesturesCalculator);
     if(!lastGesture.notEmpty){
       executeAction(currentAction,lastGesture,
                     cc->InputTimestamp().Seconds(),
-                    angles,
+                    handOffset, angles,
                     cc);                            
     }
     
     else{
-      if(currentAction.auto_repeat() && 
+      if(currentAction->auto_repeat && 
          ((cc->InputTimestamp().Seconds() - 
-          lastGesture.time) >= currentAction.time_between_actions()))
+          lastGesture.time) >= currentAction->time_between_actions))
           executeAction(currentAction,lastGesture,
                         cc->InputTimestamp().Seconds(),
-                        angles,
+                        handOffset, angles,
                         cc);
     }
     
@@ -258,58 +396,44 @@ REGISTER_CALCULATOR(fixedDynamicGesturesCalculator);
     }
 
   }
-  if(!currentAction.IsInitialized()) 
-     cc->Outputs().Tag(kFlagTag)
-      .AddPacket(MakePacket<bool>(true)
-                            .At(cc->InputTimestamp()
-                            .NextAllowedInStream()));
-
   return ::mediapipe::OkStatus();
 }
 
-::mediapipe::Status
-   fixedDynamicGesturesCalculator::executeAction(fixedActionMap& currentAction,
+void fixedDynamicGesturesCalculator::executeAction(
+                   const FixedAction* &currentAction,
                    LastGesture& lastGesture,
                    decltype(Timestamp().Seconds()) GestureTime,
-                   const Angles angles,
+                   const int handOffset,
+                   const Angles& angles,
                    CalculatorContext* cc){
   
-  Mqtt_Message currCommand;
-  currCommand.set_topic("empty");
+  const Mqtt_Message* currCommand = nullptr;
 
-  if(currentAction.has_landmark_id()){ 
+  if(currentAction->has_landmark_id){ 
     
-    const auto currAngle = getAngle(currentAction.angle_number(),
-                                    currentAction.landmark_id(),
-                                    angles);
+    const auto currAngle = getAngle(currentAction->angle_number,
+                                    currentAction->landmark_id,
+                                    handOffset, angles);
     
-    for(int i=0;i<currentAction.angle_limits().size();i++){
-      if((currAngle<=currentAction.angle_limits(i).angle_limit_pos()) &&
-        (currAngle>=currentAction.angle_limits(i).angle_limit_neg())){
+    for(const auto& command : currentAction->angle_commands){
+      if((currAngle<=command.angle_limit_pos) &&
+        (currAngle>=command.angle_limit_neg)){
       
-        currCommand.set_topic(currentAction.mqtt_message(i).topic());
-        currCommand.set_payload(currentAction.mqtt_message(i).payload());
+        currCommand = &command.message;
       } 
     }
   }
   else{
-    currCommand.set_topic(currentAction.mqtt_message(0).topic());
-    currCommand.set_payload(currentAction.mqtt_message(0).payload());
+    currCommand = &currentAction->message;
   }
 
-  if(currCommand.topic().compare("empty") != 0){
-    setLastGesture(lastGesture, currentAction, GestureTime);
-    //  std::cout << "\n !!Action:" << std::to_string(currentAction.start_action())
-    //        << "\t :" << currCommand.payload(); 
-     mqttMessages.emplace_back(currCommand);
-     cc->Outputs().Tag(kMqttMessageTag)
-         .AddPacket(MakePacket<MqttMessages>(mqttMessages)
-         .At(cc->InputTimestamp()
-         .NextAllowedInStream()));        
+  if(currCommand != nullptr){
+    setLastGesture(lastGesture, *currentAction, GestureTime);
+    //  std::cout << "\n !!Action:" << std::to_string(currentAction->start_action)
+    //        << "\t :" << currCommand->payload(); 
+     mqttMessages.emplace_back(*currCommand);
   }
-  currentAction.Clear();
-  mqttMessages.clear();
-  return ::mediapipe::OkStatus();
+  currentAction = nullptr;
 }
 
 
@@ -0,0 +1,127 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/calculator_runner.h"
+#include "mediapipe/framework/formats/detection.pb.h"
+#include "mediapipe/framework/formats/landmark.pb.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "myMediapipe/calculators/gestures/multi_hand.h"
+#include "myMediapipe/framework/formats/angles.pb.h"
+#include "myMediapipe/framework/formats/mqtt_message.pb.h"
+
+namespace mediapipe {
+namespace {
+
+constexpr int kMuteGesture = 1;
+// Frames of a held gesture are 100 ms apart
+constexpr int64 kFrameIntervalUs = 100000;
+
+CalculatorGraphConfig::Node MakeNode(bool auto_repeat) {
+  return ParseTextProtoOrDie<CalculatorGraphConfig::Node>(absl::StrCat(R"(
+    calculator: "fixedDynamicGesturesCalculator"
+    input_stream: "NORM_LANDMARKS:landmarks"
+    input_stream: "DETECTIONS:detections"
+    input_stream: "ANGLES:angles"
+    output_stream: "FLAG:flag"
+    output_stream: "MQTT_MESSAGE:messages"
+    options {
+      [mediapipe.fixedDynamicGesturesCalculatorOptions.ext] {
+        fixed_time_out_s: 1.5
+        fixed_actions_map {
+          start_action: 1
+          time_between_actions: 0.5
+          auto_repeat: )",
+      auto_repeat ? "true" : "false", R"(
+          mqtt_message { topic: "tv" payload: "KEY_MUTE" }
+        }
+      }
+    }
+  )"));
+}
+
+// Feeds the gesture on one hand for num_frames frames
+void HoldGesture(int label_id, int num_frames, CalculatorRunner* runner) {
+  for (int i = 0; i < num_frames; ++i) {
+    const Timestamp timestamp(i * kFrameIntervalUs);
+    Detection detection;
+    detection.add_label_id(label_id);
+    runner->MutableInputs()
+        ->Tag("DETECTIONS")
+        .packets.push_back(
+            MakePacket<std::vector<Detection>>(1, detection).At(timestamp));
+    runner->MutableInputs()
+        ->Tag("NORM_LANDMARKS")
+        .packets.push_back(MakePacket<std::vector<NormalizedLandmark>>(
+                               multi_hand::kLandmarksPerHand)
+                               .At(timestamp));
+    runner->MutableInputs()
+        ->Tag("ANGLES")
+        .packets.push_back(
+            MakePacket<std::vector<Angle>>(multi_hand::kLandmarksPerHand)
+                .At(timestamp));
+  }
+}
+
+// Timestamps in us of the messages, one per message
+std::vector<int64> MessageTimes(const CalculatorRunner& runner) {
+  std::vector<int64> times;
+  for (const Packet& packet : runner.Outputs().Tag("MQTT_MESSAGE").packets) {
+    for (const auto& message : packet.Get<std::vector<Mqtt_Message>>()) {
+      EXPECT_EQ(message.payload(), "KEY_MUTE");
+      times.push_back(packet.Timestamp().Value());
+    }
+  }
+  return times;
+}
+
+TEST(FixedDynamicGesturesCalculatorTest, HeldGestureRepeatsEveryInterval) {
+  CalculatorRunner runner(MakeNode(/*auto_repeat=*/true));
+  // 0 to 1.0 s
+  HoldGesture(kMuteGesture, 11, &runner);
+  MP_ASSERT_OK(runner.Run());
+
+  // Fired at 0 s, then repeated at 0.5 s and 1.0 s
+  const std::vector<int64> expected = {1, 500001, 1000001};
+  EXPECT_EQ(MessageTimes(runner), expected);
+}
+
+TEST(FixedDynamicGesturesCalculatorTest, HeldGestureFiresOnceWithoutRepeat) {
+  CalculatorRunner runner(MakeNode(/*auto_repeat=*/false));
+  // 0 to 1.4 s, within fixed_time_out_s of the first message
+  HoldGesture(kMuteGesture, 15, &runner);
+  MP_ASSERT_OK(runner.Run());
+
+  const std::vector<int64> expected = {1};
+  EXPECT_EQ(MessageTimes(runner), expected);
+}
+
+TEST(FixedDynamicGesturesCalculatorTest, HeldGestureFiresAgainAfterTimeOut) {
+  CalculatorRunner runner(MakeNode(/*auto_repeat=*/false));
+  // 0 to 2.0 s, the hand times out 1.5 s after the first message
+  HoldGesture(kMuteGesture, 21, &runner);
+  MP_ASSERT_OK(runner.Run());
+
+  const std::vector<int64> expected = {1, 1600001};
+  EXPECT_EQ(MessageTimes(runner), expected);
+}
+
+}  // namespace
+}  // namespace mediapipe
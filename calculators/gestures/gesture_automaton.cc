@@ -0,0 +1,228 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myMediapipe/calculators/gestures/gesture_automaton.h"
+
+#include <limits>
+#include <utility>
+
+#include "mediapipe/framework/port/ret_check.h"
+
+namespace mediapipe {
+namespace gesture_automaton {
+
+namespace {
+
+using gesture_dispatch::GestureClass;
+
+// Adds the record of a label to records, replacing the previous record of
+// the label: the last one wins, like in the dynamic gestures calculators
+template <class Record>
+void AddRecord(int label_id, Record record, std::vector<int>* label_records,
+               std::vector<Record>* records) {
+  if (label_id < 0) return;
+  if (label_id >= static_cast<int>(label_records->size())) {
+    label_records->resize(label_id + 1, -1);
+  }
+  int& index = (*label_records)[label_id];
+  if (index >= 0) {
+    (*records)[index] = std::move(record);
+    return;
+  }
+  index = records->size();
+  records->emplace_back(std::move(record));
+}
+
+MovingAction MakeMovingAction(const movingActionMap& act) {
+  MovingAction action;
+  action.action_type = act.action_type();
+  action.landmark_id = act.landmark_id();
+  action.angle_number = act.angle_number();
+  action.action_threshold = act.action_threshold();
+  action.time_between_actions = act.time_between_actions();
+  action.auto_repeat = act.auto_repeat();
+  action.has_max_repeat = act.has_max_repeat();
+  action.max_repeat = act.max_repeat();
+  action.positive_message.set_topic(act.topic());
+  action.positive_message.set_payload(act.positive_payload());
+  action.negative_message.set_topic(act.topic());
+  action.negative_message.set_payload(act.negative_payload());
+  return action;
+}
+
+::mediapipe::Status MakeFixedAction(const fixedActionMap& act,
+                                    FixedAction* action) {
+  action->start_action = act.start_action();
+  action->has_landmark_id = act.has_landmark_id();
+  action->landmark_id = act.landmark_id();
+  action->angle_number = act.angle_number();
+  action->time_between_actions = act.time_between_actions();
+  action->auto_repeat = act.auto_repeat();
+  if (action->has_landmark_id) {
+    RET_CHECK(act.has_angle_number()) << "angle_number not provided";
+    RET_CHECK_EQ(act.angle_limits().size(), act.mqtt_message().size())
+        << "Command should have the same number of entries as angle_limits";
+    for (int i = 0; i < act.angle_limits().size(); i++) {
+      AngleCommand command;
+      command.angle_limit_pos = act.angle_limits(i).angle_limit_pos();
+      command.angle_limit_neg = act.angle_limits(i).angle_limit_neg();
+      command.message.set_topic(act.mqtt_message(i).topic());
+      command.message.set_payload(act.mqtt_message(i).payload());
+      action->angle_commands.emplace_back(std::move(command));
+    }
+  } else {
+    RET_CHECK_GE(act.mqtt_message().size(), 1) << "mqtt_message not provided";
+    action->message.set_topic(act.mqtt_message(0).topic());
+    action->message.set_payload(act.mqtt_message(0).payload());
+  }
+  return ::mediapipe::OkStatus();
+}
+
+// Action of the label in label_records, -1 if none
+int RecordOf(const std::vector<int>& label_records, int label_id) {
+  return label_id < static_cast<int>(label_records.size())
+             ? label_records[label_id]
+             : -1;
+}
+
+}  // namespace
+
+constexpr int Program::kIdleState;
+
+::mediapipe::Status Program::Compile(
+    const gestureAutomatonCalculatorOptions& options,
+    const std::vector<GestureClass>& classes) {
+  options_ = options;
+
+  // label_id -> position in the records
+  std::vector<int> transition_labels;
+  std::vector<int> moving_labels;
+  std::vector<int> fixed_labels;
+  int num_labels = classes.size();
+  for (const auto& act : options.transition().actions_map()) {
+    TransitionAction action;
+    action.end_action = act.end_action();
+    action.message.set_topic(act.mqtt_message().topic());
+    action.message.set_payload(act.mqtt_message().payload());
+    AddRecord(act.start_action(), std::move(action), &transition_labels,
+              &transition_actions_);
+    num_labels = std::max(num_labels, act.end_action() + 1);
+  }
+  for (const auto& act : options.moving().moving_actions_map()) {
+    AddRecord(act.start_action(), MakeMovingAction(act), &moving_labels,
+              &moving_actions_);
+  }
+  for (const auto& act : options.fixed().fixed_actions_map()) {
+    FixedAction action;
+    MP_RETURN_IF_ERROR(MakeFixedAction(act, &action));
+    AddRecord(act.start_action(), std::move(action), &fixed_labels,
+              &fixed_actions_);
+  }
+  for (const auto& act : options.writing().writing_actions_map()) {
+    Mqtt_Message message;
+    message.set_topic(act.topic());
+    message.set_payload(act.payload());
+    digit_messages_.Add(act.digit(), std::move(message));
+  }
+  for (const auto* labels : {&transition_labels, &moving_labels,
+                              &fixed_labels}) {
+    num_labels = std::max<int>(num_labels, labels->size());
+  }
+  num_labels_ = num_labels;
+
+  // Idle, writing, then the states of the actions in record order
+  const int writing_state = 1;
+  const int first_transition = 2;
+  const int first_moving = first_transition + transition_actions_.size();
+  const int first_fixed = first_moving + moving_actions_.size();
+  states_.push_back({Behavior::kIdle, -1});
+  states_.push_back({Behavior::kWriting, -1});
+  for (int i = 0; i < static_cast<int>(transition_actions_.size()); ++i) {
+    states_.push_back({Behavior::kTransition, i});
+  }
+  for (int i = 0; i < static_cast<int>(moving_actions_.size()); ++i) {
+    states_.push_back({Behavior::kMoving, i});
+  }
+  for (int i = 0; i < static_cast<int>(fixed_actions_.size()); ++i) {
+    states_.push_back({Behavior::kFixed, i});
+  }
+  const int num_states = states_.size();
+  RET_CHECK_LE(num_states, std::numeric_limits<int16>::max())
+      << "Too many actions";
+
+  const int num_columns = num_labels_ + 1;
+  table_.resize(num_states * num_columns);
+  for (int state = 0; state < num_states; ++state) {
+    Transition* row = &table_[state * num_columns];
+    for (int label = 0; label < num_columns; ++label) {
+      row[label] = {Op::kStay, static_cast<int16>(state)};
+    }
+    switch (states_[state].behavior) {
+      case Behavior::kIdle:
+        for (int label = 0; label < num_labels_; ++label) {
+          const GestureClass gesture_class =
+              label < static_cast<int>(classes.size()) ? classes[label]
+                                                       : GestureClass::kNone;
+          int next_state = -1;
+          switch (gesture_class) {
+            case GestureClass::kTransition: {
+              const int action = RecordOf(transition_labels, label);
+              if (action >= 0) next_state = first_transition + action;
+              break;
+            }
+            case GestureClass::kMoving: {
+              const int action = RecordOf(moving_labels, label);
+              if (action >= 0) next_state = first_moving + action;
+              break;
+            }
+            case GestureClass::kWriting:
+              if (options.has_writing()) next_state = writing_state;
+              break;
+            case GestureClass::kFixed: {
+              const int action = RecordOf(fixed_labels, label);
+              if (action >= 0) next_state = first_fixed + action;
+              break;
+            }
+            case GestureClass::kNone:
+              break;
+          }
+          if (next_state >= 0) {
+            row[label] = {Op::kEnter, static_cast<int16>(next_state)};
+          }
+        }
+        break;
+      case Behavior::kTransition: {
+        const int end_action =
+            transition_actions_[states_[state].action].end_action;
+        if (end_action >= 0) row[end_action] = {Op::kFire, kIdleState};
+        break;
+      }
+      case Behavior::kFixed: {
+        const int start_action =
+            fixed_actions_[states_[state].action].start_action;
+        for (int label = 0; label < num_columns; ++label) {
+          if (label != start_action) row[label] = {Op::kLeave, kIdleState};
+        }
+        break;
+      }
+      case Behavior::kMoving:
+      case Behavior::kWriting:
+        break;
+    }
+  }
+  return ::mediapipe::OkStatus();
+}
+
+}  // namespace gesture_automaton
+}  // namespace mediapipe
@@ -0,0 +1,235 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_CALCULATORS_GESTURES_GESTURE_AUTOMATON_H_
+#define MYMEDIAPIPE_CALCULATORS_GESTURES_GESTURE_AUTOMATON_H_
+
+#include <algorithm>
+#include <vector>
+
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/status.h"
+#include "myMediapipe/calculators/gestures/gesture_automaton_calculator.pb.h"
+#include "myMediapipe/calculators/gestures/gesture_dispatch.h"
+#include "myMediapipe/framework/formats/mqtt_message.pb.h"
+
+namespace mediapipe {
+namespace gesture_automaton {
+
+// Hashed timer wheel. A timer goes to the slot of the tick of its
+// deadline, Advance visits the slots of the ticks elapsed since the last
+// call (all of them at most once) and fires the timers that are due, the
+// ones of a later round stay in their slot. Scheduling is O(1) and a frame
+// only visits a few slots, whatever the number of timers.
+//
+// Timers are never removed: every timer carries the generation of its key
+// at the time it was scheduled, and the owner ignores the ones whose
+// generation is stale.
+//
+// Example:
+//   TimerWheel wheel(256, 10000);
+//   wheel.Schedule(now_us + 1500000, hand_id, ++generation[hand_id]);
+//   wheel.Advance(now_us, [&](int key, int generation) {
+//     if (generation == generation[key]) Expire(key);
+//   });
+class TimerWheel {
+ public:
+  TimerWheel(int num_slots, int64 tick_us)
+      : slots_(std::max(num_slots, 1)),
+        tick_us_(std::max<int64>(tick_us, 1)) {}
+
+  // Fires at the first Advance with now_us >= deadline_us
+  void Schedule(int64 deadline_us, int key, int generation) {
+    // A deadline already past goes to the slot Advance visits next
+    const int64 tick = std::max(deadline_us / tick_us_, current_tick_);
+    slots_[tick % slots_.size()].push_back({deadline_us, key, generation});
+  }
+
+  // Calls fn(key, generation) for every timer due at now_us
+  template <typename Fn>
+  void Advance(int64 now_us, Fn fn) {
+    const int64 now_tick = now_us / tick_us_;
+    if (now_tick < current_tick_) return;
+    const int64 num_ticks = std::min<int64>(now_tick - current_tick_ + 1,
+                                            slots_.size());
+    for (int64 tick = now_tick - num_ticks + 1; tick <= now_tick; ++tick) {
+      std::vector<Timer>& slot = slots_[tick % slots_.size()];
+      if (slot.empty()) continue;
+      // fn may schedule into this slot, so it walks a copy
+      scratch_.swap(slot);
+      for (const Timer& timer : scratch_) {
+        if (timer.deadline_us <= now_us) {
+          fn(timer.key, timer.generation);
+        } else {
+          slot.push_back(timer);
+        }
+      }
+      scratch_.clear();
+    }
+    // The current tick is visited again, it can still get timers
+    current_tick_ = now_tick;
+  }
+
+ private:
+  struct Timer {
+    int64 deadline_us;
+    int key;
+    int generation;
+  };
+
+  std::vector<std::vector<Timer>> slots_;
+  // Keeps its capacity between slots, so Advance doesn't allocate
+  std::vector<Timer> scratch_;
+  const int64 tick_us_;
+  int64 current_tick_ = 0;
+};
+
+// What a hand does in a state
+enum class Behavior { kIdle, kTransition, kMoving, kWriting, kFixed };
+
+// Effect of a label on a hand
+enum class Op {
+  // Nothing changes
+  kStay,
+  // Starts the action of next_state
+  kEnter,
+  // Publishes the message of the transition and goes back to idle
+  kFire,
+  // Goes back to idle, where the label is looked up again
+  kLeave,
+};
+
+struct Transition {
+  Op op;
+  int16 next_state;
+};
+
+struct TransitionAction {
+  int end_action;
+  Mqtt_Message message;
+};
+
+// Flat copy of a movingActionMap
+struct MovingAction {
+  movingActionMap::actType action_type;
+  int landmark_id;
+  int angle_number;
+  float action_threshold;
+  float time_between_actions;
+  bool auto_repeat;
+  bool has_max_repeat;
+  int max_repeat;
+  Mqtt_Message positive_message;
+  Mqtt_Message negative_message;
+};
+
+// Message sent while the angle is within [angle_limit_neg, angle_limit_pos]
+struct AngleCommand {
+  float angle_limit_pos;
+  float angle_limit_neg;
+  Mqtt_Message message;
+};
+
+// Flat copy of a fixedActionMap
+struct FixedAction {
+  int start_action;
+  // Whether the message depends on the angle of landmark_id
+  bool has_landmark_id;
+  int landmark_id;
+  int angle_number;
+  float time_between_actions;
+  bool auto_repeat;
+  std::vector<AngleCommand> angle_commands;
+  // Sent when the action has no landmark_id
+  Mqtt_Message message;
+};
+
+struct State {
+  Behavior behavior;
+  // Position of the action in the records of the behavior, -1 for idle
+  // and writing
+  int action;
+};
+
+// Every action map of gestureAutomatonCalculatorOptions compiled into one
+// flat table of states x labels. State 0 is idle, then come the writing
+// state and one state per transition, moving and fixed action. From idle,
+// a label enters the state of the action it starts in the map of its
+// class (see gestures_types_file_name). A transition fires on its end
+// label, a fixed action holds while its start label lasts and moving and
+// writing keep their hand until their timers or their own logic release
+// it. Labels outside the table share its last column.
+class Program {
+ public:
+  static constexpr int kIdleState = 0;
+
+  // Fills a new Program, classes holds the class of every label_id
+  ::mediapipe::Status Compile(
+      const gestureAutomatonCalculatorOptions& options,
+      const std::vector<gesture_dispatch::GestureClass>& classes);
+
+  const Transition& Next(int state, int label_id) const {
+    const int column =
+        label_id >= 0 && label_id < num_labels_ ? label_id : num_labels_;
+    return table_[state * (num_labels_ + 1) + column];
+  }
+
+  // Next, with a label leaving its state looked up again from idle, so the
+  // gesture that ends an action can start another one in the same frame.
+  // kLeave is only returned when the label starts nothing.
+  Transition Step(int state, int label_id) const {
+    const Transition& next = Next(state, label_id);
+    if (next.op != Op::kLeave) return next;
+    const Transition& from_idle = Next(kIdleState, label_id);
+    return from_idle.op == Op::kEnter ? from_idle : next;
+  }
+
+  const State& state(int state) const { return states_[state]; }
+  int num_states() const { return states_.size(); }
+
+  const TransitionAction& transition_action(int state) const {
+    return transition_actions_[states_[state].action];
+  }
+  const MovingAction& moving_action(int state) const {
+    return moving_actions_[states_[state].action];
+  }
+  const FixedAction& fixed_action(int state) const {
+    return fixed_actions_[states_[state].action];
+  }
+  // Message of a recognized digit, nullptr if none
+  const Mqtt_Message* digit_message(int digit) const {
+    return digit_messages_.Find(digit);
+  }
+
+  // The options compiled, with the timeouts and the writing parameters
+  const gestureAutomatonCalculatorOptions& options() const {
+    return options_;
+  }
+
+ private:
+  gestureAutomatonCalculatorOptions options_;
+  std::vector<State> states_;
+  // states x (num_labels_ + 1)
+  std::vector<Transition> table_;
+  int num_labels_ = 0;
+  std::vector<TransitionAction> transition_actions_;
+  std::vector<MovingAction> moving_actions_;
+  std::vector<FixedAction> fixed_actions_;
+  gesture_dispatch::DispatchTable<Mqtt_Message> digit_messages_;
+};
+
+}  // namespace gesture_automaton
+}  // namespace mediapipe
+
+#endif  // MYMEDIAPIPE_CALCULATORS_GESTURES_GESTURE_AUTOMATON_H_
@@ -0,0 +1,647 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "myMediapipe/calculators/gestures/gesture_automaton_calculator.pb.h"
+#include "absl/memory/memory.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/detection.pb.h"
+#include "mediapipe/framework/formats/landmark.pb.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/port/statusor.h"
+#include "myMediapipe/calculators/gestures/digit_recognizer.h"
+#include "myMediapipe/calculators/gestures/gesture_automaton.h"
+#include "myMediapipe/calculators/gestures/gesture_dispatch.h"
+#include "myMediapipe/calculators/gestures/multi_hand.h"
+#include "myMediapipe/calculators/gestures/reloadable_table.h"
+#include "myMediapipe/calculators/gestures/writing_tracker.h"
+#include "myMediapipe/calculators/tflite/model_cache.h"
+#include "myMediapipe/calculators/util/calculator_stats.h"
+#include "myMediapipe/framework/formats/angles.pb.h"
+#include "myMediapipe/framework/formats/mqtt_message.pb.h"
+
+namespace mediapipe {
+
+namespace {
+
+using gesture_automaton::Behavior;
+using gesture_automaton::Op;
+using gesture_automaton::Program;
+using gesture_dispatch::GestureClass;
+
+typedef std::vector<Detection> Detections;
+typedef std::vector<Angle> Angles;
+typedef std::vector<NormalizedLandmark> Landmarks;
+typedef std::vector<Mqtt_Message> MqttMessages;
+
+constexpr char kDetectionTag[] = "DETECTIONS";
+constexpr char kNormLandmarksTag[] = "NORM_LANDMARKS";
+constexpr char kAnglesTag[] = "ANGLES";
+constexpr char kVelocityTag[] = "VELOCITY";
+constexpr char kMqttMessageTag[] = "MQTT_MESSAGE";
+constexpr char kLatchMovingTag[] = "LATCH_MOVING";
+constexpr char kLatchWritingTag[] = "LATCH_WRITING";
+constexpr char kClearTag[] = "CLEAR";
+
+// Timers of a hand, the key of a timer is hand_id * kNumTimers + timer
+enum Timer { kTimeoutTimer, kStepTimer, kNumTimers };
+
+int64 Micros(double seconds) {
+  return seconds * Timestamp::kTimestampUnitsPerSecond;
+}
+
+// One class per line, the line number is the label_id
+std::vector<GestureClass> ParseGestureClasses(const std::string& contents) {
+  std::vector<GestureClass> classes;
+  std::istringstream stream(contents);
+  std::string line;
+  while (std::getline(stream, line)) {
+    classes.push_back(gesture_dispatch::ParseGestureClass(line));
+  }
+  return classes;
+}
+
+// The node options with the sections of the actions map file
+::mediapipe::Status MergeActionsMapFile(
+    const std::string& contents,
+    gestureAutomatonCalculatorOptions* options) {
+  gestureAutomatonCalculatorOptions file_options;
+  proto_ns::TextFormat::Parser parser;
+  parser.AllowPartialMessage(true);
+  RET_CHECK(parser.ParseFromString(contents, &file_options))
+      << "Not a gestureAutomatonCalculatorOptions";
+  if (file_options.has_transition()) {
+    options->mutable_transition()->clear_actions_map();
+  }
+  if (file_options.has_moving()) {
+    options->mutable_moving()->clear_moving_actions_map();
+  }
+  if (file_options.has_writing()) {
+    options->mutable_writing()->clear_writing_actions_map();
+  }
+  if (file_options.has_fixed()) {
+    options->mutable_fixed()->clear_fixed_actions_map();
+  }
+  options->MergeFrom(file_options);
+  return ::mediapipe::OkStatus();
+}
+
+// handOffset is the position of the hand angles, see multi_hand.h
+float GetAngle(int angle_number, int landmark_id, int hand_offset,
+               const Angles& angles) {
+  const Angle& angle = angles[hand_offset + landmark_id];
+  return angle_number == 1 ? angle.angle1() : angle.angle2();
+}
+
+// Inputs of the frame, nullptr when not connected or empty
+struct Frame {
+  const Landmarks* landmarks = nullptr;
+  const Angles* angles = nullptr;
+  const Landmarks* velocity = nullptr;
+};
+
+template <typename T>
+const T* GetOrNull(CalculatorContext* cc, const char* tag) {
+  if (!cc->Inputs().HasTag(tag) || cc->Inputs().Tag(tag).IsEmpty()) {
+    return nullptr;
+  }
+  return &cc->Inputs().Tag(tag).Get<T>();
+}
+
+}  // namespace
+
+// Gesture automaton, replaces gestureRouterCalculator, the four dynamic
+// gestures calculators and the merges of their outputs.
+//
+// The action maps of the transition, moving, writing and fixed sections
+// are compiled at Open into a single table of states x labels (see
+// gesture_automaton::Program), so a detection costs one table lookup
+// whatever the number of actions. Every hand (detection_id) has its own
+// state, several hands can run different gestures at the same time. The
+// timeouts of the gestures (time_out_s, moving_time_out_s, watchdog_time,
+// fixed_time_out_s) and the pacing of the repeated actions
+// (time_between_actions) are timers of a timer wheel, checked once per
+// frame.
+//
+// The gestures behave as in the dynamic gestures calculators, except that
+// moving_time_out_s counts from the start of the move and not from its
+// last evaluation, so a hand that doesn't move releases the full rate.
+//
+// Landmarks and angles of hand N are taken from [N*21, N*21+21) of their
+// vectors. NORM_LANDMARKS is needed by the moving and writing gestures,
+// ANGLES by the moving gestures and the fixed ones with angle_limits.
+//
+// Input:
+//   DETECTIONS: std::vector<Detection>, the stabilized static gestures.
+//   NORM_LANDMARKS: optional, the hand landmarks of the frame.
+//   ANGLES: optional, the angles of the frame.
+//   VELOCITY: optional, the landmark velocities of the frame, used by the
+//     moving (TRASLATION) and writing gestures as their calculators do.
+//
+// Output:
+//   MQTT_MESSAGE: std::vector<Mqtt_Message>, the actions of the frame.
+//   LATCH_MOVING, LATCH_WRITING: optional bool, true when a hand starts a
+//     moving or writing gesture. Drive FrameRateControllerCalculator.
+//   CLEAR: optional bool, emitted when the last moving or writing gesture
+//     ends.
+//
+// Example config:
+// node {
+//   calculator: "gestureAutomatonCalculator"
+//   input_stream: "DETECTIONS:detections"
+//   input_stream: "NORM_LANDMARKS:hand_landmarks"
+//   input_stream: "ANGLES:angles"
+//   output_stream: "MQTT_MESSAGE:message"
+//   output_stream: "LATCH_MOVING:moving_gesture_flag"
+//   output_stream: "CLEAR:gesture_clear"
+//   node_options: {
+//     [type.googleapis.com/mediapipe.gestureAutomatonCalculatorOptions] {
+//       gestures_types_file_name: "dynamic_gestures_map.txt"
+//       transition {
+//         time_out_s: 1.50
+//         actions_map { start_action: 0 end_action: 2
+//           mqtt_message{ topic: "handCommander/tv/ir_command"
+//                         payload: "KEY_POWER"}
+//         }
+//       }
+//       moving {
+//         moving_time_out_s: 1.50
+//         moving_actions_map { start_action: 4  action_type: TRASLATION
+//                              landmark_id: 0   angle_number: 0
+//                              action_threshold: 0.1
+//                              time_between_actions: 0.5
+//                              auto_repeat: false
+//                              topic: "handCommander/VLC"
+//                              positive_payload: "next"
+//                              negative_payload: "prev"}
+//       }
+//     }
+//   }
+// }
+class gestureAutomatonCalculator : public CalculatorBase {
+ public:
+  static ::mediapipe::Status GetContract(CalculatorContract* cc);
+  ::mediapipe::Status Open(CalculatorContext* cc) override;
+  ::mediapipe::Status Process(CalculatorContext* cc) override;
+
+ private:
+  struct HandState {
+    int state = Program::kIdleState;
+    // Bumped to cancel the pending timers of the hand
+    int generation[kNumTimers] = {};
+    // The step timer fired, the action runs on the next detection
+    bool step_due = false;
+    // Moving gesture
+    float start_angle = 0;
+    float start_x = 0;
+    // x travel of the landmark since the start, integrated from VELOCITY
+    float traslation = 0;
+    double velocity_time = 0;
+    // Created by the first writing gesture of the hand
+    std::unique_ptr<WritingTracker> writing;
+  };
+
+  ::mediapipe::Status ProcessHand(int label_id, int hand_id,
+                                  const Frame& frame, double now);
+  ::mediapipe::Status Enter(int hand_id, int state, const Frame& frame,
+                            double now, HandState* hand);
+  // Per frame work of the moving, writing and fixed gestures
+  ::mediapipe::Status Update(int hand_id, bool entered, const Frame& frame,
+                             double now, HandState* hand);
+  ::mediapipe::Status Move(int hand_id, const Frame& frame, double now,
+                           HandState* hand);
+  ::mediapipe::Status Write(int hand_id, const Frame& frame, double now,
+                            HandState* hand);
+  // Publishes the message of the fixed gesture at the current angle and
+  // arms its timers, returns false when no angle_limits match
+  ::mediapipe::StatusOr<bool> Fix(int hand_id, const Frame& frame,
+                                  double now, HandState* hand);
+  void OnTimer(int key, int generation);
+  void Schedule(int hand_id, Timer timer, double deadline, HandState* hand);
+  void SetState(int state, HandState* hand);
+  void ResetHands();
+
+  ::mediapipe::gestureAutomatonCalculatorOptions options_;
+  // The compiled action maps, recompiled when actions_map_file changes
+  ReloadableTable<Program> program_;
+  std::unique_ptr<gesture_automaton::TimerWheel> timers_;
+  // Indexed by hand_id
+  std::vector<HandState> hands_;
+  DigitRecognizer recognizer_;
+  MqttMessages mqttMessages;
+  bool latch_moving_ = false;
+  bool latch_writing_ = false;
+  // Whether a hand was moving or writing at the previous frame
+  bool busy_ = false;
+  // Shared by every flag packet, so idle frames don't allocate
+  Packet truePacket_;
+  calculator_stats::NodeStats* stats_ = nullptr;
+};
+REGISTER_CALCULATOR(gestureAutomatonCalculator);
+
+::mediapipe::Status gestureAutomatonCalculator::GetContract(
+    CalculatorContract* cc) {
+  RET_CHECK(cc->Inputs().HasTag(kDetectionTag))
+      << "Detections input stream is NOT provided.";
+  cc->Inputs().Tag(kDetectionTag).Set<Detections>();
+  if (cc->Inputs().HasTag(kNormLandmarksTag))
+    cc->Inputs().Tag(kNormLandmarksTag).Set<Landmarks>();
+  if (cc->Inputs().HasTag(kAnglesTag))
+    cc->Inputs().Tag(kAnglesTag).Set<Angles>();
+  if (cc->Inputs().HasTag(kVelocityTag))
+    cc->Inputs().Tag(kVelocityTag).Set<Landmarks>();
+
+  cc->Outputs().Tag(kMqttMessageTag).Set<MqttMessages>();
+  if (cc->Outputs().HasTag(kLatchMovingTag))
+    cc->Outputs().Tag(kLatchMovingTag).Set<bool>();
+  if (cc->Outputs().HasTag(kLatchWritingTag))
+    cc->Outputs().Tag(kLatchWritingTag).Set<bool>();
+  if (cc->Outputs().HasTag(kClearTag))
+    cc->Outputs().Tag(kClearTag).Set<bool>();
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status gestureAutomatonCalculator::Open(CalculatorContext* cc) {
+  cc->SetOffset(TimestampDiff(0));
+  stats_ = calculator_stats::ForNode(cc->NodeName());
+  truePacket_ = MakePacket<bool>(true);
+  options_ = cc->Options<::mediapipe::gestureAutomatonCalculatorOptions>();
+  RET_CHECK(options_.has_gestures_types_file_name())
+      << "gestures_types_file_name not provided";
+  RET_CHECK_GT(options_.timer_wheel_slots(), 0);
+  RET_CHECK_GT(options_.timer_tick_s(), 0);
+  if (options_.has_writing()) {
+    RET_CHECK_GT(options_.writing().max_trajectory_points(),
+                 options_.writing().window_for_angle_detection())
+        << "The trajectory can't hold the window for angle detection.";
+  }
+  timers_ = absl::make_unique<gesture_automaton::TimerWheel>(
+      options_.timer_wheel_slots(), Micros(options_.timer_tick_s()));
+
+  // Read once for all the graphs of the process
+  std::shared_ptr<const std::string> classes_string;
+  ASSIGN_OR_RETURN(classes_string, model_cache::GetContents(
+                                       options_.gestures_types_file_name()));
+  const std::vector<GestureClass> classes =
+      ParseGestureClasses(*classes_string);
+
+  if (options_.writing().has_digit_model_path()) {
+    MP_RETURN_IF_ERROR(
+        recognizer_.Load(options_.writing().digit_model_path()));
+  }
+
+  if (options_.has_actions_map_file()) {
+    const gestureAutomatonCalculatorOptions node_options = options_;
+    return program_.Watch(
+        options_.actions_map_file(),
+        absl::Seconds(options_.reload_interval_s()),
+        [node_options, classes](const std::string& contents,
+                                Program* program) {
+          gestureAutomatonCalculatorOptions options = node_options;
+          MP_RETURN_IF_ERROR(MergeActionsMapFile(contents, &options));
+          return program->Compile(options, classes);
+        });
+  }
+  return program_.mutable_table()->Compile(options_, classes);
+}
+
+::mediapipe::Status gestureAutomatonCalculator::Process(
+    CalculatorContext* cc) {
+  calculator_stats::ScopedProcessTimer timer(stats_);
+  // The hands point into the previous program
+  if (program_.Refresh()) ResetHands();
+
+  const double now = cc->InputTimestamp().Seconds();
+  timers_->Advance(cc->InputTimestamp().Value(),
+                   [this](int key, int generation) {
+                     OnTimer(key, generation);
+                   });
+
+  if (!cc->Inputs().Tag(kDetectionTag).IsEmpty()) {
+    Frame frame;
+    frame.landmarks = GetOrNull<Landmarks>(cc, kNormLandmarksTag);
+    frame.angles = GetOrNull<Angles>(cc, kAnglesTag);
+    frame.velocity = GetOrNull<Landmarks>(cc, kVelocityTag);
+    for (const auto& detection :
+         cc->Inputs().Tag(kDetectionTag).Get<Detections>()) {
+      if (detection.label_id_size() == 0) continue;
+      MP_RETURN_IF_ERROR(ProcessHand(detection.label_id(0),
+                                     multi_hand::HandId(detection), frame,
+                                     now));
+    }
+  }
+
+  const Timestamp timestamp = cc->InputTimestamp();
+  if (!mqttMessages.empty()) {
+    cc->Outputs().Tag(kMqttMessageTag)
+        .Add(new MqttMessages(std::move(mqttMessages)), timestamp);
+    mqttMessages.clear();
+  }
+  if (latch_moving_ && cc->Outputs().HasTag(kLatchMovingTag)) {
+    cc->Outputs().Tag(kLatchMovingTag).AddPacket(truePacket_.At(timestamp));
+  }
+  if (latch_writing_ && cc->Outputs().HasTag(kLatchWritingTag)) {
+    cc->Outputs().Tag(kLatchWritingTag).AddPacket(truePacket_.At(timestamp));
+  }
+  latch_moving_ = latch_writing_ = false;
+
+  bool busy = false;
+  for (const auto& hand : hands_) {
+    const Behavior behavior = program_.get().state(hand.state).behavior;
+    busy |= behavior == Behavior::kMoving || behavior == Behavior::kWriting;
+  }
+  if (busy_ && !busy && cc->Outputs().HasTag(kClearTag)) {
+    cc->Outputs().Tag(kClearTag).AddPacket(truePacket_.At(timestamp));
+  }
+  busy_ = busy;
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status gestureAutomatonCalculator::ProcessHand(
+    int label_id, int hand_id, const Frame& frame, double now) {
+  RET_CHECK_GE(hand_id, 0);
+  if (hand_id >= static_cast<int>(hands_.size())) hands_.resize(hand_id + 1);
+  HandState* hand = &hands_[hand_id];
+  const Program& program = program_.get();
+
+  const gesture_automaton::Transition next =
+      program.Step(hand->state, label_id);
+  switch (next.op) {
+    case Op::kStay:
+      return Update(hand_id, false, frame, now, hand);
+    case Op::kFire:
+      mqttMessages.emplace_back(
+          program.transition_action(hand->state).message);
+      SetState(Program::kIdleState, hand);
+      return ::mediapipe::OkStatus();
+    case Op::kLeave:
+      SetState(Program::kIdleState, hand);
+      return ::mediapipe::OkStatus();
+    case Op::kEnter:
+      break;
+  }
+  MP_RETURN_IF_ERROR(Enter(hand_id, next.next_state, frame, now, hand));
+  return Update(hand_id, true, frame, now, hand);
+}
+
+::mediapipe::Status gestureAutomatonCalculator::Enter(
+    int hand_id, int state, const Frame& frame, double now,
+    HandState* hand) {
+  const Program& program = program_.get();
+  SetState(state, hand);
+  switch (program.state(state).behavior) {
+    case Behavior::kTransition:
+      Schedule(hand_id, kTimeoutTimer,
+               now + program.options().transition().time_out_s(), hand);
+      break;
+    case Behavior::kMoving: {
+      RET_CHECK(frame.landmarks && frame.angles)
+          << "Moving gestures need NORM_LANDMARKS and ANGLES.";
+      RET_CHECK(multi_hand::HasHand(hand_id, frame.landmarks->size()) &&
+                multi_hand::HasHand(hand_id, frame.angles->size()))
+          << "No landmarks or angles for hand " << hand_id;
+      const auto& action = program.moving_action(state);
+      const int hand_offset = multi_hand::HandOffset(hand_id);
+      hand->start_angle = GetAngle(action.angle_number, action.landmark_id,
+                                   hand_offset, *frame.angles);
+      hand->start_x = (*frame.landmarks)[hand_offset + action.landmark_id].x();
+      hand->traslation = 0;
+      hand->velocity_time = now;
+      Schedule(hand_id, kTimeoutTimer,
+               now + program.options().moving().moving_time_out_s(), hand);
+      Schedule(hand_id, kStepTimer, now + action.time_between_actions, hand);
+      latch_moving_ = true;
+      break;
+    }
+    case Behavior::kWriting:
+      if (!hand->writing) {
+        hand->writing =
+            absl::make_unique<WritingTracker>(program.options().writing());
+      }
+      hand->writing->Reset();
+      Schedule(hand_id, kTimeoutTimer,
+               now + program.options().writing().watchdog_time(), hand);
+      latch_writing_ = true;
+      break;
+    case Behavior::kFixed: {
+      bool fired;
+      ASSIGN_OR_RETURN(fired, Fix(hand_id, frame, now, hand));
+      // Tried again on the next frame, as long as the gesture lasts
+      if (!fired) SetState(Program::kIdleState, hand);
+      break;
+    }
+    case Behavior::kIdle:
+      break;
+  }
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status gestureAutomatonCalculator::Update(
+    int hand_id, bool entered, const Frame& frame, double now,
+    HandState* hand) {
+  switch (program_.get().state(hand->state).behavior) {
+    case Behavior::kMoving:
+      if (entered) break;
+      return Move(hand_id, frame, now, hand);
+    case Behavior::kWriting:
+      return Write(hand_id, frame, now, hand);
+    case Behavior::kFixed:
+      if (entered || !hand->step_due) break;
+      return Fix(hand_id, frame, now, hand).status();
+    case Behavior::kIdle:
+    case Behavior::kTransition:
+      break;
+  }
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status gestureAutomatonCalculator::Move(int hand_id,
+                                                     const Frame& frame,
+                                                     double now,
+                                                     HandState* hand) {
+  const auto& action = program_.get().moving_action(hand->state);
+  const int hand_offset = multi_hand::HandOffset(hand_id);
+  if (frame.velocity) {
+    RET_CHECK(multi_hand::HasHand(hand_id, frame.velocity->size()))
+        << "No velocities for hand " << hand_id;
+    const auto& velocity = (*frame.velocity)[hand_offset + action.landmark_id];
+    hand->traslation += velocity.x() * (now - hand->velocity_time);
+    hand->velocity_time = now;
+  }
+  if (!hand->step_due) return ::mediapipe::OkStatus();
+
+  RET_CHECK(frame.landmarks && frame.angles)
+      << "Moving gestures need NORM_LANDMARKS and ANGLES.";
+  RET_CHECK(multi_hand::HasHand(hand_id, frame.landmarks->size()) &&
+            multi_hand::HasHand(hand_id, frame.angles->size()))
+      << "No landmarks or angles for hand " << hand_id;
+  float movementDiff = 0;
+  switch (action.action_type) {
+    case movingActionMap::TRASLATION:
+      movementDiff =
+          frame.velocity
+              ? -hand->traslation
+              : hand->start_x -
+                    (*frame.landmarks)[hand_offset + action.landmark_id].x();
+      break;
+    case movingActionMap::ROTATION:
+      movementDiff = hand->start_angle -
+                     GetAngle(action.angle_number, action.landmark_id,
+                              hand_offset, *frame.angles);
+      break;
+  }
+  int numActions = (int)(movementDiff / action.action_threshold);
+
+  if (!action.auto_repeat && numActions) {
+    numActions = numActions / abs(numActions);
+  }
+  if (action.has_max_repeat && abs(numActions) > action.max_repeat) {
+    numActions = numActions > 0 ? action.max_repeat : -action.max_repeat;
+  }
+
+  if (numActions == 0) {
+    hand->step_due = false;
+    Schedule(hand_id, kStepTimer, now + action.time_between_actions, hand);
+    return ::mediapipe::OkStatus();
+  }
+  const Mqtt_Message& message =
+      numActions > 0 ? action.positive_message : action.negative_message;
+  for (int i = 1; i <= abs(numActions); i++) {
+    mqttMessages.emplace_back(message);
+  }
+  SetState(Program::kIdleState, hand);
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status gestureAutomatonCalculator::Write(int hand_id,
+                                                      const Frame& frame,
+                                                      double now,
+                                                      HandState* hand) {
+  const Program& program = program_.get();
+  const auto& options = program.options().writing();
+  RET_CHECK(frame.landmarks) << "Writing gestures need NORM_LANDMARKS.";
+  RET_CHECK(multi_hand::HasHand(hand_id, frame.landmarks->size()))
+      << "No landmarks for hand " << hand_id;
+  const int tip_id = multi_hand::HandOffset(hand_id) + options.landmark_id();
+  float tip_speed = -1;
+  if (frame.velocity) {
+    RET_CHECK(multi_hand::HasHand(hand_id, frame.velocity->size()))
+        << "No velocities for hand " << hand_id;
+    const auto& tip_velocity = (*frame.velocity)[tip_id];
+    tip_speed = std::hypot(tip_velocity.x(), tip_velocity.y());
+  }
+  const auto& tip = (*frame.landmarks)[tip_id];
+  if (!hand->writing->Update(tip.x(), tip.y(), tip_speed, now)) {
+    return ::mediapipe::OkStatus();
+  }
+
+  int digit = 0;
+  float score = 0;
+  ::mediapipe::Status status;
+  if (recognizer_.loaded()) {
+    status = recognizer_.Recognize(hand->writing->trajectory(), &digit, &score);
+  }
+  hand->writing->Reset();
+  SetState(Program::kIdleState, hand);
+  MP_RETURN_IF_ERROR(status);
+  if (!recognizer_.loaded()) return ::mediapipe::OkStatus();
+
+  VLOG(1) << "Digit " << digit << " drawn, score " << score;
+  if (score < options.prediction_threshold()) return ::mediapipe::OkStatus();
+  const Mqtt_Message* message = program.digit_message(digit);
+  if (message != nullptr) mqttMessages.emplace_back(*message);
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::StatusOr<bool> gestureAutomatonCalculator::Fix(
+    int hand_id, const Frame& frame, double now, HandState* hand) {
+  const Program& program = program_.get();
+  const auto& action = program.fixed_action(hand->state);
+  const Mqtt_Message* command = nullptr;
+  if (action.has_landmark_id) {
+    RET_CHECK(frame.angles) << "Fixed gestures with angles need ANGLES.";
+    RET_CHECK(multi_hand::HasHand(hand_id, frame.angles->size()))
+        << "No angles for hand " << hand_id;
+    const float angle =
+        GetAngle(action.angle_number, action.landmark_id,
+                 multi_hand::HandOffset(hand_id), *frame.angles);
+    for (const auto& angle_command : action.angle_commands) {
+      if (angle <= angle_command.angle_limit_pos &&
+          angle >= angle_command.angle_limit_neg) {
+        command = &angle_command.message;
+      }
+    }
+  } else {
+    command = &action.message;
+  }
+  // A repeat that doesn't match is tried again on the next frame
+  if (command == nullptr) return false;
+
+  mqttMessages.emplace_back(*command);
+  hand->step_due = false;
+  // The gesture is held fixed_time_out_s after its last message, then a
+  // gesture still there starts again
+  Schedule(hand_id, kTimeoutTimer,
+           now + program.options().fixed().fixed_time_out_s(), hand);
+  if (action.auto_repeat) {
+    Schedule(hand_id, kStepTimer, now + action.time_between_actions, hand);
+  }
+  return true;
+}
+
+void gestureAutomatonCalculator::OnTimer(int key, int generation) {
+  const int hand_id = key / kNumTimers;
+  const Timer timer = static_cast<Timer>(key % kNumTimers);
+  if (hand_id >= static_cast<int>(hands_.size())) return;
+  HandState* hand = &hands_[hand_id];
+  if (generation != hand->generation[timer]) return;
+  if (timer == kStepTimer) {
+    hand->step_due = true;
+    return;
+  }
+  if (hand->writing) hand->writing->Reset();
+  SetState(Program::kIdleState, hand);
+}
+
+void gestureAutomatonCalculator::Schedule(int hand_id, Timer timer,
+                                          double deadline, HandState* hand) {
+  timers_->Schedule(Micros(deadline), hand_id * kNumTimers + timer,
+                    ++hand->generation[timer]);
+}
+
+void gestureAutomatonCalculator::SetState(int state, HandState* hand) {
+  hand->state = state;
+  hand->step_due = false;
+  // Cancels the timers of the previous state
+  for (int& generation : hand->generation) ++generation;
+}
+
+// The generations keep growing, the timers of the previous program are
+// ignored
+void gestureAutomatonCalculator::ResetHands() {
+  for (auto& hand : hands_) {
+    SetState(Program::kIdleState, &hand);
+    // Holds the writing options of the previous program
+    hand.writing.reset();
+  }
+}
+
+}  // namespace mediapipe
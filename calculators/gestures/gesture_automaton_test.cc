@@ -0,0 +1,312 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myMediapipe/calculators/gestures/gesture_automaton.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+
+namespace mediapipe {
+namespace gesture_automaton {
+namespace {
+
+using gesture_dispatch::GestureClass;
+
+typedef std::vector<std::pair<int, int>> Fired;
+
+// Labels of the program below
+constexpr int kNoGesture = 0;
+constexpr int kPowerStart = 1;
+constexpr int kPowerEnd = 2;
+constexpr int kVolume = 3;
+constexpr int kMute = 4;
+
+// Idle, writing, then one state per action in the order of the maps
+constexpr int kPowerState = 2;
+constexpr int kVolumeState = 3;
+constexpr int kMuteState = 4;
+
+gestureAutomatonCalculatorOptions MakeOptions() {
+  return ParseTextProtoOrDie<gestureAutomatonCalculatorOptions>(R"(
+    transition {
+      actions_map {
+        start_action: 1
+        end_action: 2
+        mqtt_message { topic: "tv" payload: "KEY_POWER" }
+      }
+    }
+    moving {
+      moving_actions_map {
+        start_action: 3
+        action_type: ROTATION
+        landmark_id: 0
+        angle_number: 0
+        action_threshold: 10
+        time_between_actions: 0.5
+        auto_repeat: true
+        topic: "tv"
+        positive_payload: "KEY_VOLUMEUP"
+        negative_payload: "KEY_VOLUMEDOWN"
+      }
+    }
+    fixed {
+      fixed_actions_map {
+        start_action: 4
+        time_between_actions: 0.5
+        auto_repeat: false
+        mqtt_message { topic: "tv" payload: "KEY_MUTE" }
+      }
+    }
+  )");
+}
+
+std::vector<GestureClass> MakeClasses() {
+  return {GestureClass::kNone, GestureClass::kTransition, GestureClass::kNone,
+          GestureClass::kMoving, GestureClass::kFixed};
+}
+
+// Runs the labels of one hand from idle, returns the transition of every
+// label and leaves the final state in state
+std::vector<Transition> Run(const Program& program,
+                            const std::vector<int>& labels, int* state) {
+  std::vector<Transition> transitions;
+  *state = Program::kIdleState;
+  for (int label : labels) {
+    const Transition next = program.Step(*state, label);
+    if (next.op != Op::kStay) *state = next.next_state;
+    transitions.push_back(next);
+  }
+  return transitions;
+}
+
+void ExpectTransition(const Transition& transition, Op op, int next_state) {
+  EXPECT_TRUE(transition.op == op);
+  EXPECT_EQ(transition.next_state, next_state);
+}
+
+TEST(TimerWheelTest, FiresAtTheFirstAdvancePastTheDeadline) {
+  TimerWheel wheel(8, 10);
+  Fired fired;
+  auto collect = [&](int key, int generation) {
+    fired.emplace_back(key, generation);
+  };
+  wheel.Schedule(25, 1, 1);
+  wheel.Advance(20, collect);
+  EXPECT_TRUE(fired.empty());
+  wheel.Advance(27, collect);
+  EXPECT_EQ(fired, Fired({{1, 1}}));
+  wheel.Advance(40, collect);
+  EXPECT_EQ(fired.size(), 1u);
+}
+
+TEST(TimerWheelTest, KeepsLaterRoundsAcrossWraps) {
+  // 8 slots of 10 us, the wheel wraps every 80 us
+  TimerWheel wheel(8, 10);
+  Fired fired;
+  auto collect = [&](int key, int generation) {
+    fired.emplace_back(key, generation);
+  };
+  // Same slot, the second one two rounds later
+  wheel.Schedule(30, 1, 1);
+  wheel.Schedule(190, 2, 1);
+  for (int64 now_us = 10; now_us < 190; now_us += 10) {
+    wheel.Advance(now_us, collect);
+  }
+  EXPECT_EQ(fired, Fired({{1, 1}}));
+  wheel.Advance(190, collect);
+  EXPECT_EQ(fired, Fired({{1, 1}, {2, 1}}));
+}
+
+TEST(TimerWheelTest, JumpOfSeveralRoundsFiresEveryDueTimer) {
+  TimerWheel wheel(8, 10);
+  Fired fired;
+  auto collect = [&](int key, int generation) {
+    fired.emplace_back(key, generation);
+  };
+  wheel.Schedule(35, 1, 1);
+  wheel.Schedule(500, 2, 1);
+  wheel.Schedule(1500, 3, 1);
+  wheel.Advance(1000, collect);
+  // The slots are visited from the tick after now, minus a round
+  std::sort(fired.begin(), fired.end());
+  EXPECT_EQ(fired, Fired({{1, 1}, {2, 1}}));
+  wheel.Advance(1500, collect);
+  EXPECT_EQ(fired, Fired({{1, 1}, {2, 1}, {3, 1}}));
+}
+
+TEST(TimerWheelTest, PastDeadlineFiresAtTheNextAdvance) {
+  TimerWheel wheel(8, 10);
+  Fired fired;
+  auto collect = [&](int key, int generation) {
+    fired.emplace_back(key, generation);
+  };
+  wheel.Advance(100, collect);
+  wheel.Schedule(5, 1, 1);
+  wheel.Advance(100, collect);
+  EXPECT_EQ(fired, Fired({{1, 1}}));
+}
+
+TEST(TimerWheelTest, RescheduledTimerIsIgnoredAndReplaced) {
+  TimerWheel wheel(8, 10);
+  std::vector<int> generation(2, 0);
+  Fired expired;
+  auto expire = [&](int key, int timer_generation) {
+    if (timer_generation == generation[key]) {
+      expired.emplace_back(key, timer_generation);
+    }
+  };
+  wheel.Schedule(50, 0, ++generation[0]);
+  wheel.Schedule(50, 1, ++generation[1]);
+  // Cancels the first timer of key 0 by scheduling it again
+  wheel.Schedule(120, 0, ++generation[0]);
+  // Cancels key 1
+  ++generation[1];
+  wheel.Advance(100, expire);
+  EXPECT_TRUE(expired.empty());
+  wheel.Advance(120, expire);
+  EXPECT_EQ(expired, Fired({{0, 2}}));
+}
+
+TEST(TimerWheelTest, TimerScheduledWhileFiringWaitsItsDeadline) {
+  TimerWheel wheel(8, 10);
+  Fired fired;
+  auto repeat = [&](int key, int generation) {
+    fired.emplace_back(key, generation);
+    // Same slot as the one firing, next round
+    if (generation < 3) {
+      wheel.Schedule(40 + generation * 80, key, generation + 1);
+    }
+  };
+  wheel.Schedule(40, 1, 1);
+  wheel.Advance(40, repeat);
+  EXPECT_EQ(fired, Fired({{1, 1}}));
+  wheel.Advance(120, repeat);
+  EXPECT_EQ(fired, Fired({{1, 1}, {1, 2}}));
+  wheel.Advance(200, repeat);
+  EXPECT_EQ(fired, Fired({{1, 1}, {1, 2}, {1, 3}}));
+}
+
+TEST(ProgramTest, CompilesTheOptionsIntoTheStateTable) {
+  Program program;
+  MP_ASSERT_OK(program.Compile(MakeOptions(), MakeClasses()));
+
+  ASSERT_EQ(program.num_states(), 5);
+  EXPECT_TRUE(program.state(Program::kIdleState).behavior == Behavior::kIdle);
+  EXPECT_TRUE(program.state(1).behavior == Behavior::kWriting);
+  EXPECT_TRUE(program.state(kPowerState).behavior == Behavior::kTransition);
+  EXPECT_TRUE(program.state(kVolumeState).behavior == Behavior::kMoving);
+  EXPECT_TRUE(program.state(kMuteState).behavior == Behavior::kFixed);
+  EXPECT_EQ(program.transition_action(kPowerState).message.payload(),
+            "KEY_POWER");
+  EXPECT_EQ(program.moving_action(kVolumeState).positive_message.payload(),
+            "KEY_VOLUMEUP");
+  EXPECT_EQ(program.fixed_action(kMuteState).message.payload(), "KEY_MUTE");
+
+  // From idle, every label enters the action it starts in its class
+  ExpectTransition(program.Next(Program::kIdleState, kNoGesture), Op::kStay,
+                   Program::kIdleState);
+  ExpectTransition(program.Next(Program::kIdleState, kPowerStart), Op::kEnter,
+                   kPowerState);
+  ExpectTransition(program.Next(Program::kIdleState, kPowerEnd), Op::kStay,
+                   Program::kIdleState);
+  ExpectTransition(program.Next(Program::kIdleState, kVolume), Op::kEnter,
+                   kVolumeState);
+  ExpectTransition(program.Next(Program::kIdleState, kMute), Op::kEnter,
+                   kMuteState);
+  // Labels outside the table share its last column
+  ExpectTransition(program.Next(Program::kIdleState, 99), Op::kStay,
+                   Program::kIdleState);
+  ExpectTransition(program.Next(Program::kIdleState, -1), Op::kStay,
+                   Program::kIdleState);
+
+  ExpectTransition(program.Next(kPowerState, kPowerEnd), Op::kFire,
+                   Program::kIdleState);
+  ExpectTransition(program.Next(kPowerState, kMute), Op::kStay, kPowerState);
+  ExpectTransition(program.Next(kVolumeState, kNoGesture), Op::kStay,
+                   kVolumeState);
+  ExpectTransition(program.Next(kMuteState, kMute), Op::kStay, kMuteState);
+  ExpectTransition(program.Next(kMuteState, kNoGesture), Op::kLeave,
+                   Program::kIdleState);
+  ExpectTransition(program.Next(kMuteState, 99), Op::kLeave,
+                   Program::kIdleState);
+}
+
+TEST(ProgramTest, LabelsWithoutClassStartNothing) {
+  Program program;
+  const std::vector<GestureClass> classes(5, GestureClass::kNone);
+  MP_ASSERT_OK(program.Compile(MakeOptions(), classes));
+  for (int label = 0; label < 5; ++label) {
+    ExpectTransition(program.Next(Program::kIdleState, label), Op::kStay,
+                     Program::kIdleState);
+  }
+}
+
+TEST(ProgramTest, RejectsAngleCommandsWithoutAngleNumber) {
+  gestureAutomatonCalculatorOptions options = MakeOptions();
+  options.mutable_fixed()->mutable_fixed_actions_map(0)->set_landmark_id(8);
+  Program program;
+  EXPECT_FALSE(program.Compile(options, MakeClasses()).ok());
+}
+
+TEST(ProgramTest, TransitionFiresOnItsEndLabel) {
+  Program program;
+  MP_ASSERT_OK(program.Compile(MakeOptions(), MakeClasses()));
+  int state;
+  const auto transitions = Run(
+      program, {kNoGesture, kPowerStart, kPowerStart, kMute, kPowerEnd},
+      &state);
+  ExpectTransition(transitions[0], Op::kStay, Program::kIdleState);
+  ExpectTransition(transitions[1], Op::kEnter, kPowerState);
+  ExpectTransition(transitions[2], Op::kStay, kPowerState);
+  ExpectTransition(transitions[3], Op::kStay, kPowerState);
+  ExpectTransition(transitions[4], Op::kFire, Program::kIdleState);
+  EXPECT_EQ(state, Program::kIdleState);
+}
+
+TEST(ProgramTest, MovingKeepsItsHandWhateverTheLabel) {
+  Program program;
+  MP_ASSERT_OK(program.Compile(MakeOptions(), MakeClasses()));
+  int state;
+  const auto transitions =
+      Run(program, {kVolume, kNoGesture, kMute, kPowerStart}, &state);
+  ExpectTransition(transitions[0], Op::kEnter, kVolumeState);
+  for (int i = 1; i < static_cast<int>(transitions.size()); ++i) {
+    ExpectTransition(transitions[i], Op::kStay, kVolumeState);
+  }
+  EXPECT_EQ(state, kVolumeState);
+}
+
+TEST(ProgramTest, FixedHoldsWhileItsLabelLasts) {
+  Program program;
+  MP_ASSERT_OK(program.Compile(MakeOptions(), MakeClasses()));
+  int state;
+  const auto transitions =
+      Run(program, {kMute, kMute, kNoGesture, kMute, kPowerStart}, &state);
+  ExpectTransition(transitions[0], Op::kEnter, kMuteState);
+  ExpectTransition(transitions[1], Op::kStay, kMuteState);
+  ExpectTransition(transitions[2], Op::kLeave, Program::kIdleState);
+  ExpectTransition(transitions[3], Op::kEnter, kMuteState);
+  // Leaving the fixed action starts the transition in the same frame
+  ExpectTransition(transitions[4], Op::kEnter, kPowerState);
+  EXPECT_EQ(state, kPowerState);
+}
+
+}  // namespace
+}  // namespace gesture_automaton
+}  // namespace mediapipe
@@ -12,7 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-//#include <memory>
+#include <memory>
 
 #include "myMediapipe/calculators/gestures/gesture_classifier_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
@@ -21,6 +21,9 @@
 #include "mediapipe/util/resource_util.h"
 #include "mediapipe/framework/port/status.h"
 #include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/logging.h"
+#include "myMediapipe/calculators/gestures/gesture_dispatch.h"
+#include "myMediapipe/calculators/tflite/model_cache.h"
 
 namespace mediapipe {
 
@@ -40,30 +43,25 @@ constexpr char kLatchFixedTag[] = "LATCH_FIXED";
 // function, to send a FINISHED signal to the Flow Limiter
 constexpr char kTBDTag[] = "TBD";
 
-constexpr char transitionTag[] = "transition";
-constexpr char movingTag[] = "moving";
-constexpr char writingTag[] = "writing";
-constexpr char fixedTag[] = "fixed";
-
-constexpr unsigned int str2int(const char* str, int h = 0)
-{
-    return !str[h] ? 5381 : (str2int(str, h+1) * 33) ^ str[h];
-}
+using gesture_dispatch::GestureClass;
 
+// The latch packets are shared, only the timestamp changes between frames
 void setLatches(const bool transition,
                 const bool moving,
                 const bool writing,
                 const bool fixed,
+                const Packet& truePacket,
+                const Packet& falsePacket,
                 CalculatorContext* cc){
-
+  const Timestamp timestamp = cc->InputTimestamp();
   cc->Outputs().Tag(kLatchTransitionTag).AddPacket(
-          MakePacket<bool>(transition).At(cc->InputTimestamp()));
+          (transition ? truePacket : falsePacket).At(timestamp));
   cc->Outputs().Tag(kLatchMovingTag).AddPacket(
-          MakePacket<bool>(moving).At(cc->InputTimestamp()));
+          (moving ? truePacket : falsePacket).At(timestamp));
   cc->Outputs().Tag(kLatchWritingTag).AddPacket(
-          MakePacket<bool>(writing).At(cc->InputTimestamp()));
+          (writing ? truePacket : falsePacket).At(timestamp));
   cc->Outputs().Tag(kLatchFixedTag).AddPacket(
-          MakePacket<bool>(fixed).At(cc->InputTimestamp()));
+          (fixed ? truePacket : falsePacket).At(timestamp));
 }
 
 }  // namespace
@@ -76,6 +74,8 @@ void setLatches(const bool transition,
 //for further proccesing
 // Then, it will remain disabled until a cleared flag is received 
 // which can happen when a gesture is proccesed or a timeout event
+// When the detections come from several hands (see detection_id) the
+// latches of the classes of all of them are opened.
 //
 // Input:
 //  DETECTION: A Detection proto containing the detected gesture.
@@ -127,9 +127,12 @@ class gestureClassifierCalculator : public CalculatorBase {
   ::mediapipe::Status Process(CalculatorContext* cc) override;
  
   private:
-    std::unordered_map<int, std::string> gesture_map_;
+    // label_id -> class, resolved once at Open
+    gesture_dispatch::DispatchTable<GestureClass> gesture_map_;
     ::mediapipe::gestureClassifierCalculatorOptions options_;
     bool disabled;
+    Packet truePacket_;
+    Packet falsePacket_;
 };
 REGISTER_CALCULATOR(gestureClassifierCalculator);
 
@@ -166,18 +169,21 @@ REGISTER_CALCULATOR(gestureClassifierCalculator);
   cc->SetOffset(TimestampDiff(0));
   
   options_ = cc->Options<::mediapipe::gestureClassifierCalculatorOptions>();
-  std::string string_path;
-  ASSIGN_OR_RETURN(string_path, PathToResourceAsFile(options_.gestures_types_file_name()));
-  std::string gesture_map_string;
-  MP_RETURN_IF_ERROR(file::GetContents(string_path, &gesture_map_string));
+  // Read once for all the graphs of the process
+  std::shared_ptr<const std::string> gesture_map_string;
+  ASSIGN_OR_RETURN(
+      gesture_map_string,
+      model_cache::GetContents(options_.gestures_types_file_name()));
 
-  std::istringstream stream(gesture_map_string);
+  std::istringstream stream(*gesture_map_string);
   std::string line;
   int i = 0;
   while (std::getline(stream, line)) {
-    gesture_map_[i++] = line;
+    gesture_map_.Add(i++, gesture_dispatch::ParseGestureClass(line));
   }
   disabled=false;
+  truePacket_ = MakePacket<bool>(true);
+  falsePacket_ = MakePacket<bool>(false);
 
   // std::cout << "\n gestureClassifierCalculator::Open";
   return ::mediapipe::OkStatus();
@@ -190,42 +196,43 @@ REGISTER_CALCULATOR(gestureClassifierCalculator);
    if(!cc->Inputs().Tag(kDetectionTag).IsEmpty()){
     const auto& input_detections =
           cc->Inputs().Tag(kDetectionTag).Get<Detections>();
-    const auto& input_detection = input_detections.back();
-    const char* outLabel = ""; 
-    
-    const int32 label_id = input_detection.label_id().Get(0);
-    //std::cout << "\n inLabel:" << std::to_string(label_id);
-    if (gesture_map_.find(label_id) != gesture_map_.end()) 
-      outLabel = gesture_map_[label_id].c_str();
-
-    //std::cout << "\t outLabel:" << outLabel;
-
-    switch (str2int(outLabel)){
-      case str2int(transitionTag):
-        std::cout << "\n-----transition:";
-        setLatches(true, false, false, false, cc);
-        break;
-      case str2int(movingTag):
-        std::cout << "\n-----moving:";
-        setLatches(false, true, false, false, cc);
-        break;
-      case str2int(writingTag):
-        std::cout << "\n-----writing:";
-        setLatches(false, false, true, false, cc);
-        break;
-      case str2int(fixedTag):
-        std::cout << "\n-----fixed:";
-        setLatches(false, false, false, true, cc);
-        break;
-      default:
-        //blocks processing nodes and reenables self input through 
-        // flow limiter
-        std::cout << "\n-----default:"  << outLabel;
-        setLatches(false, false, false, false, cc);;
-        cc->Outputs().Tag(kTBDTag).AddPacket(
-          MakePacket<bool>(true)
-            .At(cc->InputTimestamp().NextAllowedInStream()));
-        break;
+    // With several hands every latch used by any of them is opened,
+    // the dynamic gestures calculators keep the state of each hand
+    bool transition = false;
+    bool moving = false;
+    bool writing = false;
+    bool fixed = false;
+
+    for (const auto& input_detection : input_detections) {
+      const int32 label_id = input_detection.label_id().Get(0);
+      const GestureClass* gesture_class = gesture_map_.Find(label_id);
+
+      switch (gesture_class ? *gesture_class : GestureClass::kNone){
+        case GestureClass::kTransition:
+          transition = true;
+          break;
+        case GestureClass::kMoving:
+          moving = true;
+          break;
+        case GestureClass::kWriting:
+          writing = true;
+          break;
+        case GestureClass::kFixed:
+          fixed = true;
+          break;
+        case GestureClass::kNone:
+          VLOG(2) << "Gesture " << label_id << " has no class";
+          break;
+      }
+    }
+
+    setLatches(transition, moving, writing, fixed, truePacket_, falsePacket_,
+               cc);
+    if (!(transition || moving || writing || fixed)) {
+      //blocks processing nodes and reenables self input through 
+      // flow limiter
+      cc->Outputs().Tag(kTBDTag).AddPacket(
+        truePacket_.At(cc->InputTimestamp().NextAllowedInStream()));
     }
   }
   return ::mediapipe::OkStatus();
@@ -0,0 +1,90 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_CALCULATORS_GESTURES_GESTURE_DISPATCH_H_
+#define MYMEDIAPIPE_CALCULATORS_GESTURES_GESTURE_DISPATCH_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mediapipe {
+namespace gesture_dispatch {
+
+// Maps the label_id of a static gesture to the record of the action it
+// starts. Built once at Open from the calculator options, so the per
+// frame lookup is an index into a dense vector instead of a scan over the
+// proto action maps.
+//
+// Records are stored contiguously in the order they are added. When two
+// records use the same label the last one wins, like the original scans
+// did.
+//
+// Example:
+//   DispatchTable<MovingAction> table;
+//   for (const auto& act : options_.moving_actions_map())
+//     table.Add(act.start_action(), MakeRecord(act));
+//   const MovingAction* action = table.Find(label_id);
+template <class Record>
+class DispatchTable {
+ public:
+  void Add(int label_id, Record record) {
+    if (label_id < 0) return;
+    if (label_id >= static_cast<int>(index_.size())) {
+      index_.resize(label_id + 1, -1);
+    }
+    if (index_[label_id] >= 0) {
+      records_[index_[label_id]] = std::move(record);
+      return;
+    }
+    index_[label_id] = records_.size();
+    records_.emplace_back(std::move(record));
+  }
+
+  // Record of the label, nullptr when the label has no action. Pointers
+  // stay valid until the next Add.
+  const Record* Find(int label_id) const {
+    if (label_id < 0 || label_id >= static_cast<int>(index_.size())) {
+      return nullptr;
+    }
+    const int idx = index_[label_id];
+    return idx < 0 ? nullptr : &records_[idx];
+  }
+
+  bool empty() const { return records_.empty(); }
+  int size() const { return records_.size(); }
+
+ private:
+  // label_id -> position in records_, -1 for labels without action
+  std::vector<int> index_;
+  std::vector<Record> records_;
+};
+
+// Class of every static gesture, read by gestureClassifierCalculator
+// and gestureRouterCalculator from gestures_types_file_name.
+enum class GestureClass { kNone, kTransition, kMoving, kWriting, kFixed };
+
+// One line of gestures_types_file_name, kNone for unknown names.
+inline GestureClass ParseGestureClass(const std::string& name) {
+  if (name == "transition") return GestureClass::kTransition;
+  if (name == "moving") return GestureClass::kMoving;
+  if (name == "writing") return GestureClass::kWriting;
+  if (name == "fixed") return GestureClass::kFixed;
+  return GestureClass::kNone;
+}
+
+}  // namespace gesture_dispatch
+}  // namespace mediapipe
+
+#endif  // MYMEDIAPIPE_CALCULATORS_GESTURES_GESTURE_DISPATCH_H_
@@ -0,0 +1,271 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "myMediapipe/calculators/gestures/gesture_router_calculator.pb.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/detection.pb.h"
+#include "mediapipe/framework/port/logging.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/stream_handler/sync_set_input_stream_handler.pb.h"
+#include "myMediapipe/calculators/gestures/gesture_dispatch.h"
+#include "myMediapipe/calculators/gestures/reloadable_table.h"
+#include "myMediapipe/calculators/tflite/model_cache.h"
+
+namespace mediapipe {
+
+namespace {
+
+typedef std::vector<Detection> Detections;
+
+constexpr char kDetectionTag[] = "DETECTIONS";
+constexpr char kNormLandmarksTag[] = "NORM_LANDMARKS";
+constexpr char kAnglesTag[] = "ANGLES";
+constexpr char kVelocityTag[] = "VELOCITY";
+constexpr char kClearTag[] = "CLEAR";
+constexpr char kLatchMovingTag[] = "LATCH_MOVING";
+constexpr char kLatchWritingTag[] = "LATCH_WRITING";
+
+// Data streams routed to the branches, the index of every output tag is
+// the branch
+constexpr const char* kRoutedTags[] = {kDetectionTag, kNormLandmarksTag,
+                                       kAnglesTag, kVelocityTag};
+
+using gesture_dispatch::GestureClass;
+typedef gesture_dispatch::DispatchTable<GestureClass> GestureMap;
+
+constexpr int kNoBranch = -1;
+
+// Output index of the branch of a class: 0 transition, 1 moving,
+// 2 writing and 3 fixed
+int BranchOf(GestureClass gesture_class) {
+  return gesture_class == GestureClass::kNone
+             ? kNoBranch
+             : static_cast<int>(gesture_class) - 1;
+}
+
+// One class per line, the line number is the label_id
+::mediapipe::Status ParseGestureMap(const std::string& contents,
+                                    GestureMap* gesture_map) {
+  std::istringstream stream(contents);
+  std::string line;
+  int i = 0;
+  while (std::getline(stream, line)) {
+    gesture_map->Add(i++, gesture_dispatch::ParseGestureClass(line));
+  }
+  return ::mediapipe::OkStatus();
+}
+
+}  // namespace
+
+// Gestures router, replaces gestureClassifierCalculator and the latches
+// in front of every dynamic gestures calculator.
+//
+// Classifies the incoming DETECTIONS with the classes of
+// gestures_types_file_name and sends the frame (detections, landmarks,
+// angles and landmark velocities) to the branch of its class only. The
+// branch keeps receiving the frames until it releases the router with a
+// CLEAR packet, then the next classified frame picks the branch again.
+// With several hands the first detection with a class picks the branch.
+//
+// The outputs of the branches not fed advance their timestamp bounds, so
+// their calculators are not woken up and no node waits on them. CLEAR is
+// in its own sync set, the back edge never holds the frames back.
+//
+// With watch_gestures_types_file the classes are reloaded when the file
+// changes, the branch in use is kept.
+//
+// Input:
+//   DETECTIONS: std::vector<Detection>, the stabilized static gestures.
+//   NORM_LANDMARKS: optional, the hand landmarks of the frame.
+//   ANGLES: optional, the angles of the frame.
+//   VELOCITY: optional, the landmark velocities of the frame.
+//   CLEAR: optional, the merged FLAG outputs of the dynamic gestures
+//     calculators. Back edge.
+//
+// Output:
+//   DETECTIONS:<i>, NORM_LANDMARKS:<i>, ANGLES:<i>, VELOCITY:<i>: the
+//     frames of branch i; 0 transition, 1 moving, 2 writing and 3 fixed.
+//     Any of them can be left unconnected.
+//   LATCH_MOVING, LATCH_WRITING: optional bool, emitted when a branch is
+//     picked, true for its class. Drive FrameRateControllerCalculator.
+//
+// Example config:
+// node {
+//   calculator: "gestureRouterCalculator"
+//   input_stream: "DETECTIONS:detections"
+//   input_stream: "NORM_LANDMARKS:hand_landmarks"
+//   input_stream: "ANGLES:angles"
+//   input_stream: "CLEAR:gesture_clear"
+//   input_stream_info: { tag_index: "CLEAR" back_edge: true }
+//   output_stream: "DETECTIONS:0:transition_detections"
+//   output_stream: "NORM_LANDMARKS:0:transition_landmarks"
+//   output_stream: "DETECTIONS:1:moving_detections"
+//   output_stream: "NORM_LANDMARKS:1:moving_landmarks"
+//   output_stream: "ANGLES:1:moving_angles"
+//   output_stream: "LATCH_MOVING:moving_gesture_flag"
+//   node_options: {
+//     [type.googleapis.com/mediapipe.gestureRouterCalculatorOptions] {
+//       gestures_types_file_name: "dynamic_gestures_map.txt"
+//     }
+//   }
+// }
+class gestureRouterCalculator : public CalculatorBase {
+ public:
+  static ::mediapipe::Status GetContract(CalculatorContract* cc);
+  ::mediapipe::Status Open(CalculatorContext* cc) override;
+  ::mediapipe::Status Process(CalculatorContext* cc) override;
+
+ private:
+  // Branch of the first detection with a class, kNoBranch if none
+  int Classify(const Detections& detections) const;
+  void Route(int branch, CalculatorContext* cc);
+  void SetLatches(int branch, CalculatorContext* cc);
+
+  // label_id -> class, resolved at Open and on every reload
+  ReloadableTable<GestureMap> gesture_map_;
+  int active_branch_ = kNoBranch;
+  Packet truePacket_;
+  Packet falsePacket_;
+};
+REGISTER_CALCULATOR(gestureRouterCalculator);
+
+::mediapipe::Status gestureRouterCalculator::GetContract(
+    CalculatorContract* cc) {
+  RET_CHECK(cc->Inputs().HasTag(kDetectionTag));
+  cc->Inputs().Tag(kDetectionTag).Set<Detections>();
+  for (const char* tag : kRoutedTags) {
+    if (!cc->Inputs().HasTag(tag)) {
+      RET_CHECK_EQ(cc->Outputs().NumEntries(tag), 0)
+          << "Output " << tag << " needs the input of the same tag.";
+      continue;
+    }
+    if (tag != kDetectionTag) cc->Inputs().Tag(tag).SetAny();
+    for (int i = 0; i < cc->Outputs().NumEntries(tag); ++i) {
+      cc->Outputs().Get(tag, i).SetSameAs(&cc->Inputs().Tag(tag));
+    }
+  }
+
+  if (cc->Inputs().HasTag(kClearTag)) {
+    cc->Inputs().Tag(kClearTag).SetAny();
+    MediaPipeOptions handler_options;
+    handler_options.MutableExtension(SyncSetInputStreamHandlerOptions::ext)
+        ->add_sync_set()
+        ->add_tag_index(kClearTag);
+    cc->SetInputStreamHandler("SyncSetInputStreamHandler");
+    cc->SetInputStreamHandlerOptions(handler_options);
+  }
+  if (cc->Outputs().HasTag(kLatchMovingTag))
+    cc->Outputs().Tag(kLatchMovingTag).Set<bool>();
+  if (cc->Outputs().HasTag(kLatchWritingTag))
+    cc->Outputs().Tag(kLatchWritingTag).Set<bool>();
+
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status gestureRouterCalculator::Open(CalculatorContext* cc) {
+  cc->SetOffset(TimestampDiff(0));
+
+  const auto& options =
+      cc->Options<::mediapipe::gestureRouterCalculatorOptions>();
+  if (options.watch_gestures_types_file()) {
+    MP_RETURN_IF_ERROR(
+        gesture_map_.Watch(options.gestures_types_file_name(),
+                           absl::Seconds(options.reload_interval_s()),
+                           ParseGestureMap));
+  } else {
+    // Read once for all the graphs of the process
+    std::shared_ptr<const std::string> gesture_map_string;
+    ASSIGN_OR_RETURN(
+        gesture_map_string,
+        model_cache::GetContents(options.gestures_types_file_name()));
+    MP_RETURN_IF_ERROR(
+        ParseGestureMap(*gesture_map_string, gesture_map_.mutable_table()));
+  }
+  truePacket_ = MakePacket<bool>(true);
+  falsePacket_ = MakePacket<bool>(false);
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status gestureRouterCalculator::Process(CalculatorContext* cc) {
+  gesture_map_.Refresh();
+  if (cc->Inputs().HasTag(kClearTag) &&
+      !cc->Inputs().Tag(kClearTag).IsEmpty()) {
+    active_branch_ = kNoBranch;
+  }
+
+  // A CLEAR alone comes from its own sync set, possibly ahead of the
+  // frame of the same timestamp, so the bounds are left to the offset
+  if (cc->Inputs().Tag(kDetectionTag).IsEmpty()) {
+    return ::mediapipe::OkStatus();
+  }
+
+  if (active_branch_ == kNoBranch) {
+    active_branch_ =
+        Classify(cc->Inputs().Tag(kDetectionTag).Get<Detections>());
+    if (active_branch_ != kNoBranch) SetLatches(active_branch_, cc);
+  }
+  Route(active_branch_, cc);
+  return ::mediapipe::OkStatus();
+}
+
+int gestureRouterCalculator::Classify(const Detections& detections) const {
+  for (const auto& detection : detections) {
+    if (detection.label_id_size() == 0) continue;
+    const int label_id = detection.label_id(0);
+    const GestureClass* gesture_class = gesture_map_.get().Find(label_id);
+    if (gesture_class && *gesture_class != GestureClass::kNone) {
+      return BranchOf(*gesture_class);
+    }
+    VLOG(2) << "Gesture " << label_id << " has no class";
+  }
+  return kNoBranch;
+}
+
+void gestureRouterCalculator::Route(int branch, CalculatorContext* cc) {
+  const Timestamp next = cc->InputTimestamp().NextAllowedInStream();
+  for (const char* tag : kRoutedTags) {
+    const int num_branches = cc->Outputs().NumEntries(tag);
+    if (num_branches == 0) continue;
+    const auto& input = cc->Inputs().Tag(tag);
+    for (int i = 0; i < num_branches; ++i) {
+      if (i == branch && !input.IsEmpty()) {
+        cc->Outputs().Get(tag, i).AddPacket(input.Value());
+      } else {
+        cc->Outputs().Get(tag, i).SetNextTimestampBound(next);
+      }
+    }
+  }
+}
+
+// The latch packets are shared, only the timestamp changes between frames
+void gestureRouterCalculator::SetLatches(int branch, CalculatorContext* cc) {
+  const Timestamp timestamp = cc->InputTimestamp();
+  if (cc->Outputs().HasTag(kLatchMovingTag)) {
+    const bool moving = branch == BranchOf(GestureClass::kMoving);
+    cc->Outputs().Tag(kLatchMovingTag).AddPacket(
+        (moving ? truePacket_ : falsePacket_).At(timestamp));
+  }
+  if (cc->Outputs().HasTag(kLatchWritingTag)) {
+    const bool writing = branch == BranchOf(GestureClass::kWriting);
+    cc->Outputs().Tag(kLatchWritingTag).AddPacket(
+        (writing ? truePacket_ : falsePacket_).At(timestamp));
+  }
+}
+
+}  // namespace mediapipe
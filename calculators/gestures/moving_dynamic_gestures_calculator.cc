@@ -13,14 +13,21 @@
 // limitations under the License.
 
 #include <memory>
+#include <utility>
 
 #include "myMediapipe/calculators/gestures/moving_dynamic_gestures_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
+#include "myMediapipe/calculators/util/calculator_stats.h"
 #include "mediapipe/framework/formats/detection.pb.h"
 #include "mediapipe/framework/formats/landmark.pb.h"
 #include "myMediapipe/framework/formats/angles.pb.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
 #include "mediapipe/framework/port/ret_check.h"
 #include "myMediapipe/framework/formats/mqtt_message.pb.h"
+#include "myMediapipe/calculators/gestures/gesture_dispatch.h"
+#include "myMediapipe/calculators/gestures/multi_hand.h"
+#include "myMediapipe/calculators/gestures/reloadable_table.h"
+#include <unordered_map>
 
 
 namespace mediapipe {
@@ -33,6 +40,9 @@ struct StartingGesture{
   decltype(Timestamp().Seconds()) time;
   decltype(Angle().angle1()) angle;
   NormalizedLandmark lmInfo;
+  // x travel of the landmark since the start, integrated from VELOCITY
+  float traslation;
+  decltype(Timestamp().Seconds()) velocityTime;
 };
 
 typedef std::vector<Detection> Detections;
@@ -40,35 +50,99 @@ typedef std::vector<Angle> Angles;
 typedef std::vector<NormalizedLandmark> Landmarks;
 typedef std::vector<Mqtt_Message> MqttMessages;
 
+// Flat copy of a movingActionMap, messages are built once at Open
+struct MovingAction {
+  int start_action;
+  movingActionMap::actType action_type;
+  int landmark_id;
+  int angle_number;
+  float action_threshold;
+  float time_between_actions;
+  bool auto_repeat;
+  bool has_max_repeat;
+  int max_repeat;
+  Mqtt_Message positive_message;
+  Mqtt_Message negative_message;
+};
+
+MovingAction MakeMovingAction(const movingActionMap& act) {
+  MovingAction action;
+  action.start_action = act.start_action();
+  action.action_type = act.action_type();
+  action.landmark_id = act.landmark_id();
+  action.angle_number = act.angle_number();
+  action.action_threshold = act.action_threshold();
+  action.time_between_actions = act.time_between_actions();
+  action.auto_repeat = act.auto_repeat();
+  action.has_max_repeat = act.has_max_repeat();
+  action.max_repeat = act.max_repeat();
+  action.positive_message.set_topic(act.topic());
+  action.positive_message.set_payload(act.positive_payload());
+  action.negative_message.set_topic(act.topic());
+  action.negative_message.set_payload(act.negative_payload());
+  return action;
+}
+
+typedef gesture_dispatch::DispatchTable<MovingAction> ActionsMap;
+
+::mediapipe::Status BuildActionsMap(
+    const movingDynamicGesturesCalculatorOptions& options,
+    ActionsMap* actionsMap) {
+  for (const auto& act_ : options.moving_actions_map()) {
+    actionsMap->Add(act_.start_action(), MakeMovingAction(act_));
+  }
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status ParseActionsMap(const std::string& contents,
+                                    ActionsMap* actionsMap) {
+  movingDynamicGesturesCalculatorOptions options;
+  RET_CHECK(ParseTextProto(contents, &options))
+      << "Not a movingDynamicGesturesCalculatorOptions";
+  return BuildActionsMap(options, actionsMap);
+}
+
+// Action in progress for one hand
+struct HandState {
+  const MovingAction* currentAction = nullptr;
+  StartingGesture startingGesture = {};
+};
+
 constexpr char kDetectionTag[] = "DETECTIONS";
 constexpr char kNormLandmarksTag[] = "NORM_LANDMARKS";
 constexpr char kAnglesTag[] = "ANGLES";
+constexpr char kVelocityTag[] = "VELOCITY";
 constexpr char kFlagTag[] = "FLAG";
 constexpr char kMqttMessageTag[] = "MQTT_MESSAGE";
 
-void clear(movingActionMap &currentAction,
+void clear(const MovingAction* &currentAction,
            StartingGesture& startingGesture) {
-  currentAction.Clear();
+  currentAction = nullptr;
   startingGesture = (struct StartingGesture){0};
 }
 
-decltype(Angle().angle1()) getAngle(int angleNumber, int lmId, const Angles angles){
+// handOffset is the position of the hand angles, see multi_hand.h
+decltype(Angle().angle1()) getAngle(int angleNumber, int lmId, int handOffset,
+                                    const Angles& angles){
   // TODO: replace this literal (by changing the field angle in Angle message to repeated)
-  if(angleNumber==1) return angles[lmId].angle1();
-  else return angles[lmId].angle2();
+  if(angleNumber==1) return angles[handOffset + lmId].angle1();
+  else return angles[handOffset + lmId].angle2();
 }
 
 void setStartingGesture(StartingGesture& startingGesture,
-                        movingActionMap currentAction,
+                        const MovingAction& currentAction,
                         decltype(Timestamp().Seconds()) startingGestureTime,
-                        const Landmarks landmarks,
-                        const Angles angles){
-  startingGesture.start_action= currentAction.start_action();
+                        int handOffset,
+                        const Landmarks& landmarks,
+                        const Angles& angles){
+  startingGesture.start_action= currentAction.start_action;
   startingGesture.time=startingGestureTime;
-  startingGesture.angle=getAngle(currentAction.angle_number(),
-                                 currentAction.landmark_id(),
-                                 angles);
-  startingGesture.lmInfo=landmarks[currentAction.landmark_id()];
+  startingGesture.angle=getAngle(currentAction.angle_number,
+                                 currentAction.landmark_id,
+                                 handOffset, angles);
+  startingGesture.lmInfo=landmarks[handOffset + currentAction.landmark_id];
+  startingGesture.traslation = 0;
+  startingGesture.velocityTime = startingGestureTime;
 
 }
 
@@ -82,10 +156,24 @@ void setStartingGesture(StartingGesture& startingGesture,
 // 
 // 
 //
+// Each detection is tracked by its hand (detection_id), landmarks and
+// angles of hand N are taken from [N*21, N*21+21) of their vectors. The
+// ids are positional (see multi_hand.h), every hand is expired on every
+// frame, so a hand that leaves mid move times out even without detections.
+//
+// With actions_map_file the actions map is read from that file and
+// reloaded when it changes; the moves in progress are dropped.
+//
+// With VELOCITY, the filtered landmark velocities of
+// OneEuroLandmarksFilterCalculator, TRASLATION integrates the velocity of
+// the landmark instead of taking the difference of its positions, so the
+// jitter of a single frame can't trigger an action.
+//
 // Input:
 //  LANDMARKS: used actions requiering hand location
-//  DETECTION: the current detected static gesture.
+//  DETECTION: the current detected static gesture of each hand.
 //  ANGLES
+//  VELOCITY: optional, velocities of the landmarks, same layout.
 //
 // Output:
 //   MQTT_MESSAGE: a message containing the topic and payload 
@@ -97,6 +185,7 @@ void setStartingGesture(StartingGesture& startingGesture,
 //   input_stream: "NORM_LANDMARKS:latched_transition_landmarks"
 //   input_stream: "DETECTIONS:latched_moving_detection"
 //   input_stream: "ANGLES:latched_moving_angles"
+//   input_stream: "VELOCITY:latched_moving_velocity"
 //   Output:
 //   MQTT_MESSAGE: a message containing the topic and payload 
 //                 to be sent to the mqtt dispatcher
@@ -126,11 +215,20 @@ class movingDynamicGesturesCalculator : public CalculatorBase {
   ::mediapipe::Status Process(CalculatorContext* cc) override;
   
   private:
+  void ProcessHand(const int32 label_id, const int handOffset,
+                   HandState& hand, const Landmarks& landmarks,
+                   const Angles& angles, const Landmarks* velocity,
+                   CalculatorContext* cc);
+
   ::mediapipe::movingDynamicGesturesCalculatorOptions options_;
-  movingActionMap currentAction;
-  StartingGesture startingGesture;
+  std::unordered_map<int, HandState> hands;
+  // start_action -> action
+  ReloadableTable<ActionsMap> actionsMap;
   MqttMessages mqttMessages;
   
+  // Shared by every FLAG packet, so idle frames don't allocate
+  Packet flagPacket_;
+  calculator_stats::NodeStats* stats_ = nullptr;
 };
 REGISTER_CALCULATOR(movingDynamicGesturesCalculator);
 
@@ -152,6 +250,9 @@ REGISTER_CALCULATOR(movingDynamicGesturesCalculator);
   
   if (cc->Inputs().HasTag(kAnglesTag))
     cc->Inputs().Tag(kAnglesTag).Set<Angles>(); 
+
+  if (cc->Inputs().HasTag(kVelocityTag))
+    cc->Inputs().Tag(kVelocityTag).Set<Landmarks>();
   
   cc->Outputs().Tag(kFlagTag).Set<bool>();
   cc->Outputs().Tag(kMqttMessageTag).Set<MqttMessages>();
@@ -164,60 +265,125 @@ REGISTER_CALCULATOR(movingDynamicGesturesCalculator);
 ::mediapipe::Status movingDynamicGesturesCalculator::Open(
     CalculatorContext* cc) {
   cc->SetOffset(TimestampDiff(0));
+  stats_ = calculator_stats::ForNode(cc->NodeName());
+  flagPacket_ = MakePacket<bool>(true);
   
   options_ = cc->Options<::mediapipe::movingDynamicGesturesCalculatorOptions>();
 
   RET_CHECK_GE(options_.moving_actions_map_size(),0) 
     << "You should at least provide one action map"; 
- 
-  return ::mediapipe::OkStatus();
+
+  if (options_.has_actions_map_file()) {
+    return actionsMap.Watch(options_.actions_map_file(),
+                            absl::Seconds(options_.reload_interval_s()),
+                            ParseActionsMap);
+  }
+  return BuildActionsMap(options_, actionsMap.mutable_table());
 }
 
 ::mediapipe::Status movingDynamicGesturesCalculator::Process(
     CalculatorContext* cc) {
-      
-  RET_CHECK(!cc->Inputs().Tag(kDetectionTag).IsEmpty());
-  const auto& input_detections =
+  calculator_stats::ScopedProcessTimer timer(stats_);
+  // The hands point into the previous map
+  if (actionsMap.Refresh()) hands.clear();
+
+  if (!cc->Inputs().Tag(kDetectionTag).IsEmpty()) {
+    const auto& input_detections =
         cc->Inputs().Tag(kDetectionTag).Get<Detections>();
-  const auto& input_detection = input_detections.back();
-  const int32 label_id = input_detection.label_id().Get(0);
-  
-  RET_CHECK(!cc->Inputs().Tag(kNormLandmarksTag).IsEmpty());
-  const auto &landmarks = cc->Inputs()
-                              .Tag(kNormLandmarksTag)
-                              .Get<std::vector<NormalizedLandmark>>();
-  RET_CHECK(!cc->Inputs().Tag(kAnglesTag).IsEmpty());
-  const auto &angles = cc->Inputs()
-                              .Tag(kAnglesTag)
-                              .Get<std::vector<Angle>>();
+
+    RET_CHECK(!cc->Inputs().Tag(kNormLandmarksTag).IsEmpty());
+    const auto &landmarks = cc->Inputs()
+                                .Tag(kNormLandmarksTag)
+                                .Get<std::vector<NormalizedLandmark>>();
+    RET_CHECK(!cc->Inputs().Tag(kAnglesTag).IsEmpty());
+    const auto &angles = cc->Inputs()
+                                .Tag(kAnglesTag)
+                                .Get<std::vector<Angle>>();
+    const Landmarks* velocity = nullptr;
+    if (cc->Inputs().HasTag(kVelocityTag) &&
+        !cc->Inputs().Tag(kVelocityTag).IsEmpty()) {
+      velocity = &cc->Inputs().Tag(kVelocityTag).Get<Landmarks>();
+    }
+
+    for (const auto& input_detection : input_detections) {
+      const int hand_id = multi_hand::HandId(input_detection);
+      RET_CHECK(multi_hand::HasHand(hand_id, landmarks.size()) &&
+                multi_hand::HasHand(hand_id, angles.size()))
+          << "No landmarks or angles for hand " << hand_id;
+      RET_CHECK(!velocity || multi_hand::HasHand(hand_id, velocity->size()))
+          << "No velocities for hand " << hand_id;
+      ProcessHand(input_detection.label_id().Get(0),
+                  multi_hand::HandOffset(hand_id), hands[hand_id], landmarks,
+                  angles, velocity, cc);
+    }
+  }
+
+  const auto now = cc->InputTimestamp().Seconds();
+  multi_hand::EraseHandsIf(&hands, [&](const HandState& hand) {
+    return hand.currentAction == nullptr ||
+           now - hand.startingGesture.time >= options_.moving_time_out_s();
+  });
+
+  if(!mqttMessages.empty()){
+    cc->Outputs().Tag(kMqttMessageTag)
+       .Add(new MqttMessages(std::move(mqttMessages)),
+             cc->InputTimestamp().NextAllowedInStream());
+    mqttMessages.clear();
+  }
+
+  // Only the hands with a move in progress are left
+  const bool busy = !hands.empty();
+  if(!busy) 
+     cc->Outputs().Tag(kFlagTag)
+      .AddPacket(flagPacket_.At(
+          cc->InputTimestamp().NextAllowedInStream()));
+
+
+
+  return ::mediapipe::OkStatus();
+}
+
+void movingDynamicGesturesCalculator::ProcessHand(
+    const int32 label_id, const int handOffset, HandState& hand,
+    const Landmarks& landmarks, const Angles& angles,
+    const Landmarks* velocity, CalculatorContext* cc) {
+  const MovingAction* &currentAction = hand.currentAction;
+  StartingGesture& startingGesture = hand.startingGesture;
   
-  if(startingGesture.start_action!=currentAction.start_action())
+  if(currentAction != nullptr &&
+     startingGesture.start_action!=currentAction->start_action)
     clear(currentAction, startingGesture);
   
-  if (!currentAction.IsInitialized()){
-    for(auto act_ : options_.moving_actions_map()){
-      if(act_.start_action()==label_id){
-        currentAction = act_;
-        setStartingGesture(startingGesture, currentAction,
-                           cc->InputTimestamp().Seconds(), landmarks,
-                           angles);
-      } 
+  if (currentAction == nullptr){
+    currentAction = actionsMap.get().Find(label_id);
+    if(currentAction != nullptr){
+      setStartingGesture(startingGesture, *currentAction,
+                         cc->InputTimestamp().Seconds(), handOffset,
+                         landmarks, angles);
     }
     //no gesture found 
-    if(!currentAction.IsInitialized()){
+    else{
       clear(currentAction, startingGesture);
     }
   }
   else{
       // std::cout << "\n !!Gesture:" << std::to_string(label_id)
-//                 << "\t :" << std::to_string(currentAction.start_action())
+//                 << "\t :" << std::to_string(currentAction->start_action)
 //                 << "\t :" << std::to_string(startingGesture.lmInfo.x())
-//                 << "\t :" << std::to_string(landmarks[currentAction.landmark_id()].x())
-//                  << "\t :" << std::to_string(currentAction.action_type())
+//                 << "\t :" << std::to_string(landmarks[currentAction->landmark_id].x())
+//                  << "\t :" << std::to_string(currentAction->action_type)
 //  
 
     //            << "\t :" << std::to_string(releaseControl)
     //           << "\t :" << std::to_string(cc->InputTimestamp().Seconds());
+    if (velocity) {
+      const auto now = cc->InputTimestamp().Seconds();
+      startingGesture.traslation +=
+          (*velocity)[handOffset + currentAction->landmark_id].x() *
+          (now - startingGesture.velocityTime);
+      startingGesture.velocityTime = now;
+    }
+
     // TimeOut
     if((cc->InputTimestamp().Seconds() - 
         startingGesture.time) >= options_.moving_time_out_s()){
@@ -225,79 +391,58 @@ REGISTER_CALCULATOR(movingDynamicGesturesCalculator);
     }
 
     //execute action
-    if((currentAction.IsInitialized()) && 
+    if((currentAction != nullptr) && 
        ((cc->InputTimestamp().Seconds() - 
-        startingGesture.time) >= currentAction.time_between_actions())){
+        startingGesture.time) >= currentAction->time_between_actions)){
       startingGesture.time=cc->InputTimestamp().Seconds();
 
       int numActions = 0;
       float movementDiff = 0;
       
-      switch(currentAction.action_type()){
+      switch(currentAction->action_type){
         
-        case currentAction.TRASLATION:
-          movementDiff = startingGesture.lmInfo.x() - 
-                         landmarks[currentAction.landmark_id()].x();
-          numActions = (int)(movementDiff/currentAction.action_threshold());
+        case movingActionMap::TRASLATION:
+          movementDiff = velocity ? -startingGesture.traslation
+                                  : startingGesture.lmInfo.x() -
+                         landmarks[handOffset + currentAction->landmark_id].x();
+          numActions = (int)(movementDiff/currentAction->action_threshold);
           
-            //  std::cout << "\n !!TRASLATION:" << std::to_string(currentAction.start_action()) 
+            //  std::cout << "\n !!TRASLATION:" << std::to_string(currentAction->start_action) 
             //     << "\t :" << std::to_string(startingGesture.lmInfo.x())
-            //     << "\t :" << std::to_string(landmarks[currentAction.landmark_id()].x())
+            //     << "\t :" << std::to_string(landmarks[currentAction->landmark_id].x())
             //     << "\t :" << std::to_string(movementDiff)
             //     << "\t :" << std::to_string(numActions);
           break;  
         
-        case currentAction.ROTATION:
+        case movingActionMap::ROTATION:
           movementDiff = startingGesture.angle - 
-                                    getAngle(currentAction.angle_number(),
-                                    currentAction.landmark_id(),
-                                    angles);
-          numActions = (int)(movementDiff/currentAction.action_threshold());                                  
+                                    getAngle(currentAction->angle_number,
+                                    currentAction->landmark_id,
+                                    handOffset, angles);
+          numActions = (int)(movementDiff/currentAction->action_threshold);                                  
           break;
       }
 
-      if(!currentAction.auto_repeat() && numActions ) numActions=numActions/abs(numActions);
-      if(currentAction.has_max_repeat() && numActions){
-        if(abs(numActions) > currentAction.max_repeat()){
-          if(numActions>0) numActions=currentAction.max_repeat();
-          else numActions=currentAction.max_repeat() * (-1);
+      if(!currentAction->auto_repeat && numActions ) numActions=numActions/abs(numActions);
+      if(currentAction->has_max_repeat && numActions){
+        if(abs(numActions) > currentAction->max_repeat){
+          if(numActions>0) numActions=currentAction->max_repeat;
+          else numActions=currentAction->max_repeat * (-1);
         }
       } 
 
+      const Mqtt_Message& message = (numActions > 0)
+                                        ? currentAction->positive_message
+                                        : currentAction->negative_message;
       for (int i = 1;  i<=abs(numActions); i++){
-        // std::cout << "\n !!Action:" << std::to_string(currentAction.start_action()) 
-        //   << "\t :" << std::to_string(startingGesture.angle)
-        //   << "\t :" << std::to_string(startingGesture.lmInfo.x())
-        //   << "\t :" << std::to_string(movementDiff)
-        //   << "\t :" << std::to_string(numActions);
-        Mqtt_Message message;
-        message.set_topic(currentAction.topic());
-        if(numActions>0) message.set_payload(currentAction.positive_payload());
-        else message.set_payload(currentAction.negative_payload());
         mqttMessages.emplace_back(message);
       }
         
       if(abs(numActions)){ 
-        cc->Outputs().Tag(kMqttMessageTag)
-           .AddPacket(MakePacket<MqttMessages>(mqttMessages)
-           .At(cc->InputTimestamp()
-           .NextAllowedInStream()));
-        mqttMessages.clear();   
         clear(currentAction, startingGesture);
       }
     } 
   }
-
-
-  if(!currentAction.IsInitialized()) 
-     cc->Outputs().Tag(kFlagTag)
-      .AddPacket(MakePacket<bool>(true)
-                            .At(cc->InputTimestamp()
-                            .NextAllowedInStream()));
-
-
-
-  return ::mediapipe::OkStatus();
 }
 
 }  // namespace mediapipe
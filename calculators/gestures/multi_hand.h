@@ -0,0 +1,67 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_CALCULATORS_GESTURES_MULTI_HAND_H_
+#define MYMEDIAPIPE_CALCULATORS_GESTURES_MULTI_HAND_H_
+
+#include "mediapipe/framework/formats/detection.pb.h"
+
+namespace mediapipe {
+namespace multi_hand {
+
+// Landmarks and angles of every hand, hand N is stored at
+// [N*kLandmarksPerHand, (N+1)*kLandmarksPerHand) of the landmark and
+// angle vectors
+constexpr int kLandmarksPerHand = 21;
+
+// The hand a static gesture detection belongs to, AnglesToDetectionCalculator
+// stores it as the detection_id. Detections without id come from a single
+// hand pipeline.
+//
+// Ids are positional, the row of the hand in the multi hand vectors of the
+// frame, not a tracked identity: when a hand leaves, the next frame may
+// give its id to another hand. Calculators keeping per hand state expire
+// every hand on every frame, see EraseHandsIf.
+inline int HandId(const Detection& detection) {
+  return detection.has_detection_id() ? detection.detection_id() : 0;
+}
+
+// Position of the first landmark/angle of the hand in the flat vectors
+inline int HandOffset(int hand_id) { return hand_id * kLandmarksPerHand; }
+
+// Whether the flat vector of landmarks/angles holds the given hand
+inline bool HasHand(int hand_id, int size) {
+  return hand_id >= 0 && HandOffset(hand_id + 1) <= size;
+}
+
+// Erases the hands of an id -> state map for which predicate(state) is
+// true. Called on every Process with the hands that are idle or whose
+// gesture timed out, whether their detection came or not, so a hand that
+// leaves mid gesture doesn't stay busy and the map only holds the
+// gestures in progress.
+template <typename HandMap, typename Predicate>
+void EraseHandsIf(HandMap* hands, Predicate predicate) {
+  for (auto it = hands->begin(); it != hands->end();) {
+    if (predicate(it->second)) {
+      it = hands->erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+}  // namespace multi_hand
+}  // namespace mediapipe
+
+#endif  // MYMEDIAPIPE_CALCULATORS_GESTURES_MULTI_HAND_H_
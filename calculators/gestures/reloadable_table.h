@@ -0,0 +1,110 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_CALCULATORS_GESTURES_RELOADABLE_TABLE_H_
+#define MYMEDIAPIPE_CALCULATORS_GESTURES_RELOADABLE_TABLE_H_
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "absl/memory/memory.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/logging.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/util/resource_util.h"
+#include "myMediapipe/calculators/util/file_watcher.h"
+
+namespace mediapipe {
+
+// Dispatch table of a calculator that can be replaced while the graph
+// runs. The table is built from a file, rebuilt from a FileWatcher thread
+// whenever the file changes and handed to Process through a single
+// pointer: the watcher publishes the new table with an atomic exchange
+// and Process takes it at the start of a frame with Refresh, so the hot
+// path never locks. The table in use is only freed by Refresh, once the
+// calculator is done with the previous frame.
+//
+// Example:
+//   // Open
+//   MP_RETURN_IF_ERROR(table_.Watch(path, absl::Seconds(1), ParseTable));
+//   // Process
+//   if (table_.Refresh()) hands_.clear();  // pointers into the old table
+//   const Record* record = table_.get().Find(label_id);
+template <class Table>
+class ReloadableTable {
+ public:
+  // Builds the table from the contents of the file
+  typedef std::function<::mediapipe::Status(const std::string& contents,
+                                            Table* table)>
+      Parser;
+
+  ~ReloadableTable() {
+    watcher_.reset();
+    delete pending_.exchange(nullptr);
+  }
+
+  // Table used when nothing is watched, filled at Open
+  Table* mutable_table() { return current_.get(); }
+  const Table& get() const { return *current_; }
+
+  // Builds the table from path now, a bad file fails Open, then rebuilds
+  // it every time the file changes. Bad versions of the file are logged
+  // and the last good table stays.
+  ::mediapipe::Status Watch(const std::string& path, absl::Duration interval,
+                            Parser parser) {
+    std::string resolved_path;
+    ASSIGN_OR_RETURN(resolved_path, PathToResourceAsFile(path));
+    std::string contents;
+    MP_RETURN_IF_ERROR(file::GetContents(resolved_path, &contents));
+    current_ = absl::make_unique<Table>();
+    MP_RETURN_IF_ERROR(parser(contents, current_.get()));
+
+    watcher_ = absl::make_unique<FileWatcher>(
+        resolved_path, interval,
+        [this, resolved_path, parser](const std::string& contents) {
+          auto table = absl::make_unique<Table>();
+          ::mediapipe::Status status = parser(contents, table.get());
+          if (!status.ok()) {
+            LOG(ERROR) << "Keeping the previous table, can't reload "
+                       << resolved_path << ": " << status.message();
+            return;
+          }
+          LOG(INFO) << "Reloaded " << resolved_path;
+          // A table Process didn't take yet is replaced
+          delete pending_.exchange(table.release(), std::memory_order_acq_rel);
+        });
+    return ::mediapipe::OkStatus();
+  }
+
+  // Swaps in the table published since the last call, if any. Returns
+  // true when it did, the references to the previous table are invalid.
+  bool Refresh() {
+    if (pending_.load(std::memory_order_relaxed) == nullptr) return false;
+    current_.reset(pending_.exchange(nullptr, std::memory_order_acq_rel));
+    return true;
+  }
+
+ private:
+  std::unique_ptr<Table> current_ = absl::make_unique<Table>();
+  // Owned, published by the watcher thread and taken by Refresh
+  std::atomic<Table*> pending_{nullptr};
+  std::unique_ptr<FileWatcher> watcher_;
+};
+
+}  // namespace mediapipe
+
+#endif  // MYMEDIAPIPE_CALCULATORS_GESTURES_RELOADABLE_TABLE_H_
@@ -0,0 +1,250 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/landmark.pb.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "myMediapipe/calculators/gestures/skeleton_calculator.pb.h"
+#include "myMediapipe/calculators/gestures/skeleton_features.h"
+#include "myMediapipe/calculators/tflite/tensor_ring.h"
+
+namespace mediapipe {
+
+namespace {
+
+constexpr char kNormLandmarksTag[] = "NORM_LANDMARKS";
+constexpr char kMultiNormLandmarksTag[] = "MULTI_NORM_LANDMARKS";
+constexpr char kFeaturesTag[] = "FEATURES";
+constexpr char kTensorsTag[] = "TENSORS";
+
+// One instantiation of skeleton_features::FeatureSet, picked at Open
+struct FeatureSetInfo {
+  int size;
+  void (*compute)(const float* x, const float* y, float* features);
+};
+
+template <unsigned Groups>
+FeatureSetInfo MakeFeatureSetInfo() {
+  using Set = skeleton_features::FeatureSet<Groups>;
+  return {Set::kSize, &Set::Compute};
+}
+
+::mediapipe::Status GetFeatureSetInfo(
+    skeletonCalculatorOptions::FeatureSet feature_set, FeatureSetInfo* info) {
+  using namespace skeleton_features;  // NOLINT
+  switch (feature_set) {
+    case skeletonCalculatorOptions::ALL:
+      *info = MakeFeatureSetInfo<kAllFeatures>();
+      break;
+    case skeletonCalculatorOptions::BONES:
+      *info = MakeFeatureSetInfo<kBones>();
+      break;
+    case skeletonCalculatorOptions::FINGER_DISTANCES:
+      *info = MakeFeatureSetInfo<kFingerDistances>();
+      break;
+    case skeletonCalculatorOptions::JOINT_ANGLES:
+      *info = MakeFeatureSetInfo<kJointAngles>();
+      break;
+    case skeletonCalculatorOptions::BONES_AND_ANGLES:
+      *info = MakeFeatureSetInfo<kBones | kJointAngles>();
+      break;
+    case skeletonCalculatorOptions::DISTANCES_AND_ANGLES:
+      *info = MakeFeatureSetInfo<kFingerDistances | kJointAngles>();
+      break;
+    default:
+      RET_CHECK_FAIL() << "Unknown feature set " << feature_set;
+  }
+  return ::mediapipe::OkStatus();
+}
+
+}  // namespace
+
+// Computes skeleton features of the hands: normalized bone vectors,
+// distances between finger tips and joint angles, see skeleton_features.h.
+// All the groups come out of a single pass over the landmarks, and the
+// feature_set option selects which of them are written, so a classifier
+// can be trained on a compact input instead of the 42 padded angles of
+// landmarksToTfLiteConverterCalculator. The sets are instantiated at
+// compile time, the option only picks one of them at Open.
+//
+// Input, one of the following tags:
+//  NORM_LANDMARKS: A NormalizedLandmarkList with the hand landmarks.
+//  MULTI_NORM_LANDMARKS: A std::vector<NormalizedLandmarkList> with the
+//                        landmarks of several hands.
+//
+// Output, at least one of the following tags:
+//  FEATURES: A std::vector<float> with the features of every hand, one
+//            after the other.
+//  TENSORS: Vector of TfLiteTensor of type kTfLiteFloat32 with the same
+//           features, shaped {num_features} for a single hand or
+//           {num_hands, num_features} for MULTI_NORM_LANDMARKS, ready for
+//           batchTfLiteInferenceCalculator. Allocated at Open for
+//           max_num_hands.
+//
+// Example config:
+// node {
+//   calculator: "skeletonCalculator"
+//   input_stream: "MULTI_NORM_LANDMARKS:multi_hand_landmarks"
+//   output_stream: "TENSORS:skeleton_tensor"
+//   options: {
+//     [mediapipe.skeletonCalculatorOptions.ext] {
+//       feature_set: DISTANCES_AND_ANGLES
+//     }
+//   }
+// }
+
+class skeletonCalculator : public CalculatorBase {
+ public:
+  static ::mediapipe::Status GetContract(CalculatorContract* cc);
+  ::mediapipe::Status Open(CalculatorContext* cc) override;
+  ::mediapipe::Status Process(CalculatorContext* cc) override;
+
+ private:
+  ::mediapipe::Status ComputeFeatures(
+      const std::vector<const NormalizedLandmarkList*>& hands);
+  ::mediapipe::Status OutputTensor(int num_hands, CalculatorContext* cc);
+
+  skeletonCalculatorOptions options_;
+  FeatureSetInfo feature_set_;
+  // Features of all the hands of the current frame
+  std::vector<float> features_;
+
+  // Only created when the TENSORS output is used
+  std::unique_ptr<TensorRing> tensors_;
+};
+REGISTER_CALCULATOR(skeletonCalculator);
+
+::mediapipe::Status skeletonCalculator::GetContract(CalculatorContract* cc) {
+  RET_CHECK(cc->Inputs().HasTag(kNormLandmarksTag) ^
+            cc->Inputs().HasTag(kMultiNormLandmarksTag))
+      << "Either NORM_LANDMARKS or MULTI_NORM_LANDMARKS must be provided.";
+  RET_CHECK(cc->Outputs().HasTag(kFeaturesTag) ||
+            cc->Outputs().HasTag(kTensorsTag))
+      << "FEATURES or TENSORS output stream must be provided.";
+
+  if (cc->Inputs().HasTag(kNormLandmarksTag)) {
+    cc->Inputs().Tag(kNormLandmarksTag).Set<NormalizedLandmarkList>();
+  } else {
+    cc->Inputs()
+        .Tag(kMultiNormLandmarksTag)
+        .Set<std::vector<NormalizedLandmarkList>>();
+  }
+  if (cc->Outputs().HasTag(kFeaturesTag)) {
+    cc->Outputs().Tag(kFeaturesTag).Set<std::vector<float>>();
+  }
+  if (cc->Outputs().HasTag(kTensorsTag)) {
+    cc->Outputs().Tag(kTensorsTag).Set<std::vector<TfLiteTensor>>();
+  }
+
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status skeletonCalculator::Open(CalculatorContext* cc) {
+  cc->SetOffset(TimestampDiff(0));
+
+  options_ = cc->Options<skeletonCalculatorOptions>();
+  MP_RETURN_IF_ERROR(GetFeatureSetInfo(options_.feature_set(), &feature_set_));
+
+  if (cc->Outputs().HasTag(kTensorsTag)) {
+    tensors_ = absl::make_unique<TensorRing>();
+
+    // Allocated once for the most hands, a frame with fewer hands only
+    // reshapes its tensor
+    if (cc->Inputs().HasTag(kNormLandmarksTag)) {
+      MP_RETURN_IF_ERROR(
+          tensors_->Allocate(kTfLiteFloat32, {feature_set_.size}));
+    } else {
+      RET_CHECK_GT(options_.max_num_hands(), 0);
+      MP_RETURN_IF_ERROR(tensors_->Allocate(
+          kTfLiteFloat32, {options_.max_num_hands(), feature_set_.size}));
+    }
+  }
+
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status skeletonCalculator::ComputeFeatures(
+    const std::vector<const NormalizedLandmarkList*>& hands) {
+  float x[skeleton_features::kNumLandmarks];
+  float y[skeleton_features::kNumLandmarks];
+  features_.resize(hands.size() * feature_set_.size);
+  for (int hand = 0; hand < static_cast<int>(hands.size()); ++hand) {
+    const auto& landmarks = *hands[hand];
+    RET_CHECK_GE(landmarks.landmark_size(), skeleton_features::kNumLandmarks);
+    for (int i = 0; i < skeleton_features::kNumLandmarks; ++i) {
+      x[i] = landmarks.landmark(i).x();
+      y[i] = landmarks.landmark(i).y();
+    }
+    feature_set_.compute(x, y, features_.data() + hand * feature_set_.size);
+  }
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status skeletonCalculator::OutputTensor(int num_hands,
+                                                     CalculatorContext* cc) {
+  const int tensor_idx = tensors_->Next();
+  if (cc->Inputs().HasTag(kMultiNormLandmarksTag)) {
+    RET_CHECK_LE(num_hands, options_.max_num_hands())
+        << "More hands than max_num_hands.";
+    MP_RETURN_IF_ERROR(
+        tensors_->Reshape(tensor_idx, {num_hands, feature_set_.size}));
+  }
+  std::copy(features_.begin(), features_.end(),
+            tensors_->data<float>(tensor_idx));
+  cc->Outputs().Tag(kTensorsTag).Add(
+      tensors_->MakeOutput(tensor_idx).release(), cc->InputTimestamp());
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status skeletonCalculator::Process(CalculatorContext* cc) {
+  std::vector<const NormalizedLandmarkList*> hands;
+  if (cc->Inputs().HasTag(kNormLandmarksTag)) {
+    if (cc->Inputs().Tag(kNormLandmarksTag).IsEmpty()) {
+      return ::mediapipe::OkStatus();
+    }
+    hands.push_back(
+        &cc->Inputs().Tag(kNormLandmarksTag).Get<NormalizedLandmarkList>());
+  } else {
+    if (cc->Inputs().Tag(kMultiNormLandmarksTag).IsEmpty()) {
+      return ::mediapipe::OkStatus();
+    }
+    for (const auto& landmarks :
+         cc->Inputs()
+             .Tag(kMultiNormLandmarksTag)
+             .Get<std::vector<NormalizedLandmarkList>>()) {
+      hands.push_back(&landmarks);
+    }
+  }
+  const int num_hands = hands.size();
+  if (num_hands == 0) return ::mediapipe::OkStatus();
+
+  MP_RETURN_IF_ERROR(ComputeFeatures(hands));
+
+  if (cc->Outputs().HasTag(kFeaturesTag)) {
+    cc->Outputs().Tag(kFeaturesTag).AddPacket(
+        MakePacket<std::vector<float>>(features_).At(cc->InputTimestamp()));
+  }
+  if (cc->Outputs().HasTag(kTensorsTag)) {
+    MP_RETURN_IF_ERROR(OutputTensor(num_hands, cc));
+  }
+
+  return ::mediapipe::OkStatus();
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,125 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_CALCULATORS_GESTURES_SKELETON_FEATURES_H_
+#define MYMEDIAPIPE_CALCULATORS_GESTURES_SKELETON_FEATURES_H_
+
+#include <cmath>
+
+#include "myMediapipe/calculators/util/hand_angles.h"
+
+namespace mediapipe {
+namespace skeleton_features {
+
+// Feature groups, combined as bit flags in the FeatureSet parameter
+constexpr unsigned kBones = 1 << 0;
+constexpr unsigned kFingerDistances = 1 << 1;
+constexpr unsigned kJointAngles = 1 << 2;
+constexpr unsigned kAllFeatures = kBones | kFingerDistances | kJointAngles;
+
+constexpr int kNumLandmarks = hand_angles::kNumLandmarks;
+// Bone i goes from landmark kBoneParents[i] to landmark i + 1
+constexpr int kBoneParents[] = {0, 1, 2, 3,  0, 5,  6,  7,  0,  9,
+                                10, 11, 0, 13, 14, 15, 0, 17, 18, 19};
+constexpr int kNumBones = sizeof(kBoneParents) / sizeof(kBoneParents[0]);
+constexpr int kFingerTips[] = {4, 8, 12, 16, 20};
+constexpr int kNumFingerTips = sizeof(kFingerTips) / sizeof(kFingerTips[0]);
+
+// Features of every group
+constexpr int kNumBoneFeatures = kNumBones * 2;
+constexpr int kNumFingerDistances = kNumFingerTips * (kNumFingerTips - 1) / 2;
+// The joint angles of hand_angles plus the palm one
+constexpr int kNumJointAngles = hand_angles::kNumJointTriples + 1;
+
+// Number of features computed for the groups, known at compile time so
+// callers can size buffers and tensors with it.
+constexpr int NumFeatures(unsigned groups) {
+  return ((groups & kBones) ? kNumBoneFeatures : 0) +
+         ((groups & kFingerDistances) ? kNumFingerDistances : 0) +
+         ((groups & kJointAngles) ? kNumJointAngles : 0);
+}
+
+// Skeleton features of one hand, computed in a single pass over the
+// landmarks into a flat float buffer. Groups left out of the set are not
+// computed at all, the branches on Groups are resolved at compile time.
+//
+// Layout of the buffer, in this order and only for the groups selected:
+//   bones:            (dx, dy) of the 20 bones, child minus parent, divided
+//                     by the palm length (wrist to middle finger MCP) so
+//                     they don't depend on the distance to the camera.
+//   finger distances: distance between every pair of finger tips, thumb
+//                     to index first, also divided by the palm length.
+//   joint angles:     the palm angle followed by the joint angles of
+//                     hand_angles::kJointTriples, in radians, without the
+//                     zero padding of hand_angles::ComputeFeatures.
+//
+// Example:
+//   using Compact = skeleton_features::FeatureSet<
+//       skeleton_features::kFingerDistances | skeleton_features::kJointAngles>;
+//   float features[Compact::kSize];
+//   Compact::Compute(x, y, features);
+template <unsigned Groups>
+struct FeatureSet {
+  static_assert(Groups != 0 && (Groups & ~kAllFeatures) == 0,
+                "Unknown skeleton feature group");
+  static constexpr int kSize = NumFeatures(Groups);
+
+  // x and y hold the kNumLandmarks landmark coordinates, features kSize
+  // values.
+  static void Compute(const float* x, const float* y, float* features) {
+    const float palm_x = x[9] - x[0];
+    const float palm_y = y[9] - y[0];
+    const float palm_length = std::sqrt(palm_x * palm_x + palm_y * palm_y);
+    // A collapsed hand gives zeros instead of infinities
+    const float inv_palm = palm_length > 1e-6f ? 1.0f / palm_length : 0.0f;
+
+    float* out = features;
+    if (Groups & kBones) {
+      for (int bone = 0; bone < kNumBones; ++bone) {
+        const int parent = kBoneParents[bone];
+        *out++ = (x[bone + 1] - x[parent]) * inv_palm;
+        *out++ = (y[bone + 1] - y[parent]) * inv_palm;
+      }
+    }
+    if (Groups & kFingerDistances) {
+      for (int i = 0; i < kNumFingerTips; ++i) {
+        for (int j = i + 1; j < kNumFingerTips; ++j) {
+          const float dx = x[kFingerTips[j]] - x[kFingerTips[i]];
+          const float dy = y[kFingerTips[j]] - y[kFingerTips[i]];
+          *out++ = std::sqrt(dx * dx + dy * dy) * inv_palm;
+        }
+      }
+    }
+    if (Groups & kJointAngles) {
+      // Same handedness guess as hand_angles, it assumes the palm faces the
+      // camera
+      const bool right_hand = (x[5] > x[17]);
+      *out++ = hand_angles::AngleBetweenLines(x[0], y[0], x[9], y[9], 0, y[0],
+                                              false);
+      for (const auto& triple : hand_angles::kJointTriples) {
+        *out++ = hand_angles::AngleBetweenLines(
+            x[triple.joint], y[triple.joint], x[triple.first],
+            y[triple.first], x[triple.second], y[triple.second], right_hand);
+      }
+    }
+  }
+};
+
+template <unsigned Groups>
+constexpr int FeatureSet<Groups>::kSize;
+
+}  // namespace skeleton_features
+}  // namespace mediapipe
+
+#endif  // MYMEDIAPIPE_CALCULATORS_GESTURES_SKELETON_FEATURES_H_
@@ -0,0 +1,103 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myMediapipe/calculators/gestures/stroke_raster.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace mediapipe {
+
+constexpr int StrokeRaster::kImageSize;
+constexpr int StrokeRaster::kDigitBox;
+constexpr int StrokeRaster::kSupersampling;
+constexpr int StrokeRaster::kCanvasSize;
+
+StrokeRaster::StrokeRaster(float stroke_width)
+    : radius_(std::max(stroke_width, 0.5f) * kSupersampling / 2) {
+  std::memset(canvas_, 0, sizeof(canvas_));
+  std::memset(image_, 0, sizeof(image_));
+}
+
+void StrokeRaster::Draw(const TrajectoryBuffer& trajectory) {
+  std::memset(canvas_, 0, sizeof(canvas_));
+
+  if (!trajectory.empty()) {
+    const float width = trajectory.max_x() - trajectory.min_x();
+    const float height = trajectory.max_y() - trajectory.min_y();
+    const float extent = std::max(width, height);
+    // A trajectory without extent is drawn as a dot in the middle
+    const float scale =
+        extent > 0 ? (kDigitBox * kSupersampling - 2 * radius_) / extent : 0;
+    const float offset_x = kCanvasSize / 2.0f -
+                           (trajectory.min_x() + width / 2) * scale;
+    const float offset_y = kCanvasSize / 2.0f -
+                           (trajectory.min_y() + height / 2) * scale;
+
+    float prev_x = trajectory.x(0) * scale + offset_x;
+    float prev_y = trajectory.y(0) * scale + offset_y;
+    DrawSegment(prev_x, prev_y, prev_x, prev_y);
+    for (int i = 1; i < trajectory.size(); ++i) {
+      const float x = trajectory.x(i) * scale + offset_x;
+      const float y = trajectory.y(i) * scale + offset_y;
+      DrawSegment(prev_x, prev_y, x, y);
+      prev_x = x;
+      prev_y = y;
+    }
+  }
+
+  // Box filter down to the image
+  constexpr float kNorm = 1.0f / (255 * kSupersampling * kSupersampling);
+  for (int row = 0; row < kImageSize; ++row) {
+    for (int col = 0; col < kImageSize; ++col) {
+      int sum = 0;
+      for (int sy = 0; sy < kSupersampling; ++sy) {
+        const uint8* canvas_row =
+            canvas_ + (row * kSupersampling + sy) * kCanvasSize +
+            col * kSupersampling;
+        for (int sx = 0; sx < kSupersampling; ++sx) sum += canvas_row[sx];
+      }
+      image_[row * kImageSize + col] = sum * kNorm;
+    }
+  }
+}
+
+void StrokeRaster::DrawSegment(float x0, float y0, float x1, float y1) {
+  const int min_col = std::max(0, (int)std::floor(std::min(x0, x1) - radius_));
+  const int max_col =
+      std::min(kCanvasSize - 1, (int)std::ceil(std::max(x0, x1) + radius_));
+  const int min_row = std::max(0, (int)std::floor(std::min(y0, y1) - radius_));
+  const int max_row =
+      std::min(kCanvasSize - 1, (int)std::ceil(std::max(y0, y1) + radius_));
+
+  const float dx = x1 - x0;
+  const float dy = y1 - y0;
+  const float length2 = dx * dx + dy * dy;
+  const float radius2 = radius_ * radius_;
+  for (int row = min_row; row <= max_row; ++row) {
+    const float py = row + 0.5f - y0;
+    for (int col = min_col; col <= max_col; ++col) {
+      const float px = col + 0.5f - x0;
+      // Distance from the pixel center to the closest point of the segment
+      float t = length2 > 0 ? (px * dx + py * dy) / length2 : 0;
+      t = std::min(1.0f, std::max(0.0f, t));
+      const float ex = px - t * dx;
+      const float ey = py - t * dy;
+      if (ex * ex + ey * ey <= radius2) canvas_[row * kCanvasSize + col] = 255;
+    }
+  }
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,58 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_CALCULATORS_GESTURES_STROKE_RASTER_H_
+#define MYMEDIAPIPE_CALCULATORS_GESTURES_STROKE_RASTER_H_
+
+#include "mediapipe/framework/port/integral_types.h"
+#include "myMediapipe/calculators/gestures/trajectory_buffer.h"
+
+namespace mediapipe {
+
+// Draws the trajectory of a writing gesture as an MNIST digit: a white
+// stroke on black, scaled to fit a kDigitBox square keeping its aspect
+// ratio and centered in a kImageSize square image.
+//
+// The stroke is drawn kSupersampling times bigger into a fixed canvas and
+// then averaged down, which antialiases it. Both buffers are members, so
+// drawing doesn't allocate.
+class StrokeRaster {
+ public:
+  static constexpr int kImageSize = 28;
+  static constexpr int kDigitBox = 20;
+  static constexpr int kSupersampling = 4;
+  static constexpr int kCanvasSize = kImageSize * kSupersampling;
+
+  // stroke_width in pixels of the kImageSize image
+  explicit StrokeRaster(float stroke_width = 2.0f);
+
+  // Replaces image() with the drawing of the trajectory
+  void Draw(const TrajectoryBuffer& trajectory);
+
+  // kImageSize * kImageSize values in [0,1], row major
+  const float* image() const { return image_; }
+
+ private:
+  // Sets every canvas pixel within radius_ of the segment, coordinates are
+  // canvas pixels
+  void DrawSegment(float x0, float y0, float x1, float y1);
+
+  const float radius_;
+  uint8 canvas_[kCanvasSize * kCanvasSize];
+  float image_[kImageSize * kImageSize];
+};
+
+}  // namespace mediapipe
+
+#endif  // MYMEDIAPIPE_CALCULATORS_GESTURES_STROKE_RASTER_H_
@@ -0,0 +1,105 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myMediapipe/calculators/gestures/trajectory_buffer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace mediapipe {
+
+namespace {
+
+// Same angle the writing calculator used to compute from the landmark
+// protos, the turn at `middle` in degrees
+int TurningAngle(float start_x, float start_y, float middle_x,
+                 float middle_y, float end_x, float end_y) {
+  const float ang1 = std::atan2(end_y - middle_y, end_x - middle_x);
+  const float ang2 = std::atan2(start_y - middle_y, start_x - middle_x);
+  return static_cast<int>(std::abs((ang1 - ang2) * (180 / M_PI)));
+}
+
+}  // namespace
+
+void TrajectoryBuffer::MonotonicQueue::Push(int64 seq,
+                                            const std::vector<float>& values,
+                                            int slot_mod, bool keep_smaller) {
+  const float value = values[seq % slot_mod];
+  while (size_ > 0) {
+    const float back_value = values[back() % slot_mod];
+    if (keep_smaller ? back_value < value : back_value > value) break;
+    --size_;
+  }
+  seqs_[(head_ + size_) % seqs_.size()] = seq;
+  ++size_;
+}
+
+void TrajectoryBuffer::MonotonicQueue::DropBefore(int64 seq) {
+  while (size_ > 0 && front() < seq) {
+    head_ = (head_ + 1) % seqs_.size();
+    --size_;
+  }
+}
+
+TrajectoryBuffer::TrajectoryBuffer(int capacity, int angle_window)
+    : capacity_(std::max(capacity, 1)),
+      angle_window_(std::max(angle_window, 2)),
+      x_(capacity_),
+      y_(capacity_),
+      t_(capacity_),
+      min_x_(capacity_),
+      max_x_(capacity_),
+      min_y_(capacity_),
+      max_y_(capacity_) {}
+
+void TrajectoryBuffer::Clear() {
+  size_ = 0;
+  last_angle_ = -1;
+  min_x_.Clear();
+  max_x_.Clear();
+  min_y_.Clear();
+  max_y_.Clear();
+}
+
+void TrajectoryBuffer::Push(float x, float y, double t) {
+  const int64 seq = next_seq_++;
+  const int slot = seq % capacity_;
+  x_[slot] = x;
+  y_[slot] = y;
+  t_[slot] = t;
+  if (size_ < capacity_) ++size_;
+
+  // The point dropped to make room, if any, leaves the bounding box
+  const int64 oldest = next_seq_ - size_;
+  min_x_.DropBefore(oldest);
+  max_x_.DropBefore(oldest);
+  min_y_.DropBefore(oldest);
+  max_y_.DropBefore(oldest);
+  min_x_.Push(seq, x_, capacity_, /*keep_smaller=*/true);
+  max_x_.Push(seq, x_, capacity_, /*keep_smaller=*/false);
+  min_y_.Push(seq, y_, capacity_, /*keep_smaller=*/true);
+  max_y_.Push(seq, y_, capacity_, /*keep_smaller=*/false);
+
+  if (size_ > angle_window_) {
+    const int end = size_ - 1;
+    const int middle = end - angle_window_ / 2;
+    const int start = end - angle_window_;
+    last_angle_ = TurningAngle(this->x(start), this->y(start),
+                               this->x(middle), this->y(middle), x, y);
+  } else {
+    last_angle_ = -1;
+  }
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,111 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_CALCULATORS_GESTURES_TRAJECTORY_BUFFER_H_
+#define MYMEDIAPIPE_CALCULATORS_GESTURES_TRAJECTORY_BUFFER_H_
+
+#include <vector>
+
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+
+// Last `capacity` positions of a landmark, ie the tip of the index while a
+// writing gesture is drawn. Memory is allocated once at construction, a
+// full buffer drops its oldest point.
+//
+// Points are kept as a structure of arrays (x, y, t) so sequence models
+// can read them without unpacking protos. The bounding box of the points
+// kept and the turning angle at every point are updated as points come
+// in, so neither walks the buffer.
+//
+// Example:
+//   TrajectoryBuffer trajectory(/*capacity=*/256, /*angle_window=*/15);
+//   trajectory.Push(landmark.x(), landmark.y(), timestamp.Seconds());
+//   if (trajectory.last_angle() >= 0 && trajectory.last_angle() < 140) ...
+class TrajectoryBuffer {
+ public:
+  // The angle at a point is the one between the point angle_window points
+  // before, the one in between and itself.
+  TrajectoryBuffer(int capacity, int angle_window);
+
+  void Clear();
+  void Push(float x, float y, double t);
+
+  bool empty() const { return size_ == 0; }
+  int size() const { return size_; }
+  int capacity() const { return capacity_; }
+
+  // i-th point kept, 0 is the oldest
+  float x(int i) const { return x_[Slot(i)]; }
+  float y(int i) const { return y_[Slot(i)]; }
+  double t(int i) const { return t_[Slot(i)]; }
+
+  // Turning angle at the last point in degrees, within [0, 360), -1 while
+  // there are not enough points
+  int last_angle() const { return last_angle_; }
+
+  // Bounding box of the points kept, 0 when empty
+  float min_x() const { return Extreme(min_x_, x_); }
+  float max_x() const { return Extreme(max_x_, x_); }
+  float min_y() const { return Extreme(min_y_, y_); }
+  float max_y() const { return Extreme(max_y_, y_); }
+
+ private:
+  // Sequence numbers of the points that can still be the min or max of the
+  // points kept, in the order they were added. A point that is worse than
+  // a newer one never becomes the extreme again, so it is dropped, and
+  // each update is O(1) amortized.
+  class MonotonicQueue {
+   public:
+    explicit MonotonicQueue(int capacity) : seqs_(capacity) {}
+    void Clear() { head_ = size_ = 0; }
+    // values holds the coordinate of every slot, keep_smaller selects min
+    void Push(int64 seq, const std::vector<float>& values, int slot_mod,
+              bool keep_smaller);
+    void DropBefore(int64 seq);
+    bool empty() const { return size_ == 0; }
+    int64 front() const { return seqs_[head_]; }
+
+   private:
+    int64 back() const { return seqs_[(head_ + size_ - 1) % seqs_.size()]; }
+    std::vector<int64> seqs_;
+    int head_ = 0;
+    int size_ = 0;
+  };
+
+  int Slot(int i) const { return (next_seq_ - size_ + i) % capacity_; }
+  float Extreme(const MonotonicQueue& queue,
+                const std::vector<float>& values) const {
+    return queue.empty() ? 0 : values[queue.front() % capacity_];
+  }
+
+  const int capacity_;
+  const int angle_window_;
+  std::vector<float> x_;
+  std::vector<float> y_;
+  std::vector<double> t_;
+  int size_ = 0;
+  // Sequence number of the next point pushed, slot = seq % capacity
+  int64 next_seq_ = 0;
+  int last_angle_ = -1;
+  MonotonicQueue min_x_;
+  MonotonicQueue max_x_;
+  MonotonicQueue min_y_;
+  MonotonicQueue max_y_;
+};
+
+}  // namespace mediapipe
+
+#endif  // MYMEDIAPIPE_CALCULATORS_GESTURES_TRAJECTORY_BUFFER_H_
@@ -13,33 +13,35 @@
 // limitations under the License.
 
 //#include <memory>
+#include <utility>
 
 #include "myMediapipe/calculators/gestures/transition_dynamic_gestures_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
+#include "myMediapipe/calculators/util/calculator_stats.h"
 #include "mediapipe/framework/formats/detection.pb.h"
 #include "mediapipe/framework/formats/landmark.pb.h"
 #include "myMediapipe/framework/formats/mqtt_message.pb.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
 #include "mediapipe/framework/port/ret_check.h"
+#include "myMediapipe/calculators/gestures/gesture_dispatch.h"
+#include "myMediapipe/calculators/gestures/multi_hand.h"
+#include "myMediapipe/calculators/gestures/reloadable_table.h"
+#include <unordered_map>
 
 
 namespace mediapipe {
 
 namespace {
 
-struct Mqtt{
-  std::string topic;
-  std::string payload;
+// Action of a start gesture, the message is built once at Open
+struct TransitionAction{
+  int endAction;
+  Mqtt_Message message;
 };
 
-struct _actions{
-     int startAction;
-     int endAction;
-     Mqtt mqtt;
-     bool notEmpty;
- };
-
 typedef std::vector<Detection> Detections;
 typedef std::vector<Mqtt_Message> MqttMessages;
+typedef gesture_dispatch::DispatchTable<TransitionAction> ActionsMap;
 
 constexpr char kDetectionTag[] = "DETECTIONS";
 constexpr char kNormLandmarksTag[] = "NORM_LANDMARKS";
@@ -49,11 +51,38 @@ constexpr char kMqttMessageTag[] = "MQTT_MESSAGE";
 
 
 
-void clear(_actions &currentAction,
+// Action in progress for one hand
+struct HandState {
+  const TransitionAction* currentAction = nullptr;
+  decltype(Timestamp().Seconds()) startingGestureTime = 0;
+};
+
+void clear(const TransitionAction* &currentAction,
            decltype(Timestamp().Seconds()) &startingGestureTime) {
-  currentAction=(struct _actions){0};
+  currentAction = nullptr;
   startingGestureTime = 0;
 }
+
+::mediapipe::Status BuildActionsMap(
+    const transitionDynamicGesturesCalculatorOptions& options,
+    ActionsMap* actionsMap) {
+  for (const auto& act_ : options.actions_map()){
+    TransitionAction loadAct;
+    loadAct.endAction = act_.end_action();
+    loadAct.message.set_topic(act_.mqtt_message().topic());
+    loadAct.message.set_payload(act_.mqtt_message().payload());
+    actionsMap->Add(act_.start_action(), std::move(loadAct));
+  }
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status ParseActionsMap(const std::string& contents,
+                                    ActionsMap* actionsMap) {
+  transitionDynamicGesturesCalculatorOptions options;
+  RET_CHECK(ParseTextProto(contents, &options))
+      << "Not a transitionDynamicGesturesCalculatorOptions";
+  return BuildActionsMap(options, actionsMap);
+}
 }  // namespace
 
 // Transition Gestures 
@@ -62,9 +91,17 @@ void clear(_actions &currentAction,
 //                and ends with another
 // 
 //
+// Each detection is tracked by its hand (detection_id), so several hands
+// can run their own transition at the same time. The ids are positional
+// (see multi_hand.h), every hand is expired on every frame, so a hand that
+// leaves mid transition times out even without detections.
+//
+// With actions_map_file the actions map is read from that file and
+// reloaded when it changes; the transitions in progress are dropped.
+//
 // Input:
 //  LANDMARKS: used actions requiering hand location
-//  DETECTION: the current detected static gesture.
+//  DETECTION: the current detected static gesture of each hand.
 //
 // Output:
 //   MQTT_MESSAGE: a message containing the topic and payload 
@@ -96,11 +133,17 @@ class transitionDynamicGesturesCalculator : public CalculatorBase {
   ::mediapipe::Status Process(CalculatorContext* cc) override;
   
   private:
+  void ProcessHand(const int32 label_id, HandState& hand,
+                   CalculatorContext* cc);
+
   ::mediapipe::transitionDynamicGesturesCalculatorOptions options_;
-  _actions currentAction;
-  decltype(Timestamp().Seconds()) startingGestureTime;
-  std::vector<_actions> actionsMap;
+  std::unordered_map<int, HandState> hands;
+  // start_action -> action
+  ReloadableTable<ActionsMap> actionsMap;
   MqttMessages mqttMessages;
+  // Shared by every FLAG packet, so idle frames don't allocate
+  Packet flagPacket_;
+  calculator_stats::NodeStats* stats_ = nullptr;
 };
 REGISTER_CALCULATOR(transitionDynamicGesturesCalculator);
 
@@ -134,47 +177,72 @@ REGISTER_CALCULATOR(transitionDynamicGesturesCalculator);
 ::mediapipe::Status transitionDynamicGesturesCalculator::Open(
     CalculatorContext* cc) {
   cc->SetOffset(TimestampDiff(0));
+  stats_ = calculator_stats::ForNode(cc->NodeName());
+  flagPacket_ = MakePacket<bool>(true);
   options_ = cc->Options<::mediapipe::transitionDynamicGesturesCalculatorOptions>();
 
   RET_CHECK_GE(options_.actions_map_size(),0) 
     << "You should at least provide one action map"; 
 
-  for(int i = 0; i<options_.actions_map_size(); i++){
-    _actions loadAct;
-    loadAct.startAction = options_.actions_map(i).start_action();
-    loadAct.endAction = options_.actions_map(i).end_action();
-    loadAct.mqtt.topic = options_.actions_map(i).mqtt_message().topic();
-    loadAct.mqtt.payload = options_.actions_map(i).mqtt_message().payload();
-    loadAct.notEmpty=true;
-    actionsMap.emplace_back(loadAct);
+  if (options_.has_actions_map_file()) {
+    return actionsMap.Watch(options_.actions_map_file(),
+                            absl::Seconds(options_.reload_interval_s()),
+                            ParseActionsMap);
   }
-    return ::mediapipe::OkStatus();
+  return BuildActionsMap(options_, actionsMap.mutable_table());
 }
 
 ::mediapipe::Status transitionDynamicGesturesCalculator::Process(
     CalculatorContext* cc) {
-   
-   
-  if(cc->Inputs().Tag(kDetectionTag).IsEmpty())
-    return ::mediapipe::OkStatus();
-
-  const auto& input_detections =
-      cc->Inputs().Tag(kDetectionTag).Get<Detections>();
-  const auto& input_detection = input_detections.back();
-  const int32 label_id = input_detection.label_id().Get(0);
-  
+  calculator_stats::ScopedProcessTimer timer(stats_);
+  // The hands point into the previous map
+  if (actionsMap.Refresh()) hands.clear();
+
+  if (!cc->Inputs().Tag(kDetectionTag).IsEmpty()) {
+    const auto& input_detections =
+        cc->Inputs().Tag(kDetectionTag).Get<Detections>();
+    for (const auto& input_detection : input_detections) {
+      ProcessHand(input_detection.label_id().Get(0),
+                  hands[multi_hand::HandId(input_detection)], cc);
+    }
+  }
+
+  const auto now = cc->InputTimestamp().Seconds();
+  multi_hand::EraseHandsIf(&hands, [&](const HandState& hand) {
+    return hand.currentAction == nullptr ||
+           now - hand.startingGestureTime >= options_.time_out_s();
+  });
+
+  if(!mqttMessages.empty()){
+    cc->Outputs().Tag(kMqttMessageTag)
+         .Add(new MqttMessages(std::move(mqttMessages)),
+             cc->InputTimestamp().NextAllowedInStream());
+    mqttMessages.clear();
+  }
+
+  // Only the hands with a transition in progress are left
+  const bool busy = !hands.empty();
+  if(!busy) 
+     cc->Outputs().Tag(kFlagTag)
+      .AddPacket(flagPacket_.At(
+          cc->InputTimestamp().NextAllowedInStream()));
+
+
+  return ::mediapipe::OkStatus();
+}
+
+void transitionDynamicGesturesCalculator::ProcessHand(
+    const int32 label_id, HandState& hand, CalculatorContext* cc) {
+  const TransitionAction* &currentAction = hand.currentAction;
+  auto& startingGestureTime = hand.startingGestureTime;
   
-  if (!currentAction.notEmpty){
-    //
-    //currentAction=NULL;
-    for(auto act_ : actionsMap){
-      if(act_.startAction==label_id){
-        currentAction = act_;
-        startingGestureTime=cc->InputTimestamp().Seconds();
-      } 
+  if (currentAction == nullptr){
+    currentAction = actionsMap.get().Find(label_id);
+    if(currentAction != nullptr){
+      startingGestureTime=cc->InputTimestamp().Seconds();
     }
     //no gesture found 
-    if(!currentAction.notEmpty){
+    else{
       clear(currentAction, startingGestureTime);
     }
       
@@ -186,35 +254,13 @@ REGISTER_CALCULATOR(transitionDynamicGesturesCalculator);
           clear( currentAction, startingGestureTime);
     }
     //execute action
-    if((currentAction.notEmpty) && 
-       (label_id==currentAction.endAction)){
-      // std::cout << "\n !!Action:" << std::to_string(currentAction.startAction) 
-      //           << "\t :" << std::to_string(currentAction.endAction)
-      //           << "\t :" << currentAction.mqtt.topic
-      //           << "\t :" << currentAction.mqtt.payload;
-      Mqtt_Message message;
-      message.set_topic(currentAction.mqtt.topic);
-      message.set_payload(currentAction.mqtt.payload);
-      mqttMessages.emplace_back(message);
-
-      cc->Outputs().Tag(kMqttMessageTag)
-           .AddPacket(MakePacket<MqttMessages>(mqttMessages)
-           .At(cc->InputTimestamp()
-           .NextAllowedInStream()));
-      
+    if((currentAction != nullptr) && 
+       (label_id==currentAction->endAction)){
+      mqttMessages.emplace_back(currentAction->message);
+
       clear(currentAction, startingGestureTime); 
-      mqttMessages.clear();         
     } 
   }
-  
-  if(!currentAction.notEmpty) 
-     cc->Outputs().Tag(kFlagTag)
-      .AddPacket(MakePacket<bool>(true)
-                            .At(cc->InputTimestamp()
-                            .NextAllowedInStream()));
-
-
-  return ::mediapipe::OkStatus();
 }
 
 }  // namespace mediapipe
@@ -12,56 +12,62 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include <memory>
+#include <cmath>
+#include <string>
+#include <unordered_map>
+#include <utility>
 
 #include "myMediapipe/calculators/gestures/writing_dynamic_gestures_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
+#include "myMediapipe/calculators/gestures/digit_recognizer.h"
+#include "myMediapipe/calculators/gestures/gesture_dispatch.h"
+#include "myMediapipe/calculators/gestures/multi_hand.h"
+#include "myMediapipe/calculators/gestures/reloadable_table.h"
+#include "myMediapipe/calculators/gestures/writing_tracker.h"
+#include "myMediapipe/calculators/util/calculator_stats.h"
 #include "mediapipe/framework/formats/detection.pb.h"
 #include "mediapipe/framework/formats/landmark.pb.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
 #include "mediapipe/framework/port/ret_check.h"
 #include "myMediapipe/framework/formats/mqtt_message.pb.h"
-#include <math.h>
-#include <opencv2/core.hpp>
-#include <opencv2/imgproc/imgproc.hpp>
-#include <opencv2/highgui/highgui.hpp>  
 
 namespace mediapipe {
 
 
 namespace {
 
-struct ROI
-{
-  float left;
-  float rigth;
-  float top;
-  float bottom;
-  int x_length;
-  int y_length;
-  float ratio;
-};
-
 typedef std::vector<Detection> Detections;
 typedef std::vector<NormalizedLandmark> Landmarks;
 typedef std::vector<Mqtt_Message> MqttMessages;
+typedef gesture_dispatch::DispatchTable<Mqtt_Message> ActionsMap;
 
 constexpr char kDetectionTag[] = "DETECTIONS";
 constexpr char kNormLandmarksTag[] = "NORM_LANDMARKS";
+constexpr char kVelocityTag[] = "VELOCITY";
 constexpr char kFlagTag[] = "FLAG";
 constexpr char kMqttMessageTag[] = "MQTT_MESSAGE";
 
-int GetAngle(NormalizedLandmark point_start, 
-            NormalizedLandmark point_middle, 
-            NormalizedLandmark point_end) {
-  const auto ang1 = atan2(point_end.y() - point_middle.y(), point_end.x() - point_middle.x());
-  const auto ang2 = atan2(point_start.y() - point_middle.y(), point_start.x() - point_middle.x());
-  const auto angle = abs((ang1 - ang2) * (180 / M_PI));
-  int return_angle = (int)angle;
-  return return_angle;
+::mediapipe::Status BuildActionsMap(
+    const writingDynamicGesturesCalculatorOptions& options,
+    ActionsMap* actionsMap) {
+  for (const auto& act_ : options.writing_actions_map()) {
+    Mqtt_Message message;
+    message.set_topic(act_.topic());
+    message.set_payload(act_.payload());
+    actionsMap->Add(act_.digit(), std::move(message));
+  }
+  return ::mediapipe::OkStatus();
 }
 
-long map(long x, long in_min, long in_max, long out_min, long out_max) {
-  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+::mediapipe::Status ParseActionsMap(const std::string& contents,
+                                    ActionsMap* actionsMap) {
+  writingDynamicGesturesCalculatorOptions options;
+  // Only writing_actions_map is read, the required fields are not needed
+  proto_ns::TextFormat::Parser parser;
+  parser.AllowPartialMessage(true);
+  RET_CHECK(parser.ParseFromString(contents, &options))
+      << "Not a writingDynamicGesturesCalculatorOptions";
+  return BuildActionsMap(options, actionsMap);
 }
 
 }  // namespace
@@ -71,23 +77,45 @@ long map(long x, long in_min, long in_max, long out_min, long out_max) {
 // A fixed gesture  used 
 //          to draw a number or symbol
 // 
-// 
-// 
-// 
+// The tip (landmark_id) of each hand is tracked by a WritingTracker: the
+// first line, drawn while moving the finger to the starting point, is
+// removed when accute_angle_trigger sharp angles are found. Once the
+// drawing is taller than ratio_trigger times its width the digit is
+// processed time_to_inference seconds later. A drawing is abandoned after
+// watchdog_time seconds.
+//
+// Processing runs the DigitRecognizer on the drawing. A digit scoring
+// prediction_threshold or more publishes its writing_actions_map message.
+// Without digit_model_path the drawings are tracked but not recognized.
+//
+// Each detection is tracked by its hand (detection_id), landmarks of hand
+// N are taken from [N*21, N*21+21) of the vector.
+//
+// With actions_map_file the actions map is read from that file and
+// reloaded when it changes, the drawings in progress are kept.
+//
+// With VELOCITY, the filtered landmark velocities of
+// OneEuroLandmarksFilterCalculator, the tip is not added to the drawing
+// while it moves slower than min_tip_speed, so the jitter of a resting
+// finger doesn't draw sharp angles.
 //
 // Input:
 //  LANDMARKS: used actions requiering hand location
-//  DETECTION: the current detected static gesture.
+//  DETECTION: the current detected static gesture of each hand.
+//  VELOCITY: optional, velocities of the landmarks, same layout.
 //
 // Output:
-//   TBD
+//   FLAG: emitted when no hand is drawing, releases the writing latch
+//   MQTT_MESSAGE: a message containing the topic and payload 
+//                 to be sent to the mqtt dispatcher
 //
 // Example config:
 // node {
 //   calculator: "writingDynamicGesturesCalculator"
 //   input_stream: "NORM_LANDMARKS:gated_writing_landmarks"
 //   input_stream: "DETECTIONS:gated_writing_detection"
-//   output_stream: TBD
+//   output_stream: "FLAG:writing_gesture_clear"
+//   output_stream: "MQTT_MESSAGE:message_writing"
 //   node_options: {
 //     [type.googleapis.com/mediapipe.writingDynamicGesturesCalculatorOptions] {
 //       time_out_ms: 2500
@@ -100,6 +128,9 @@ long map(long x, long in_min, long in_max, long out_min, long out_max) {
 //       time_to_inference: 3 //This is the time to wait between a start condition (accute angle detected) and inference 
 //       watchdog_time: 4.0     //To avoid blocking in the case that current drawing is too noisy  or gable
 //       prediction_threshold: 0.7
+//       digit_model_path: "myMediapipe/models/dynamicGestures/digits.tflite"
+//       writing_actions_map { digit: 1  topic: "handCommander/tv/ir_command"
+//                             payload: "KEY_1" }
 //     }
 //   }
 // }
@@ -111,18 +142,24 @@ class writingDynamicGesturesCalculator : public CalculatorBase {
   ::mediapipe::Status Process(CalculatorContext* cc) override;
   
   private:
-  void ProcessROI(int y_length,int x_length,int y_start,int x_start);
+  WritingTracker& Hand(int hand_id);
+  // tip_speed is negative when unknown
+  ::mediapipe::Status ProcessHand(const NormalizedLandmark& current_landmark,
+                                  float tip_speed, WritingTracker& hand,
+                                  CalculatorContext* cc);
+  // Recognizes the digit drawn, queuing its message
+  ::mediapipe::Status ProcessROI(const TrajectoryBuffer& trajectory);
+
   ::mediapipe::writingDynamicGesturesCalculatorOptions options_;
-  std::vector<NormalizedLandmark> point_list;
-  decltype(Timestamp().Seconds()) init_drawing_time; //used by the watchdog
-  decltype(Timestamp().Seconds()) digit_start_time;  //tracks the beginning of a digit drawing 
-  ROI roi; //region of interest
-  int current_angle;
-  int number_of_accute_angles;
-  bool accute_angle_cleared;
-  float old_x;
-  float old_y;
-  bool minimun_ratio_trigered;
+  std::unordered_map<int, WritingTracker> hands;
+  // digit -> message
+  ReloadableTable<ActionsMap> actionsMap;
+  MqttMessages mqttMessages;
+
+  DigitRecognizer recognizer_;
+  // Shared by every FLAG packet, so idle frames don't allocate
+  Packet flagPacket_;
+  calculator_stats::NodeStats* stats_ = nullptr;
 };
 
 REGISTER_CALCULATOR(writingDynamicGesturesCalculator);
@@ -140,6 +177,9 @@ REGISTER_CALCULATOR(writingDynamicGesturesCalculator);
 
   if (cc->Inputs().HasTag(kDetectionTag))
     cc->Inputs().Tag(kDetectionTag).Set<Detections>();
+
+  if (cc->Inputs().HasTag(kVelocityTag))
+    cc->Inputs().Tag(kVelocityTag).Set<Landmarks>();
   
   cc->Outputs().Tag(kFlagTag).Set<bool>();
   cc->Outputs().Tag(kMqttMessageTag).Set<MqttMessages>();
@@ -152,141 +192,123 @@ REGISTER_CALCULATOR(writingDynamicGesturesCalculator);
 ::mediapipe::Status writingDynamicGesturesCalculator::Open(
     CalculatorContext* cc) {
   cc->SetOffset(TimestampDiff(0));
+  stats_ = calculator_stats::ForNode(cc->NodeName());
+  flagPacket_ = MakePacket<bool>(true);
   
   options_ = cc->Options<::mediapipe::writingDynamicGesturesCalculatorOptions>();
+  RET_CHECK_GT(options_.max_trajectory_points(),
+               options_.window_for_angle_detection())
+      << "The trajectory can't hold the window for angle detection.";
+
+  if (options_.has_actions_map_file()) {
+    MP_RETURN_IF_ERROR(
+        actionsMap.Watch(options_.actions_map_file(),
+                         absl::Seconds(options_.reload_interval_s()),
+                         ParseActionsMap));
+  } else {
+    MP_RETURN_IF_ERROR(BuildActionsMap(options_, actionsMap.mutable_table()));
+  }
+  if (options_.has_digit_model_path()) {
+    MP_RETURN_IF_ERROR(recognizer_.Load(options_.digit_model_path()));
+  }
   return ::mediapipe::OkStatus();
 }
 
 ::mediapipe::Status writingDynamicGesturesCalculator::Process(
     CalculatorContext* cc) {
+  calculator_stats::ScopedProcessTimer timer(stats_);
+  // Messages are copied out of the map, nothing points into it
+  actionsMap.Refresh();
 
-      /* 
-  // RET_CHECK(!cc->Inputs().Tag(kDetectionTag).IsEmpty());
-  //  const auto& input_detections =
-  //       cc->Inputs().Tag(kDetectionTag).Get<Detections>();
-  //  const auto& input_detection = input_detections.back();
-
-  // const int32 label_id = input_detection.label_id().Get(0);
+  RET_CHECK(!cc->Inputs().Tag(kDetectionTag).IsEmpty());
+  const auto& input_detections =
+      cc->Inputs().Tag(kDetectionTag).Get<Detections>();
 
   RET_CHECK(!cc->Inputs().Tag(kNormLandmarksTag).IsEmpty());
   const auto &landmarks = cc->Inputs()
                               .Tag(kNormLandmarksTag)
                               .Get<std::vector<NormalizedLandmark>>();
+  const Landmarks* velocity = nullptr;
+  if (cc->Inputs().HasTag(kVelocityTag) &&
+      !cc->Inputs().Tag(kVelocityTag).IsEmpty()) {
+    velocity = &cc->Inputs().Tag(kVelocityTag).Get<Landmarks>();
+  }
 
-  const auto current_landmark = landmarks[options_.landmark_id()];
-  point_list.push_back(current_landmark);
-  
-  if(point_list.size()==1){
-    init_drawing_time =
-    roi.left = current_landmark.x();
-    roi.rigth = current_landmark.x();
-    roi.top = current_landmark.y();
-    roi.bottom = current_landmark.y(); 
+  for (const auto& input_detection : input_detections) {
+    const int hand_id = multi_hand::HandId(input_detection);
+    RET_CHECK(multi_hand::HasHand(hand_id, landmarks.size()))
+        << "No landmarks for hand " << hand_id;
+    const int tip_id =
+        multi_hand::HandOffset(hand_id) + options_.landmark_id();
+    float tip_speed = -1;
+    if (velocity) {
+      RET_CHECK(multi_hand::HasHand(hand_id, velocity->size()))
+          << "No velocities for hand " << hand_id;
+      const auto& tip_velocity = (*velocity)[tip_id];
+      tip_speed = std::hypot(tip_velocity.x(), tip_velocity.y());
+    }
+    MP_RETURN_IF_ERROR(
+        ProcessHand(landmarks[tip_id], tip_speed, Hand(hand_id), cc));
   }
 
-  const auto last_point_index = point_list.size() - 1;
-  
-  if (point_list.size() > options_.window_for_angle_detection()){
-    const int mid_point = last_point_index - (int)(options_.window_for_angle_detection() / 2);
-    const int start_point = last_point_index - options_.window_for_angle_detection();
-    current_angle = GetAngle(point_list[start_point],
-                             point_list[mid_point],
-                             point_list[last_point_index]);
+  if(!mqttMessages.empty()){
+    cc->Outputs().Tag(kMqttMessageTag)
+       .Add(new MqttMessages(std::move(mqttMessages)),
+             cc->InputTimestamp().NextAllowedInStream());
+    mqttMessages.clear();
   }
 
-  //first line with accute angle removal
-  if ((current_angle > 0) && 
-      (current_angle >= options_.angle_max_limit() ||
-       current_angle <= options_.angle_min_limit())){
-    
-    number_of_accute_angles++;
-
-    if (number_of_accute_angles >= options_.accute_angle_trigger() &&
-        (!accute_angle_cleared) ){
-      //clear path (point_list.size());
-      //eliminates the first line after an accute angle is detected
-      point_list.clear();
-      roi.left    = old_x;
-      roi.rigth   = old_x;
-      roi.top     = old_y;
-      roi.bottom  = old_y;
-      number_of_accute_angles=0;
-      accute_angle_cleared=true;
+  // The watchdog also covers the hands that left the frame
+  bool busy = false;
+  for (auto& hand : hands) {
+    if (hand.second.drawing() &&
+        (cc->InputTimestamp().Seconds() - hand.second.init_drawing_time()) >=
+            options_.watchdog_time()) {
+      hand.second.Reset();
     }
-  } 
-
-  // setting the Region Of Interest     
-  if (roi.left   > current_landmark.x()) roi.left   = current_landmark.x();
-  if (roi.rigth  < current_landmark.x()) roi.rigth  = current_landmark.x();
-  if (roi.top    > current_landmark.y()) roi.top    = current_landmark.y();
-  if (roi.bottom < current_landmark.y()) roi.bottom = current_landmark.y();
-
-  // ratio is used to trigger the inference system, basically its a way to emulate a "pen up" event
-  roi.x_length = roi.rigth - roi.left;
-  roi.y_length = roi.bottom - roi.top;
-  roi.ratio =  roi.y_length / roi.x_length;
-
-  //at this point we have a valid input
-  if (((roi.ratio >= options_.ratio_trigger()) || minimun_ratio_trigered ) 
-                && (accute_angle_cleared)){
-    minimun_ratio_trigered=true;
-
-    ProcessROI(static_cast<int>(map(roi.y_length,0,1,0,65535)),
-               static_cast<int>(map(roi.x_length,0,1,0,65535)),
-               static_cast<int>(map(roi.top,0,1,0,65535)),
-               static_cast<int>(map(roi.left,0,1,0,65535)));
-   
-    // // start inference timer and cancel the watchdog
-    //   if (self.inference_timer is None) or \
-    //   (not self.inference_timer.is_alive()):
-    //     self.inference_timer = Timer(self.TIME_TO_INFERENCE, self.infer)
-    //     self.inference_timer.start()
-    //     self.watchdog_timer.cancel()
+    busy |= hand.second.drawing();
   }
+  if (!busy)
+    cc->Outputs().Tag(kFlagTag)
+        .AddPacket(flagPacket_.At(
+            cc->InputTimestamp().NextAllowedInStream()));
 
+  return ::mediapipe::OkStatus();
+}
 
-  old_x = current_landmark.x();
-  old_y = current_landmark.y(); */
-
-  cc->Outputs().Tag(kFlagTag)
-      .AddPacket(MakePacket<bool>(true)
-                            .At(cc->InputTimestamp()
-                            .NextAllowedInStream()));
-  
+WritingTracker& writingDynamicGesturesCalculator::Hand(int hand_id) {
+  auto it = hands.find(hand_id);
+  if (it == hands.end()) {
+    it = hands.emplace(hand_id, WritingTracker(options_)).first;
+  }
+  return it->second;
+}
 
-  return ::mediapipe::OkStatus();
+::mediapipe::Status writingDynamicGesturesCalculator::ProcessHand(
+    const NormalizedLandmark& current_landmark, float tip_speed,
+    WritingTracker& hand, CalculatorContext* cc) {
+  if (!hand.Update(current_landmark.x(), current_landmark.y(), tip_speed,
+                   cc->InputTimestamp().Seconds())) {
+    return ::mediapipe::OkStatus();
+  }
+  const ::mediapipe::Status status = ProcessROI(hand.trajectory());
+  hand.Reset();
+  return status;
 }
 
 // this will process the valid Region Of Interest 
-void writingDynamicGesturesCalculator::ProcessROI(int y_length,int x_length,int y_start,int x_start){ 
-  //print(y_length,x_length,y_start,x_start)
-  uint8_t kMargin = 100;
-  uint8_t kHorizontalOffset = x_start  - static_cast<int>(kMargin/2);
-  uint8_t kVerticalOffset  = y_start  - static_cast<int>(kMargin/2);
-  uint8_t kThreshold = 64;
-  struct Coord{
-    int x;
-    int y;
-  };
-        
-  // first it will create a new image with the ROI drawing, plus some margin for centering
-  //uint8_t roi_image[(y_length + kMargin)][(x_length + kMargin)];
-  cv::Mat roi_image = cv::Mat::zeros((y_length + kMargin),(x_length + kMargin),CV_8UC1);      
-  for(auto i=0; i<point_list.size()-2;i++){
-    cv::Point line_init;
-    cv::Point line_end;
-    
-    line_init.x = static_cast<int>(map(point_list[i].x(),0,1,0,65535)) - kHorizontalOffset;
-    line_init.y = static_cast<int>(map(point_list[i].y(),0,1,0,65535)) - kVerticalOffset;
-    line_end.x = static_cast<int>(map(point_list[i + 1].x(),0,1,0,65535)) - kHorizontalOffset;
-    line_end.y = static_cast<int>(map(point_list[i].x(),0,1,0,65535)) - kVerticalOffset;
-    cv::line(roi_image, line_init, line_end, 255, 8);
-  }
-//   // then it resizes the imagee to the 28*28 format of the neural model
-  cv::Mat scaled_image = cv::Mat::zeros(28,28,CV_8UC1);
-  cv::resize(roi_image, scaled_image, scaled_image.size(), CV_INTER_AREA);
-//   // applies a simple Threshold operation, improves inference
-//   self.scaled_image[self.scaled_image > THRESHOLD] = 255
+::mediapipe::Status writingDynamicGesturesCalculator::ProcessROI(
+    const TrajectoryBuffer& trajectory) {
+  if (!recognizer_.loaded()) return ::mediapipe::OkStatus();
+
+  int digit = 0;
+  float score = 0;
+  MP_RETURN_IF_ERROR(recognizer_.Recognize(trajectory, &digit, &score));
+  VLOG(1) << "Digit " << digit << " drawn, score " << score;
+  if (score < options_.prediction_threshold()) return ::mediapipe::OkStatus();
+  const Mqtt_Message* message = actionsMap.get().Find(digit);
+  if (message != nullptr) mqttMessages.emplace_back(*message);
+  return ::mediapipe::OkStatus();
 }
 
 }  // namespace mediapipe
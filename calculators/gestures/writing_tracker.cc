@@ -0,0 +1,89 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myMediapipe/calculators/gestures/writing_tracker.h"
+
+namespace mediapipe {
+
+WritingTracker::WritingTracker(
+    const writingDynamicGesturesCalculatorOptions& options)
+    : options_(options),
+      trajectory_(options.max_trajectory_points(),
+                  options.window_for_angle_detection()) {}
+
+void WritingTracker::Reset() {
+  trajectory_.Clear();
+  drawing_ = false;
+  digit_start_time_ = -1;
+  number_of_accute_angles_ = 0;
+  accute_angle_cleared_ = false;
+  minimun_ratio_trigered_ = false;
+}
+
+bool WritingTracker::Update(float x, float y, float tip_speed, double now) {
+  if (!drawing_) {
+    Reset();
+    drawing_ = true;
+    init_drawing_time_ = now;
+  }
+
+  // A resting tip adds nothing to the drawing, the timers keep running
+  const bool tip_moving =
+      tip_speed < 0 || tip_speed >= options_.min_tip_speed();
+  int current_angle = -1;
+  if (tip_moving) {
+    trajectory_.Push(x, y, now);
+    current_angle = trajectory_.last_angle();
+  }
+
+  //first line with accute angle removal
+  if ((current_angle > 0) &&
+      (current_angle >= options_.angle_max_limit() ||
+       current_angle <= options_.angle_min_limit())) {
+    number_of_accute_angles_++;
+
+    if (number_of_accute_angles_ >= options_.accute_angle_trigger() &&
+        (!accute_angle_cleared_)) {
+      //eliminates the first line after an accute angle is detected,
+      //the drawing starts at the previous point
+      trajectory_.Clear();
+      trajectory_.Push(old_x_, old_y_, now);
+      trajectory_.Push(x, y, now);
+      number_of_accute_angles_ = 0;
+      accute_angle_cleared_ = true;
+    }
+  }
+
+  // ratio is used to trigger the inference system, basically its a way to
+  // emulate a "pen up" event
+  const float x_length = trajectory_.max_x() - trajectory_.min_x();
+  const float y_length = trajectory_.max_y() - trajectory_.min_y();
+  const float ratio = x_length > 0 ? y_length / x_length : 0;
+
+  //at this point we have a valid input, start the inference timer
+  if (((ratio >= options_.ratio_trigger()) || minimun_ratio_trigered_) &&
+      (accute_angle_cleared_)) {
+    minimun_ratio_trigered_ = true;
+    if (digit_start_time_ < 0) digit_start_time_ = now;
+  }
+
+  if (tip_moving) {
+    old_x_ = x;
+    old_y_ = y;
+  }
+  return digit_start_time_ >= 0 &&
+         (now - digit_start_time_) >= options_.time_to_inference();
+}
+
+}  // namespace mediapipe
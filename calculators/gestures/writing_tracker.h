@@ -0,0 +1,73 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_CALCULATORS_GESTURES_WRITING_TRACKER_H_
+#define MYMEDIAPIPE_CALCULATORS_GESTURES_WRITING_TRACKER_H_
+
+#include "myMediapipe/calculators/gestures/trajectory_buffer.h"
+#include "myMediapipe/calculators/gestures/writing_dynamic_gestures_calculator.pb.h"
+
+namespace mediapipe {
+
+// Drawing of a writing gesture by one hand, shared by
+// writingDynamicGesturesCalculator and gestureAutomatonCalculator.
+//
+// The tip (landmark_id) is kept in a TrajectoryBuffer of
+// max_trajectory_points, so a long drawing never grows the memory. The
+// first line, drawn while moving the finger to the starting point, is
+// removed when accute_angle_trigger sharp angles are found. Once the
+// drawing is taller than ratio_trigger times its width the digit is ready
+// time_to_inference seconds later.
+//
+// Example:
+//   WritingTracker tracker(options);
+//   if (tracker.Update(tip.x(), tip.y(), tip_speed, now)) {
+//     MP_RETURN_IF_ERROR(recognizer.Recognize(tracker.trajectory(), ...));
+//     tracker.Reset();
+//   }
+class WritingTracker {
+ public:
+  // options must outlive the tracker
+  explicit WritingTracker(
+      const writingDynamicGesturesCalculatorOptions& options);
+
+  // Adds the tip to the drawing, starting one if needed. tip_speed is
+  // negative when unknown, a tip slower than min_tip_speed is not added.
+  // Returns true when the digit is ready for recognition.
+  bool Update(float x, float y, float tip_speed, double now);
+  // Drops the drawing, the next Update starts a new one
+  void Reset();
+
+  bool drawing() const { return drawing_; }
+  // Start of the drawing, for the watchdog
+  double init_drawing_time() const { return init_drawing_time_; }
+  const TrajectoryBuffer& trajectory() const { return trajectory_; }
+
+ private:
+  const writingDynamicGesturesCalculatorOptions& options_;
+  TrajectoryBuffer trajectory_;
+  bool drawing_ = false;
+  double init_drawing_time_ = 0;
+  // Beginning of the digit drawing, -1 until then
+  double digit_start_time_ = -1;
+  int number_of_accute_angles_ = 0;
+  bool accute_angle_cleared_ = false;
+  bool minimun_ratio_trigered_ = false;
+  float old_x_ = 0;
+  float old_y_ = 0;
+};
+
+}  // namespace mediapipe
+
+#endif  // MYMEDIAPIPE_CALCULATORS_GESTURES_WRITING_TRACKER_H_
@@ -12,24 +12,34 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <cmath>
 #include <string>
 #include <vector>
-//#include <algorithm>
 
 #include "myMediapipe/calculators/tflite/angles_to_tflite_converter_calculator.pb.h"
+#include "myMediapipe/calculators/tflite/quantization.h"
+#include "myMediapipe/calculators/tflite/tensor_ring.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/port/canonical_errors.h"
+#include "mediapipe/framework/port/integral_types.h"
 #include "myMediapipe/framework/formats/angles.pb.h"
 #include "mediapipe/framework/port/ret_check.h"
 //#include "mediapipe/util/resource_util.h"
 #include "tensorflow/lite/error_reporter.h"
 #include "tensorflow/lite/interpreter.h"
 
-
+#if !defined(MEDIAPIPE_DISABLE_GL_COMPUTE)
+#include "mediapipe/gpu/gl_calculator_helper.h"
+#include "myMediapipe/calculators/tflite/gpu_tensor.h"
+#endif  // !MEDIAPIPE_DISABLE_GL_COMPUTE
 
 namespace mediapipe {
 
-constexpr char kAngleDataTag[] = "ANGLES";   
+constexpr char kAngleDataTag[] = "ANGLES";
+constexpr char kTensorsGpuTag[] = "TENSORS_GPU";
+// angle1 and angle2 on each Angle Input (see angles.proto)
+constexpr int kNumAnglesPerInput = 2;
 
 // Converts Angle streams to Tensors to feed them to an Inference calculator
 //
@@ -38,7 +48,21 @@ constexpr char kAngleDataTag[] = "ANGLES";
 //
 // Output:
 //  One of the following tags:
-//  TENSORS - Vector of TfLiteTensor of type kTfLiteFloat32, or kTfLiteUint8.
+//  TENSORS - Vector of TfLiteTensor of type kTfLiteFloat32, kTfLiteUint8
+//            or kTfLiteInt8.
+//  TENSORS_GPU - Vector of float32 GpuTensor, for a
+//                TfLiteInferenceCalculator running the model on the GPU
+//                delegate. The angles are uploaded straight to a shader
+//                storage buffer, the delegate doesn't copy them from the
+//                CPU itself. The buffers are a ring of
+//                TensorRing::kNumTensors owned by the calculator, like the
+//                CPU tensors, and the packets only reference them.
+//
+// The input tensors are allocated at Open from num_angles and
+// max_num_hands, so Process only writes the values into them. The angles
+// of hand N are row N of the tensor. Quantized tensors carry their scale and
+// zero point in their quantization params, either the ones of the model
+// (quant_scale, quant_zero_point) or the ones of the selected range.
 //
 // Example use:
 // node {
@@ -51,6 +75,33 @@ constexpr char kAngleDataTag[] = "ANGLES";
 //     }
 //   }
 // }
+//
+// Input of an int8 classifier:
+// node {
+//   calculator: "anglesToTfLiteConverterCalculator"
+//   input_stream: "ANGLES:angles"
+//   output_stream: "TENSORS:angle_tensor"
+//   options: {
+//     [mediapipe.anglesToTfLiteConverterCalculatorOptions.ext] {
+//       use_quantized_tensors: true
+//       quantized_type: INT8
+//       quant_scale: 0.0246
+//       quant_zero_point: 0
+//     }
+//   }
+// }
+//
+// Input of a classifier on the GPU delegate:
+// node {
+//   calculator: "anglesToTfLiteConverterCalculator"
+//   input_stream: "ANGLES:angles"
+//   output_stream: "TENSORS_GPU:angle_tensor"
+//   options: {
+//     [mediapipe.anglesToTfLiteConverterCalculatorOptions.ext] {
+//       max_num_hands: 1
+//     }
+//   }
+// }
 
 class anglesToTfLiteConverterCalculator : public CalculatorBase {
  public:
@@ -68,17 +119,41 @@ class anglesToTfLiteConverterCalculator : public CalculatorBase {
   ::mediapipe::Status Close(CalculatorContext* cc) override;
 
  private:
-  //::mediapipe::Status CopyMatrixToTensor(const Matrix& matrix,
-  //                                       float* tensor_buffer);
-  
+  ::mediapipe::Status AllocateTensors(const std::vector<int>& max_dims);
+  template <class T>
+  void CopyAnglesToTensor(const std::vector<Angle>& angles, T* tensor_buffer);
 
-  std::unique_ptr<tflite::Interpreter> interpreter_ = nullptr;
+  // CPU tensors, not created with use_gpu
+  std::unique_ptr<TensorRing> tensors_;
   anglesToTfLiteConverterCalculatorOptions options_;
 
   bool zero_center_ = true;  // normalize range to [-1,1] | otherwise [0,1]
   bool row_major_matrix_ = false;
   bool use_quantized_tensors_ = false;
-
+  TfLiteType quantized_type_ = kTfLiteUInt8;
+  bool normalize_angles_ = false;
+  bool use_gpu_ = false;
+  // Whether the tensor has a row per hand, see max_num_hands
+  bool batched_ = false;
+
+  // Allocated tensor size, 0 until allocated
+  int tensor_size_ = 0;
+
+  // Affine transform applied to every angle, value * scale_ + offset_
+  float scale_ = 1.0f;
+  float offset_ = 0.0f;
+  // Quantization params of the quantized tensors
+  float quant_scale_ = 1.0f;
+  int quant_zero_point_ = 0;
+
+#if !defined(MEDIAPIPE_DISABLE_GL_COMPUTE)
+  mediapipe::GlCalculatorHelper gpu_helper_;
+  // Angles of the frame, written here before the upload
+  std::vector<float> gpu_values_;
+  // Allocated with the CPU tensors, each frame is uploaded to the next one
+  std::vector<GpuTensor> gpu_tensors_;
+  int next_gpu_tensor_ = 0;
+#endif  // !MEDIAPIPE_DISABLE_GL_COMPUTE
 };
 REGISTER_CALCULATOR(anglesToTfLiteConverterCalculator);
 
@@ -91,9 +166,23 @@ REGISTER_CALCULATOR(anglesToTfLiteConverterCalculator);
     cc->Inputs().Tag(kAngleDataTag).Set<std::vector<Angle>>();
   }
 
+  RET_CHECK(cc->Outputs().HasTag("TENSORS") ^
+            cc->Outputs().HasTag(kTensorsGpuTag))
+      << "Exactly one of TENSORS or TENSORS_GPU must be output.";
+
   if (cc->Outputs().HasTag("TENSORS"))
     cc->Outputs().Tag("TENSORS").Set<std::vector<TfLiteTensor>>();
-  
+
+  if (cc->Outputs().HasTag(kTensorsGpuTag)) {
+#if !defined(MEDIAPIPE_DISABLE_GL_COMPUTE)
+    cc->Outputs().Tag(kTensorsGpuTag).Set<std::vector<GpuTensor>>();
+    MP_RETURN_IF_ERROR(mediapipe::GlCalculatorHelper::UpdateContract(cc));
+#else
+    RET_CHECK_FAIL() << "TENSORS_GPU needs GL compute, this build has "
+                        "MEDIAPIPE_DISABLE_GL_COMPUTE defined.";
+#endif  // !MEDIAPIPE_DISABLE_GL_COMPUTE
+  }
+
   return ::mediapipe::OkStatus();
 }
 
@@ -110,74 +199,202 @@ REGISTER_CALCULATOR(anglesToTfLiteConverterCalculator);
 
   // Get tensor type, float or quantized.
   use_quantized_tensors_ = options_.use_quantized_tensors();
+  quantized_type_ = options_.quantized_type() ==
+                            anglesToTfLiteConverterCalculatorOptions::INT8
+                        ? kTfLiteInt8
+                        : kTfLiteUInt8;
+
+  normalize_angles_ = options_.normalize_angles();
+  RET_CHECK_GE(options_.num_angles(), 0);
+  RET_CHECK_GT(options_.max_num_hands(), 0);
+  batched_ = options_.num_angles() > 0 && options_.max_num_hands() > 1;
+
+  use_gpu_ = cc->Outputs().HasTag(kTensorsGpuTag);
+  if (use_gpu_) {
+    // The GL delegate only takes float buffers
+    RET_CHECK(!use_quantized_tensors_)
+        << "Quantized tensors can't be output on TENSORS_GPU.";
+    RET_CHECK(!batched_) << "TENSORS_GPU takes a single hand, set "
+                            "max_num_hands to 1.";
+#if !defined(MEDIAPIPE_DISABLE_GL_COMPUTE)
+    MP_RETURN_IF_ERROR(gpu_helper_.Open(cc));
+#endif  // !MEDIAPIPE_DISABLE_GL_COMPUTE
+  }
+
+  // Range of the values written to the tensor, angles come in [-PI,PI]
+  float range_min = -M_PI;
+  float range_max = M_PI;
+  if (normalize_angles_) {
+    if (zero_center_) {
+      scale_ = 1.0f / M_PI;
+      offset_ = 0.0f;
+      range_min = -1.0f;
+    } else {
+      scale_ = 0.5f / M_PI;
+      offset_ = 0.5f;
+      range_min = 0.0f;
+    }
+    range_max = 1.0f;
+  }
+  if (options_.quant_scale() > 0) {
+    quant_scale_ = options_.quant_scale();
+    quant_zero_point_ = options_.quant_zero_point();
+  } else {
+    // The range maps to [0,255], or to [-128,127] for int8
+    quant_scale_ = (range_max - range_min) / 255.0f;
+    quant_zero_point_ =
+        static_cast<int>(std::round(-range_min / quant_scale_)) +
+        (quantized_type_ == kTfLiteInt8 ? -128 : 0);
+  }
+
+  if (!use_gpu_) {
+    tensors_ = absl::make_unique<TensorRing>();
+  }
+
+  const int row_size = options_.num_angles() * kNumAnglesPerInput;
+  if (batched_) {
+    MP_RETURN_IF_ERROR(
+        AllocateTensors({options_.max_num_hands(), row_size}));
+  } else if (options_.num_angles() > 0) {
+    MP_RETURN_IF_ERROR(AllocateTensors({row_size}));
+  }
+
+  return ::mediapipe::OkStatus();
+}
 
-  interpreter_ = absl::make_unique<tflite::Interpreter>();
-  interpreter_->AddTensors(1);
-  interpreter_->SetInputs({0});
+::mediapipe::Status anglesToTfLiteConverterCalculator::AllocateTensors(
+    const std::vector<int>& max_dims) {
+  int size = 1;
+  for (const int dim : max_dims) size *= dim;
+#if !defined(MEDIAPIPE_DISABLE_GL_COMPUTE)
+  if (use_gpu_) {
+    gpu_values_.assign(size, 0.0f);
+    gpu_tensors_.resize(TensorRing::kNumTensors);
+    MP_RETURN_IF_ERROR(gpu_helper_.RunInGlContext(
+        [this, size]() -> ::mediapipe::Status {
+          for (auto& tensor : gpu_tensors_) {
+            MP_RETURN_IF_ERROR(gpu_tensor::CreateFloats(size, &tensor));
+          }
+          return ::mediapipe::OkStatus();
+        }));
+    tensor_size_ = size;
+    return ::mediapipe::OkStatus();
+  }
+#endif  // !MEDIAPIPE_DISABLE_GL_COMPUTE
+  if (use_quantized_tensors_) {
+    MP_RETURN_IF_ERROR(tensors_->Allocate(quantized_type_, max_dims,
+                                          quant_scale_, quant_zero_point_));
+  } else {
+    MP_RETURN_IF_ERROR(tensors_->Allocate(kTfLiteFloat32, max_dims));
+  }
+  tensor_size_ = size;
 
   return ::mediapipe::OkStatus();
 }
 
+template <>
+void anglesToTfLiteConverterCalculator::CopyAnglesToTensor<float>(
+    const std::vector<Angle>& angles, float* tensor_buffer) {
+  for (const auto& angle : angles) {
+    *tensor_buffer++ = angle.angle1() * scale_ + offset_;
+    *tensor_buffer++ = angle.angle2() * scale_ + offset_;
+  }
+}
+
+template <class T>
+void anglesToTfLiteConverterCalculator::CopyAnglesToTensor(
+    const std::vector<Angle>& angles, T* tensor_buffer) {
+  auto quantize = [this](float value) {
+    return quantization::Quantize<T>(value * scale_ + offset_, quant_scale_,
+                                     quant_zero_point_);
+  };
+  for (const auto& angle : angles) {
+    *tensor_buffer++ = quantize(angle.angle1());
+    *tensor_buffer++ = quantize(angle.angle2());
+  }
+}
+
 ::mediapipe::Status anglesToTfLiteConverterCalculator::Process(CalculatorContext* cc) {
   
   if (cc->Inputs().Tag(kAngleDataTag).IsEmpty()){
     return ::mediapipe::OkStatus();
   }
-  
-  const int channels = 1; //Move to proto
-  const int numAngles = 2; //number of angles on each Angle Input (see angle.proto)
 
-  
   const auto &angles = cc->Inputs()
                           .Tag(kAngleDataTag)
                           .Get<std::vector<Angle>>();
 
-  int size_ = angles.size() * numAngles;
-  std::vector<int> sizes = {size_};
-  float oneRowAngles[size_];
- 
-  // std::cout << "\n inAngle:\n";
-  for(int i=0;i<angles.size();i++){
-    oneRowAngles[i*2]   = angles[i].angle1();    
-    oneRowAngles[(i*2)+1] = angles[i].angle2();
-    // std::cout  << " i:" << std::to_string(i) << " "
-    //            << std::to_string(angles[i].angle1()) 
-    //            << "\t" << std::to_string(angles[i].angle2()) << "\n";
-   // std::cout  << std::to_string(oneRowAngles[i]) 
-   //            << "\t" << std::to_string(oneRowAngles[i+1]) << "\n";
-  }
-
-  // std::cout << "\n OneRowAngle size:" << std::to_string(size_) << "\n";
-  // for(int i=0;i<size_;i++){
-  //   std::cout  << "i:" << std::to_string(i)
-  //              << " :" << std::to_string(oneRowAngles[i]) << "\t";
-  // }
-  
-  const int tensor_idx = interpreter_->inputs()[0];
+  if (angles.empty()) return ::mediapipe::OkStatus();
+
+  const int size = angles.size() * kNumAnglesPerInput;
+  std::vector<int> dims = {size};
+  if (options_.num_angles() > 0) {
+    const int num_hands = angles.size() / options_.num_angles();
+    RET_CHECK_EQ(num_hands * options_.num_angles(),
+                 static_cast<int>(angles.size()))
+        << "Expected " << options_.num_angles() << " angles per hand, got "
+        << angles.size();
+    RET_CHECK_LE(num_hands, options_.max_num_hands())
+        << "More hands than max_num_hands.";
+    if (batched_) {
+      dims = {num_hands, options_.num_angles() * kNumAnglesPerInput};
+    }
+  } else if (tensor_size_ == 0) {
+    // The packets in flight point to the tensors, they are only allocated
+    // once, for the first packet, and later ones can't be larger
+    MP_RETURN_IF_ERROR(AllocateTensors({size}));
+  } else {
+    RET_CHECK_LE(size, tensor_size_)
+        << "More angles than the first packet, set num_angles.";
+  }
 
-  interpreter_->SetTensorParametersReadWrite(
-        /*tensor_index=*/0, /*type=*/kTfLiteFloat32, /*name=*/"",
-        /*dims=*/{channels}, /*quantization=*/TfLiteQuantization());
-   
-  interpreter_->ResizeInputTensor(tensor_idx, sizes);
-  interpreter_->AllocateTensors();
-  float* inTensor = interpreter_->typed_input_tensor<float>(0);
+#if !defined(MEDIAPIPE_DISABLE_GL_COMPUTE)
+  if (use_gpu_) {
+    CopyAnglesToTensor(angles, gpu_values_.data());
+    GpuTensor& tensor = gpu_tensors_[next_gpu_tensor_];
+    next_gpu_tensor_ = (next_gpu_tensor_ + 1) % gpu_tensors_.size();
+    MP_RETURN_IF_ERROR(gpu_helper_.RunInGlContext([this, &tensor]() {
+      return gpu_tensor::WriteFloats(gpu_values_, &tensor);
+    }));
+    // The packet references the buffer of the ring without owning it,
+    // TfLiteInferenceCalculator copies it into the delegate input
+    auto output_tensors = absl::make_unique<std::vector<GpuTensor>>();
+    output_tensors->push_back(tensor.MakeRef());
+    cc->Outputs()
+        .Tag(kTensorsGpuTag)
+        .Add(output_tensors.release(), cc->InputTimestamp());
+    return ::mediapipe::OkStatus();
+  }
+#endif  // !MEDIAPIPE_DISABLE_GL_COMPUTE
 
-  std::memcpy(inTensor, &oneRowAngles, sizeof(oneRowAngles));
-  //asasdasdasdasd
+  const int tensor_idx = tensors_->Next();
+  MP_RETURN_IF_ERROR(tensors_->Reshape(tensor_idx, dims));
 
-  TfLiteTensor* tensor = interpreter_->tensor(tensor_idx);
+  if (use_quantized_tensors_ && quantized_type_ == kTfLiteInt8) {
+    CopyAnglesToTensor(angles, tensors_->data<int8>(tensor_idx));
+  } else if (use_quantized_tensors_) {
+    CopyAnglesToTensor(angles, tensors_->data<uint8>(tensor_idx));
+  } else {
+    CopyAnglesToTensor(angles, tensors_->data<float>(tensor_idx));
+  }
 
-  auto output_tensors = absl::make_unique<std::vector<TfLiteTensor>>();
-  output_tensors->emplace_back(*tensor);
-  cc->Outputs().Tag("TENSORS").Add(output_tensors.release(),
-                                    cc->InputTimestamp());
+  cc->Outputs().Tag("TENSORS").Add(
+      tensors_->MakeOutput(tensor_idx).release(), cc->InputTimestamp());
 
 
   return ::mediapipe::OkStatus();
 }
 
 ::mediapipe::Status anglesToTfLiteConverterCalculator::Close(CalculatorContext* cc) {
+#if !defined(MEDIAPIPE_DISABLE_GL_COMPUTE)
+  if (!gpu_tensors_.empty()) {
+    // The buffers are released in the GL context they were created in
+    return gpu_helper_.RunInGlContext([this]() {
+      gpu_tensors_.clear();
+      return ::mediapipe::OkStatus();
+    });
+  }
+#endif  // !MEDIAPIPE_DISABLE_GL_COMPUTE
   return ::mediapipe::OkStatus();
 }
 
@@ -0,0 +1,274 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "myMediapipe/calculators/tflite/batch_tflite_inference_calculator.pb.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "myMediapipe/calculators/tflite/model_cache.h"
+#include "tensorflow/lite/interpreter.h"
+#include "tensorflow/lite/kernels/register.h"
+#include "tensorflow/lite/model.h"
+
+namespace mediapipe {
+
+namespace {
+
+constexpr char kTensorsTag[] = "TENSORS";
+constexpr char kCustomOpResolverTag[] = "CUSTOM_OP_RESOLVER";
+
+}  // namespace
+
+// Runs a TfLite model on CPU over a batch of inputs.
+//
+// TfLiteInferenceCalculator copies the input tensors into the model inputs
+// as they are, so it can only feed the exact shape the model was exported
+// with. This calculator resizes the first dimension of the model inputs
+// once at Open to max_batch_size, so the N rows produced by
+// landmarksToTfLiteConverterCalculator for N hands are classified by a
+// single Invoke. A batch of fewer rows fills the first ones and its output
+// tensors only cover them. The interpreter is never reallocated after
+// Open, the output packets point to its buffers. Without max_batch_size,
+// ie the image tensors of the hand detection and landmark models, the
+// model runs as exported, as TfLiteInferenceCalculator does on CPU.
+//
+// The model is taken from model_cache, every graph of the process running
+// the same model_path shares a single mmap'd copy and only builds its own
+// interpreter. With warmup the interpreter is invoked once at Open.
+//
+// Input side packet:
+//  CUSTOM_OP_RESOLVER (optional): tflite::ops::builtin::BuiltinOpResolver
+//           with the custom ops of the model, ie the one of
+//           TfLiteCustomOpResolverCalculator for the palm detection model.
+//
+// Input:
+//  TENSORS: Vector of TfLiteTensor of type kTfLiteFloat32, kTfLiteUInt8
+//           or kTfLiteInt8, one per model input, shaped {batch, ...}.
+//           Unlike TfLiteInferenceCalculator the data is copied as is,
+//           so this is the one feeding full integer (int8) models.
+//
+// Output:
+//  TENSORS: Vector of TfLiteTensor with the model outputs, the first
+//           dimension of each one is the batch size. They point to the
+//           buffers of the interpreter, valid until the next Invoke.
+//
+// Example use:
+// node {
+//   calculator: "batchTfLiteInferenceCalculator"
+//   input_stream: "TENSORS:angle_tensor"
+//   output_stream: "TENSORS:detection_tensors"
+//   options: {
+//     [mediapipe.batchTfLiteInferenceCalculatorOptions.ext] {
+//       model_path: "myMediapipe/models/staticGestures/gestures002.tflite"
+//       max_batch_size: 2
+//     }
+//   }
+// }
+
+class batchTfLiteInferenceCalculator : public CalculatorBase {
+ public:
+  batchTfLiteInferenceCalculator() {}
+  ~batchTfLiteInferenceCalculator() override;
+  batchTfLiteInferenceCalculator(const batchTfLiteInferenceCalculator&) =
+      delete;
+  batchTfLiteInferenceCalculator& operator=(
+      const batchTfLiteInferenceCalculator&) = delete;
+
+  static ::mediapipe::Status GetContract(CalculatorContract* cc);
+
+  ::mediapipe::Status Open(CalculatorContext* cc) override;
+  ::mediapipe::Status Process(CalculatorContext* cc) override;
+
+ private:
+  ::mediapipe::Status ResizeBatch(int batch_size);
+  void InitOutputDims();
+  ::mediapipe::Status Warmup();
+
+  batchTfLiteInferenceCalculatorOptions options_;
+  // Shared with the other graphs, outlives interpreter_
+  std::shared_ptr<const tflite::FlatBufferModel> model_;
+  std::unique_ptr<tflite::Interpreter> interpreter_;
+  // Shapes of the model inputs as exported
+  std::vector<std::vector<int>> model_input_dims_;
+  // Batch the interpreter is allocated for, fixed at Open
+  int max_batch_size_ = 1;
+  // output_dims_[b - 1][i] is the shape of output i for a batch of b. The
+  // output packets point to them, they live as long as the calculator.
+  std::vector<std::vector<TfLiteIntArray*>> output_dims_;
+  // Whether the first dimension of output i is the batch
+  std::vector<bool> output_is_batched_;
+};
+REGISTER_CALCULATOR(batchTfLiteInferenceCalculator);
+
+batchTfLiteInferenceCalculator::~batchTfLiteInferenceCalculator() {
+  for (auto& batch_dims : output_dims_) {
+    for (TfLiteIntArray* dims : batch_dims) TfLiteIntArrayFree(dims);
+  }
+}
+
+::mediapipe::Status batchTfLiteInferenceCalculator::GetContract(
+    CalculatorContract* cc) {
+  RET_CHECK(cc->Inputs().HasTag(kTensorsTag))
+      << "Tensors input stream is NOT provided.";
+  RET_CHECK(cc->Outputs().HasTag(kTensorsTag))
+      << "Tensors output stream is NOT provided.";
+
+  cc->Inputs().Tag(kTensorsTag).Set<std::vector<TfLiteTensor>>();
+  cc->Outputs().Tag(kTensorsTag).Set<std::vector<TfLiteTensor>>();
+  if (cc->InputSidePackets().HasTag(kCustomOpResolverTag)) {
+    cc->InputSidePackets()
+        .Tag(kCustomOpResolverTag)
+        .Set<tflite::ops::builtin::BuiltinOpResolver>();
+  }
+
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status batchTfLiteInferenceCalculator::Open(
+    CalculatorContext* cc) {
+  cc->SetOffset(TimestampDiff(0));
+
+  options_ = cc->Options<batchTfLiteInferenceCalculatorOptions>();
+  RET_CHECK(options_.has_model_path()) << "model_path is NOT provided.";
+
+  ASSIGN_OR_RETURN(model_, model_cache::GetModel(options_.model_path()));
+
+  if (cc->InputSidePackets().HasTag(kCustomOpResolverTag)) {
+    const auto& op_resolver =
+        cc->InputSidePackets()
+            .Tag(kCustomOpResolverTag)
+            .Get<tflite::ops::builtin::BuiltinOpResolver>();
+    tflite::InterpreterBuilder(*model_, op_resolver)(&interpreter_);
+  } else {
+    tflite::ops::builtin::BuiltinOpResolver op_resolver;
+    tflite::InterpreterBuilder(*model_, op_resolver)(&interpreter_);
+  }
+  RET_CHECK(interpreter_) << "Failed to build the interpreter.";
+  interpreter_->SetNumThreads(options_.cpu_num_thread());
+  RET_CHECK_EQ(interpreter_->AllocateTensors(), kTfLiteOk);
+
+  RET_CHECK(!interpreter_->inputs().empty());
+  for (const int input : interpreter_->inputs()) {
+    const TfLiteIntArray* dims = interpreter_->tensor(input)->dims;
+    model_input_dims_.emplace_back(dims->data, dims->data + dims->size);
+  }
+  const std::vector<int>& first_dims = model_input_dims_[0];
+  max_batch_size_ = first_dims.size() > 1 ? first_dims[0] : 1;
+  if (options_.max_batch_size() > 0 &&
+      options_.max_batch_size() != max_batch_size_) {
+    MP_RETURN_IF_ERROR(ResizeBatch(options_.max_batch_size()));
+  }
+  InitOutputDims();
+
+  if (options_.warmup()) MP_RETURN_IF_ERROR(Warmup());
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status batchTfLiteInferenceCalculator::Warmup() {
+  for (const int input : interpreter_->inputs()) {
+    TfLiteTensor* tensor = interpreter_->tensor(input);
+    std::memset(tensor->data.raw, 0, tensor->bytes);
+  }
+  RET_CHECK_EQ(interpreter_->Invoke(), kTfLiteOk)
+      << "Warmup of " << options_.model_path() << " failed.";
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status batchTfLiteInferenceCalculator::ResizeBatch(
+    int batch_size) {
+  for (int i = 0; i < model_input_dims_.size(); ++i) {
+    std::vector<int> dims = model_input_dims_[i];
+    RET_CHECK_GE(dims.size(), 2)
+        << "Model input " << i << " has no batch dimension.";
+    dims[0] = batch_size;
+    RET_CHECK_EQ(interpreter_->ResizeInputTensor(interpreter_->inputs()[i],
+                                                 dims),
+                 kTfLiteOk);
+  }
+  RET_CHECK_EQ(interpreter_->AllocateTensors(), kTfLiteOk);
+  max_batch_size_ = batch_size;
+
+  return ::mediapipe::OkStatus();
+}
+
+void batchTfLiteInferenceCalculator::InitOutputDims() {
+  for (const int output : interpreter_->outputs()) {
+    const TfLiteIntArray* dims = interpreter_->tensor(output)->dims;
+    output_is_batched_.push_back(dims->size > 1 &&
+                                 dims->data[0] == max_batch_size_);
+  }
+  output_dims_.resize(max_batch_size_);
+  for (int batch_size = 1; batch_size <= max_batch_size_; ++batch_size) {
+    for (int i = 0; i < interpreter_->outputs().size(); ++i) {
+      TfLiteIntArray* dims =
+          TfLiteIntArrayCopy(interpreter_->output_tensor(i)->dims);
+      if (output_is_batched_[i]) dims->data[0] = batch_size;
+      output_dims_[batch_size - 1].push_back(dims);
+    }
+  }
+}
+
+::mediapipe::Status batchTfLiteInferenceCalculator::Process(
+    CalculatorContext* cc) {
+  if (cc->Inputs().Tag(kTensorsTag).IsEmpty()) {
+    return ::mediapipe::OkStatus();
+  }
+
+  const auto& input_tensors =
+      cc->Inputs().Tag(kTensorsTag).Get<std::vector<TfLiteTensor>>();
+  RET_CHECK_EQ(input_tensors.size(), interpreter_->inputs().size());
+
+  // Inputs without a batch dimension hold a single row
+  const TfLiteTensor& first = input_tensors[0];
+  const int batch_size = first.dims->size > 1 ? first.dims->data[0] : 1;
+  RET_CHECK_GE(batch_size, 1);
+  RET_CHECK_LE(batch_size, max_batch_size_)
+      << "Batch larger than max_batch_size.";
+
+  for (int i = 0; i < input_tensors.size(); ++i) {
+    const TfLiteTensor* input_tensor = &input_tensors[i];
+    TfLiteTensor* local_tensor = interpreter_->input_tensor(i);
+    RET_CHECK(input_tensor->data.raw);
+    RET_CHECK_EQ(input_tensor->type, local_tensor->type);
+    // The rows past the batch keep the values of an earlier one, their
+    // outputs are not emitted
+    RET_CHECK_EQ(input_tensor->bytes,
+                 local_tensor->bytes / max_batch_size_ * batch_size)
+        << "Input " << i << " does not match the model input size.";
+    std::memcpy(local_tensor->data.raw, input_tensor->data.raw,
+                input_tensor->bytes);
+  }
+
+  RET_CHECK_EQ(interpreter_->Invoke(), kTfLiteOk);
+
+  auto output_tensors = absl::make_unique<std::vector<TfLiteTensor>>();
+  for (int i = 0; i < interpreter_->outputs().size(); ++i) {
+    TfLiteTensor tensor = *interpreter_->output_tensor(i);
+    if (output_is_batched_[i]) {
+      tensor.dims = output_dims_[batch_size - 1][i];
+      tensor.bytes = tensor.bytes / max_batch_size_ * batch_size;
+    }
+    output_tensors->emplace_back(tensor);
+  }
+  cc->Outputs().Tag(kTensorsTag).Add(output_tensors.release(),
+                                     cc->InputTimestamp());
+
+  return ::mediapipe::OkStatus();
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,80 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_CALCULATORS_TFLITE_GPU_TENSOR_H_
+#define MYMEDIAPIPE_CALCULATORS_TFLITE_GPU_TENSOR_H_
+
+// GPU tensors as TfLiteInferenceCalculator takes and outputs them on its
+// TENSORS_GPU streams, shader storage buffers of the GL delegate. Not
+// available without OpenGL ES 3.1, ie on macOS or desktop builds with
+// --copt -DMEDIAPIPE_DISABLE_GL_COMPUTE.
+#if !defined(MEDIAPIPE_DISABLE_GL_COMPUTE)
+
+#include <vector>
+
+#include "absl/types/span.h"
+#include "mediapipe/framework/port/canonical_errors.h"
+#include "mediapipe/framework/port/status.h"
+#include "tensorflow/lite/delegates/gpu/gl/gl_buffer.h"
+
+namespace mediapipe {
+
+typedef ::tflite::gpu::gl::GlBuffer GpuTensor;
+
+namespace gpu_tensor {
+
+// Status of the GL delegate calls as a ::mediapipe::Status
+template <typename GpuStatus>
+inline ::mediapipe::Status FromGpuStatus(const GpuStatus& status) {
+  if (status.ok()) return ::mediapipe::OkStatus();
+  return ::mediapipe::InternalError(status.error_message());
+}
+
+// Number of floats held by the tensor
+inline int NumFloats(const GpuTensor& tensor) {
+  return tensor.bytes_size() / sizeof(float);
+}
+
+// Allocates tensor with room for num_floats floats. Must run in the GL
+// context, see GlCalculatorHelper::RunInGlContext.
+inline ::mediapipe::Status CreateFloats(int num_floats, GpuTensor* tensor) {
+  return FromGpuStatus(
+      ::tflite::gpu::gl::CreateReadWriteShaderStorageBuffer<float>(
+          num_floats, tensor));
+}
+
+// Uploads the values to the start of tensor, which is never reallocated:
+// fails when they don't fit. Must run in the GL context.
+inline ::mediapipe::Status WriteFloats(const std::vector<float>& values,
+                                       GpuTensor* tensor) {
+  if (static_cast<int>(values.size()) > NumFloats(*tensor)) {
+    return ::mediapipe::InvalidArgumentError(
+        "More floats than the GPU tensor holds.");
+  }
+  return FromGpuStatus(tensor->Write(absl::MakeConstSpan(values)));
+}
+
+// Downloads the whole tensor into values. Must run in the GL context.
+inline ::mediapipe::Status ReadFloats(const GpuTensor& tensor,
+                                      std::vector<float>* values) {
+  values->resize(NumFloats(tensor));
+  return FromGpuStatus(tensor.Read(absl::MakeSpan(*values)));
+}
+
+}  // namespace gpu_tensor
+}  // namespace mediapipe
+
+#endif  // !MEDIAPIPE_DISABLE_GL_COMPUTE
+
+#endif  // MYMEDIAPIPE_CALCULATORS_TFLITE_GPU_TENSOR_H_
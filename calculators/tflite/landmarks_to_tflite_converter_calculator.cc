@@ -0,0 +1,235 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/landmark.pb.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "myMediapipe/calculators/tflite/landmarks_to_tflite_converter_calculator.pb.h"
+#include "myMediapipe/calculators/tflite/quantization.h"
+#include "myMediapipe/calculators/tflite/tensor_ring.h"
+#include "myMediapipe/calculators/util/hand_angles.h"
+
+namespace mediapipe {
+
+namespace {
+
+constexpr char kNormLandmarksTag[] = "NORM_LANDMARKS";
+constexpr char kMultiNormLandmarksTag[] = "MULTI_NORM_LANDMARKS";
+constexpr char kTensorsTag[] = "TENSORS";
+
+}  // namespace
+
+// Fused version of the LandmarksListToVectorLandmarksCalculator ->
+// LandmarksToAnglesCalculator -> anglesToTfLiteConverterCalculator chain.
+// Takes the landmarks of one hand and writes the angle features straight
+// into a TfLite tensor allocated at Open, skipping the intermediate
+// std::vector<NormalizedLandmark> and std::vector<Angle> packets.
+// The three original calculators are still available, ie to inspect
+// the angles or to record them with LandmarksAndAnglesToFileCalculator
+//
+// Input, one of the following tags:
+//  NORM_LANDMARKS: A NormalizedLandmarkList with the hand landmarks.
+//  MULTI_NORM_LANDMARKS: A std::vector<NormalizedLandmarkList> with the
+//                        landmarks of several hands.
+//
+// Output:
+//  TENSORS: Vector of TfLiteTensor of type kTfLiteFloat32 with the
+//           hand_angles::kNumFeatures angle features, shaped {42} for a
+//           single hand or {num_hands, 42} for MULTI_NORM_LANDMARKS, so
+//           all the hands are classified by a single invoke of
+//           batchTfLiteInferenceCalculator. Row N holds hand N.
+//           Tensors are allocated at Open for max_num_hands, a frame
+//           with fewer hands only reshapes its tensor.
+//           With quant_scale set the tensors are kTfLiteInt8, quantized
+//           with the input params of a full integer model.
+//
+// Example use:
+// node {
+//   calculator: "landmarksToTfLiteConverterCalculator"
+//   input_stream: "NORM_LANDMARKS:hand_landmarks"
+//   output_stream: "TENSORS:angle_tensor"
+// }
+//
+// node {
+//   calculator: "landmarksToTfLiteConverterCalculator"
+//   input_stream: "MULTI_NORM_LANDMARKS:multi_hand_landmarks"
+//   output_stream: "TENSORS:angle_tensor"
+//   options: {
+//     [mediapipe.landmarksToTfLiteConverterCalculatorOptions.ext] {
+//       quant_scale: 0.0246
+//       quant_zero_point: 0
+//     }
+//   }
+// }
+
+class landmarksToTfLiteConverterCalculator : public CalculatorBase {
+ public:
+  landmarksToTfLiteConverterCalculator() {}
+  ~landmarksToTfLiteConverterCalculator() override {}
+  landmarksToTfLiteConverterCalculator(
+      const landmarksToTfLiteConverterCalculator&) = delete;
+  landmarksToTfLiteConverterCalculator& operator=(
+      const landmarksToTfLiteConverterCalculator&) = delete;
+
+  static ::mediapipe::Status GetContract(CalculatorContract* cc);
+
+  ::mediapipe::Status Open(CalculatorContext* cc) override;
+  ::mediapipe::Status Process(CalculatorContext* cc) override;
+
+ private:
+  ::mediapipe::Status AllocateTensors(const std::vector<int>& max_dims);
+  void ComputeHandFeatures(const NormalizedLandmarkList& landmarks,
+                           float* features);
+  // Writes the features of a hand into row `hand` of the tensor
+  void WriteHandFeatures(const NormalizedLandmarkList& landmarks,
+                         int tensor_idx, int hand);
+  void OutputTensor(int tensor_idx, CalculatorContext* cc);
+
+  TensorRing tensors_;
+
+  landmarksToTfLiteConverterCalculatorOptions options_;
+  bool quantize_ = false;
+  // Float features of a hand, before quantizing them
+  float hand_features_[hand_angles::kNumFeatures];
+};
+REGISTER_CALCULATOR(landmarksToTfLiteConverterCalculator);
+
+::mediapipe::Status landmarksToTfLiteConverterCalculator::GetContract(
+    CalculatorContract* cc) {
+  RET_CHECK(cc->Inputs().HasTag(kNormLandmarksTag) ^
+            cc->Inputs().HasTag(kMultiNormLandmarksTag))
+      << "Either NORM_LANDMARKS or MULTI_NORM_LANDMARKS must be provided.";
+  RET_CHECK(cc->Outputs().HasTag(kTensorsTag))
+      << "Tensors output stream is NOT provided.";
+
+  if (cc->Inputs().HasTag(kNormLandmarksTag)) {
+    cc->Inputs().Tag(kNormLandmarksTag).Set<NormalizedLandmarkList>();
+  } else {
+    cc->Inputs()
+        .Tag(kMultiNormLandmarksTag)
+        .Set<std::vector<NormalizedLandmarkList>>();
+  }
+  cc->Outputs().Tag(kTensorsTag).Set<std::vector<TfLiteTensor>>();
+
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status landmarksToTfLiteConverterCalculator::Open(
+    CalculatorContext* cc) {
+  cc->SetOffset(TimestampDiff(0));
+
+  options_ = cc->Options<landmarksToTfLiteConverterCalculatorOptions>();
+  RET_CHECK_GE(options_.quant_scale(), 0);
+  quantize_ = options_.quant_scale() > 0;
+
+  // Tensors are allocated once here, for the most hands, and Process only
+  // writes the features into them
+  if (cc->Inputs().HasTag(kNormLandmarksTag)) {
+    MP_RETURN_IF_ERROR(AllocateTensors({hand_angles::kNumFeatures}));
+  } else {
+    RET_CHECK_GT(options_.max_num_hands(), 0);
+    MP_RETURN_IF_ERROR(AllocateTensors(
+        {options_.max_num_hands(), hand_angles::kNumFeatures}));
+  }
+
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status landmarksToTfLiteConverterCalculator::AllocateTensors(
+    const std::vector<int>& max_dims) {
+  if (quantize_) {
+    return tensors_.Allocate(kTfLiteInt8, max_dims, options_.quant_scale(),
+                             options_.quant_zero_point());
+  }
+  return tensors_.Allocate(kTfLiteFloat32, max_dims);
+}
+
+void landmarksToTfLiteConverterCalculator::ComputeHandFeatures(
+    const NormalizedLandmarkList& landmarks, float* features) {
+  float x[hand_angles::kNumLandmarks];
+  float y[hand_angles::kNumLandmarks];
+  for (int i = 0; i < hand_angles::kNumLandmarks; ++i) {
+    x[i] = landmarks.landmark(i).x();
+    y[i] = landmarks.landmark(i).y();
+  }
+  hand_angles::ComputeFeatures(x, y, features);
+}
+
+void landmarksToTfLiteConverterCalculator::WriteHandFeatures(
+    const NormalizedLandmarkList& landmarks, int tensor_idx, int hand) {
+  const int offset = hand * hand_angles::kNumFeatures;
+  if (!quantize_) {
+    ComputeHandFeatures(
+        landmarks, tensors_.data<float>(tensor_idx) + offset);
+    return;
+  }
+  ComputeHandFeatures(landmarks, hand_features_);
+  int8* features = tensors_.data<int8>(tensor_idx) + offset;
+  for (int i = 0; i < hand_angles::kNumFeatures; ++i) {
+    features[i] = quantization::Quantize<int8>(hand_features_[i],
+                                              options_.quant_scale(),
+                                              options_.quant_zero_point());
+  }
+}
+
+void landmarksToTfLiteConverterCalculator::OutputTensor(
+    int tensor_idx, CalculatorContext* cc) {
+  cc->Outputs().Tag(kTensorsTag).Add(
+      tensors_.MakeOutput(tensor_idx).release(), cc->InputTimestamp());
+}
+
+::mediapipe::Status landmarksToTfLiteConverterCalculator::Process(
+    CalculatorContext* cc) {
+  if (cc->Inputs().HasTag(kNormLandmarksTag)) {
+    if (cc->Inputs().Tag(kNormLandmarksTag).IsEmpty()) {
+      return ::mediapipe::OkStatus();
+    }
+    const auto& landmarks =
+        cc->Inputs().Tag(kNormLandmarksTag).Get<NormalizedLandmarkList>();
+    RET_CHECK_GE(landmarks.landmark_size(), hand_angles::kNumLandmarks);
+
+    const int tensor_idx = tensors_.Next();
+    WriteHandFeatures(landmarks, tensor_idx, 0);
+    OutputTensor(tensor_idx, cc);
+    return ::mediapipe::OkStatus();
+  }
+
+  if (cc->Inputs().Tag(kMultiNormLandmarksTag).IsEmpty()) {
+    return ::mediapipe::OkStatus();
+  }
+  const auto& multi_landmarks = cc->Inputs()
+                                    .Tag(kMultiNormLandmarksTag)
+                                    .Get<std::vector<NormalizedLandmarkList>>();
+  const int num_hands = multi_landmarks.size();
+  if (num_hands == 0) return ::mediapipe::OkStatus();
+
+  RET_CHECK_LE(num_hands, options_.max_num_hands())
+      << "More hands than max_num_hands.";
+
+  const int tensor_idx = tensors_.Next();
+  MP_RETURN_IF_ERROR(
+      tensors_.Reshape(tensor_idx, {num_hands, hand_angles::kNumFeatures}));
+  for (int hand = 0; hand < num_hands; ++hand) {
+    const auto& landmarks = multi_landmarks[hand];
+    RET_CHECK_GE(landmarks.landmark_size(), hand_angles::kNumLandmarks);
+    WriteHandFeatures(landmarks, tensor_idx, hand);
+  }
+  OutputTensor(tensor_idx, cc);
+
+  return ::mediapipe::OkStatus();
+}
+
+}  // namespace mediapipe
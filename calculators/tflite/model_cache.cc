@@ -0,0 +1,99 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myMediapipe/calculators/tflite/model_cache.h"
+
+#include <map>
+#include <utility>
+
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/logging.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/util/resource_util.h"
+
+namespace mediapipe {
+namespace model_cache {
+
+namespace {
+
+// Weak references, the graphs own the entries
+template <class T>
+struct Registry {
+  absl::Mutex mutex;
+  std::map<std::string, std::weak_ptr<const T>> entries GUARDED_BY(mutex);
+};
+
+template <class T>
+Registry<T>* GetRegistry() {
+  static Registry<T>* registry = new Registry<T>();
+  return registry;
+}
+
+// Entry of the resolved path, loaded by load when missing. The lock is
+// held while loading, so graphs starting together load a path only once.
+template <class T, class Loader>
+::mediapipe::StatusOr<std::shared_ptr<const T>> GetOrLoad(
+    const std::string& path, Loader load) {
+  ::mediapipe::StatusOr<std::string> resolved_path =
+      PathToResourceAsFile(path);
+  if (!resolved_path.ok()) return resolved_path.status();
+
+  Registry<T>* registry = GetRegistry<T>();
+  absl::MutexLock lock(&registry->mutex);
+  std::weak_ptr<const T>& entry =
+      registry->entries[resolved_path.ValueOrDie()];
+  std::shared_ptr<const T> cached = entry.lock();
+  if (cached) return cached;
+
+  std::shared_ptr<const T> loaded;
+  ::mediapipe::Status status = load(resolved_path.ValueOrDie(), &loaded);
+  if (!status.ok()) return status;
+  entry = loaded;
+  VLOG(1) << "Loaded " << resolved_path.ValueOrDie();
+  return loaded;
+}
+
+}  // namespace
+
+::mediapipe::StatusOr<std::shared_ptr<const tflite::FlatBufferModel>>
+GetModel(const std::string& path) {
+  return GetOrLoad<tflite::FlatBufferModel>(
+      path, [](const std::string& resolved_path,
+               std::shared_ptr<const tflite::FlatBufferModel>* model)
+                -> ::mediapipe::Status {
+        *model = tflite::FlatBufferModel::BuildFromFile(resolved_path.c_str());
+        RET_CHECK(*model) << "Failed to load model from path "
+                          << resolved_path;
+        return ::mediapipe::OkStatus();
+      });
+}
+
+::mediapipe::StatusOr<std::shared_ptr<const std::string>> GetContents(
+    const std::string& path) {
+  return GetOrLoad<std::string>(
+      path, [](const std::string& resolved_path,
+               std::shared_ptr<const std::string>* contents)
+                -> ::mediapipe::Status {
+        auto file_contents = std::make_shared<std::string>();
+        MP_RETURN_IF_ERROR(
+            file::GetContents(resolved_path, file_contents.get()));
+        *contents = std::move(file_contents);
+        return ::mediapipe::OkStatus();
+      });
+}
+
+}  // namespace model_cache
+}  // namespace mediapipe
@@ -0,0 +1,49 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_CALCULATORS_TFLITE_MODEL_CACHE_H_
+#define MYMEDIAPIPE_CALCULATORS_TFLITE_MODEL_CACHE_H_
+
+#include <memory>
+#include <string>
+
+#include "mediapipe/framework/port/statusor.h"
+#include "tensorflow/lite/model.h"
+
+namespace mediapipe {
+namespace model_cache {
+
+// Process wide cache of the models and resource files of the graphs.
+//
+// Every graph of a process asking for the same path gets the same object:
+// a model is mmap'd once (FlatBufferModel::BuildFromFile) and shared by
+// the interpreters of all the graphs, a file is read once. The entries
+// are reference counted, they are released with the last graph using
+// them, so a graph started later in a long running process only pays for
+// its interpreters. Paths are resolved with PathToResourceAsFile. Thread
+// safe.
+
+// Model at path, the model is read only and can back any number of
+// interpreters at the same time
+::mediapipe::StatusOr<std::shared_ptr<const tflite::FlatBufferModel>>
+GetModel(const std::string& path);
+
+// Contents of the file at path
+::mediapipe::StatusOr<std::shared_ptr<const std::string>> GetContents(
+    const std::string& path);
+
+}  // namespace model_cache
+}  // namespace mediapipe
+
+#endif  // MYMEDIAPIPE_CALCULATORS_TFLITE_MODEL_CACHE_H_
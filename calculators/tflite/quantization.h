@@ -0,0 +1,47 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_CALCULATORS_TFLITE_QUANTIZATION_H_
+#define MYMEDIAPIPE_CALCULATORS_TFLITE_QUANTIZATION_H_
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+namespace quantization {
+
+// Affine quantization of TfLite, value = scale * (q - zero_point), with q
+// an uint8 or int8. The scale and zero point of a tensor are in its
+// params, the ones of a model input are printed by
+// projects/staticGestures/train_quantized_model.py.
+template <typename T>
+inline T Quantize(float value, float scale, int32 zero_point) {
+  const float q = std::round(value / scale) + zero_point;
+  return static_cast<T>(
+      std::min<float>(std::numeric_limits<T>::max(),
+                      std::max<float>(std::numeric_limits<T>::min(), q)));
+}
+
+template <typename T>
+inline float Dequantize(T value, float scale, int32 zero_point) {
+  return scale * (static_cast<int32>(value) - zero_point);
+}
+
+}  // namespace quantization
+}  // namespace mediapipe
+
+#endif  // MYMEDIAPIPE_CALCULATORS_TFLITE_QUANTIZATION_H_
@@ -0,0 +1,93 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myMediapipe/calculators/tflite/tensor_ring.h"
+
+#include "absl/memory/memory.h"
+#include "mediapipe/framework/port/ret_check.h"
+
+namespace mediapipe {
+
+constexpr int TensorRing::kNumTensors;
+
+TensorRing::TensorRing()
+    : interpreter_(absl::make_unique<tflite::Interpreter>()) {
+  interpreter_->AddTensors(kNumTensors);
+  std::vector<int> inputs;
+  for (int i = 0; i < kNumTensors; ++i) inputs.push_back(i);
+  interpreter_->SetInputs(inputs);
+}
+
+::mediapipe::Status TensorRing::Allocate(TfLiteType type,
+                                         const std::vector<int>& dims,
+                                         float quant_scale,
+                                         int quant_zero_point) {
+  RET_CHECK(!allocated_) << "The tensors are only allocated once.";
+  for (int i = 0; i < kNumTensors; ++i) {
+    if (type == kTfLiteFloat32) {
+      RET_CHECK_EQ(interpreter_->SetTensorParametersReadWrite(
+                       /*tensor_index=*/i, /*type=*/type, /*name=*/"",
+                       /*dims=*/dims, /*quantization=*/TfLiteQuantization()),
+                   kTfLiteOk);
+    } else {
+      TfLiteQuantizationParams quant;
+      quant.scale = quant_scale;
+      quant.zero_point = quant_zero_point;
+      RET_CHECK_EQ(interpreter_->SetTensorParametersReadWrite(
+                       /*tensor_index=*/i, /*type=*/type, /*name=*/"",
+                       /*dims=*/dims, quant),
+                   kTfLiteOk);
+    }
+  }
+  RET_CHECK_EQ(interpreter_->AllocateTensors(), kTfLiteOk);
+
+  size_t num_elements = 1;
+  for (const int dim : dims) num_elements *= dim;
+  RET_CHECK_GT(num_elements, 0u);
+  capacity_bytes_ = interpreter_->tensor(0)->bytes;
+  element_bytes_ = capacity_bytes_ / num_elements;
+  allocated_ = true;
+
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status TensorRing::Reshape(int tensor_idx,
+                                        const std::vector<int>& dims) {
+  RET_CHECK(allocated_);
+  TfLiteTensor* tensor = interpreter_->tensor(tensor_idx);
+  RET_CHECK_EQ(tensor->dims->size, static_cast<int>(dims.size()));
+  size_t num_elements = 1;
+  for (const int dim : dims) num_elements *= dim;
+  RET_CHECK_LE(num_elements * element_bytes_, capacity_bytes_)
+      << "Shape larger than the one the tensors were allocated for.";
+  for (int i = 0; i < tensor->dims->size; ++i) tensor->dims->data[i] = dims[i];
+  tensor->bytes = num_elements * element_bytes_;
+
+  return ::mediapipe::OkStatus();
+}
+
+int TensorRing::Next() {
+  const int tensor_idx = next_tensor_;
+  next_tensor_ = (next_tensor_ + 1) % kNumTensors;
+  return tensor_idx;
+}
+
+std::unique_ptr<std::vector<TfLiteTensor>> TensorRing::MakeOutput(
+    int tensor_idx) const {
+  auto output_tensors = absl::make_unique<std::vector<TfLiteTensor>>();
+  output_tensors->emplace_back(*interpreter_->tensor(tensor_idx));
+  return output_tensors;
+}
+
+}  // namespace mediapipe
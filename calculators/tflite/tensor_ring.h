@@ -0,0 +1,85 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_CALCULATORS_TFLITE_TENSOR_RING_H_
+#define MYMEDIAPIPE_CALCULATORS_TFLITE_TENSOR_RING_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "mediapipe/framework/port/status.h"
+#include "tensorflow/lite/interpreter.h"
+
+namespace mediapipe {
+
+// Input tensors of the converter calculators. The tensors live in a private
+// tflite::Interpreter and each frame is written to the next one of the
+// ring, so a frame still waiting for inference is not overwritten by the
+// next one. The packets only point to the buffers and shapes of the ring,
+// so the graph must not have more than kNumTensors frames of a converter
+// in flight, and the ring is allocated once, at Open, for the largest
+// shape. A smaller frame only rewrites the shape of its own tensor.
+//
+// Example use:
+//   ring_.Allocate(kTfLiteFloat32, {max_num_hands, num_features});
+//   const int tensor_idx = ring_.Next();
+//   MP_RETURN_IF_ERROR(ring_.Reshape(tensor_idx, {num_hands, num_features}));
+//   float* features = ring_.data<float>(tensor_idx);
+//   ...
+//   cc->Outputs().Tag(kTensorsTag).Add(
+//       ring_.MakeOutput(tensor_idx).release(), cc->InputTimestamp());
+class TensorRing {
+ public:
+  static constexpr int kNumTensors = 4;
+
+  TensorRing();
+  TensorRing(const TensorRing&) = delete;
+  TensorRing& operator=(const TensorRing&) = delete;
+
+  // Allocates every tensor of the ring with the largest shape it holds.
+  // Quantized types take the scale and zero point of the model input.
+  // Fails when called twice, packets in flight point to the buffers.
+  ::mediapipe::Status Allocate(TfLiteType type, const std::vector<int>& dims,
+                               float quant_scale = 0,
+                               int quant_zero_point = 0);
+
+  // Sets the shape of one tensor, of the allocated rank and with no more
+  // elements, without touching its buffer
+  ::mediapipe::Status Reshape(int tensor_idx, const std::vector<int>& dims);
+
+  // Index of the tensor the next frame is written to
+  int Next();
+
+  template <typename T>
+  T* data(int tensor_idx) {
+    return interpreter_->typed_tensor<T>(tensor_idx);
+  }
+
+  // TfLiteInferenceCalculator expects a vector of tensors, the struct
+  // copied here only points to the buffer owned by the ring
+  std::unique_ptr<std::vector<TfLiteTensor>> MakeOutput(int tensor_idx) const;
+
+ private:
+  std::unique_ptr<tflite::Interpreter> interpreter_;
+  int next_tensor_ = 0;
+  bool allocated_ = false;
+  // Allocated size of every tensor
+  size_t capacity_bytes_ = 0;
+  size_t element_bytes_ = 0;
+};
+
+}  // namespace mediapipe
+
+#endif  // MYMEDIAPIPE_CALCULATORS_TFLITE_TENSOR_RING_H_
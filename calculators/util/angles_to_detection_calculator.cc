@@ -12,39 +12,62 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <memory>
+#include <vector>
 
+#include "absl/memory/memory.h"
+#include "myMediapipe/calculators/tflite/quantization.h"
 #include "myMediapipe/calculators/util/angles_to_detection_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
+#include "myMediapipe/calculators/util/calculator_stats.h"
+#include "myMediapipe/calculators/util/class_scores.h"
 #include "mediapipe/framework/formats/detection.pb.h"
 #include "tensorflow/lite/interpreter.h"
 #include "mediapipe/framework/port/ret_check.h"
 
+#if !defined(MEDIAPIPE_DISABLE_GL_COMPUTE)
+#include "mediapipe/gpu/gl_calculator_helper.h"
+#include "myMediapipe/calculators/tflite/gpu_tensor.h"
+#endif  // !MEDIAPIPE_DISABLE_GL_COMPUTE
+
 namespace mediapipe {
 
 typedef std::vector<Detection> Detections; 
 
 namespace {
 
-constexpr char kDetectionTag[] = "DETECTIONS";
+constexpr char kClassesTag[] = "CLASSES";
 constexpr char kTfLiteFloat32[] = "TENSORS"; 
+constexpr char kTensorsGpuTag[] = "TENSORS_GPU";
 
 }  // namespace
 
 // Converts Angles to Detection proto. 
 //
-// If option queue_size is set , it will put each new 
-// detection in a FIFO of max size queue_size  
-// and will return the class corresponding to the 
-// highest occcurence in the FIFO, usefull to stabilize detections
-// eliminating spurious missclasifications 
+// The raw classification of every frame is output, to stabilize the
+// detections follow it with a DetectionClassStabilizationCalculator.
+//
+// When the tensor holds a batch of hands ({num_hands, num_classes}) one
+// detection is output per hand, with the row number as detection_id.
+// The top_k classes of a hand are picked straight from the float or
+// quantized (uint8 or int8) scores, and min_score_threshold is applied before any
+// output is built. Consumers that only need the classes can take the
+// CLASSES output instead of the Detection protos.
 //
 // Input:
-//  TENSOR: A Vector of TfLiteTensor of type kTfLiteFloat32 with the confidence score
-//          for each static gesture.
+//  TENSOR: A Vector of TfLiteTensor of type kTfLiteFloat32, kTfLiteUInt8
+//          or kTfLiteInt8 with the confidence score for each static
+//          gesture. Quantized scores are dequantized with the params of
+//          the tensor.
+//  TENSORS_GPU: A Vector of float32 GpuTensor, the output of a
+//               TfLiteInferenceCalculator on the GPU delegate. Only the
+//               scores are read back, the GPU buffers carry no shape so
+//               a batch of hands needs num_classes.
 //
-// Output:
-//   DETECTION: A Detection proto.
+// Output (at least one of them):
+//   DETECTION: A vector of Detection protos, one per hand.
+//   CLASSES: A vector of ClassScore, top_k per hand, best first.
 //
 // Example config:
 // node {
@@ -52,6 +75,13 @@ constexpr char kTfLiteFloat32[] = "TENSORS";
 //   input_stream: ""TENSORS:tensors"
 //   output_stream: "DETECTIONS:detections"
 // }
+//
+// Scores of a classifier on the GPU delegate:
+// node {
+//   calculator: "AnglesToDetectionCalculator"
+//   input_stream: "TENSORS_GPU:tensors"
+//   output_stream: "detections"
+// }
 
 class AnglesToDetectionCalculator : public CalculatorBase {
  public:
@@ -61,30 +91,70 @@ class AnglesToDetectionCalculator : public CalculatorBase {
   ::mediapipe::Status Process(CalculatorContext* cc) override;
 
  private:
-  typedef struct {
-    float score_; 
-    int label_;
-    } inValues_t ;
- 
-  std::vector<inValues_t> inferenceQueue;
-  decltype(Timestamp().Seconds()) startingGestureTime;
+  // Outputs the classes of num_hands hands, hand_classes(hand) fills
+  // labels_ and scores_ and returns how many were kept
+  template <typename HandClassesFn>
+  void AddHands(CalculatorContext* cc, int num_hands, int top_k,
+                HandClassesFn hand_classes);
+  // Fills labels_ and scores_ with the classes of a hand above the
+  // threshold, returns how many
+  int HandClasses(const TfLiteTensor* raw_tensor, int hand, int num_classes,
+                  int top_k);
+  // Scores of HandClasses for the float tensors
+  void FloatHandScores(const float* raw_scores, int hand, int num_classes,
+                       int top_k);
+  // Leading classes of scores_ that pass min_score_threshold
+  int NumKeptClasses(int top_k) const;
+  // Scores of HandClasses for the uint8 and int8 tensors
+  template <typename T>
+  void QuantizedHandScores(const T* raw_scores,
+                           const TfLiteQuantizationParams& params, int hand,
+                           int num_classes, int top_k);
+
   ::mediapipe::AnglesToDetectionCalculatorOptions options_;
-  void mostFrequent(inValues_t &currentInference, 
-                    decltype(Timestamp().Seconds()) currGestureTime);
-  
+  std::vector<int> labels_;
+  std::vector<float> scores_;
+  bool output_detections_ = false;
+  bool output_classes_ = false;
+  bool use_gpu_ = false;
+
+#if !defined(MEDIAPIPE_DISABLE_GL_COMPUTE)
+  mediapipe::GlCalculatorHelper gpu_helper_;
+  // Scores read back from the GPU tensor
+  std::vector<float> gpu_scores_;
+#endif  // !MEDIAPIPE_DISABLE_GL_COMPUTE
+
+  calculator_stats::NodeStats* stats_ = nullptr;
 };
 REGISTER_CALCULATOR(AnglesToDetectionCalculator);
 
 ::mediapipe::Status AnglesToDetectionCalculator::GetContract(
     CalculatorContract* cc) {
-  RET_CHECK(cc->Inputs().HasTag(kTfLiteFloat32));
-  //RET_CHECK(cc->Outputs().HasTag(kDetectionTag));
+  RET_CHECK(cc->Inputs().HasTag(kTfLiteFloat32) ^
+            cc->Inputs().HasTag(kTensorsGpuTag));
+  RET_CHECK(cc->Outputs().NumEntries("") > 0 ||
+            cc->Outputs().HasTag(kClassesTag));
   // TODO: Also support converting Landmark to Detection.
-  cc->Inputs()
-      .Tag(kTfLiteFloat32) 
-      .Set<std::vector<TfLiteTensor>>();
-  //cc->Outputs().Tag(kDetectionTag).Set<Detection>();
-  cc->Outputs().Index(0).Set<Detections>();
+  if (cc->Inputs().HasTag(kTfLiteFloat32)) {
+    cc->Inputs()
+        .Tag(kTfLiteFloat32)
+        .Set<std::vector<TfLiteTensor>>();
+  }
+  if (cc->Inputs().HasTag(kTensorsGpuTag)) {
+#if !defined(MEDIAPIPE_DISABLE_GL_COMPUTE)
+    cc->Inputs().Tag(kTensorsGpuTag).Set<std::vector<GpuTensor>>();
+    MP_RETURN_IF_ERROR(mediapipe::GlCalculatorHelper::UpdateContract(cc));
+#else
+    RET_CHECK_FAIL() << "TENSORS_GPU needs GL compute, this build has "
+                        "MEDIAPIPE_DISABLE_GL_COMPUTE defined.";
+#endif  // !MEDIAPIPE_DISABLE_GL_COMPUTE
+  }
+  if (cc->Outputs().NumEntries("") > 0) {
+    cc->Outputs().Index(0).Set<Detections>();
+  }
+  if (cc->Outputs().HasTag(kClassesTag)) {
+    cc->Outputs().Tag(kClassesTag).Set<std::vector<ClassScore>>();
+  }
 
   return ::mediapipe::OkStatus();
 }
@@ -92,124 +162,190 @@ REGISTER_CALCULATOR(AnglesToDetectionCalculator);
 ::mediapipe::Status AnglesToDetectionCalculator::Open(
     CalculatorContext* cc) {
   cc->SetOffset(TimestampDiff(0));
+  stats_ = calculator_stats::ForNode(cc->NodeName());
 
   options_ = cc->Options<::mediapipe::AnglesToDetectionCalculatorOptions>();
+  RET_CHECK_LE(options_.queue_size(), 1)
+      << "queue_size is no longer supported, stabilize the detections with "
+         "a DetectionClassStabilizationCalculator.";
+  RET_CHECK_GT(options_.top_k(), 0);
+  labels_.resize(options_.top_k());
+  scores_.resize(options_.top_k());
+  output_detections_ = cc->Outputs().NumEntries("") > 0;
+  output_classes_ = cc->Outputs().HasTag(kClassesTag);
+  RET_CHECK_GE(options_.num_classes(), 0);
+
+  use_gpu_ = cc->Inputs().HasTag(kTensorsGpuTag);
+#if !defined(MEDIAPIPE_DISABLE_GL_COMPUTE)
+  if (use_gpu_) MP_RETURN_IF_ERROR(gpu_helper_.Open(cc));
+#endif  // !MEDIAPIPE_DISABLE_GL_COMPUTE
   return ::mediapipe::OkStatus();
 }
 
 ::mediapipe::Status AnglesToDetectionCalculator::Process(
     CalculatorContext* cc) {
+  calculator_stats::ScopedProcessTimer timer(stats_);
+
+#if !defined(MEDIAPIPE_DISABLE_GL_COMPUTE)
+  if (use_gpu_) {
+    RET_CHECK(!cc->Inputs().Tag(kTensorsGpuTag).IsEmpty());
+    const auto& input_tensors =
+        cc->Inputs().Tag(kTensorsGpuTag).Get<std::vector<GpuTensor>>();
+    RET_CHECK(!input_tensors.empty());
+    // A few floats per hand, reading them back is cheaper than decoding
+    // the classes in a shader
+    MP_RETURN_IF_ERROR(
+        gpu_helper_.RunInGlContext([this, &input_tensors]() {
+          return gpu_tensor::ReadFloats(input_tensors[0], &gpu_scores_);
+        }));
+
+    const int num_scores = gpu_scores_.size();
+    const int num_classes =
+        options_.num_classes() > 0 ? options_.num_classes() : num_scores;
+    RET_CHECK_GT(num_classes, 0);
+    RET_CHECK_EQ(num_scores % num_classes, 0)
+        << num_scores << " scores are not a batch of " << num_classes
+        << " classes";
+    const int top_k = std::min(options_.top_k(), num_classes);
+    AddHands(cc, num_scores / num_classes, top_k,
+             [this, num_classes, top_k](int hand) {
+               FloatHandScores(gpu_scores_.data(), hand, num_classes, top_k);
+               return NumKeptClasses(top_k);
+             });
+    return ::mediapipe::OkStatus();
+  }
+#endif  // !MEDIAPIPE_DISABLE_GL_COMPUTE
+
   RET_CHECK(!cc->Inputs().Tag(kTfLiteFloat32).IsEmpty());
 
   const auto& input_tensors =
       cc->Inputs().Tag(kTfLiteFloat32).Get<std::vector<TfLiteTensor>>();
   // TODO: Add option to specify which tensor to take 
   const TfLiteTensor* raw_tensor = &input_tensors[0];
-  const float* raw_floats = raw_tensor->data.f;
-  
-  //std::cout  << raw_tensor->name;
-  inValues_t currentInference; 
-  
-
-  for(int i=0;i<raw_tensor->dims->data[1]; i++){
-    if(raw_floats[i]>currentInference.score_){
-        currentInference.score_=raw_floats[i];
-        currentInference.label_=i;
-    }  
-  }
-
-  if(options_.queue_size()>1) 
-    mostFrequent(currentInference, cc->InputTimestamp().Seconds());
-  
-  
-  auto* output_detections = new Detections();
-  output_detections->reserve(1);
-  auto detection = absl::make_unique<Detection>();
-  detection->add_score(currentInference.score_);
-  detection->add_label_id(currentInference.label_);
-  
-  LocationData location_data;
-  location_data.set_format(LocationData::BOUNDING_BOX);
-  location_data.mutable_bounding_box()->set_xmin(450);
-  location_data.mutable_bounding_box()->set_ymin(450);
-  location_data.mutable_bounding_box()->set_width(200);
-  location_data.mutable_bounding_box()->set_height(20);
-  *(detection->mutable_location_data()) = location_data;
-
+  RET_CHECK(raw_tensor->type == kTfLiteFloat32 ||
+            raw_tensor->type == kTfLiteUInt8 ||
+            raw_tensor->type == kTfLiteInt8)
+      << "Unsupported tensor type " << raw_tensor->type;
   
-  
-  output_detections->push_back(*detection);
-
-  cc->Outputs()
-      .Index(0)
-      .Add(output_detections, cc->InputTimestamp());
+  // {num_classes} or {num_hands, num_classes}
+  const int num_hands =
+      raw_tensor->dims->size > 1 ? raw_tensor->dims->data[0] : 1;
+  const int num_classes = raw_tensor->dims->data[raw_tensor->dims->size - 1];
+  RET_CHECK_GT(num_classes, 0);
+  const int top_k = std::min(options_.top_k(), num_classes);
+
+  AddHands(cc, num_hands, top_k,
+           [this, raw_tensor, num_classes, top_k](int hand) {
+             return HandClasses(raw_tensor, hand, num_classes, top_k);
+           });
 
   return ::mediapipe::OkStatus();
 }
 
-void AnglesToDetectionCalculator::mostFrequent(inValues_t &currentInference,
-                                               decltype(Timestamp().Seconds()) currGestureTime){
-  struct attr
-  {
-    decltype(currentInference.score_) sumScores;
-    int32 counts;
-  } inferenceAttr={};
-  
-  struct highestOccurrence_t{
-    int32 label;
-    int32 count;
-  } highestOccurrence = {};
+template <typename HandClassesFn>
+void AnglesToDetectionCalculator::AddHands(CalculatorContext* cc,
+                                           int num_hands, int top_k,
+                                           HandClassesFn hand_classes) {
+  std::unique_ptr<Detections> output_detections;
+  std::unique_ptr<std::vector<ClassScore>> output_classes;
+  if (output_detections_) {
+    output_detections = absl::make_unique<Detections>();
+    output_detections->reserve(num_hands);
+  }
+  if (output_classes_) {
+    output_classes = absl::make_unique<std::vector<ClassScore>>();
+    output_classes->reserve(num_hands * top_k);
+  }
 
-  std::map<int,attr> trackInferences; //label, score, count
-  std::map<int,attr>::iterator it;
+  for (int hand = 0; hand < num_hands; ++hand) {
+    const int num_kept = hand_classes(hand);
+    if (num_kept == 0) continue;
 
-  inferenceQueue.emplace_back(currentInference);
+    if (output_classes) {
+      for (int i = 0; i < num_kept; ++i) {
+        output_classes->push_back({hand, labels_[i], scores_[i]});
+      }
+    }
+    if (!output_detections) continue;
 
-  if(options_.has_queue_time_out_s() && (startingGestureTime)){
-    if((currGestureTime - 
-        startingGestureTime) >= options_.queue_time_out_s()){
-      inferenceQueue.clear();    
+    output_detections->emplace_back();
+    Detection& detection = output_detections->back();
+    for (int i = 0; i < num_kept; ++i) {
+      detection.add_score(scores_[i]);
+      detection.add_label_id(labels_[i]);
+    }
+    detection.set_detection_id(hand);
+
+    if (options_.add_location_data()) {
+      LocationData* location_data = detection.mutable_location_data();
+      location_data->set_format(LocationData::BOUNDING_BOX);
+      location_data->mutable_bounding_box()->set_xmin(450);
+      location_data->mutable_bounding_box()->set_ymin(450 + 30 * hand);
+      location_data->mutable_bounding_box()->set_width(200);
+      location_data->mutable_bounding_box()->set_height(20);
     }
-  }  
-  startingGestureTime = currGestureTime;
+  }
 
+  if (output_detections) {
+    cc->Outputs()
+        .Index(0)
+        .Add(output_detections.release(), cc->InputTimestamp());
+  }
+  if (output_classes) {
+    cc->Outputs()
+        .Tag(kClassesTag)
+        .Add(output_classes.release(), cc->InputTimestamp());
+  }
+}
 
-  if(inferenceQueue.size()>=options_.queue_size()){
-    inferenceQueue.erase(inferenceQueue.begin());
+int AnglesToDetectionCalculator::HandClasses(const TfLiteTensor* raw_tensor,
+                                             int hand, int num_classes,
+                                             int top_k) {
+  switch (raw_tensor->type) {
+    case kTfLiteUInt8:
+      QuantizedHandScores(raw_tensor->data.uint8, raw_tensor->params, hand,
+                          num_classes, top_k);
+      break;
+    case kTfLiteInt8:
+      QuantizedHandScores(raw_tensor->data.int8, raw_tensor->params, hand,
+                          num_classes, top_k);
+      break;
+    default:
+      FloatHandScores(raw_tensor->data.f, hand, num_classes, top_k);
+  }
+  return NumKeptClasses(top_k);
+}
 
-    for(auto cInference: inferenceQueue){
-      
-       
-      it = trackInferences.find(cInference.label_);
-      if(it == trackInferences.end()) {
-        inferenceAttr.counts=1;
-        inferenceAttr.sumScores=cInference.score_;
-        trackInferences.emplace(cInference.label_,inferenceAttr);
-      }
-      else{
-        trackInferences[cInference.label_].counts++;
-        trackInferences[cInference.label_].sumScores+=cInference.score_;
-      }
-      
-      if(trackInferences[cInference.label_].counts > highestOccurrence.count){ 
-        highestOccurrence.label = cInference.label_;
-        highestOccurrence.count = trackInferences[cInference.label_].counts;
-      }
+void AnglesToDetectionCalculator::FloatHandScores(const float* raw_scores,
+                                                  int hand, int num_classes,
+                                                  int top_k) {
+  const float* hand_scores = raw_scores + hand * num_classes;
+  class_scores::TopK(hand_scores, num_classes, top_k, labels_.data());
+  for (int i = 0; i < top_k; ++i) scores_[i] = hand_scores[labels_[i]];
+}
 
-      //  std::cout << "\n3:" << std::to_string(i)
-      //          << "\t" << std::to_string(inferenceQueue[i].label_)
-      //          //<< "\t" << std::to_string(c_ference.label_)
-      //          << "\t" << std::to_string(trackInferences[inferenceQueue[i].label_].counts)
-      //          << "\t" << std::to_string(highestOccurrence.label);
-    
-    }
-  
-    currentInference.label_=highestOccurrence.label;
-    currentInference.score_= trackInferences[highestOccurrence.label].sumScores / 
-                          highestOccurrence.count;
+int AnglesToDetectionCalculator::NumKeptClasses(int top_k) const {
+  // Best first, so the classes kept are a prefix
+  int num_kept = 0;
+  while (num_kept < top_k &&
+         scores_[num_kept] >= options_.min_score_threshold()) {
+    ++num_kept;
+  }
+  return num_kept;
+}
 
-    trackInferences.clear();  
-  }  
+template <typename T>
+void AnglesToDetectionCalculator::QuantizedHandScores(
+    const T* raw_scores, const TfLiteQuantizationParams& params, int hand,
+    int num_classes, int top_k) {
+  // The order of the quantized values is the one of the scores, only the
+  // top_k kept are dequantized
+  const T* hand_scores = raw_scores + hand * num_classes;
+  class_scores::TopK(hand_scores, num_classes, top_k, labels_.data());
+  for (int i = 0; i < top_k; ++i) {
+    scores_[i] = quantization::Dequantize(hand_scores[labels_[i]],
+                                          params.scale, params.zero_point);
+  }
 }
 
 }  // namespace mediapipe
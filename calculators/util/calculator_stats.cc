@@ -0,0 +1,123 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myMediapipe/calculators/util/calculator_stats.h"
+
+#include <map>
+#include <memory>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+
+namespace mediapipe {
+namespace calculator_stats {
+
+namespace {
+
+// Older timestamps are not capture times of this run
+constexpr int64 kMaxEndToEndUs = 60 * 1000 * 1000;
+
+struct Registry {
+  absl::Mutex mutex;
+  // std::map keeps the output sorted and the NodeStats addresses stable
+  std::map<std::string, std::unique_ptr<NodeStats>> nodes GUARDED_BY(mutex);
+};
+
+Registry* GetRegistry() {
+  static Registry* registry = new Registry();
+  return registry;
+}
+
+void AppendHistogram(const std::string& metric, const std::string& node,
+                     const LatencyHistogram& histogram, std::string* out) {
+  int64 cumulative = 0;
+  for (int i = 0; i < LatencyHistogram::kNumBuckets; ++i) {
+    cumulative += histogram.bucket(i);
+    const std::string le =
+        i < LatencyHistogram::kNumBuckets - 1
+            ? absl::StrCat(LatencyHistogram::kBucketBoundsUs[i])
+            : "+Inf";
+    absl::StrAppend(out, metric, "_bucket{node=\"", node, "\",le=\"", le,
+                    "\"} ", cumulative, "\n");
+  }
+  absl::StrAppend(out, metric, "_sum{node=\"", node, "\"} ",
+                  histogram.sum_us(), "\n");
+  absl::StrAppend(out, metric, "_count{node=\"", node, "\"} ",
+                  histogram.count(), "\n");
+}
+
+}  // namespace
+
+const int64 LatencyHistogram::kBucketBoundsUs[kNumBuckets - 1] = {
+    50,    100,    250,    500,    1000,   2500,   5000,
+    10000, 25000, 50000, 100000, 250000, 1000000};
+
+void LatencyHistogram::Record(int64 us) {
+  if (us < 0) us = 0;
+  int bucket = 0;
+  while (bucket < kNumBuckets - 1 && us > kBucketBoundsUs[bucket]) ++bucket;
+  buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_us_.fetch_add(us, std::memory_order_relaxed);
+  int64 max_us = max_us_.load(std::memory_order_relaxed);
+  while (us > max_us && !max_us_.compare_exchange_weak(
+                            max_us, us, std::memory_order_relaxed)) {
+  }
+}
+
+void NodeStats::RecordEndToEnd(Timestamp timestamp) {
+  if (!timestamp.IsRangeValue()) return;
+  const int64 latency_us = NowMicros() - timestamp.Microseconds();
+  if (latency_us < 0 || latency_us > kMaxEndToEndUs) return;
+  end_to_end.Record(latency_us);
+}
+
+NodeStats* ForNode(const std::string& node_name) {
+  Registry* registry = GetRegistry();
+  absl::MutexLock lock(&registry->mutex);
+  auto& stats = registry->nodes[node_name];
+  if (!stats) stats = absl::make_unique<NodeStats>();
+  return stats.get();
+}
+
+std::string RenderPrometheusText() {
+  Registry* registry = GetRegistry();
+  absl::MutexLock lock(&registry->mutex);
+  std::string process_time, end_to_end, queue_depth;
+  for (const auto& node : registry->nodes) {
+    const NodeStats& stats = *node.second;
+    if (stats.process_time.count() > 0) {
+      AppendHistogram("mymediapipe_process_time_us", node.first,
+                      stats.process_time, &process_time);
+    }
+    if (stats.end_to_end.count() > 0) {
+      AppendHistogram("mymediapipe_end_to_end_latency_us", node.first,
+                      stats.end_to_end, &end_to_end);
+    }
+    absl::StrAppend(&queue_depth, "mymediapipe_queue_depth{node=\"",
+                    node.first, "\"} ", stats.queue_depth.load(), "\n");
+  }
+  return absl::StrCat(
+      "# HELP mymediapipe_process_time_us Time spent in Process.\n",
+      "# TYPE mymediapipe_process_time_us histogram\n", process_time,
+      "# HELP mymediapipe_end_to_end_latency_us Frame capture to node "
+      "output.\n",
+      "# TYPE mymediapipe_end_to_end_latency_us histogram\n", end_to_end,
+      "# HELP mymediapipe_queue_depth Items waiting in the node queue.\n",
+      "# TYPE mymediapipe_queue_depth gauge\n", queue_depth);
+}
+
+}  // namespace calculator_stats
+}  // namespace mediapipe
@@ -0,0 +1,110 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_CALCULATORS_UTIL_CALCULATOR_STATS_H_
+#define MYMEDIAPIPE_CALCULATORS_UTIL_CALCULATOR_STATS_H_
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/timestamp.h"
+
+namespace mediapipe {
+namespace calculator_stats {
+
+// Microseconds on the steady clock. The camera runners timestamp frames
+// with cv::getTickCount, which is the same monotonic clock on Linux, so
+// packet timestamps can be compared with it to get end to end latencies.
+inline int64 NowMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Lock free histogram of durations in microseconds, with fixed buckets
+// from 50us to 1s.
+class LatencyHistogram {
+ public:
+  static constexpr int kNumBuckets = 14;
+  // Upper bound of every bucket, the last one is +Inf
+  static const int64 kBucketBoundsUs[kNumBuckets - 1];
+
+  void Record(int64 us);
+
+  int64 bucket(int i) const {
+    return buckets_[i].load(std::memory_order_relaxed);
+  }
+  int64 count() const { return count_.load(std::memory_order_relaxed); }
+  int64 sum_us() const { return sum_us_.load(std::memory_order_relaxed); }
+  int64 max_us() const { return max_us_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<int64> buckets_[kNumBuckets] = {};
+  std::atomic<int64> count_{0};
+  std::atomic<int64> sum_us_{0};
+  std::atomic<int64> max_us_{0};
+};
+
+// Stats of one node, shared by the nodes with the same name when several
+// graphs run in one process.
+struct NodeStats {
+  // Time spent in Process
+  LatencyHistogram process_time;
+  // Capture of the frame to the output of the node, only recorded by the
+  // nodes that end the pipeline, ie MqttPublisherCalculator
+  LatencyHistogram end_to_end;
+  // Items waiting in the internal queue of the node, if it has one
+  std::atomic<int64> queue_depth{0};
+
+  // Records timestamp -> now in end_to_end. Ignored when the timestamp is
+  // not a capture time of the steady clock, ie frames decoded from a file.
+  void RecordEndToEnd(Timestamp timestamp);
+};
+
+// Stats of the node, created on first use. The pointer stays valid for
+// the life of the process, so calculators look it up once at Open.
+NodeStats* ForNode(const std::string& node_name);
+
+// Every node in the Prometheus text exposition format, see
+// https://prometheus.io/docs/instrumenting/exposition_formats/
+std::string RenderPrometheusText();
+
+// Measures the enclosing scope into process_time.
+//
+// Example:
+//   ::mediapipe::Status MyCalculator::Process(CalculatorContext* cc) {
+//     calculator_stats::ScopedProcessTimer timer(stats_);
+//     ...
+//   }
+class ScopedProcessTimer {
+ public:
+  explicit ScopedProcessTimer(NodeStats* stats)
+      : stats_(stats), start_us_(NowMicros()) {}
+  ~ScopedProcessTimer() {
+    if (stats_) stats_->process_time.Record(NowMicros() - start_us_);
+  }
+  ScopedProcessTimer(const ScopedProcessTimer&) = delete;
+  ScopedProcessTimer& operator=(const ScopedProcessTimer&) = delete;
+
+ private:
+  NodeStats* stats_;
+  const int64 start_us_;
+};
+
+}  // namespace calculator_stats
+}  // namespace mediapipe
+
+#endif  // MYMEDIAPIPE_CALCULATORS_UTIL_CALCULATOR_STATS_H_
@@ -0,0 +1,70 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_CALCULATORS_UTIL_CLASS_SCORES_H_
+#define MYMEDIAPIPE_CALCULATORS_UTIL_CLASS_SCORES_H_
+
+#include <algorithm>
+
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+
+// Best class of a hand, the compact alternative to a Detection proto
+// output by AnglesToDetectionCalculator.
+struct ClassScore {
+  // Row of the hand in the classifier batch, see multi_hand::HandId
+  int32 hand_id;
+  int32 label_id;
+  float score;
+};
+
+namespace class_scores {
+
+// Index of the highest of the n (> 0) scores, the first one on ties.
+// The max is found first with a branchless loop the compiler vectorizes,
+// the second pass only looks for it.
+template <typename T>
+inline int ArgMax(const T* scores, int n) {
+  T best = scores[0];
+  for (int i = 1; i < n; ++i) best = std::max(best, scores[i]);
+  int index = 0;
+  while (index < n - 1 && scores[index] != best) ++index;
+  return index;
+}
+
+// Indexes of the k highest scores into labels, best first, k <= n.
+// Insertion into the k kept, k is a handful of classes at most.
+template <typename T>
+inline void TopK(const T* scores, int n, int k, int* labels) {
+  if (k == 1) {
+    labels[0] = ArgMax(scores, n);
+    return;
+  }
+  int kept = 0;
+  for (int i = 0; i < n; ++i) {
+    if (kept == k && scores[i] <= scores[labels[k - 1]]) continue;
+    int slot = kept < k ? kept++ : k - 1;
+    while (slot > 0 && scores[labels[slot - 1]] < scores[i]) {
+      labels[slot] = labels[slot - 1];
+      --slot;
+    }
+    labels[slot] = i;
+  }
+}
+
+}  // namespace class_scores
+}  // namespace mediapipe
+
+#endif  // MYMEDIAPIPE_CALCULATORS_UTIL_CLASS_SCORES_H_
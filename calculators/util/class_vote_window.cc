@@ -0,0 +1,72 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myMediapipe/calculators/util/class_vote_window.h"
+
+#include <algorithm>
+
+namespace mediapipe {
+
+void ClassVoteWindow::Reset(int capacity) {
+  ring_.assign(std::max(capacity, 1), Vote());
+  head_ = 0;
+  size_ = 0;
+  std::fill(counts_.begin(), counts_.end(), 0);
+  std::fill(score_sums_.begin(), score_sums_.end(), 0.0f);
+  mode_label_ = -1;
+}
+
+void ClassVoteWindow::ExpireBefore(double time_s) {
+  while (size_ > 0 && ring_[head_].time_s < time_s) RemoveOldest();
+}
+
+void ClassVoteWindow::Add(int label, float score, double time_s) {
+  if (label < 0) return;
+  if (size_ == capacity()) RemoveOldest();
+  if (label >= static_cast<int>(counts_.size())) {
+    counts_.resize(label + 1, 0);
+    score_sums_.resize(label + 1, 0.0f);
+  }
+  ring_[(head_ + size_) % capacity()] = {label, score, time_s};
+  ++size_;
+  ++counts_[label];
+  score_sums_[label] += score;
+  if (mode_label_ < 0 || counts_[label] > counts_[mode_label_]) {
+    mode_label_ = label;
+  }
+}
+
+void ClassVoteWindow::RemoveOldest() {
+  const Vote& vote = ring_[head_];
+  head_ = (head_ + 1) % capacity();
+  --size_;
+  if (--counts_[vote.label] == 0) {
+    // Resets the sum, so float errors don't build up
+    score_sums_[vote.label] = 0.0f;
+  } else {
+    score_sums_[vote.label] -= vote.score;
+  }
+  if (vote.label != mode_label_) return;
+
+  // Only losing a vote of the mode can change it, the labels are a handful
+  // of static gestures so this stays cheap
+  mode_label_ = size_ == 0 ? -1 : vote.label;
+  for (int label = 0; label < static_cast<int>(counts_.size()); ++label) {
+    if (mode_label_ >= 0 && counts_[label] > counts_[mode_label_]) {
+      mode_label_ = label;
+    }
+  }
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,85 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_CALCULATORS_UTIL_CLASS_VOTE_WINDOW_H_
+#define MYMEDIAPIPE_CALCULATORS_UTIL_CLASS_VOTE_WINDOW_H_
+
+#include <vector>
+
+namespace mediapipe {
+
+// Last N classifications of one hand, with the count and score sum of every
+// class kept up to date as votes come in and expire, so getting the most
+// frequent class doesn't walk the window.
+//
+// On a tie the current mode is kept, a class has to outvote it to take
+// over, which is what filters single frame misclassifications.
+class ClassVoteWindow {
+ public:
+  explicit ClassVoteWindow(int capacity = 1) { Reset(capacity); }
+
+  // Empties the window and changes its capacity
+  void Reset(int capacity);
+
+  // Drops the votes taken before time_s
+  void ExpireBefore(double time_s);
+
+  // Adds a vote, dropping the oldest one when the window is full.
+  // Negative labels are ignored.
+  void Add(int label, float score, double time_s);
+
+  bool empty() const { return size_ == 0; }
+  int size() const { return size_; }
+  int capacity() const { return ring_.size(); }
+
+  // Most frequent class, -1 when empty
+  int mode_label() const { return mode_label_; }
+  int mode_count() const {
+    return mode_label_ < 0 ? 0 : counts_[mode_label_];
+  }
+  // Mean score of the votes for the mode class
+  float mode_mean_score() const {
+    return mode_label_ < 0 ? 0 : score_sums_[mode_label_] / mode_count();
+  }
+  // Share of the window voting for the mode class
+  float mode_confidence() const { return confidence(mode_label_); }
+  // Share of the window voting for label, 0 for a label never voted
+  float confidence(int label) const {
+    if (size_ == 0 || label < 0 || label >= static_cast<int>(counts_.size())) {
+      return 0;
+    }
+    return static_cast<float>(counts_[label]) / size_;
+  }
+
+ private:
+  struct Vote {
+    int label;
+    float score;
+    double time_s;
+  };
+
+  void RemoveOldest();
+
+  std::vector<Vote> ring_;
+  int head_ = 0;
+  int size_ = 0;
+  // Indexed by label, grown as new labels show up
+  std::vector<int> counts_;
+  std::vector<float> score_sums_;
+  int mode_label_ = -1;
+};
+
+}  // namespace mediapipe
+
+#endif  // MYMEDIAPIPE_CALCULATORS_UTIL_CLASS_VOTE_WINDOW_H_
@@ -12,44 +12,58 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include <memory>
+#include <vector>
 
-#include "myMediapipe/calculators/util/angles_to_detection_calculator.pb.h"
+#include "absl/memory/memory.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/formats/detection.pb.h"
-#include "tensorflow/lite/interpreter.h"
 #include "mediapipe/framework/port/ret_check.h"
+#include "myMediapipe/calculators/gestures/multi_hand.h"
+#include "myMediapipe/calculators/util/calculator_stats.h"
+#include "myMediapipe/calculators/util/class_vote_window.h"
+#include "myMediapipe/calculators/util/detection_class_stabilization_calculator.pb.h"
 
 namespace mediapipe {
 
-typedef std::vector<Detection> Detections; 
+typedef std::vector<Detection> Detections;
 
 namespace {
 
-constexpr char kDetectionTag[] = "DETECTIONS";
+constexpr char kDetectionsTag[] = "DETECTIONS";
 
 }  // namespace
 
-// This put every new detection in a FIFO of size queue_size  
-// and will return a detection with a class corresponding to the 
-// highest occcurence in the FIFO, usefull to stabilize detections
-// eliminating spureous missclasifications 
+// Stabilizes the static gesture detections, eliminating spurious
+// missclasifications before they reach the dynamic gestures calculators.
+//
+// The last window_size detections of every hand (see detection_id) vote
+// for its class. The class output is the most frequent one, with its share
+// of the votes as score. A new class has to get min_confidence of the
+// window to replace the one output before, until then the previous class
+// is kept, with its own share of the current votes as score. Votes older
+// than max_age_s are dropped.
 //
 // Input:
-//  TENSOR: A Vector of TfLiteTensor of type kTfLiteFloat32 with the confidence score
-//          for each static gesture.
+//   DETECTIONS: A vector of Detection protos, one per hand, see
+//               AnglesToDetectionCalculator.
 //
 // Output:
-//   DETECTION: A Detection proto.
+//   DETECTIONS: The same detections with the stabilized label_id and the
+//               confidence as score.
 //
 // Example config:
 // node {
-//   calculator: "AnglesToDetectionCalculator"
-//   input_stream: ""TENSORS:tensors"
+//   calculator: "DetectionClassStabilizationCalculator"
+//   input_stream: "DETECTIONS:raw_detections"
 //   output_stream: "DETECTIONS:detections"
+//   node_options: {
+//     [type.googleapis.com/mediapipe.DetectionClassStabilizationCalculatorOptions] {
+//       window_size: 10
+//       max_age_s: 1.5
+//     }
+//   }
 // }
-
-class AnglesToDetectionCalculator : public CalculatorBase {
+class DetectionClassStabilizationCalculator : public CalculatorBase {
  public:
   static ::mediapipe::Status GetContract(CalculatorContract* cc);
   ::mediapipe::Status Open(CalculatorContext* cc) override;
@@ -57,80 +71,95 @@ class AnglesToDetectionCalculator : public CalculatorBase {
   ::mediapipe::Status Process(CalculatorContext* cc) override;
 
  private:
-  ::mediapipe::AnglesToDetectionCalculatorOptions options_;
+  struct HandState {
+    ClassVoteWindow votes;
+    // Class output the last time, -1 before the first detection
+    int stable_label = -1;
+  };
+
+  HandState& Hand(int hand_id);
+
+  ::mediapipe::DetectionClassStabilizationCalculatorOptions options_;
+  std::vector<HandState> hands_;
+
+  calculator_stats::NodeStats* stats_ = nullptr;
 };
-REGISTER_CALCULATOR(AnglesToDetectionCalculator);
+REGISTER_CALCULATOR(DetectionClassStabilizationCalculator);
 
-::mediapipe::Status AnglesToDetectionCalculator::GetContract(
+::mediapipe::Status DetectionClassStabilizationCalculator::GetContract(
     CalculatorContract* cc) {
-  RET_CHECK(cc->Inputs().HasTag(kTfLiteFloat32));
-  //RET_CHECK(cc->Outputs().HasTag(kDetectionTag));
-  // TODO: Also support converting Landmark to Detection.
-  cc->Inputs()
-      .Tag(kTfLiteFloat32) 
-      .Set<std::vector<TfLiteTensor>>();
-  //cc->Outputs().Tag(kDetectionTag).Set<Detection>();
-  cc->Outputs().Index(0).Set<Detections>();
+  RET_CHECK(cc->Inputs().HasTag(kDetectionsTag));
+  RET_CHECK(cc->Outputs().HasTag(kDetectionsTag));
+  cc->Inputs().Tag(kDetectionsTag).Set<Detections>();
+  cc->Outputs().Tag(kDetectionsTag).Set<Detections>();
 
   return ::mediapipe::OkStatus();
 }
 
-::mediapipe::Status AnglesToDetectionCalculator::Open(
+::mediapipe::Status DetectionClassStabilizationCalculator::Open(
     CalculatorContext* cc) {
   cc->SetOffset(TimestampDiff(0));
+  stats_ = calculator_stats::ForNode(cc->NodeName());
 
-  //options_ = cc->Options<::mediapipe::AnglesToDetectionCalculatorOptions>();
+  options_ =
+      cc->Options<::mediapipe::DetectionClassStabilizationCalculatorOptions>();
+  RET_CHECK_GT(options_.window_size(), 0);
+  RET_CHECK_GE(options_.max_age_s(), 0);
   return ::mediapipe::OkStatus();
 }
 
-::mediapipe::Status AnglesToDetectionCalculator::Process(
+::mediapipe::Status DetectionClassStabilizationCalculator::Process(
     CalculatorContext* cc) {
-  RET_CHECK(!cc->Inputs().Tag(kTfLiteFloat32).IsEmpty());
-
-  const auto& input_tensors =
-      cc->Inputs().Tag(kTfLiteFloat32).Get<std::vector<TfLiteTensor>>();
-  // TODO: Add option to specify which tensor to take from.
-  const TfLiteTensor* raw_tensor = &input_tensors[0];
-  const float* raw_floats = raw_tensor->data.f;
-
-  
-  //std::cout  << raw_tensor->name;
-  float biggest;
-  int label_;
-  for(int i=0;i<raw_tensor->dims->data[1]; i++){
-    if(raw_floats[i]>biggest){
-        biggest=raw_floats[i];
-        label_=i;
-    }  
-    //std::cout  << "\t:" << std::to_string(raw_floats[i]);
+  calculator_stats::ScopedProcessTimer timer(stats_);
+  if (cc->Inputs().Tag(kDetectionsTag).IsEmpty()) {
+    return ::mediapipe::OkStatus();
+  }
+
+  const auto& input_detections =
+      cc->Inputs().Tag(kDetectionsTag).Get<Detections>();
+  const double now_s = cc->InputTimestamp().Seconds();
+
+  auto output_detections = absl::make_unique<Detections>(input_detections);
+  for (auto& detection : *output_detections) {
+    if (detection.label_id_size() == 0) continue;
+    const int hand_id = multi_hand::HandId(detection);
+    RET_CHECK_GE(hand_id, 0);
+    HandState& hand = Hand(hand_id);
+
+    if (options_.max_age_s() > 0) {
+      hand.votes.ExpireBefore(now_s - options_.max_age_s());
+    }
+    hand.votes.Add(detection.label_id(0),
+                   detection.score_size() > 0 ? detection.score(0) : 0,
+                   now_s);
+
+    if (hand.stable_label < 0 ||
+        hand.votes.mode_confidence() >= options_.min_confidence()) {
+      hand.stable_label = hand.votes.mode_label();
+    }
+
+    detection.set_label_id(0, hand.stable_label);
+    detection.clear_score();
+    detection.add_score(hand.votes.confidence(hand.stable_label));
   }
-  //   std::cout  << "\n";
-    
-  
-  
-  auto* output_detections = new Detections();
-  output_detections->reserve(1);
-  auto detection = absl::make_unique<Detection>();
-  detection->add_score(biggest);
-  detection->add_label_id(label_);
-  
-  LocationData location_data;
-  location_data.set_format(LocationData::BOUNDING_BOX);
-  location_data.mutable_bounding_box()->set_xmin(450);
-  location_data.mutable_bounding_box()->set_ymin(450);
-  location_data.mutable_bounding_box()->set_width(200);
-  location_data.mutable_bounding_box()->set_height(20);
-  *(detection->mutable_location_data()) = location_data;
-
-  
-  
-  output_detections->push_back(*detection);
 
   cc->Outputs()
-      .Index(0)
-      .Add(output_detections, cc->InputTimestamp());
+      .Tag(kDetectionsTag)
+      .Add(output_detections.release(), cc->InputTimestamp());
 
   return ::mediapipe::OkStatus();
 }
 
+DetectionClassStabilizationCalculator::HandState&
+DetectionClassStabilizationCalculator::Hand(int hand_id) {
+  if (hand_id >= static_cast<int>(hands_.size())) {
+    const int old_size = hands_.size();
+    hands_.resize(hand_id + 1);
+    for (int i = old_size; i < static_cast<int>(hands_.size()); ++i) {
+      hands_[i].votes.Reset(options_.window_size());
+    }
+  }
+  return hands_[hand_id];
+}
+
 }  // namespace mediapipe
@@ -0,0 +1,70 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myMediapipe/calculators/util/file_watcher.h"
+
+#include <sys/stat.h>
+
+#include <utility>
+
+#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/logging.h"
+#include "mediapipe/framework/port/status.h"
+
+namespace mediapipe {
+
+FileWatcher::FileWatcher(const std::string& path, absl::Duration interval,
+                         Callback on_change)
+    : path_(path), interval_(interval), on_change_(std::move(on_change)) {
+  Stat(&version_);
+  thread_ = std::thread([this] { Loop(); });
+}
+
+FileWatcher::~FileWatcher() {
+  {
+    absl::MutexLock lock(&mutex_);
+    stop_ = true;
+  }
+  thread_.join();
+}
+
+bool FileWatcher::Stat(Version* version) const {
+  struct stat info;
+  if (stat(path_.c_str(), &info) != 0) return false;
+  version->mtime_ns =
+      static_cast<int64>(info.st_mtim.tv_sec) * 1000000000 +
+      info.st_mtim.tv_nsec;
+  version->size = info.st_size;
+  version->inode = info.st_ino;
+  return true;
+}
+
+void FileWatcher::Loop() {
+  absl::MutexLock lock(&mutex_);
+  while (!mutex_.AwaitWithTimeout(absl::Condition(&stop_), interval_)) {
+    Version version;
+    if (!Stat(&version) || version == version_) continue;
+    version_ = version;
+
+    std::string contents;
+    ::mediapipe::Status status = file::GetContents(path_, &contents);
+    if (!status.ok()) {
+      LOG(ERROR) << "Can't read " << path_ << ": " << status.message();
+      continue;
+    }
+    on_change_(contents);
+  }
+}
+
+}  // namespace mediapipe
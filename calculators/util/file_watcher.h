@@ -0,0 +1,75 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_CALCULATORS_UTIL_FILE_WATCHER_H_
+#define MYMEDIAPIPE_CALCULATORS_UTIL_FILE_WATCHER_H_
+
+#include <functional>
+#include <string>
+#include <thread>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+
+// Polls a file from its own thread and hands its contents to a callback
+// whenever it changes: modification time, size or inode, so files
+// replaced by a rename, as most editors save them, are seen too. The file
+// as it is at construction is not reported. A missing file is skipped
+// until it shows up again.
+//
+// Example:
+//   FileWatcher watcher(path, absl::Seconds(1),
+//                       [](const std::string& contents) { ... });
+class FileWatcher {
+ public:
+  typedef std::function<void(const std::string& contents)> Callback;
+
+  FileWatcher(const std::string& path, absl::Duration interval,
+              Callback on_change);
+  // Stops the thread, on_change is not called after it returns
+  ~FileWatcher();
+
+  FileWatcher(const FileWatcher&) = delete;
+  FileWatcher& operator=(const FileWatcher&) = delete;
+
+ private:
+  struct Version {
+    int64 mtime_ns = -1;
+    int64 size = -1;
+    uint64 inode = 0;
+    bool operator==(const Version& other) const {
+      return mtime_ns == other.mtime_ns && size == other.size &&
+             inode == other.inode;
+    }
+  };
+
+  // False when the file can't be stat'ed
+  bool Stat(Version* version) const;
+  void Loop();
+
+  const std::string path_;
+  const absl::Duration interval_;
+  const Callback on_change_;
+  Version version_;
+  absl::Mutex mutex_;
+  bool stop_ GUARDED_BY(mutex_) = false;
+  std::thread thread_;
+};
+
+}  // namespace mediapipe
+
+#endif  // MYMEDIAPIPE_CALCULATORS_UTIL_FILE_WATCHER_H_
@@ -0,0 +1,224 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myMediapipe/calculators/util/hand_angles.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define HAND_ANGLES_USE_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HAND_ANGLES_USE_NEON
+#endif
+
+namespace mediapipe {
+namespace hand_angles {
+
+namespace {
+
+constexpr float kPi = 3.14159265358979f;
+constexpr float kHalfPi = 1.57079632679490f;
+constexpr float kTwoPi = 6.28318530717959f;
+
+// Minimax coefficients of atan(z) = z * P(z^2) on [0,1], the absolute
+// error of this polynomial is below 1.7e-6 rad.
+constexpr float kAtan0 = 0.99997726f;
+constexpr float kAtan1 = -0.33262347f;
+constexpr float kAtan2 = 0.19354346f;
+constexpr float kAtan3 = -0.11643287f;
+constexpr float kAtan4 = 0.05265332f;
+constexpr float kAtan5 = -0.01172120f;
+
+// Line vectors of every lane, gathered from the landmarks so the kernel
+// works on contiguous memory. The palm angle takes the last used lane,
+// padding lanes have zero vectors and their result is discarded.
+struct KernelInput {
+  alignas(16) float dx1[kNumKernelLanes];
+  alignas(16) float dy1[kNumKernelLanes];
+  alignas(16) float dx2[kNumKernelLanes];
+  alignas(16) float dy2[kNumKernelLanes];
+  alignas(16) float sign[kNumKernelLanes];
+};
+
+inline float FastAtan2(float y, float x) {
+  const float ax = std::fabs(x);
+  const float ay = std::fabs(y);
+  const float mx = ax > ay ? ax : ay;
+  const float mn = ax > ay ? ay : ax;
+  const float z = mx > 0 ? mn / mx : 0;
+  const float z2 = z * z;
+  float r = ((((kAtan5 * z2 + kAtan4) * z2 + kAtan3) * z2 + kAtan2) * z2 +
+             kAtan1) * z2 + kAtan0;
+  r *= z;
+  if (ay > ax) r = kHalfPi - r;
+  if (x < 0) r = kPi - r;
+  if (y < 0) r = -r;
+  return r;
+}
+
+inline float FastNormalizeRadians(float angle) {
+  // The difference of two atan2 is within (-2PI,2PI], one wrap is enough
+  if (angle >= kPi) return angle - kTwoPi;
+  if (angle < -kPi) return angle + kTwoPi;
+  return angle;
+}
+
+#if defined(HAND_ANGLES_USE_SSE)
+
+inline __m128 Select(__m128 mask, __m128 a, __m128 b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+inline __m128 FastAtan2(__m128 y, __m128 x) {
+  const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  const __m128 sign_mask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 ax = _mm_and_ps(x, abs_mask);
+  const __m128 ay = _mm_and_ps(y, abs_mask);
+  const __m128 mx = _mm_max_ps(ax, ay);
+  const __m128 mn = _mm_min_ps(ax, ay);
+  const __m128 valid = _mm_cmpgt_ps(mx, zero);
+  const __m128 z = _mm_and_ps(valid, _mm_div_ps(mn, _mm_or_ps(
+                                         mx, _mm_andnot_ps(valid,
+                                                           _mm_set1_ps(1)))));
+  const __m128 z2 = _mm_mul_ps(z, z);
+  __m128 r = _mm_set1_ps(kAtan5);
+  r = _mm_add_ps(_mm_mul_ps(r, z2), _mm_set1_ps(kAtan4));
+  r = _mm_add_ps(_mm_mul_ps(r, z2), _mm_set1_ps(kAtan3));
+  r = _mm_add_ps(_mm_mul_ps(r, z2), _mm_set1_ps(kAtan2));
+  r = _mm_add_ps(_mm_mul_ps(r, z2), _mm_set1_ps(kAtan1));
+  r = _mm_add_ps(_mm_mul_ps(r, z2), _mm_set1_ps(kAtan0));
+  r = _mm_mul_ps(r, z);
+  r = Select(_mm_cmpgt_ps(ay, ax), _mm_sub_ps(_mm_set1_ps(kHalfPi), r), r);
+  r = Select(_mm_cmplt_ps(x, zero), _mm_sub_ps(_mm_set1_ps(kPi), r), r);
+  return _mm_or_ps(r, _mm_and_ps(_mm_cmplt_ps(y, zero), sign_mask));
+}
+
+void RunKernel(const KernelInput& in, float* out) {
+  const __m128 pi = _mm_set1_ps(kPi);
+  const __m128 minus_pi = _mm_set1_ps(-kPi);
+  const __m128 two_pi = _mm_set1_ps(kTwoPi);
+  for (int i = 0; i < kNumKernelLanes; i += 4) {
+    const __m128 a1 = FastAtan2(_mm_load_ps(in.dy1 + i), _mm_load_ps(in.dx1 + i));
+    const __m128 a2 = FastAtan2(_mm_load_ps(in.dy2 + i), _mm_load_ps(in.dx2 + i));
+    __m128 d = _mm_mul_ps(_mm_sub_ps(a1, a2), _mm_load_ps(in.sign + i));
+    d = _mm_sub_ps(d, _mm_and_ps(_mm_cmpge_ps(d, pi), two_pi));
+    d = _mm_add_ps(d, _mm_and_ps(_mm_cmplt_ps(d, minus_pi), two_pi));
+    _mm_store_ps(out + i, d);
+  }
+}
+
+#elif defined(HAND_ANGLES_USE_NEON)
+
+inline float32x4_t Divide(float32x4_t a, float32x4_t b) {
+#if defined(__aarch64__)
+  return vdivq_f32(a, b);
+#else
+  // Two Newton-Raphson steps on the reciprocal estimate
+  float32x4_t inv = vrecpeq_f32(b);
+  inv = vmulq_f32(vrecpsq_f32(b, inv), inv);
+  inv = vmulq_f32(vrecpsq_f32(b, inv), inv);
+  return vmulq_f32(a, inv);
+#endif
+}
+
+inline float32x4_t FastAtan2(float32x4_t y, float32x4_t x) {
+  const float32x4_t zero = vdupq_n_f32(0);
+  const float32x4_t ax = vabsq_f32(x);
+  const float32x4_t ay = vabsq_f32(y);
+  const float32x4_t mx = vmaxq_f32(ax, ay);
+  const float32x4_t mn = vminq_f32(ax, ay);
+  const uint32x4_t valid = vcgtq_f32(mx, zero);
+  const float32x4_t z =
+      vbslq_f32(valid, Divide(mn, vbslq_f32(valid, mx, vdupq_n_f32(1))), zero);
+  const float32x4_t z2 = vmulq_f32(z, z);
+  float32x4_t r = vdupq_n_f32(kAtan5);
+  r = vmlaq_f32(vdupq_n_f32(kAtan4), r, z2);
+  r = vmlaq_f32(vdupq_n_f32(kAtan3), r, z2);
+  r = vmlaq_f32(vdupq_n_f32(kAtan2), r, z2);
+  r = vmlaq_f32(vdupq_n_f32(kAtan1), r, z2);
+  r = vmlaq_f32(vdupq_n_f32(kAtan0), r, z2);
+  r = vmulq_f32(r, z);
+  r = vbslq_f32(vcgtq_f32(ay, ax), vsubq_f32(vdupq_n_f32(kHalfPi), r), r);
+  r = vbslq_f32(vcltq_f32(x, zero), vsubq_f32(vdupq_n_f32(kPi), r), r);
+  return vbslq_f32(vcltq_f32(y, zero), vnegq_f32(r), r);
+}
+
+void RunKernel(const KernelInput& in, float* out) {
+  const float32x4_t pi = vdupq_n_f32(kPi);
+  const float32x4_t minus_pi = vdupq_n_f32(-kPi);
+  const float32x4_t two_pi = vdupq_n_f32(kTwoPi);
+  for (int i = 0; i < kNumKernelLanes; i += 4) {
+    const float32x4_t a1 =
+        FastAtan2(vld1q_f32(in.dy1 + i), vld1q_f32(in.dx1 + i));
+    const float32x4_t a2 =
+        FastAtan2(vld1q_f32(in.dy2 + i), vld1q_f32(in.dx2 + i));
+    float32x4_t d = vmulq_f32(vsubq_f32(a1, a2), vld1q_f32(in.sign + i));
+    d = vbslq_f32(vcgeq_f32(d, pi), vsubq_f32(d, two_pi), d);
+    d = vbslq_f32(vcltq_f32(d, minus_pi), vaddq_f32(d, two_pi), d);
+    vst1q_f32(out + i, d);
+  }
+}
+
+#else
+
+void RunKernel(const KernelInput& in, float* out) {
+  for (int i = 0; i < kNumKernelLanes; ++i) {
+    const float a1 = FastAtan2(in.dy1[i], in.dx1[i]);
+    const float a2 = FastAtan2(in.dy2[i], in.dx2[i]);
+    out[i] = FastNormalizeRadians((a1 - a2) * in.sign[i]);
+  }
+}
+
+#endif
+
+}  // namespace
+
+void ComputeFeatures(const float* x, const float* y, float* features) {
+  // this only works if palm is facing the camera,
+  // TODO: add palm/back dettection
+  const float sign = (x[5] > x[17]) ? -1.0f : 1.0f;
+
+  KernelInput in;
+  for (int i = 0; i < kNumJointTriples; ++i) {
+    const JointTriple& triple = kJointTriples[i];
+    in.dx1[i] = x[triple.joint] - x[triple.first];
+    in.dy1[i] = y[triple.joint] - y[triple.first];
+    in.dx2[i] = x[triple.joint] - x[triple.second];
+    in.dy2[i] = y[triple.joint] - y[triple.second];
+    in.sign[i] = sign;
+  }
+  // Palm angle, against the horizontal line through landmark 0 and never
+  // mirrored for right hands
+  in.dx1[kNumJointTriples] = x[0] - x[9];
+  in.dy1[kNumJointTriples] = y[0] - y[9];
+  in.dx2[kNumJointTriples] = x[0];
+  in.dy2[kNumJointTriples] = 0;
+  in.sign[kNumJointTriples] = 1.0f;
+  for (int i = kNumJointTriples + 1; i < kNumKernelLanes; ++i) {
+    in.dx1[i] = in.dy1[i] = in.dx2[i] = in.dy2[i] = in.sign[i] = 0;
+  }
+
+  alignas(16) float angles[kNumKernelLanes];
+  RunKernel(in, angles);
+
+  for (int id = 0; id < kNumFeatures; ++id) features[id] = 0;
+  for (int i = 0; i < kNumJointTriples; ++i) {
+    features[kJointTriples[i].feature] = angles[i];
+  }
+  features[0] = angles[kNumJointTriples];
+}
+
+}  // namespace hand_angles
+}  // namespace mediapipe
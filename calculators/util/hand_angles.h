@@ -0,0 +1,112 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_CALCULATORS_UTIL_HAND_ANGLES_H_
+#define MYMEDIAPIPE_CALCULATORS_UTIL_HAND_ANGLES_H_
+
+#include <cmath>
+
+namespace mediapipe {
+namespace hand_angles {
+
+constexpr int kNumLandmarks = 21;
+// angle1 and angle2, see angles.proto
+constexpr int kAnglesPerLandmark = 2;
+// Size of the feature vector fed to the static gestures classifier
+constexpr int kNumFeatures = kNumLandmarks * kAnglesPerLandmark;
+
+// Wraps around an angle in radians to within -M_PI and M_PI.
+inline float NormalizeRadians(float angle) {
+  return angle - 2 * M_PI * std::floor((angle - (-M_PI)) / (2 * M_PI));
+}
+
+// Angle at vertex (x0,y0) between the lines going to (x1,y1) and (x2,y2)
+inline float AngleBetweenLines(float x0, float y0, float x1, float y1,
+                               float x2, float y2, bool right_hand) {
+  const float angle1 = std::atan2((y0 - y1), x0 - x1);
+  const float angle2 = std::atan2((y0 - y2), x0 - x2);
+  if (right_hand) return NormalizeRadians(angle2 - angle1);
+  return NormalizeRadians(angle1 - angle2);
+}
+
+// Joint angle: the angle at landmark `joint` between the lines going to
+// landmarks `first` and `second`, stored at features[feature].
+struct JointTriple {
+  int joint;
+  int first;
+  int second;
+  int feature;
+};
+
+// Every angle LandmarksToAnglesCalculator computes except the palm one,
+// which measures against the horizontal and is handled on its own.
+constexpr JointTriple kJointTriples[] = {
+    // Pip Dip angles, stored as angle1
+    {2, 3, 1, 4},
+    {3, 4, 2, 6},
+    {6, 7, 5, 12},
+    {7, 8, 6, 14},
+    {10, 11, 9, 20},
+    {11, 12, 10, 22},
+    {14, 15, 13, 28},
+    {15, 16, 14, 30},
+    {18, 19, 17, 36},
+    {19, 20, 18, 38},
+    // MCP angles, angles between fingers, stored as angle2
+    {1, 8, 4, 3},
+    {5, 12, 8, 11},
+    {9, 16, 12, 19},
+    {13, 20, 16, 27},
+};
+constexpr int kNumJointTriples =
+    sizeof(kJointTriples) / sizeof(kJointTriples[0]);
+// Joint angles plus the palm one, padded to whole SIMD registers of 4 lanes
+constexpr int kNumKernelLanes = ((kNumJointTriples + 1 + 3) / 4) * 4;
+
+// Computes the angle features of one hand straight from the landmark
+// coordinates, x and y must hold kNumLandmarks values and features
+// kNumFeatures, laid out as the classifier expects them:
+//   [angle1(LM0), angle2(LM0), angle1(LM1), angle2(LM1), ...]
+// Values are the ones LandmarksToAnglesCalculator stores in the Angle
+// protos, joints without an angle are set to 0.
+//
+// All angles are computed in one pass with SSE or NEON when available,
+// and with a scalar loop otherwise. atan2 is replaced by a polynomial
+// approximation whose error is below 2e-6 rad, so every feature is within
+// 5e-6 rad of ComputeFeaturesReference.
+void ComputeFeatures(const float* x, const float* y, float* features);
+
+// Straightforward version of ComputeFeatures using std::atan2, matches the
+// output of the original LandmarksToAnglesCalculator.
+inline void ComputeFeaturesReference(const float* x, const float* y,
+                                     float* features) {
+  // this only works if palm is facing the camera,
+  // TODO: add palm/back dettection
+  const bool right_hand = (x[5] > x[17]);
+
+  for (int id = 0; id < kNumFeatures; ++id) features[id] = 0;
+
+  for (const auto& triple : kJointTriples) {
+    features[triple.feature] = AngleBetweenLines(
+        x[triple.joint], y[triple.joint], x[triple.first], y[triple.first],
+        x[triple.second], y[triple.second], right_hand);
+  }
+  // Palm angle
+  features[0] = AngleBetweenLines(x[0], y[0], x[9], y[9], 0, y[0], false);
+}
+
+}  // namespace hand_angles
+}  // namespace mediapipe
+
+#endif  // MYMEDIAPIPE_CALCULATORS_UTIL_HAND_ANGLES_H_
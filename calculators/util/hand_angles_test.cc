@@ -0,0 +1,107 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myMediapipe/calculators/util/hand_angles.h"
+
+#include <cmath>
+#include <random>
+
+#include "mediapipe/framework/port/gtest.h"
+
+namespace mediapipe {
+namespace hand_angles {
+namespace {
+
+// Documented bound of ComputeFeatures against the reference
+constexpr float kMaxErrorRad = 5e-6f;
+
+// Angles near +-M_PI may come out on either side of the wrap, so the
+// error is the distance on the circle.
+float AngleError(float a, float b) {
+  return std::fabs(NormalizeRadians(a - b));
+}
+
+void ExpectMatchesReference(const float* x, const float* y) {
+  float features[kNumFeatures];
+  float reference[kNumFeatures];
+  ComputeFeatures(x, y, features);
+  ComputeFeaturesReference(x, y, reference);
+  for (int i = 0; i < kNumFeatures; ++i) {
+    EXPECT_LE(AngleError(features[i], reference[i]), kMaxErrorRad)
+        << "feature " << i << ": " << features[i] << " vs " << reference[i];
+  }
+}
+
+TEST(HandAnglesTest, MatchesReferenceOnRandomLandmarks) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> coordinate(0.f, 1.f);
+  float x[kNumLandmarks];
+  float y[kNumLandmarks];
+  for (int hand = 0; hand < 10000; ++hand) {
+    for (int i = 0; i < kNumLandmarks; ++i) {
+      x[i] = coordinate(rng);
+      y[i] = coordinate(rng);
+    }
+    ExpectMatchesReference(x, y);
+  }
+}
+
+TEST(HandAnglesTest, MatchesReferenceOnCoincidentLandmarks) {
+  float x[kNumLandmarks];
+  float y[kNumLandmarks];
+  for (float value : {0.f, 0.5f, 1.f}) {
+    for (int i = 0; i < kNumLandmarks; ++i) {
+      x[i] = value;
+      y[i] = value;
+    }
+    ExpectMatchesReference(x, y);
+  }
+}
+
+TEST(HandAnglesTest, MatchesReferenceOnAxisAlignedLandmarks) {
+  float x[kNumLandmarks];
+  float y[kNumLandmarks];
+  // All on a vertical line, then on a horizontal one: every line vector
+  // has a zero component and the angles sit on multiples of M_PI / 2
+  for (int i = 0; i < kNumLandmarks; ++i) {
+    x[i] = 0.5f;
+    y[i] = i / static_cast<float>(kNumLandmarks);
+  }
+  ExpectMatchesReference(x, y);
+  for (int i = 0; i < kNumLandmarks; ++i) {
+    x[i] = i / static_cast<float>(kNumLandmarks);
+    y[i] = 0.5f;
+  }
+  ExpectMatchesReference(x, y);
+}
+
+TEST(HandAnglesTest, MatchesReferenceOnRepeatedPoints) {
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> grid(0, 2);
+  float x[kNumLandmarks];
+  float y[kNumLandmarks];
+  // Few distinct points, so many joints share a position with one of
+  // their neighbours and lines of zero length are common
+  for (int hand = 0; hand < 1000; ++hand) {
+    for (int i = 0; i < kNumLandmarks; ++i) {
+      x[i] = grid(rng) * 0.5f;
+      y[i] = grid(rng) * 0.5f;
+    }
+    ExpectMatchesReference(x, y);
+  }
+}
+
+}  // namespace
+}  // namespace hand_angles
+}  // namespace mediapipe
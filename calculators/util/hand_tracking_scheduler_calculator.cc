@@ -0,0 +1,202 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/rect.pb.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "myMediapipe/calculators/util/hand_tracking_scheduler_calculator.pb.h"
+
+namespace mediapipe {
+
+namespace {
+
+constexpr char kImageTag[] = "IMAGE";
+constexpr char kPresenceTag[] = "PRESENCE";
+constexpr char kNormRectTag[] = "NORM_RECT";
+constexpr char kAllowDetectionTag[] = "ALLOW_DETECTION";
+
+}  // namespace
+
+// Decides, for every frame, whether palm detection runs and which ROI the
+// landmark model gets otherwise.
+//
+// - Hand present in the previous frame: no detection, the ROI is the one
+//   computed from the previous landmarks, as in the default graph.
+// - Hand just lost: for max_predicted_frames the ROI is moved along the
+//   recent motion of the hand and enlarged, so a fast hand is usually
+//   found again without detection.
+// - No hand: palm detection runs right after the predictions and then
+//   once every idle_detection_interval frames. In between, the landmark
+//   model keeps checking the last ROI where a hand was seen.
+//
+// Input:
+//   IMAGE: the frames going into the graph, only used as the clock.
+//   PRESENCE: hand presence of the previous frame (from a
+//     PreviousLoopbackCalculator). Empty on the first frame.
+//   NORM_RECT: NormalizedRect computed from the landmarks of the previous
+//     frame (from a PreviousLoopbackCalculator). Empty on the first frame.
+//
+// Output:
+//   ALLOW_DETECTION: bool for the GateCalculator of the palm detection.
+//   NORM_RECT: ROI to merge with the palm detection rect, the latter has
+//     priority when the detection runs.
+//
+// Example config:
+// node {
+//   calculator: "HandTrackingSchedulerCalculator"
+//   input_stream: "IMAGE:throttled_input_video"
+//   input_stream: "PRESENCE:prev_hand_presence"
+//   input_stream: "NORM_RECT:prev_hand_rect_from_landmarks"
+//   output_stream: "ALLOW_DETECTION:allow_hand_detection"
+//   output_stream: "NORM_RECT:tracked_hand_rect"
+//   options: {
+//     [mediapipe.HandTrackingSchedulerCalculatorOptions.ext] {
+//       max_predicted_frames: 2
+//       idle_detection_interval: 5
+//     }
+//   }
+// }
+class HandTrackingSchedulerCalculator : public CalculatorBase {
+ public:
+  static ::mediapipe::Status GetContract(CalculatorContract* cc);
+  ::mediapipe::Status Open(CalculatorContext* cc) override;
+  ::mediapipe::Status Process(CalculatorContext* cc) override;
+
+ private:
+  // ROI of the last tracked hand moved by its velocity
+  NormalizedRect PredictRect(Timestamp timestamp) const;
+
+  HandTrackingSchedulerCalculatorOptions options_;
+  // Last two ROIs of a present hand, for the velocity
+  NormalizedRect last_rect_;
+  NormalizedRect previous_rect_;
+  Timestamp last_rect_timestamp_ = Timestamp::Unset();
+  Timestamp previous_rect_timestamp_ = Timestamp::Unset();
+  // Frames since the hand was lost, 0 while it's present
+  int frames_without_hand_ = 0;
+
+  Counter* detections_counter_ = nullptr;
+  Counter* predictions_counter_ = nullptr;
+};
+REGISTER_CALCULATOR(HandTrackingSchedulerCalculator);
+
+::mediapipe::Status HandTrackingSchedulerCalculator::GetContract(
+    CalculatorContract* cc) {
+  RET_CHECK(cc->Inputs().HasTag(kImageTag));
+  RET_CHECK(cc->Inputs().HasTag(kPresenceTag));
+  RET_CHECK(cc->Inputs().HasTag(kNormRectTag));
+  RET_CHECK(cc->Outputs().HasTag(kAllowDetectionTag));
+  RET_CHECK(cc->Outputs().HasTag(kNormRectTag));
+
+  cc->Inputs().Tag(kImageTag).SetAny();
+  cc->Inputs().Tag(kPresenceTag).Set<bool>();
+  cc->Inputs().Tag(kNormRectTag).Set<NormalizedRect>();
+  cc->Outputs().Tag(kAllowDetectionTag).Set<bool>();
+  cc->Outputs().Tag(kNormRectTag).Set<NormalizedRect>();
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status HandTrackingSchedulerCalculator::Open(
+    CalculatorContext* cc) {
+  cc->SetOffset(TimestampDiff(0));
+  options_ = cc->Options<HandTrackingSchedulerCalculatorOptions>();
+  RET_CHECK_GE(options_.max_predicted_frames(), 0);
+  RET_CHECK_GE(options_.idle_detection_interval(), 1);
+
+  detections_counter_ = cc->GetCounter(cc->NodeName() + "_detections");
+  predictions_counter_ = cc->GetCounter(cc->NodeName() + "_predicted_rois");
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status HandTrackingSchedulerCalculator::Process(
+    CalculatorContext* cc) {
+  const auto& presence_stream = cc->Inputs().Tag(kPresenceTag);
+  const auto& rect_stream = cc->Inputs().Tag(kNormRectTag);
+  const bool hand_present =
+      !presence_stream.IsEmpty() && presence_stream.Get<bool>();
+
+  bool allow_detection = false;
+  const NormalizedRect* rect =
+      rect_stream.IsEmpty() ? nullptr : &rect_stream.Get<NormalizedRect>();
+  NormalizedRect predicted_rect;
+
+  if (hand_present && rect) {
+    if (frames_without_hand_ > 0) {
+      // Tracking again, the motion before the loss is stale
+      last_rect_timestamp_ = Timestamp::Unset();
+    }
+    frames_without_hand_ = 0;
+    previous_rect_ = last_rect_;
+    previous_rect_timestamp_ = last_rect_timestamp_;
+    last_rect_ = *rect;
+    last_rect_timestamp_ = cc->InputTimestamp();
+  } else if (presence_stream.IsEmpty()) {
+    // First frame, nothing to track yet
+    allow_detection = true;
+  } else {
+    ++frames_without_hand_;
+    const int idle_frames =
+        frames_without_hand_ - options_.max_predicted_frames() - 1;
+    if (idle_frames < 0 && last_rect_timestamp_ != Timestamp::Unset()) {
+      predicted_rect = PredictRect(cc->InputTimestamp());
+      rect = &predicted_rect;
+      predictions_counter_->Increment();
+    } else {
+      allow_detection =
+          idle_frames < 0 ||
+          idle_frames % options_.idle_detection_interval() == 0;
+      // The landmarks of a frame without hand are noise, look where the
+      // hand was instead
+      if (last_rect_timestamp_ != Timestamp::Unset()) rect = &last_rect_;
+    }
+  }
+
+  if (allow_detection) detections_counter_->Increment();
+  cc->Outputs()
+      .Tag(kAllowDetectionTag)
+      .AddPacket(MakePacket<bool>(allow_detection).At(cc->InputTimestamp()));
+  if (rect) {
+    cc->Outputs()
+        .Tag(kNormRectTag)
+        .AddPacket(MakePacket<NormalizedRect>(*rect).At(cc->InputTimestamp()));
+  }
+  return ::mediapipe::OkStatus();
+}
+
+NormalizedRect HandTrackingSchedulerCalculator::PredictRect(
+    Timestamp timestamp) const {
+  NormalizedRect predicted = last_rect_;
+  if (previous_rect_timestamp_ != Timestamp::Unset() &&
+      last_rect_timestamp_ > previous_rect_timestamp_) {
+    // Extrapolates the center with the velocity of the last two frames
+    const double ratio =
+        static_cast<double>((timestamp - last_rect_timestamp_).Value()) /
+        (last_rect_timestamp_ - previous_rect_timestamp_).Value();
+    const float x = last_rect_.x_center() +
+                    ratio * (last_rect_.x_center() - previous_rect_.x_center());
+    const float y = last_rect_.y_center() +
+                    ratio * (last_rect_.y_center() - previous_rect_.y_center());
+    predicted.set_x_center(std::min(1.0f, std::max(0.0f, x)));
+    predicted.set_y_center(std::min(1.0f, std::max(0.0f, y)));
+  }
+  const float scale =
+      1.0f + options_.predicted_roi_expansion() * frames_without_hand_;
+  predicted.set_width(last_rect_.width() * scale);
+  predicted.set_height(last_rect_.height() * scale);
+  return predicted;
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,147 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myMediapipe/calculators/util/landmark_recorder.h"
+
+#include <cstring>
+#include <utility>
+
+#include "mediapipe/framework/port/ret_check.h"
+
+namespace mediapipe {
+namespace landmark_recorder {
+
+RecordWriter::~RecordWriter() { Close().IgnoreError(); }
+
+::mediapipe::Status RecordWriter::Open(const std::string& path,
+                                       int records_per_buffer) {
+  RET_CHECK(!file_) << "Already open";
+  RET_CHECK_GT(records_per_buffer, 0);
+  file_ = std::fopen(path.c_str(), "wb");
+  RET_CHECK(file_) << "Can't create " << path;
+
+  FileHeader header;
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.record_size = sizeof(Record);
+  if (std::fwrite(&header, sizeof(header), 1, file_) != 1) {
+    // No writer thread yet, Close would have nothing to join
+    std::fclose(file_);
+    file_ = nullptr;
+    RET_CHECK_FAIL() << "Can't write " << path;
+  }
+
+  records_per_buffer_ = records_per_buffer;
+  {
+    absl::MutexLock lock(&mutex_);
+    active_.reserve(records_per_buffer_);
+    closing_ = false;
+  }
+  full_.reserve(records_per_buffer_);
+  writer_thread_ = std::thread([this]() { WriterLoop(); });
+  return ::mediapipe::OkStatus();
+}
+
+bool RecordWriter::Append(const Record& record) {
+  absl::MutexLock lock(&mutex_);
+  if (active_.size() == records_per_buffer_) {
+    if (full_ready_) {
+      ++dropped_;
+      return false;
+    }
+    std::swap(active_, full_);
+    active_.clear();
+    full_ready_ = true;
+  }
+  active_.push_back(record);
+  return true;
+}
+
+::mediapipe::Status RecordWriter::Close() {
+  if (!file_) return ::mediapipe::OkStatus();
+  {
+    absl::MutexLock lock(&mutex_);
+    closing_ = true;
+  }
+  if (writer_thread_.joinable()) writer_thread_.join();
+
+  // The writer is gone, what is left in active_ is written from here
+  bool failed;
+  {
+    absl::MutexLock lock(&mutex_);
+    std::swap(active_, full_);
+    active_.clear();
+    failed = write_failed_;
+  }
+  failed |= !WriteFull();
+  failed |= std::fclose(file_) != 0;
+  file_ = nullptr;
+  RET_CHECK(!failed) << "Failed to write the recording";
+  return ::mediapipe::OkStatus();
+}
+
+int64 RecordWriter::dropped() {
+  absl::MutexLock lock(&mutex_);
+  return dropped_;
+}
+
+void RecordWriter::WriterLoop() {
+  while (true) {
+    {
+      absl::MutexLock lock(&mutex_);
+      mutex_.Await(absl::Condition(
+          +[](RecordWriter* writer) {
+            return writer->full_ready_ || writer->closing_;
+          },
+          this));
+      if (!full_ready_) return;
+    }
+    const bool written = WriteFull();
+    absl::MutexLock lock(&mutex_);
+    write_failed_ |= !written;
+    full_ready_ = false;
+  }
+}
+
+bool RecordWriter::WriteFull() {
+  const bool written =
+      full_.empty() ||
+      std::fwrite(full_.data(), sizeof(Record), full_.size(), file_) ==
+          full_.size();
+  full_.clear();
+  return written;
+}
+
+::mediapipe::Status ReadRecords(const std::string& path,
+                                std::vector<Record>* records) {
+  std::FILE* file = std::fopen(path.c_str(), "rb");
+  RET_CHECK(file) << "Can't open " << path;
+  FileHeader header;
+  const bool has_header = std::fread(&header, sizeof(header), 1, file) == 1;
+  bool valid = has_header &&
+               std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+               header.version == kVersion &&
+               header.record_size == sizeof(Record);
+  Record record;
+  while (valid && std::fread(&record, sizeof(record), 1, file) == 1) {
+    records->push_back(record);
+  }
+  std::fclose(file);
+  RET_CHECK(valid) << path << " is not a landmark recording of version "
+                   << kVersion;
+  return ::mediapipe::OkStatus();
+}
+
+}  // namespace landmark_recorder
+}  // namespace mediapipe
@@ -0,0 +1,106 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_CALCULATORS_UTIL_LANDMARK_RECORDER_H_
+#define MYMEDIAPIPE_CALCULATORS_UTIL_LANDMARK_RECORDER_H_
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/status.h"
+
+namespace mediapipe {
+namespace landmark_recorder {
+
+constexpr int kNumLandmarks = 21;
+
+// One frame of a recording. Files are a FileHeader followed by an array of
+// records, in the byte order of the machine that recorded them.
+struct Record {
+  int64 timestamp_us;
+  // Gesture being recorded, the third column of labels.csv
+  int32 label;
+  int32 reserved;
+  // x, y of every landmark
+  float xy[kNumLandmarks][2];
+  // angle1, angle2 of every landmark, see angles.proto
+  float angles[kNumLandmarks][2];
+};
+static_assert(sizeof(Record) == 16 + 2 * kNumLandmarks * 2 * sizeof(float),
+              "Record must not have padding");
+
+struct FileHeader {
+  char magic[8];
+  uint32 version;
+  uint32 record_size;
+};
+
+constexpr char kMagic[8] = {'M', 'M', 'P', 'L', 'R', 'E', 'C', '\0'};
+constexpr uint32 kVersion = 1;
+
+// Double buffered writer of a recording.
+//
+// Append copies the record into the active buffer, when it's full the
+// buffers are swapped and a background thread writes the full one, so the
+// graph thread never waits for the disk. If the disk is so slow that both
+// buffers are full, records are dropped and counted.
+class RecordWriter {
+ public:
+  RecordWriter() = default;
+  ~RecordWriter();
+  RecordWriter(const RecordWriter&) = delete;
+  RecordWriter& operator=(const RecordWriter&) = delete;
+
+  // Creates the file and starts the writer thread
+  ::mediapipe::Status Open(const std::string& path, int records_per_buffer);
+
+  // Returns false if the record was dropped
+  bool Append(const Record& record);
+
+  // Writes the buffered records, stops the thread and closes the file.
+  // Returns the first write error, if any.
+  ::mediapipe::Status Close();
+
+  int64 dropped();
+
+ private:
+  void WriterLoop();
+  bool WriteFull();
+
+  std::FILE* file_ = nullptr;
+  size_t records_per_buffer_ = 0;
+  std::thread writer_thread_;
+
+  absl::Mutex mutex_;
+  std::vector<Record> active_ GUARDED_BY(mutex_);
+  // Owned by the writer thread while full_ready_ is set
+  std::vector<Record> full_;
+  bool full_ready_ GUARDED_BY(mutex_) = false;
+  bool closing_ GUARDED_BY(mutex_) = false;
+  bool write_failed_ GUARDED_BY(mutex_) = false;
+  int64 dropped_ GUARDED_BY(mutex_) = 0;
+};
+
+// Reads a whole recording, checking it was written by this version
+::mediapipe::Status ReadRecords(const std::string& path,
+                                std::vector<Record>* records);
+
+}  // namespace landmark_recorder
+}  // namespace mediapipe
+
+#endif  // MYMEDIAPIPE_CALCULATORS_UTIL_LANDMARK_RECORDER_H_
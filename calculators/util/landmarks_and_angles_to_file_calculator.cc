@@ -14,6 +14,7 @@
 
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
 #include "myMediapipe/calculators/util/landmarks_and_angles_to_file_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
@@ -21,6 +22,7 @@
 #include "mediapipe/framework/formats/landmark.pb.h"
 #include "myMediapipe/framework/formats/angles.pb.h"
 #include "mediapipe/framework/port/ret_check.h"
+#include "myMediapipe/calculators/util/landmark_recorder.h"
 #include "ncurses.h"
 #include <fstream>
 
@@ -39,6 +41,9 @@ constexpr char kAngleDataTag[] = "ANGLES";
 
 // Writes Landmarks and Angles to a CSV file with the intention to generate data_ 
 // to train a model to recognize static gestures.
+// With format: BINARY the frames are written as fixed size records, see
+// landmark_recorder.h, from a background thread; recording_to_csv converts
+// them to the CSV layout afterwards.
 // If debug is enabled
 // it will also open a terminal to display current data through ncurses lib   
 //
@@ -52,6 +57,8 @@ constexpr char kAngleDataTag[] = "ANGLES";
 //             file_name: "file.csv" 
 //             debug_to_terminal: true
 //             minFPS: int ;
+//             format: BINARY
+//             label: 2
 //     }
 //   }
 // }
@@ -77,7 +84,13 @@ class LandmarksAndAnglesToFileCalculator : public CalculatorBase {
   uint16_t getFPS(double currentUS); 
   LandmarksAndAnglesToFileCalculatorOptions options_;
   uint32_t processedFrames; 
+  // Per instance, a static would mix the frames of every graph
+  double lastFrameSeconds_ = 0;
   std::ofstream outputFile;
+  landmark_recorder::RecordWriter recordWriter_;
+  bool binaryOutput_ = false;
+  bool terminalOpen_ = false;
+  std::string csvBuffer_;
 };
 REGISTER_CALCULATOR(LandmarksAndAnglesToFileCalculator);
 
@@ -113,17 +126,38 @@ REGISTER_CALCULATOR(LandmarksAndAnglesToFileCalculator);
   
   processedFrames = 0;
 
-  if(options_.has_file_name()){
+  binaryOutput_ = options_.has_file_name() &&
+      options_.format() == LandmarksAndAnglesToFileCalculatorOptions::BINARY;
+  if(binaryOutput_){
+    MP_RETURN_IF_ERROR(recordWriter_.Open(options_.file_name(),
+                                          options_.records_per_buffer()));
+  }else if(options_.has_file_name()){
     outputFile.open(options_.file_name());  
   }
+
+  // Curses is started once, Process only redraws the screen
+  if(options_.debug_to_terminal()){
+    initscr();
+    terminalOpen_ = true;
+  }
     
   return ::mediapipe::OkStatus();
   
 }
 ::mediapipe::Status LandmarksAndAnglesToFileCalculator::Close(
     CalculatorContext* cc) {
-      endwin();
+  if(terminalOpen_){
+    endwin();
+    terminalOpen_ = false;
+  }
   if (outputFile.is_open()) outputFile.close();    
+  if(binaryOutput_){
+    if(recordWriter_.dropped() > 0){
+      LOG(WARNING) << recordWriter_.dropped() << " frames of "
+                   << options_.file_name() << " were dropped.";
+    }
+    MP_RETURN_IF_ERROR(recordWriter_.Close());
+  }
   return ::mediapipe::OkStatus();
 
 }
@@ -150,65 +184,48 @@ REGISTER_CALCULATOR(LandmarksAndAnglesToFileCalculator);
   const auto fps = getFPS(cc->InputTimestamp().Seconds());
   if(fps < options_.minfps())  return ::mediapipe::OkStatus();
 
+  RET_CHECK(landmarks.size() >= landmark_recorder::kNumLandmarks &&
+            angles.size() >= landmark_recorder::kNumLandmarks)
+      << "Expected the landmarks and angles of a whole hand.";
+
   processedFrames++;
 
-  if(options_.debug_to_terminal()){
-     initscr();			/* Start curses mode 		  */
-     clear();
-     std::string header = "Output File: "; 
-     header.append(options_.file_name());
-     header.append("\nNumber of Processed Frames:");
-     header.append(std::to_string(processedFrames));
-     header.append("\tFPS:");
-     header.append(std::to_string(fps));
-     printw(header.c_str());
-  }
- 
-  for (const auto &landmark : landmarks)
-  {
-    const unsigned char lmIndex = (&landmark - &landmarks[0]);
-    
-    if(options_.debug_to_terminal()){
-      std::string dispText = "LM:"; 
-      dispText.append(std::to_string(lmIndex));
-      dispText.append("\tX:");
-      dispText.append(std::to_string(landmark.x()));
-      dispText.append("\tY:");
-      dispText.append(std::to_string(landmark.y()));
-      dispText.append("\tDegrees 1:");
-      dispText.append(std::to_string(angles[lmIndex].angle1()));
-      dispText.append("\tDegrees 2:");
-      dispText.append(std::to_string(angles[lmIndex].angle2()));
-
-
-      move(lmIndex + 2,0);
-	    printw(dispText.c_str());	
-	    
+  if(binaryOutput_){
+    landmark_recorder::Record record;
+    record.timestamp_us = cc->InputTimestamp().Microseconds();
+    record.label = options_.label();
+    record.reserved = 0;
+    for (int i = 0; i < landmark_recorder::kNumLandmarks; ++i) {
+      record.xy[i][0] = landmarks[i].x();
+      record.xy[i][1] = landmarks[i].y();
+      record.angles[i][0] = angles[i].angle1();
+      record.angles[i][1] = angles[i].angle2();
     }
-
-    if (outputFile.is_open()){
-      const char* delimiter = ",";
-      std::string outText ="";
-      outText.append(std::to_string(lmIndex));
-      outText.append(delimiter);
-      outText.append(std::to_string(landmark.x()));
-      outText.append(delimiter);
-      outText.append(std::to_string(landmark.y()));
-      outText.append(delimiter);
-      outText.append(std::to_string(angles[lmIndex].angle1()));
-      outText.append(delimiter);
-      outText.append(std::to_string(angles[lmIndex].angle2()));
-      outText.append("\n");
-      outputFile << outText;
-
+    recordWriter_.Append(record);
+  }else if (outputFile.is_open()){
+    // One write per frame, the buffer keeps its capacity between frames
+    csvBuffer_.clear();
+    for (int i = 0; i < landmark_recorder::kNumLandmarks; ++i) {
+      absl::StrAppendFormat(&csvBuffer_, "%d,%f,%f,%f,%f\n", i,
+                            landmarks[i].x(), landmarks[i].y(),
+                            angles[i].angle1(), angles[i].angle2());
     }
+    outputFile << csvBuffer_;
+  }
 
-
-    /*if((&landmark - &landmarks[0])==0){
-        std::cout  << "X:" << std::to_string(landmark.x()) << " - " << landmark_data->x() << "\n";
-      }*/
+  if(options_.debug_to_terminal()){
+    // erase only clears the window, unlike clear it doesn't force the
+    // whole terminal to be repainted on refresh
+    erase();
+    mvprintw(0, 0, "Output File: %s\nNumber of Processed Frames:%u\tFPS:%u",
+             options_.file_name().c_str(), processedFrames, fps);
+    for (int i = 0; i < landmark_recorder::kNumLandmarks; ++i) {
+      mvprintw(i + 2, 0, "LM:%d\tX:%f\tY:%f\tDegrees 1:%f\tDegrees 2:%f", i,
+               landmarks[i].x(), landmarks[i].y(), angles[i].angle1(),
+               angles[i].angle2());
+    }
+    refresh();			/* Print it on to the real screen */
   }
-   if(options_.debug_to_terminal())refresh();			/* Print it on to the real screen */
 
   // cc->Outputs()
   //     .Tag(kAngleDataTag)
@@ -217,9 +234,8 @@ REGISTER_CALCULATOR(LandmarksAndAnglesToFileCalculator);
 }
 
 uint16_t LandmarksAndAnglesToFileCalculator::getFPS(double currentUS){
-  static double oldUS=0;
-  double deltaUS = currentUS-oldUS;
-  oldUS=currentUS;
+  double deltaUS = currentUS-lastFrameSeconds_;
+  lastFrameSeconds_=currentUS;
   
   if(deltaUS>0)return uint16_t(1/deltaUS);
   else return 0;
@@ -16,10 +16,12 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "mediapipe/framework/calculator_framework.h"
+#include "myMediapipe/calculators/util/calculator_stats.h"
 #include "mediapipe/framework/calculator_options.pb.h"
 #include "mediapipe/framework/formats/landmark.pb.h"
 #include "myMediapipe/framework/formats/angles.pb.h"
 #include "mediapipe/framework/port/ret_check.h"
+#include "myMediapipe/calculators/util/hand_angles.h"
 
 namespace mediapipe {
 
@@ -35,16 +37,14 @@ inline float Remap(float x, float lo, float hi, float scale) {
   return (x - lo) / (hi - lo + 1e-6) * scale;
 }
 
-// Wraps around an angle in radians to within -M_PI and M_PI.
-inline float NormalizeRadians(float angle) {
-  return angle - 2 * M_PI * std::floor((angle - (-M_PI)) / (2 * M_PI));
-}
-
-
 }  // namespace
 
 // A calculator that calculates Angles from Landmarks
 // The input should be std::vector<Landmark>
+// The angles of all the joints are computed in one pass by
+// hand_angles::ComputeFeatures (see hand_angles.h)
+// The input can hold the landmarks of several hands one after the other,
+// the angles are then output in the same order with their hand_id set.
 //
 // Example config:
 // node {
@@ -73,9 +73,8 @@ class LandmarksToAnglesCalculator : public CalculatorBase {
   ::mediapipe::Status Process(CalculatorContext* cc) override;
 
  private:
-  float angleBetweenLines(float x0, float y0, float x1, float y1, float x2, float y2, bool rigth_hand);
-
   //LandmarksToAnglesCalculatorOptions options_;
+  calculator_stats::NodeStats* stats_ = nullptr;
 };
 REGISTER_CALCULATOR(LandmarksToAnglesCalculator);
 
@@ -105,6 +104,7 @@ REGISTER_CALCULATOR(LandmarksToAnglesCalculator);
 ::mediapipe::Status LandmarksToAnglesCalculator::Open(
     CalculatorContext* cc) {
   cc->SetOffset(TimestampDiff(0));
+  stats_ = calculator_stats::ForNode(cc->NodeName());
   //options_ = cc->Options<LandmarksToAnglesCalculatorOptions>();
 
   return ::mediapipe::OkStatus();
@@ -112,6 +112,7 @@ REGISTER_CALCULATOR(LandmarksToAnglesCalculator);
 
 ::mediapipe::Status LandmarksToAnglesCalculator::Process(
     CalculatorContext* cc) {
+  calculator_stats::ScopedProcessTimer timer(stats_);
   // Only process if there's input landmarks.
   
   if ((cc->Inputs().Tag(kNormLandmarksTag).IsEmpty())/* ||
@@ -123,69 +124,33 @@ REGISTER_CALCULATOR(LandmarksToAnglesCalculator);
   const auto &landmarks = cc->Inputs()
                               .Tag(kNormLandmarksTag)
                               .Get<std::vector<NormalizedLandmark>>();
-  auto output_angles =
-      absl::make_unique<std::vector<Angle>>();
-  
-  //this only works if palm is facing the camera,
-  //TODO: add palm/back dettection
-  bool rigthHand = (landmarks[5].x()>landmarks[17].x());     
-  
-
-  for (const auto &landmark : landmarks)
-  {
-    Angle new_angle;
-
-    new_angle.set_landmarkid(&landmark - &landmarks[0]);
-
-    //TODO: Replace Literals with something more elegant
-    //      maybe a new format with palmBase, finger[].mcp .pip .dip .tip
-
-    //Pip Dip angles
-    if (((new_angle.landmarkid() > 1) && (new_angle.landmarkid() < 4)) ||
-        ((new_angle.landmarkid() > 5) && (new_angle.landmarkid() < 8)) ||
-        ((new_angle.landmarkid() > 9) && (new_angle.landmarkid() < 12)) ||
-        ((new_angle.landmarkid() > 13) && (new_angle.landmarkid() < 16)) ||
-        ((new_angle.landmarkid() > 17) && (new_angle.landmarkid() < 20)))
-    {
+  // Several hands are concatenated one after the other,
+  // see LandmarksListToVectorLandmarksCalculator
+  const int num_hands = landmarks.size() / hand_angles::kNumLandmarks;
+  RET_CHECK_GE(num_hands, 1);
+  RET_CHECK_EQ(landmarks.size(), num_hands * hand_angles::kNumLandmarks);
 
-      new_angle.set_angle1(angleBetweenLines(landmark.x(), landmark.y(),
-                                             landmarks[new_angle.landmarkid() + 1].x(), landmarks[new_angle.landmarkid() + 1].y(),
-                                             landmarks[new_angle.landmarkid() - 1].x(), landmarks[new_angle.landmarkid() - 1].y(),
-                                             rigthHand)); //float x0, float y0, float x1, float y1, float x2, float y2
+  auto output_angles =
+      absl::make_unique<std::vector<Angle>>(landmarks.size());
+
+  float x[hand_angles::kNumLandmarks];
+  float y[hand_angles::kNumLandmarks];
+  float features[hand_angles::kNumFeatures];
+  for (int hand = 0; hand < num_hands; ++hand) {
+    const int offset = hand * hand_angles::kNumLandmarks;
+    for (int i = 0; i < hand_angles::kNumLandmarks; ++i) {
+      x[i] = landmarks[offset + i].x();
+      y[i] = landmarks[offset + i].y();
     }
-
-    //MCP angles
-    //Angles between fingers
-    if ((new_angle.landmarkid() == 1) ||
-        (new_angle.landmarkid() == 5) ||
-        (new_angle.landmarkid() == 9) ||
-        (new_angle.landmarkid() == 13)){
-      new_angle.set_angle2(angleBetweenLines(landmark.x(), landmark.y(),
-                                               landmarks[new_angle.landmarkid() + 7].x(), landmarks[new_angle.landmarkid() + 7].y(),
-                                               landmarks[new_angle.landmarkid() + 3].x(), landmarks[new_angle.landmarkid() + 3].y(),
-                                               rigthHand));
+    hand_angles::ComputeFeatures(x, y, features);
+
+    for (int i = 0; i < hand_angles::kNumLandmarks; ++i) {
+      Angle& new_angle = (*output_angles)[offset + i];
+      new_angle.set_landmarkid(i);
+      new_angle.set_hand_id(hand);
+      new_angle.set_angle1(features[i * hand_angles::kAnglesPerLandmark]);
+      new_angle.set_angle2(features[i * hand_angles::kAnglesPerLandmark + 1]);
     }
-
-    // Palm angle
-
-
-  if(new_angle.landmarkid()== 0) 
-    new_angle.set_angle1( /*atan2(-(landmarks[0].y()-landmarks[9].y()), landmarks[0].x()-landmarks[9].x()));*/
-        angleBetweenLines(landmarks[0].x(),landmarks[0].y(),
-                                           landmarks[9].x(),landmarks[9].y(),
-                                           0,landmarks[0].y(),
-                                           0));
-  
-
-  //return NormalizeRadians(rotation)
-    
-    //   new_angle.set_angle2(rigthHand);
-
-    output_angles->emplace_back(new_angle);
-
-    /*if((&landmark - &landmarks[0])==0){
-        std::cout  << "X:" << std::to_string(landmark.x()) << " - " << landmark_data->x() << "\n";
-      }*/
   }
 
   cc->Outputs()
@@ -194,20 +159,6 @@ REGISTER_CALCULATOR(LandmarksToAnglesCalculator);
   return ::mediapipe::OkStatus();
 }
 
-float LandmarksToAnglesCalculator::angleBetweenLines(float x0, float y0, float x1, float y1, float x2, float y2, bool rigth_hand) {
-  float angle1 = atan2((y0-y1), x0-x1);
-  float angle2 = atan2((y0-y2), x0-x2);
-  float result; 
-  
-  if(rigth_hand) result = (angle2-angle1);
-  else result = (angle1-angle2);
-  /*result *= 180 / 3.1415; //To degrees
-  if (result<0) {
-      result+=360;
-  }*/
-  return NormalizeRadians(result);
-}  
-
 }  // namespace mediapipe
 
 
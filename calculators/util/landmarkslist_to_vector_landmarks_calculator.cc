@@ -24,6 +24,7 @@ namespace {
 
 constexpr char kLandmarksTag[] = "LANDMARKS";
 constexpr char kNormLandmarksTag[] = "NORM_LANDMARKS";
+constexpr char kMultiNormLandmarksTag[] = "MULTI_NORM_LANDMARKS";
 
 
 
@@ -35,6 +36,11 @@ constexpr char kNormLandmarksTag[] = "NORM_LANDMARKS";
 // to the old vector of Landmarks, as a temporary fix until the rest of
 // HandCommander can be updated to LandmarkList
 //
+// With a MULTI_NORM_LANDMARKS input (std::vector<NormalizedLandmarkList>)
+// the landmarks of all the hands are concatenated in a single vector,
+// hand N taking the positions [N*21, N*21+21), which is the layout the
+// multi hand aware gesture calculators expect.
+//
 // Example config:
 // node {
 //   calculator: "LandmarksListToVectorLandmarksCalculator"
@@ -44,6 +50,12 @@ constexpr char kNormLandmarksTag[] = "NORM_LANDMARKS";
 //     }
 //   }
 // }
+//
+// node {
+//   calculator: "LandmarksListToVectorLandmarksCalculator"
+//   input_stream: "MULTI_NORM_LANDMARKS:multi_hand_landmarks"
+//   output_stream: "NORM_LANDMARKS:vector_landmarks"
+// }
 //LandmarksListToVectorLandmarksCalculator
 
 class LandmarksListToVectorLandmarksCalculator : public CalculatorBase {
@@ -71,12 +83,15 @@ REGISTER_CALCULATOR(LandmarksListToVectorLandmarksCalculator);
 ::mediapipe::Status LandmarksListToVectorLandmarksCalculator::GetContract(
     CalculatorContract* cc) {
   RET_CHECK(cc->Inputs().HasTag(kLandmarksTag) ||
-            cc->Inputs().HasTag(kNormLandmarksTag))
+            cc->Inputs().HasTag(kNormLandmarksTag) ||
+            cc->Inputs().HasTag(kMultiNormLandmarksTag))
       << "None of the input streams are provided.";
-  RET_CHECK(!(cc->Inputs().HasTag(kLandmarksTag) &&
-              cc->Inputs().HasTag(kNormLandmarksTag)))
-      << "Only one type of landmark can be taken. Either absolute or "
-         "normalized landmarks.";
+  RET_CHECK_EQ(cc->Inputs().HasTag(kLandmarksTag) +
+                   cc->Inputs().HasTag(kNormLandmarksTag) +
+                   cc->Inputs().HasTag(kMultiNormLandmarksTag),
+               1)
+      << "Only one type of landmark can be taken. Either absolute, "
+         "normalized or multi hand normalized landmarks.";
 
   //  RET_CHECK(cc->Inputs().HasTag(kPresenceTag))
   //     << "Hand Presence input stram required.";
@@ -87,6 +102,11 @@ REGISTER_CALCULATOR(LandmarksListToVectorLandmarksCalculator);
   if (cc->Inputs().HasTag(kNormLandmarksTag)) {
     cc->Inputs().Tag(kNormLandmarksTag).Set<NormalizedLandmarkList>();
   }
+  if (cc->Inputs().HasTag(kMultiNormLandmarksTag)) {
+    cc->Inputs()
+        .Tag(kMultiNormLandmarksTag)
+        .Set<std::vector<NormalizedLandmarkList>>();
+  }
   if (cc->Outputs().HasTag(kLandmarksTag)) {
     cc->Outputs().Tag(kLandmarksTag).Set<std::vector<Landmark>>();
   }
@@ -127,7 +147,27 @@ REGISTER_CALCULATOR(LandmarksListToVectorLandmarksCalculator);
      .Add(output_landmarks.release(), cc->InputTimestamp());
   }
 
-  if (cc->Outputs().HasTag(kNormLandmarksTag)) {
+  if (cc->Outputs().HasTag(kNormLandmarksTag) &&
+      cc->Inputs().HasTag(kMultiNormLandmarksTag)) {
+
+    if ((cc->Inputs().Tag(kMultiNormLandmarksTag).IsEmpty()))
+      return ::mediapipe::OkStatus();
+
+    const auto& landmarkLists = cc->Inputs()
+                                    .Tag(kMultiNormLandmarksTag)
+                                    .Get<std::vector<NormalizedLandmarkList>>();
+    if (landmarkLists.empty()) return ::mediapipe::OkStatus();
+
+    auto output_landmarks = absl::make_unique<std::vector<NormalizedLandmark>>();
+    for (const auto& landmarkList : landmarkLists) {
+      for (int i = 0; i < landmarkList.landmark_size(); ++i) {
+        output_landmarks->emplace_back(landmarkList.landmark(i));
+      }
+    }
+    cc->Outputs().Tag(kNormLandmarksTag)
+     .Add(output_landmarks.release(), cc->InputTimestamp());
+  }
+  else if (cc->Outputs().HasTag(kNormLandmarksTag)) {
     
     if ((cc->Inputs().Tag(kNormLandmarksTag).IsEmpty()))
       return ::mediapipe::OkStatus();
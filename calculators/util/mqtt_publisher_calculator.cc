@@ -12,12 +12,27 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "myMediapipe/calculators/util/mqtt_publisher_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/calculator_options.pb.h"
 #include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/port/status.h"
+#include "myMediapipe/calculators/util/calculator_stats.h"
+#include "myMediapipe/calculators/util/spsc_queue.h"
 #include "myMediapipe/framework/formats/mqtt_message.pb.h"
-#include <iostream>
 #include "myMediapipe/third_party/simple-mqtt-client/Mqtt.h"
 
 namespace mediapipe {
@@ -28,20 +43,65 @@ typedef std::vector<Mqtt_Message> MqttMessages;
 
 constexpr char Kmessage[] = "MQTT_MESSAGE";
 
+// Time the publisher thread waits on the socket before checking the queue
+constexpr int kLoopTimeoutMs = 10;
+// Time between attempts to connect to the broker
+constexpr absl::Duration kReconnectDelay = absl::Seconds(1);
+
+// Run of identical messages, ie the max_repeat copies of a rotation
+// created by movingDynamicGesturesCalculator
+struct MessageRun {
+  std::string topic;
+  std::string payload;
+  int count = 0;
+};
+
+// Messages of one input packet, stored in a single queue slot. Slots are
+// reused, so runs and their strings keep their capacity between packets.
+struct Burst {
+  std::vector<MessageRun> runs;
+  int num_runs = 0;
+  absl::Time enqueued;
+  // Timestamp of the input packet, i.e. the capture time of the frame
+  Timestamp frame_timestamp;
+};
+
 }  // namespace
 
-// MQTT publisher 
+// MQTT publisher
 //
-// takes incoming payloads and publishes  
+// takes incoming payloads and publishes
 // them to the specified broker
 //
+// Every calculator instance owns its connection, run by a thread
+// started at Open. Process only copies the messages into a bounded
+// lock-free queue and returns, so a slow or unreachable broker never
+// stalls the graph: when the queue is full the packet is dropped and
+// counted. Consecutive identical messages are queued once with a repeat
+// count, and still published that many times.
+//
 //  MQTT_MESSAGE: A message containing the topic to publish
 //                and its payload
 //
+// Counters:
+//  <node>_published: messages handed to the mosquitto client
+//  <node>_dropped: messages dropped because the queue was full
+//  <node>_publish_errors: messages rejected by the mosquitto client
+//  Queue to publish latency is logged at Close.
+//
 // Example config:
 // node {
 //   calculator: "MqttPublisherCalculator"
 //   input_stream: "MQTT_MESSAGE:message"
+//   node_options: {
+//     [type.googleapis.com/mediapipe.MqttPublisherCalculatorOptions] {
+//       client_id: "gestures"
+//       broker_ip: "localhost"
+//       broker_port: 1883
+//       qos: 1
+//       queue_depth: 64
+//     }
+//   }
 // }
 
 class MqttPublisherCalculator : public CalculatorBase {
@@ -50,14 +110,33 @@ class MqttPublisherCalculator : public CalculatorBase {
   ::mediapipe::Status Open(CalculatorContext* cc) override;
   ::mediapipe::Status Close(CalculatorContext* cc) override;
   ::mediapipe::Status Process(CalculatorContext* cc) override;
-  
-  private:
+
+ private:
+  // Body of publisher_thread_, connects, runs the mosquitto loop and
+  // drains the queue until Close
+  void PublisherLoop();
+  void PublishBurst(const Burst& burst);
+
   ::mediapipe::MqttPublisherCalculatorOptions options_;
   /**
    *  List in which all subscription topics are stored that the broker should subscribe too
   */
   std::vector<string> subscription_topic_list;
-  std::vector<Mqtt> *mqtt_list;
+  std::unique_ptr<Mqtt> mqtt_;
+  std::unique_ptr<SpscQueue<Burst>> queue_;
+  std::thread publisher_thread_;
+  std::atomic<bool> stop_{false};
+  absl::Time flush_deadline_;
+
+  Counter* published_counter_ = nullptr;
+  Counter* dropped_counter_ = nullptr;
+  Counter* error_counter_ = nullptr;
+
+  // Only touched by publisher_thread_, read after it is joined
+  int latency_count_ = 0;
+  absl::Duration latency_total_;
+  absl::Duration latency_max_;
+  calculator_stats::NodeStats* stats_ = nullptr;
 };
 REGISTER_CALCULATOR(MqttPublisherCalculator);
 
@@ -66,56 +145,155 @@ REGISTER_CALCULATOR(MqttPublisherCalculator);
   RET_CHECK(cc->Inputs().HasTag(Kmessage));
 
   cc->Inputs()
-      .Tag(Kmessage) 
+      .Tag(Kmessage)
       .Set<MqttMessages>();
-  //cc->Outputs().Tag(kDetectionTag).Set<Detection>();
-  
+
   return ::mediapipe::OkStatus();
 }
 
 ::mediapipe::Status MqttPublisherCalculator::Open(
     CalculatorContext* cc) {
   cc->SetOffset(TimestampDiff(0));
+  stats_ = calculator_stats::ForNode(cc->NodeName());
 
   options_ = cc->Options<::mediapipe::MqttPublisherCalculatorOptions>();
+  RET_CHECK(options_.qos() >= 0 && options_.qos() <= 2)
+      << "qos must be 0, 1 or 2";
+  RET_CHECK_GT(options_.queue_depth(), 0);
+
+  std::string client_id = options_.client_id();
+  if (options_.unique_client_id()) {
+    // Graphs in the same process share node names, so the instance number
+    // tells them apart
+    static std::atomic<int> instance_count(0);
+    client_id += absl::StrCat("_", getpid(), "_", instance_count++);
+  }
+
+  // Not threaded, publisher_thread_ runs the mosquitto loop so the
+  // connection is only used from one thread
+  if (options_.has_user()) {
+    mqtt_ = absl::make_unique<Mqtt>(client_id, "", subscription_topic_list,
+                                    options_.broker_ip(),
+                                    options_.broker_port(), options_.user(),
+                                    options_.password(), /*threaded=*/false);
+  } else {
+    mqtt_ = absl::make_unique<Mqtt>(client_id, "", subscription_topic_list,
+                                    options_.broker_ip(),
+                                    options_.broker_port(),
+                                    /*threaded=*/false);
+  }
+  queue_ = absl::make_unique<SpscQueue<Burst>>(options_.queue_depth());
+
+  published_counter_ = cc->GetCounter(cc->NodeName() + "_published");
+  dropped_counter_ = cc->GetCounter(cc->NodeName() + "_dropped");
+  error_counter_ = cc->GetCounter(cc->NodeName() + "_publish_errors");
+
+  publisher_thread_ = std::thread([this] { PublisherLoop(); });
+
   return ::mediapipe::OkStatus();
 }
 
 ::mediapipe::Status MqttPublisherCalculator::Process(
     CalculatorContext* cc) {
+  calculator_stats::ScopedProcessTimer timer(stats_);
   RET_CHECK(!cc->Inputs().Tag(Kmessage).IsEmpty());
 
   const auto& input_messages =
       cc->Inputs().Tag(Kmessage).Get<MqttMessages>();
-  
-  // for (auto msg : input_messages){
-  //   std::cout << "\n !!Message:" << msg.topic()
-  //             << "\t :" << msg.payload();
-  // }
-  
-  // bool exist = false;
-  // for(auto mqtt_ : mqtt_list){
-  //        if(mqtt_->publish_topic==input_message.topic()){
-  //          exist=true;
-  //        }
-  // }
-  static Mqtt *mqtt = new Mqtt(options_.client_id(), 
-                               "", 
-                               subscription_topic_list, 
-                               options_.broker_ip(), 
-                               options_.broker_port());
-  
-  for (auto msg : input_messages){
-    mqtt->publish_topic = msg.topic();
-    mqtt->publish(msg.payload());
-  }  
-  
+  if (input_messages.empty()) return ::mediapipe::OkStatus();
+
+  const bool queued = queue_->TryPush([&](Burst* burst) {
+    burst->num_runs = 0;
+    for (const auto& msg : input_messages) {
+      if (burst->num_runs > 0) {
+        MessageRun& last = burst->runs[burst->num_runs - 1];
+        if (last.topic == msg.topic() && last.payload == msg.payload()) {
+          ++last.count;
+          continue;
+        }
+      }
+      if (burst->num_runs == static_cast<int>(burst->runs.size())) {
+        burst->runs.emplace_back();
+      }
+      MessageRun& run = burst->runs[burst->num_runs++];
+      run.topic.assign(msg.topic());
+      run.payload.assign(msg.payload());
+      run.count = 1;
+    }
+    burst->enqueued = absl::Now();
+    burst->frame_timestamp = cc->InputTimestamp();
+  });
+  if (!queued) dropped_counter_->IncrementBy(input_messages.size());
+  stats_->queue_depth.store(queue_->Size(), std::memory_order_relaxed);
+
   return ::mediapipe::OkStatus();
 }
 
+void MqttPublisherCalculator::PublishBurst(const Burst& burst) {
+  for (int i = 0; i < burst.num_runs; ++i) {
+    const MessageRun& run = burst.runs[i];
+    for (int n = 0; n < run.count; ++n) {
+      if (mqtt_->publish(run.topic, run.payload, options_.qos(),
+                         options_.retain())) {
+        published_counter_->Increment();
+      } else {
+        error_counter_->Increment();
+      }
+    }
+  }
+  const absl::Duration latency = absl::Now() - burst.enqueued;
+  ++latency_count_;
+  latency_total_ += latency;
+  latency_max_ = std::max(latency_max_, latency);
+  stats_->RecordEndToEnd(burst.frame_timestamp);
+}
+
+void MqttPublisherCalculator::PublisherLoop() {
+  bool connected = false;
+  while (true) {
+    const bool stopping = stop_.load(std::memory_order_acquire);
+    if (stopping && (!connected || absl::Now() > flush_deadline_ ||
+                     (queue_->Empty() && !mqtt_->want_write()))) {
+      break;
+    }
+
+    if (!connected) {
+      connected = mqtt_->connect_to_broker();
+      if (!connected) {
+        // Packets keep queuing meanwhile, and are dropped once it is full
+        absl::SleepFor(kReconnectDelay);
+        continue;
+      }
+    }
+
+    if (mqtt_->loop(kLoopTimeoutMs) != MOSQ_ERR_SUCCESS) {
+      connected = false;
+      continue;
+    }
+    while (queue_->TryPop([this](Burst* burst) { PublishBurst(*burst); })) {
+    }
+  }
+}
+
 ::mediapipe::Status MqttPublisherCalculator::Close(
     CalculatorContext* cc) {
-  //TODO: delete mqtt;    
+  if (publisher_thread_.joinable()) {
+    flush_deadline_ =
+        absl::Now() + absl::Milliseconds(options_.flush_timeout_ms());
+    stop_.store(true, std::memory_order_release);
+    publisher_thread_.join();
+  }
+  if (queue_ && !queue_->Empty()) {
+    LOG(WARNING) << cc->NodeName()
+                 << ": closing with unpublished MQTT messages";
+  }
+  if (latency_count_ > 0) {
+    LOG(INFO) << cc->NodeName() << ": published " << latency_count_
+              << " packets, queue latency mean "
+              << absl::FormatDuration(latency_total_ / latency_count_)
+              << " max " << absl::FormatDuration(latency_max_);
+  }
+  mqtt_.reset();
   return ::mediapipe::OkStatus();
 }
 
@@ -0,0 +1,84 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myMediapipe/calculators/util/one_euro_filter.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace mediapipe {
+
+namespace {
+
+constexpr float kTwoPi = 6.28318530717959f;
+
+// Smoothing factor of a low pass filter with the cutoff, in Hz, for
+// samples dt seconds apart
+inline float Alpha(float cutoff, float dt) {
+  const float r = kTwoPi * cutoff * dt;
+  return r / (r + 1);
+}
+
+}  // namespace
+
+OneEuroFilterBank::OneEuroFilterBank(int num_channels, float min_cutoff,
+                                     float beta, float derivative_cutoff)
+    : min_cutoff_(min_cutoff),
+      beta_(beta),
+      derivative_cutoff_(derivative_cutoff),
+      raw_(num_channels, 0),
+      value_(num_channels, 0),
+      velocity_(num_channels, 0) {}
+
+void OneEuroFilterBank::Update(double time_s, float* values,
+                               float* velocities) {
+  const int n = value_.size();
+  if (!initialized_) {
+    std::copy(values, values + n, raw_.begin());
+    std::copy(values, values + n, value_.begin());
+    std::fill(velocity_.begin(), velocity_.end(), 0.0f);
+    std::fill(velocities, velocities + n, 0.0f);
+    last_time_s_ = time_s;
+    initialized_ = true;
+    return;
+  }
+  if (time_s <= last_time_s_) {
+    std::copy(value_.begin(), value_.end(), values);
+    std::copy(velocity_.begin(), velocity_.end(), velocities);
+    return;
+  }
+
+  const float dt = time_s - last_time_s_;
+  const float inv_dt = 1.0f / dt;
+  const float derivative_alpha = Alpha(derivative_cutoff_, dt);
+  const float two_pi_dt = kTwoPi * dt;
+  float* raw = raw_.data();
+  float* value = value_.data();
+  float* velocity = velocity_.data();
+  for (int i = 0; i < n; ++i) {
+    const float raw_velocity = (values[i] - raw[i]) * inv_dt;
+    raw[i] = values[i];
+    const float v =
+        velocity[i] + derivative_alpha * (raw_velocity - velocity[i]);
+    const float r = two_pi_dt * (min_cutoff_ + beta_ * std::fabs(v));
+    const float alpha = r / (r + 1);
+    value[i] += alpha * (values[i] - value[i]);
+    velocity[i] = v;
+    values[i] = value[i];
+    velocities[i] = v;
+  }
+  last_time_s_ = time_s;
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,66 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_CALCULATORS_UTIL_ONE_EURO_FILTER_H_
+#define MYMEDIAPIPE_CALCULATORS_UTIL_ONE_EURO_FILTER_H_
+
+#include <vector>
+
+namespace mediapipe {
+
+// One Euro filters (Casiez et al., CHI 2012) over a fixed number of
+// channels, ie the x, y and z of the 21 landmarks of a hand. The state is
+// kept as a structure of arrays and all the channels share the timestamp,
+// so Update is a single branch free loop the compiler can vectorize.
+//
+// Each channel is smoothed with a low pass filter whose cutoff grows with
+// the filtered speed of the channel: still landmarks get min_cutoff and
+// lose their jitter, fast ones get a larger cutoff and little lag.
+//
+// Example:
+//   OneEuroFilterBank filter(/*num_channels=*/63, /*min_cutoff=*/1.0f,
+//                            /*beta=*/10.0f, /*derivative_cutoff=*/1.0f);
+//   filter.Update(timestamp.Seconds(), values, velocities);
+class OneEuroFilterBank {
+ public:
+  // min_cutoff and derivative_cutoff in Hz, beta in Hz per unit of speed
+  OneEuroFilterBank(int num_channels, float min_cutoff, float beta,
+                    float derivative_cutoff);
+
+  // Forgets the previous samples, the next Update starts over
+  void Reset() { initialized_ = false; }
+
+  // Filters num_channels values sampled at time_s in place, and writes
+  // their filtered speed in units per second to velocities. The first
+  // sample after a reset passes through with zero velocity. Samples not
+  // newer than the previous one are ignored.
+  void Update(double time_s, float* values, float* velocities);
+
+  int num_channels() const { return value_.size(); }
+
+ private:
+  const float min_cutoff_;
+  const float beta_;
+  const float derivative_cutoff_;
+  bool initialized_ = false;
+  double last_time_s_ = 0;
+  // Last raw value, filtered value and filtered velocity of every channel
+  std::vector<float> raw_;
+  std::vector<float> value_;
+  std::vector<float> velocity_;
+};
+
+}  // namespace mediapipe
+
+#endif  // MYMEDIAPIPE_CALCULATORS_UTIL_ONE_EURO_FILTER_H_
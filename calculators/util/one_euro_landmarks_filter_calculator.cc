@@ -0,0 +1,181 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/landmark.pb.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "myMediapipe/calculators/util/hand_angles.h"
+#include "myMediapipe/calculators/util/one_euro_filter.h"
+#include "myMediapipe/calculators/util/one_euro_landmarks_filter_calculator.pb.h"
+
+namespace mediapipe {
+
+namespace {
+
+constexpr char kNormLandmarksTag[] = "NORM_LANDMARKS";
+constexpr char kVelocityTag[] = "VELOCITY";
+
+constexpr int kNumLandmarks = hand_angles::kNumLandmarks;
+// x, y and z of every landmark of a hand
+constexpr int kChannelsPerHand = kNumLandmarks * 3;
+
+typedef std::vector<NormalizedLandmark> Landmarks;
+
+}  // namespace
+
+// Smooths the hand landmarks with a One Euro filter per coordinate (see
+// one_euro_filter.h), so the jitter of a still hand doesn't reach the
+// angles and the dynamic gestures calculators, which otherwise read it as
+// small moves and rotations. Meant to run between
+// LandmarksListToVectorLandmarksCalculator and LandmarksToAnglesCalculator.
+//
+// Hands are taken from [N*21, N*21+21) of the vector, each one with its own
+// filters. The filters of a hand restart when it shows up again after
+// reset_after_s.
+//
+// Input:
+//  NORM_LANDMARKS: std::vector<NormalizedLandmark> with the landmarks of
+//                  every hand.
+//
+// Output:
+//  NORM_LANDMARKS: The filtered landmarks, same layout.
+//  VELOCITY (optional): std::vector<NormalizedLandmark> with the filtered
+//                       velocity of every landmark, x, y and z in
+//                       normalized units per second, same layout.
+//
+// Example config:
+// node {
+//   calculator: "OneEuroLandmarksFilterCalculator"
+//   input_stream: "NORM_LANDMARKS:vector_landmarks"
+//   output_stream: "NORM_LANDMARKS:smoothed_landmarks"
+//   output_stream: "VELOCITY:landmark_velocity"
+//   node_options: {
+//     [type.googleapis.com/mediapipe.OneEuroLandmarksFilterCalculatorOptions] {
+//       min_cutoff: 1.0
+//       beta: 10.0
+//     }
+//   }
+// }
+
+class OneEuroLandmarksFilterCalculator : public CalculatorBase {
+ public:
+  static ::mediapipe::Status GetContract(CalculatorContract* cc);
+  ::mediapipe::Status Open(CalculatorContext* cc) override;
+  ::mediapipe::Status Process(CalculatorContext* cc) override;
+
+ private:
+  OneEuroLandmarksFilterCalculatorOptions options_;
+  // Filters of every hand, by position in the vector
+  std::vector<std::unique_ptr<OneEuroFilterBank>> hands_;
+  double last_time_s_ = 0;
+  // Coordinates of one hand as x[21], y[21], z[21], and their velocities
+  float values_[kChannelsPerHand];
+  float velocities_[kChannelsPerHand];
+};
+REGISTER_CALCULATOR(OneEuroLandmarksFilterCalculator);
+
+::mediapipe::Status OneEuroLandmarksFilterCalculator::GetContract(
+    CalculatorContract* cc) {
+  RET_CHECK(cc->Inputs().HasTag(kNormLandmarksTag))
+      << "Normalized Landmark input stream is NOT provided.";
+  RET_CHECK(cc->Outputs().HasTag(kNormLandmarksTag))
+      << "Normalized Landmark output stream is NOT provided.";
+
+  cc->Inputs().Tag(kNormLandmarksTag).Set<Landmarks>();
+  cc->Outputs().Tag(kNormLandmarksTag).Set<Landmarks>();
+  if (cc->Outputs().HasTag(kVelocityTag)) {
+    cc->Outputs().Tag(kVelocityTag).Set<Landmarks>();
+  }
+
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status OneEuroLandmarksFilterCalculator::Open(
+    CalculatorContext* cc) {
+  cc->SetOffset(TimestampDiff(0));
+
+  options_ = cc->Options<OneEuroLandmarksFilterCalculatorOptions>();
+  RET_CHECK_GT(options_.min_cutoff(), 0);
+  RET_CHECK_GE(options_.beta(), 0);
+  RET_CHECK_GT(options_.derivative_cutoff(), 0);
+
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status OneEuroLandmarksFilterCalculator::Process(
+    CalculatorContext* cc) {
+  if (cc->Inputs().Tag(kNormLandmarksTag).IsEmpty()) {
+    return ::mediapipe::OkStatus();
+  }
+  const auto& landmarks = cc->Inputs().Tag(kNormLandmarksTag).Get<Landmarks>();
+  RET_CHECK_EQ(landmarks.size() % kNumLandmarks, 0)
+      << "Expected " << kNumLandmarks << " landmarks per hand";
+  const int num_hands = landmarks.size() / kNumLandmarks;
+
+  const double now = cc->InputTimestamp().Seconds();
+  if (now - last_time_s_ > options_.reset_after_s()) {
+    for (auto& hand : hands_) hand->Reset();
+  }
+  last_time_s_ = now;
+  while (static_cast<int>(hands_.size()) > num_hands) hands_.pop_back();
+  while (static_cast<int>(hands_.size()) < num_hands) {
+    hands_.emplace_back(absl::make_unique<OneEuroFilterBank>(
+        kChannelsPerHand, options_.min_cutoff(), options_.beta(),
+        options_.derivative_cutoff()));
+  }
+
+  auto output_landmarks = absl::make_unique<Landmarks>(landmarks);
+  std::unique_ptr<Landmarks> output_velocity;
+  if (cc->Outputs().HasTag(kVelocityTag)) {
+    output_velocity = absl::make_unique<Landmarks>(landmarks.size());
+  }
+
+  for (int hand = 0; hand < num_hands; ++hand) {
+    const int offset = hand * kNumLandmarks;
+    for (int i = 0; i < kNumLandmarks; ++i) {
+      const auto& landmark = landmarks[offset + i];
+      values_[i] = landmark.x();
+      values_[kNumLandmarks + i] = landmark.y();
+      values_[2 * kNumLandmarks + i] = landmark.z();
+    }
+    hands_[hand]->Update(now, values_, velocities_);
+    for (int i = 0; i < kNumLandmarks; ++i) {
+      auto& landmark = (*output_landmarks)[offset + i];
+      landmark.set_x(values_[i]);
+      landmark.set_y(values_[kNumLandmarks + i]);
+      landmark.set_z(values_[2 * kNumLandmarks + i]);
+      if (output_velocity) {
+        auto& velocity = (*output_velocity)[offset + i];
+        velocity.set_x(velocities_[i]);
+        velocity.set_y(velocities_[kNumLandmarks + i]);
+        velocity.set_z(velocities_[2 * kNumLandmarks + i]);
+      }
+    }
+  }
+
+  cc->Outputs().Tag(kNormLandmarksTag).Add(output_landmarks.release(),
+                                           cc->InputTimestamp());
+  if (output_velocity) {
+    cc->Outputs().Tag(kVelocityTag).Add(output_velocity.release(),
+                                        cc->InputTimestamp());
+  }
+
+  return ::mediapipe::OkStatus();
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,97 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_CALCULATORS_UTIL_SPSC_QUEUE_H_
+#define MYMEDIAPIPE_CALCULATORS_UTIL_SPSC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace mediapipe {
+
+// Bounded lock-free queue for a single producer and a single consumer
+// thread.
+//
+// Slots are allocated once and reused, items are written and read in place
+// through a callback, so a T holding containers keeps their capacity and
+// steady state pushes do not allocate.
+//
+// Example:
+//   SpscQueue<Burst> queue(64);
+//   // producer
+//   if (!queue.TryPush([&](Burst* slot) { slot->Fill(...); })) dropped++;
+//   // consumer
+//   while (queue.TryPop([&](Burst* slot) { Send(*slot); })) {}
+template <class T>
+class SpscQueue {
+ public:
+  // capacity is rounded up to a power of two
+  explicit SpscQueue(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    slots_.resize(size);
+    mask_ = size - 1;
+  }
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  size_t capacity() const { return slots_.size(); }
+
+  // Producer side. Calls fill(T*) on a free slot and publishes it, returns
+  // false without calling fill when the queue is full.
+  template <class F>
+  bool TryPush(F fill) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == slots_.size()) {
+      return false;
+    }
+    fill(&slots_[tail & mask_]);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Calls consume(T*) on the oldest item and releases its
+  // slot, returns false when the queue is empty.
+  template <class F>
+  bool TryPop(F consume) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) return false;
+    consume(&slots_[head & mask_]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool Empty() const {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+  // Approximate when called while the other side is running
+  size_t Size() const {
+    const size_t head = head_.load(std::memory_order_acquire);
+    return tail_.load(std::memory_order_acquire) - head;
+  }
+
+ private:
+  std::vector<T> slots_;
+  size_t mask_ = 0;
+  // Kept on separate cache lines, each one is written by a single thread
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+};
+
+}  // namespace mediapipe
+
+#endif  // MYMEDIAPIPE_CALCULATORS_UTIL_SPSC_QUEUE_H_
@@ -0,0 +1,135 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/port/status.h"
+#include "myMediapipe/calculators/util/calculator_stats.h"
+#include "myMediapipe/calculators/util/stats_reporter_calculator.pb.h"
+
+namespace mediapipe {
+
+namespace {
+constexpr char kTickTag[] = "TICK";
+constexpr char kStatsTag[] = "STATS";
+}  // namespace
+
+// Reports the stats recorded by the instrumented calculators of the
+// process, see calculator_stats.h, in the Prometheus text format.
+//
+// TICK drives the reports, any stream works, ie the input frames. Every
+// report_interval_s the text is written to output_file and/or sent
+// through STATS, and a last report is made at Close.
+//
+// Input:
+//   TICK: packets of any type.
+//
+// Output:
+//   STATS (optional): std::string with the whole exposition text.
+//
+// Example config:
+// node {
+//   calculator: "StatsReporterCalculator"
+//   input_stream: "TICK:input_video"
+//   options: {
+//     [mediapipe.StatsReporterCalculatorOptions.ext] {
+//       output_file: "/var/lib/node_exporter/dynamic_gestures.prom"
+//       report_interval_s: 10
+//     }
+//   }
+// }
+class StatsReporterCalculator : public CalculatorBase {
+ public:
+  static ::mediapipe::Status GetContract(CalculatorContract* cc);
+  ::mediapipe::Status Open(CalculatorContext* cc) override;
+  ::mediapipe::Status Process(CalculatorContext* cc) override;
+  ::mediapipe::Status Close(CalculatorContext* cc) override;
+
+ private:
+  ::mediapipe::Status Report(CalculatorContext* cc);
+  ::mediapipe::Status WriteOutputFile(const std::string& text);
+
+  StatsReporterCalculatorOptions options_;
+  Timestamp next_report_ = Timestamp::Unset();
+};
+REGISTER_CALCULATOR(StatsReporterCalculator);
+
+::mediapipe::Status StatsReporterCalculator::GetContract(
+    CalculatorContract* cc) {
+  RET_CHECK(cc->Inputs().HasTag(kTickTag));
+  cc->Inputs().Tag(kTickTag).SetAny();
+  if (cc->Outputs().HasTag(kStatsTag)) {
+    cc->Outputs().Tag(kStatsTag).Set<std::string>();
+  }
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status StatsReporterCalculator::Open(CalculatorContext* cc) {
+  cc->SetOffset(TimestampDiff(0));
+  options_ = cc->Options<StatsReporterCalculatorOptions>();
+  RET_CHECK_GT(options_.report_interval_s(), 0);
+  RET_CHECK(options_.has_output_file() || cc->Outputs().HasTag(kStatsTag))
+      << "Set output_file or connect STATS, there is nowhere to report.";
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status StatsReporterCalculator::Process(CalculatorContext* cc) {
+  if (next_report_ == Timestamp::Unset()) {
+    next_report_ = cc->InputTimestamp() +
+                   TimestampDiff(options_.report_interval_s() *
+                                 Timestamp::kTimestampUnitsPerSecond);
+    return ::mediapipe::OkStatus();
+  }
+  if (cc->InputTimestamp() < next_report_) return ::mediapipe::OkStatus();
+  next_report_ = cc->InputTimestamp() +
+                 TimestampDiff(options_.report_interval_s() *
+                               Timestamp::kTimestampUnitsPerSecond);
+  return Report(cc);
+}
+
+::mediapipe::Status StatsReporterCalculator::Close(CalculatorContext* cc) {
+  // The timestamps may be exhausted already, STATS only gets the
+  // periodic reports
+  if (!options_.has_output_file()) return ::mediapipe::OkStatus();
+  return WriteOutputFile(calculator_stats::RenderPrometheusText());
+}
+
+::mediapipe::Status StatsReporterCalculator::Report(CalculatorContext* cc) {
+  std::string text = calculator_stats::RenderPrometheusText();
+  if (options_.has_output_file()) MP_RETURN_IF_ERROR(WriteOutputFile(text));
+  if (cc->Outputs().HasTag(kStatsTag)) {
+    cc->Outputs().Tag(kStatsTag).AddPacket(
+        MakePacket<std::string>(std::move(text)).At(cc->InputTimestamp()));
+  }
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status StatsReporterCalculator::WriteOutputFile(
+    const std::string& text) {
+  // Renamed into place, so a scrape never reads half a file
+  const std::string tmp_file = absl::StrCat(options_.output_file(), ".tmp");
+  MP_RETURN_IF_ERROR(file::SetContents(tmp_file, text));
+  RET_CHECK_EQ(std::rename(tmp_file.c_str(), options_.output_file().c_str()),
+               0)
+      << "Can't rename " << tmp_file;
+  return ::mediapipe::OkStatus();
+}
+
+}  // namespace mediapipe
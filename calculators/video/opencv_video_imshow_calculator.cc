@@ -14,18 +14,20 @@
 
 #include <memory>
 #include <string>
-#include <vector>
+#include <thread>
+#include <utility>
 
-#include "absl/strings/str_split.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 #include "mediapipe/calculators/video/opencv_video_encoder_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/formats/image_frame.h"
 #include "mediapipe/framework/formats/image_frame_opencv.h"
 #include "mediapipe/framework/formats/video_stream_header.h"
-#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/logging.h"
 #include "mediapipe/framework/port/opencv_highgui_inc.h"
 #include "mediapipe/framework/port/opencv_imgproc_inc.h"
-#include "mediapipe/framework/port/opencv_video_inc.h"
 #include "mediapipe/framework/port/ret_check.h"
 #include "mediapipe/framework/port/source_location.h"
 #include "mediapipe/framework/port/status.h"
@@ -34,20 +36,87 @@
 
 namespace mediapipe {
 
-// Encodes the input video stream and produces a media file.
-// The media file can be output to the output_file_path specified as a side
-// packet. Currently, the calculator only supports one video stream (in
-// mediapipe::ImageFrame).
+namespace {
+
+constexpr char kWindowName[] = "MediaPipe";
+// Longest the UI thread goes without pumping the window events
+constexpr int kUiPollMs = 30;
+
+// Single slot handing the frames from Process to the UI thread. Only the
+// latest frame is kept, a frame not shown yet when the next one arrives is
+// dropped, so a slow display never holds the graph back.
+class LatestFrameMailbox {
+ public:
+  // Replaces the frame waiting to be shown, if any
+  void Put(const Packet& packet) {
+    absl::MutexLock lock(&mutex_);
+    if (!pending_.IsEmpty()) ++dropped_;
+    pending_ = packet;
+  }
+
+  // Waits up to timeout for a frame. Returns false when there is none or
+  // the mailbox is closed.
+  bool Take(absl::Duration timeout, Packet* packet) {
+    absl::MutexLock lock(&mutex_);
+    mutex_.AwaitWithTimeout(
+        absl::Condition(
+            +[](LatestFrameMailbox* mailbox) {
+              return mailbox->closed_ || !mailbox->pending_.IsEmpty();
+            },
+            this),
+        timeout);
+    if (closed_ || pending_.IsEmpty()) return false;
+    *packet = std::move(pending_);
+    pending_ = Packet();
+    return true;
+  }
+
+  void Close() {
+    absl::MutexLock lock(&mutex_);
+    closed_ = true;
+    pending_ = Packet();
+  }
+
+  bool closed() {
+    absl::MutexLock lock(&mutex_);
+    return closed_;
+  }
+
+  int64 dropped() {
+    absl::MutexLock lock(&mutex_);
+    return dropped_;
+  }
+
+ private:
+  absl::Mutex mutex_;
+  Packet pending_ GUARDED_BY(mutex_);
+  bool closed_ GUARDED_BY(mutex_) = false;
+  int64 dropped_ GUARDED_BY(mutex_) = 0;
+};
+
+}  // namespace
+
+// Shows the input video stream in a window, for debugging and monitoring.
+//
+// Process only hands the frame packet to a UI thread owned by the
+// calculator, through a single slot mailbox where the latest frame wins,
+// and returns. The UI thread converts the frame to BGR, shows it and pumps
+// the window events with cv::waitKey(1), so neither the conversion nor the
+// display pace the graph. Frames arriving faster than they can be shown
+// are dropped, the count is logged at Close. GRAY8 frames are shown as
+// they are, without conversion.
 //
-// Example config to generate the output video file:
+// The OpenCvVideoEncoderCalculatorOptions are still read, as in the
+// OpenCvVideoEncoderCalculator this calculator stands in for.
+//
+// Example config:
 //
 // node {
 //   calculator: "OpenCvVideoImShowCalculator"
 //   input_stream: "VIDEO:video"
 //   input_stream: "VIDEO_PRESTREAM:video_header"
-//   input_side_packet: "OUTPUT_FILE_PATH:output_file_path"
 //   node_options {
-//     [type.googleapis.com/mediapipe.OpenCvVideoImShowCalculatorOptions]: {
+//     [type.googleapis.com/mediapipe.OpenCvVideoEncoderCalculatorOptions]: {
 //        codec: "avc1"
 //        video_format: "mp4"
 //     }
@@ -61,12 +130,17 @@ class OpenCvVideoImShowCalculator : public CalculatorBase {
   ::mediapipe::Status Close(CalculatorContext* cc) override;
 
  private:
-  ::mediapipe::Status SetUpVideoWriter();
-
-  std::string output_file_path_;
-  int four_cc_;
+  // Body of the UI thread, owns the window
+  void UiLoop();
+  // BGR or gray Mat to show for the frame, empty if it can't be shown.
+  // Color frames are converted into display_frame_, gray ones are views of
+  // image_frame.
+  cv::Mat ToDisplayFrame(const ImageFrame& image_frame);
 
-  std::unique_ptr<cv::VideoWriter> writer_;
+  LatestFrameMailbox mailbox_;
+  std::thread ui_thread_;
+  // Reused by the UI thread for the color conversion
+  cv::Mat display_frame_;
 };
 
 ::mediapipe::Status OpenCvVideoImShowCalculator::GetContract(
@@ -76,8 +150,6 @@ class OpenCvVideoImShowCalculator : public CalculatorBase {
   if (cc->Inputs().HasTag("VIDEO_PRESTREAM")) {
     cc->Inputs().Tag("VIDEO_PRESTREAM").Set<VideoHeader>();
   }
-  //RET_CHECK(cc->InputSidePackets().HasTag("OUTPUT_FILE_PATH"));
-  //cc->InputSidePackets().Tag("OUTPUT_FILE_PATH").Set<std::string>();
   return ::mediapipe::OkStatus();
 }
 
@@ -87,81 +159,77 @@ class OpenCvVideoImShowCalculator : public CalculatorBase {
   RET_CHECK(options.has_codec() && options.codec().length() == 4)
       << "A 4-character codec code must be specified in "
          "OpenCvVideoEncoderCalculatorOptions";
-  const char* codec_array = options.codec().c_str();
-  four_cc_ = mediapipe::fourcc(codec_array[0], codec_array[1], codec_array[2],
-                               codec_array[3]);
   RET_CHECK(!options.video_format().empty())
       << "Video format must be specified in "
          "OpenCvVideoEncoderCalculatorOptions";
- /* output_file_path_ =
-      cc->InputSidePackets().Tag("OUTPUT_FILE_PATH").Get<std::string>();
-  std::vector<std::string> splited_file_path =
-      absl::StrSplit(output_file_path_, '.');
-  RET_CHECK(splited_file_path.size() >= 2 &&
-            splited_file_path[splited_file_path.size() - 1] ==
-                options.video_format())
-      << "The output file path is invalid.";*/
-  // If the video header will be available, the video metadata will be fetched
-  // from the video header directly. The calculator will receive the video
-  // header packet at timestamp prestream.
-  if (cc->Inputs().HasTag("VIDEO_PRESTREAM")) {
-    return ::mediapipe::OkStatus();
-  }
-  return SetUpVideoWriter();
+
+  // HighGUI wants the window created, drawn and pumped on a single thread
+  ui_thread_ = std::thread([this]() { UiLoop(); });
+  return ::mediapipe::OkStatus();
 }
 
 ::mediapipe::Status OpenCvVideoImShowCalculator::Process(
     CalculatorContext* cc) {
   if (cc->InputTimestamp() == Timestamp::PreStream()) {
-    //const VideoHeader& video_header =
-    //    cc->Inputs().Tag("VIDEO_PRESTREAM").Get<VideoHeader>();
-    return SetUpVideoWriter();
+    return ::mediapipe::OkStatus();
   }
 
-  const ImageFrame& image_frame =
-      cc->Inputs().Tag("VIDEO").Value().Get<ImageFrame>();
-  ImageFormat::Format format = image_frame.Format();
-  cv::Mat frame;
-  if (format == ImageFormat::GRAY8) {
-    frame = formats::MatView(&image_frame);
-    if (frame.empty()) {
-      return ::mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
-             << "Receive empty frame at timestamp "
-             << cc->Inputs().Tag("VIDEO").Value().Timestamp()
-             << " in OpenCvVideoImShowCalculator::Process()";
-    }
-  } else {
-    cv::Mat tmp_frame = formats::MatView(&image_frame);
-    if (tmp_frame.empty()) {
-      return ::mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
-             << "Receive empty frame at timestamp "
-             << cc->Inputs().Tag("VIDEO").Value().Timestamp()
-             << " in OpenCvVideoImShowCalculator::Process()";
-    }
-    if (format == ImageFormat::SRGB) {
-      cv::cvtColor(tmp_frame, frame, cv::COLOR_RGB2BGR);
-    } else if (format == ImageFormat::SRGBA) {
-      cv::cvtColor(tmp_frame, frame, cv::COLOR_RGBA2BGR);
-    } else {
-      return ::mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
-             << "Unsupported image format: " << format;
-    }
+  const Packet& packet = cc->Inputs().Tag("VIDEO").Value();
+  if (packet.Get<ImageFrame>().IsEmpty()) {
+    return ::mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
+           << "Receive empty frame at timestamp " << packet.Timestamp()
+           << " in OpenCvVideoImShowCalculator::Process()";
+  }
+  const ImageFormat::Format format = packet.Get<ImageFrame>().Format();
+  if (format != ImageFormat::GRAY8 && format != ImageFormat::SRGB &&
+      format != ImageFormat::SRGBA) {
+    return ::mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
+           << "Unsupported image format: " << format;
   }
-  cv::imshow("MediaPipe",frame);
-  cv::waitKey(25);
-  
+  // The packet keeps the frame alive until the UI thread is done with it
+  mailbox_.Put(packet);
+
   return ::mediapipe::OkStatus();
 }
 
 ::mediapipe::Status OpenCvVideoImShowCalculator::Close(CalculatorContext* cc) {
-  //cv::destroyAllWindows();
+  mailbox_.Close();
+  if (ui_thread_.joinable()) ui_thread_.join();
+  LOG(INFO) << "OpenCvVideoImShowCalculator dropped " << mailbox_.dropped()
+            << " frames the display couldn't keep up with.";
   return ::mediapipe::OkStatus();
 }
 
-::mediapipe::Status OpenCvVideoImShowCalculator::SetUpVideoWriter() {
+cv::Mat OpenCvVideoImShowCalculator::ToDisplayFrame(
+    const ImageFrame& image_frame) {
+  const cv::Mat frame = formats::MatView(&image_frame);
+  switch (image_frame.Format()) {
+    case ImageFormat::GRAY8:
+      return frame;
+    case ImageFormat::SRGB:
+      cv::cvtColor(frame, display_frame_, cv::COLOR_RGB2BGR);
+      return display_frame_;
+    case ImageFormat::SRGBA:
+      cv::cvtColor(frame, display_frame_, cv::COLOR_RGBA2BGR);
+      return display_frame_;
+    default:
+      return cv::Mat();
+  }
+}
 
-  cv::namedWindow("MediaPipe",cv::WINDOW_GUI_EXPANDED);
-  return ::mediapipe::OkStatus();
+void OpenCvVideoImShowCalculator::UiLoop() {
+  cv::namedWindow(kWindowName, cv::WINDOW_GUI_EXPANDED);
+  Packet packet;
+  while (!mailbox_.closed()) {
+    if (mailbox_.Take(absl::Milliseconds(kUiPollMs), &packet)) {
+      const cv::Mat display = ToDisplayFrame(packet.Get<ImageFrame>());
+      if (!display.empty()) cv::imshow(kWindowName, display);
+      // Gray frames are views of the packet, released only once shown
+      packet = Packet();
+    }
+    cv::waitKey(1);
+  }
+  cv::destroyWindow(kWindowName);
 }
 
 REGISTER_CALCULATOR(OpenCvVideoImShowCalculator);
@@ -0,0 +1,386 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Throughput benchmark of the gestures graphs.
+//
+// Landmarks mode replays recorded landmarks, the CSV files of trainingData
+// or BINARY recordings of LandmarksAndAnglesToFileCalculator, through
+// gestures_benchmark.pbtxt, so only the gestures calculators are measured.
+// Video mode decodes --max_frames of a video up front and feeds them as
+// fast as possible to a full graph, ie mainGraph_server.pbtxt; the frames
+// getting through the FlowLimiterCalculator are the processed ones.
+//
+// Frames/sec counts the packets of --count_stream, the first output stream
+// of the graph by default, from the end of the warmup to the last counted
+// packet, so neither the frames dropped by the graph nor its drain at the
+// end count. The MqttPublisherCalculator nodes of the graph are removed,
+// the benchmark never needs a broker.
+//
+// Reports frames/sec, heap allocations per frame (of the whole process,
+// feeding included) and the p50/p99 Process time of every node, taken
+// from the MediaPipe profiler.
+//
+// Usage:
+//   dynamic_gestures_benchmark \
+//     --calculator_graph_config_file=myMediapipe/graphs/dynamicGestures/gestures_benchmark.pbtxt \
+//     --landmarks_files=myMediapipe/projects/staticGestures/trainingData/101019_1328/fist.csv
+//
+//   dynamic_gestures_benchmark \
+//     --calculator_graph_config_file=myMediapipe/graphs/dynamicGestures/mainGraph_server.pbtxt \
+//     --video_file=myMediapipe/projects/dynamicGestures/videos/volume.mp4 \
+//     --count_stream=throttled_input_video
+//
+// The thread splits of the hand tracking graphs are compared by running
+// the same video with different --executor_threads and --tflite_threads
+// (see executor_config.h), ie on mainGraph_desktop_cam_pipelined.pbtxt:
+//   --executor_threads=palm_detection:1,hand_landmark:1,default:2 \
+//   --tflite_threads=palm_detection:2,hand_landmark:1
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/calculator_profile.pb.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/landmark.pb.h"
+#include "mediapipe/framework/port/commandlineflags.h"
+#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/opencv_video_inc.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/thread_pool_executor.h"
+#include "myMediapipe/calculators/util/landmark_recorder.h"
+#include "myMediapipe/projects/dynamicGestures/executor_config.h"
+#include "myMediapipe/projects/dynamicGestures/frame_pool.h"
+
+DEFINE_string(
+    calculator_graph_config_file, "",
+    "Name of file containing text format CalculatorGraphConfig proto.");
+DEFINE_string(landmarks_files, "",
+              "Comma separated recordings to replay, .csv files are read as "
+              "trainingData, the rest as BINARY recordings.");
+DEFINE_string(video_file, "", "Video to feed instead of landmarks.");
+DEFINE_int32(max_frames, 100,
+             "Frames of --video_file decoded and kept in memory.");
+DEFINE_int32(repeat, 10, "Times the frames are replayed.");
+DEFINE_int32(warmup_frames, 30,
+             "Frames fed before measuring, not counted in frames/sec.");
+DEFINE_int64(frame_interval_us, 33333,
+             "Timestamp increment between frames, the dynamic gestures "
+             "calculators time their actions with it.");
+DEFINE_string(count_stream, "",
+              "Stream whose packets are the processed frames, ie "
+              "throttled_input_video in video mode. Empty uses the first "
+              "output stream of the graph.");
+DEFINE_int32(histogram_interval_us, 10,
+             "Resolution of the per node latency histograms.");
+DEFINE_int32(num_histogram_intervals, 10000,
+             "Intervals of the histograms, longer Process calls are "
+             "counted in the last one.");
+DEFINE_int32(num_threads, 0,
+             "Threads of the executor provided to the graph, used as the "
+             "default one and for the executors declared without a type. "
+             "0 uses one per core.");
+DEFINE_string(executor_threads, "",
+              "Threads of the ThreadPoolExecutors of the graph, ie "
+              "'palm_detection:1,hand_landmark:1'.");
+DEFINE_string(tflite_threads, "",
+              "TfLite interpreter threads of the models, by executor, ie "
+              "'palm_detection:2,hand_landmark:1'.");
+
+namespace {
+
+constexpr char kLandmarksStream[] = "hand_landmarks";
+constexpr char kPresenceStream[] = "hand_presence";
+constexpr char kVideoStream[] = "input_video";
+constexpr char kMqttPublisherCalculator[] = "MqttPublisherCalculator";
+
+std::atomic<int64> heap_allocations(0);
+
+}  // namespace
+
+// Counts every heap allocation of the process
+void* operator new(size_t size) {
+  heap_allocations.fetch_add(1, std::memory_order_relaxed);
+  void* ptr = std::malloc(size ? size : 1);
+  if (!ptr) throw std::bad_alloc();
+  return ptr;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+
+namespace {
+
+::mediapipe::Status ReadCsvFrames(
+    const std::string& path,
+    std::vector<mediapipe::NormalizedLandmarkList>* frames) {
+  std::string contents;
+  MP_RETURN_IF_ERROR(mediapipe::file::GetContents(path, &contents));
+  mediapipe::NormalizedLandmarkList frame;
+  for (absl::string_view line : absl::StrSplit(contents, '\n')) {
+    if (line.empty()) continue;
+    std::vector<absl::string_view> fields = absl::StrSplit(line, ',');
+    RET_CHECK_EQ(fields.size(), 5) << "Bad line in " << path << ": " << line;
+    float x, y;
+    RET_CHECK(absl::SimpleAtof(fields[1], &x) &&
+              absl::SimpleAtof(fields[2], &y))
+        << "Bad line in " << path << ": " << line;
+    auto* landmark = frame.add_landmark();
+    landmark->set_x(x);
+    landmark->set_y(y);
+    if (frame.landmark_size() ==
+        mediapipe::landmark_recorder::kNumLandmarks) {
+      frames->push_back(frame);
+      frame.Clear();
+    }
+  }
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status ReadRecordedFrames(
+    const std::string& path,
+    std::vector<mediapipe::NormalizedLandmarkList>* frames) {
+  std::vector<mediapipe::landmark_recorder::Record> records;
+  MP_RETURN_IF_ERROR(
+      mediapipe::landmark_recorder::ReadRecords(path, &records));
+  for (const auto& record : records) {
+    mediapipe::NormalizedLandmarkList frame;
+    for (int i = 0; i < mediapipe::landmark_recorder::kNumLandmarks; ++i) {
+      auto* landmark = frame.add_landmark();
+      landmark->set_x(record.xy[i][0]);
+      landmark->set_y(record.xy[i][1]);
+    }
+    frames->push_back(frame);
+  }
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status ReadVideoFrames(const std::string& path,
+                                    std::vector<cv::Mat>* frames) {
+  cv::VideoCapture capture(path);
+  RET_CHECK(capture.isOpened()) << "Can't open " << path;
+  cv::Mat frame;
+  while (static_cast<int>(frames->size()) < FLAGS_max_frames) {
+    capture >> frame;
+    if (frame.empty()) break;
+    frames->push_back(frame.clone());
+  }
+  RET_CHECK(!frames->empty()) << "No frames in " << path;
+  return ::mediapipe::OkStatus();
+}
+
+// Upper bound of the interval holding the q quantile
+int64 Percentile(const mediapipe::TimeHistogram& histogram, double q) {
+  int64 total = 0;
+  for (int64 count : histogram.count()) total += count;
+  if (total == 0) return 0;
+  const int64 rank = std::max<int64>(1, static_cast<int64>(q * total));
+  int64 cumulative = 0;
+  for (int i = 0; i < histogram.count_size(); ++i) {
+    cumulative += histogram.count(i);
+    if (cumulative >= rank) return (i + 1) * histogram.interval_size_usec();
+  }
+  return histogram.count_size() * histogram.interval_size_usec();
+}
+
+void PrintNodeLatencies(mediapipe::CalculatorGraph* graph) {
+  std::vector<mediapipe::CalculatorProfile> profiles;
+  ::mediapipe::Status status =
+      graph->profiler()->GetCalculatorProfiles(&profiles);
+  if (!status.ok() || profiles.empty()) {
+    LOG(WARNING) << "No profiles, is the profiler compiled in? "
+                 << status.message();
+    return;
+  }
+  std::sort(profiles.begin(), profiles.end(),
+            [](const mediapipe::CalculatorProfile& a,
+               const mediapipe::CalculatorProfile& b) {
+              return a.process_runtime().total() >
+                     b.process_runtime().total();
+            });
+  std::printf("%-48s %10s %10s %10s %10s\n", "node", "calls", "mean_us",
+              "p50_us", "p99_us");
+  for (const auto& profile : profiles) {
+    const auto& runtime = profile.process_runtime();
+    int64 calls = 0;
+    for (int64 count : runtime.count()) calls += count;
+    if (calls == 0) continue;
+    std::printf("%-48s %10lld %10lld %10lld %10lld\n", profile.name().c_str(),
+                static_cast<long long>(calls),
+                static_cast<long long>(runtime.total() / calls),
+                static_cast<long long>(Percentile(runtime, 0.5)),
+                static_cast<long long>(Percentile(runtime, 0.99)));
+  }
+}
+
+}  // namespace
+
+::mediapipe::Status RunBenchmark() {
+  std::string calculator_graph_config_contents;
+  MP_RETURN_IF_ERROR(mediapipe::file::GetContents(
+      FLAGS_calculator_graph_config_file, &calculator_graph_config_contents));
+  mediapipe::CalculatorGraphConfig config =
+      mediapipe::ParseTextProtoOrDie<mediapipe::CalculatorGraphConfig>(
+          calculator_graph_config_contents);
+  auto* profiler_config = config.mutable_profiler_config();
+  profiler_config->set_enable_profiler(true);
+  profiler_config->set_histogram_interval_size_usec(
+      FLAGS_histogram_interval_us);
+  profiler_config->set_num_histogram_intervals(FLAGS_num_histogram_intervals);
+  MP_RETURN_IF_ERROR(mediapipe::executor_config::SetExecutorThreads(
+      FLAGS_executor_threads, &config));
+  MP_RETURN_IF_ERROR(
+      mediapipe::executor_config::SetTfLiteThreads(FLAGS_tflite_threads,
+                                                   &config));
+  auto* nodes = config.mutable_node();
+  nodes->erase(
+      std::remove_if(nodes->begin(), nodes->end(),
+                     [](const mediapipe::CalculatorGraphConfig::Node& node) {
+                       return node.calculator() == kMqttPublisherCalculator;
+                     }),
+      nodes->end());
+
+  std::string count_stream = FLAGS_count_stream;
+  if (count_stream.empty()) {
+    RET_CHECK_GT(config.output_stream_size(), 0)
+        << "Set --count_stream, the graph has no output stream.";
+    // Drops the tag of "TAG:name"
+    count_stream = config.output_stream(0);
+    count_stream = count_stream.substr(count_stream.rfind(':') + 1);
+  }
+
+  const bool video_mode = !FLAGS_video_file.empty();
+  RET_CHECK(video_mode != !FLAGS_landmarks_files.empty())
+      << "Set either --landmarks_files or --video_file.";
+  std::vector<mediapipe::NormalizedLandmarkList> landmark_frames;
+  std::vector<cv::Mat> video_frames;
+  if (video_mode) {
+    MP_RETURN_IF_ERROR(ReadVideoFrames(FLAGS_video_file, &video_frames));
+  } else {
+    const std::vector<std::string> paths =
+        absl::StrSplit(FLAGS_landmarks_files, ',', absl::SkipEmpty());
+    for (const std::string& path : paths) {
+      if (absl::EndsWith(path, ".csv")) {
+        MP_RETURN_IF_ERROR(ReadCsvFrames(path, &landmark_frames));
+      } else {
+        MP_RETURN_IF_ERROR(ReadRecordedFrames(path, &landmark_frames));
+      }
+    }
+    RET_CHECK(!landmark_frames.empty()) << "No frames to replay.";
+  }
+  const int num_frames =
+      video_mode ? video_frames.size() : landmark_frames.size();
+  const int total_frames = num_frames * FLAGS_repeat;
+  RET_CHECK_GT(total_frames, FLAGS_warmup_frames)
+      << "Not enough frames to measure after the warmup.";
+
+  const int num_threads = FLAGS_num_threads > 0
+                              ? FLAGS_num_threads
+                              : std::thread::hardware_concurrency();
+  std::printf("threads: %d, executors: '%s', tflite: '%s'\n", num_threads,
+              FLAGS_executor_threads.c_str(), FLAGS_tflite_threads.c_str());
+  mediapipe::CalculatorGraph graph;
+  MP_RETURN_IF_ERROR(mediapipe::executor_config::ProvideExecutors(
+      config, std::make_shared<mediapipe::ThreadPoolExecutor>(num_threads),
+      &graph));
+  MP_RETURN_IF_ERROR(graph.Initialize(config));
+  // Time and allocations at the last counted packet, the end of the
+  // measure
+  std::atomic<int64> processed_frames(0);
+  std::atomic<int64> last_counted_ns(0);
+  std::atomic<int64> last_allocations(0);
+  MP_RETURN_IF_ERROR(graph.ObserveOutputStream(
+      count_stream, [&](const mediapipe::Packet&) {
+        ++processed_frames;
+        last_counted_ns = absl::GetCurrentTimeNanos();
+        last_allocations = heap_allocations.load();
+        return ::mediapipe::OkStatus();
+      }));
+  MP_RETURN_IF_ERROR(graph.StartRun({}));
+
+  int64 start_ns = 0;
+  int64 start_allocations = 0;
+  int64 start_processed = 0;
+  for (int i = 0; i < total_frames; ++i) {
+    if (i == FLAGS_warmup_frames) {
+      MP_RETURN_IF_ERROR(graph.WaitUntilIdle());
+      start_ns = absl::GetCurrentTimeNanos();
+      start_allocations = heap_allocations.load();
+      start_processed = processed_frames.load();
+    }
+    const mediapipe::Timestamp timestamp(i * FLAGS_frame_interval_us);
+    if (video_mode) {
+      const cv::Mat& bgr = video_frames[i % num_frames];
+      auto frame = absl::make_unique<mediapipe::ImageFrame>(
+          mediapipe::ImageFormat::SRGB, bgr.cols, bgr.rows,
+          mediapipe::ImageFrame::kDefaultAlignmentBoundary);
+      mediapipe::CopyBgrToRgb(bgr, /*mirror=*/false, frame.get());
+      MP_RETURN_IF_ERROR(graph.AddPacketToInputStream(
+          kVideoStream, mediapipe::Adopt(frame.release()).At(timestamp)));
+    } else {
+      MP_RETURN_IF_ERROR(graph.AddPacketToInputStream(
+          kLandmarksStream,
+          mediapipe::MakePacket<mediapipe::NormalizedLandmarkList>(
+              landmark_frames[i % num_frames])
+              .At(timestamp)));
+      MP_RETURN_IF_ERROR(graph.AddPacketToInputStream(
+          kPresenceStream, mediapipe::MakePacket<bool>(true).At(timestamp)));
+    }
+  }
+  MP_RETURN_IF_ERROR(graph.CloseAllInputStreams());
+  MP_RETURN_IF_ERROR(graph.WaitUntilDone());
+
+  const int64 measured_frames = processed_frames.load() - start_processed;
+  RET_CHECK_GT(measured_frames, 0)
+      << "No packets on " << count_stream << " after the warmup.";
+  const double seconds = (last_counted_ns.load() - start_ns) * 1e-9;
+  const int64 allocations = last_allocations.load() - start_allocations;
+  std::printf("frames: %lld in %.3f s, %.1f frames/sec\n",
+              static_cast<long long>(measured_frames), seconds,
+              measured_frames / seconds);
+  std::printf("heap allocations per frame: %.1f\n",
+              measured_frames > 0
+                  ? static_cast<double>(allocations) / measured_frames
+                  : 0.0);
+  PrintNodeLatencies(&graph);
+  return ::mediapipe::OkStatus();
+}
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  ::mediapipe::Status run_status = RunBenchmark();
+  if (!run_status.ok()) {
+    LOG(ERROR) << "Failed to run the benchmark: " << run_status.message();
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+# Copyright 2020 Lisandro Bravo.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Compares the thread splits of the hand tracking graphs on 4 and 8 cores.
+
+Runs dynamic_gestures_benchmark over the same video for every graph, core
+count and split below. Each run is pinned with taskset to the first N
+cores, so a bigger box measures the smaller ones too, and the executor
+of the runner gets N threads. The frames/sec and heap allocations per
+frame of every run are written as a markdown table to --output_file.
+
+Build the benchmark first:
+  bazel build -c opt --define MEDIAPIPE_DISABLE_GPU=1 \
+    myMediapipe/projects/dynamicGestures:dynamic_gestures_benchmark
+
+Usage:
+  python3 myMediapipe/projects/dynamicGestures/benchmark_thread_splits.py \
+    --benchmark=bazel-bin/myMediapipe/projects/dynamicGestures/dynamic_gestures_benchmark \
+    --video_file=myMediapipe/projects/dynamicGestures/videos/volume.mp4 \
+    --output_file=myMediapipe/projects/dynamicGestures/thread_splits.md
+"""
+
+import argparse
+import os
+import re
+import subprocess
+
+GRAPHS_DIR = 'myMediapipe/graphs/dynamicGestures'
+GRAPHS = [
+    'mainGraph_desktop_cam.pbtxt',
+    'mainGraph_desktop_cam_pipelined.pbtxt',
+]
+CORES = [4, 8]
+
+# (--executor_threads, --tflite_threads) of every run, {half} is half the
+# cores. The default executor always gets all the cores of the run.
+SPLITS = [
+    ('palm_detection:1,hand_landmark:1', 'palm_detection:1,hand_landmark:1'),
+    ('palm_detection:1,hand_landmark:1', 'palm_detection:2,hand_landmark:1'),
+    ('palm_detection:1,hand_landmark:1', 'palm_detection:2,hand_landmark:2'),
+    ('palm_detection:1,hand_landmark:1', 'palm_detection:{half},'
+     'hand_landmark:{half}'),
+]
+
+FRAMES_RE = re.compile(r'frames: (\d+) in ([\d.]+) s, ([\d.]+) frames/sec')
+ALLOCATIONS_RE = re.compile(r'heap allocations per frame: ([\d.]+)')
+
+
+def run_benchmark(args, graph, cores, executor_threads, tflite_threads):
+  """Returns (frames/sec, allocations per frame) of one run."""
+  command = [
+      'taskset', '-c', '0-%d' % (cores - 1), args.benchmark,
+      '--calculator_graph_config_file=%s' % os.path.join(GRAPHS_DIR, graph),
+      '--video_file=%s' % args.video_file,
+      '--count_stream=throttled_input_video',
+      '--num_threads=%d' % cores,
+      '--executor_threads=%s' % executor_threads,
+      '--tflite_threads=%s' % tflite_threads,
+      '--repeat=%d' % args.repeat,
+  ]
+  output = subprocess.run(
+      command, check=True, stdout=subprocess.PIPE,
+      universal_newlines=True).stdout
+  frames = FRAMES_RE.search(output)
+  allocations = ALLOCATIONS_RE.search(output)
+  if not frames or not allocations:
+    raise RuntimeError('Unexpected benchmark output:\n' + output)
+  return float(frames.group(3)), float(allocations.group(1))
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+  parser.add_argument('--benchmark', required=True)
+  parser.add_argument('--video_file', required=True)
+  parser.add_argument('--output_file', required=True)
+  parser.add_argument('--repeat', type=int, default=10)
+  args = parser.parse_args()
+
+  rows = []
+  for cores in CORES:
+    if cores > os.cpu_count():
+      print('Skipping %d cores, only %d here' % (cores, os.cpu_count()))
+      continue
+    for graph in GRAPHS:
+      for executor_threads, tflite_threads in SPLITS:
+        tflite_threads = tflite_threads.format(half=max(1, cores // 2))
+        fps, allocations = run_benchmark(args, graph, cores,
+                                         executor_threads, tflite_threads)
+        print('%d cores, %s, %s: %.1f frames/sec' %
+              (cores, graph, tflite_threads, fps))
+        rows.append((cores, graph, executor_threads, tflite_threads, fps,
+                     allocations))
+
+  with open(args.output_file, 'w') as output:
+    output.write('Thread splits on %s, %d repeats\n\n' %
+                 (os.path.basename(args.video_file), args.repeat))
+    output.write('| cores | graph | executor_threads | tflite_threads '
+                 '| frames/sec | allocations/frame |\n')
+    output.write('|---|---|---|---|---|---|\n')
+    for row in rows:
+      output.write('| %d | %s | %s | %s | %.1f | %.1f |\n' % row)
+
+
+if __name__ == '__main__':
+  main()
@@ -13,8 +13,12 @@
 // limitations under the License.
 //
 // An example of sending OpenCV webcam frames into a MediaPipe graph.
+#include <atomic>
 #include <cstdlib>
+#include <thread>
 
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/formats/image_frame.h"
 #include "mediapipe/framework/formats/image_frame_opencv.h"
@@ -25,6 +29,9 @@
 #include "mediapipe/framework/port/opencv_video_inc.h"
 #include "mediapipe/framework/port/parse_text_proto.h"
 #include "mediapipe/framework/port/status.h"
+#include "myMediapipe/projects/dynamicGestures/executor_config.h"
+#include "myMediapipe/projects/dynamicGestures/frame_pool.h"
+#include "myMediapipe/projects/dynamicGestures/frame_ring.h"
 
 constexpr char kInputStream[] = "input_video";
 constexpr char kOutputStream[] = "output_video";
@@ -39,6 +46,182 @@ DEFINE_string(input_video_path, "",
 DEFINE_string(output_video_path, "",
               "Full path of where to save result (.mp4 only). "
               "If not provided, show result in a window.");
+DEFINE_int32(frame_pool_size, 4,
+             "Number of input frame buffers recycled between camera frames. "
+             "Frames are dropped while all of them are in use by the graph.");
+DEFINE_bool(pipelined, false,
+            "Capture on a dedicated thread and feed the graph from a "
+            "bounded ring, so capture overlaps with graph execution. "
+            "Backpressure is left to the FlowLimiterCalculator of the graph.");
+DEFINE_int32(pipeline_queue_size, 2,
+             "Frames the ring between the capture thread and the graph can "
+             "hold in --pipelined mode. A live camera drops the oldest one "
+             "when it is full, a video file waits.");
+DEFINE_string(executor_threads, "",
+              "Threads of the executors of the graph, ie "
+              "'palm_detection:1,hand_landmark:1,default:2'. Empty keeps "
+              "the ones of the graph.");
+DEFINE_string(tflite_threads, "",
+              "TfLite interpreter threads of the models, by executor, ie "
+              "'palm_detection:2,hand_landmark:1'. Empty keeps the ones of "
+              "the graph.");
+
+namespace {
+
+int64 NowMicros() {
+  return (double)cv::getTickCount() / (double)cv::getTickFrequency() * 1e6;
+}
+
+// Displays or writes one output frame. grab_frames is cleared when a key
+// is pressed on the window.
+::mediapipe::Status HandleOutputFrame(const mediapipe::Packet& packet,
+                                      bool save_video, double fps,
+                                      cv::VideoWriter* writer,
+                                      bool* grab_frames) {
+  auto& output_frame = packet.Get<mediapipe::ImageFrame>();
+
+  // Convert back to opencv for display or saving.
+  cv::Mat output_frame_mat = mediapipe::formats::MatView(&output_frame);
+  cv::cvtColor(output_frame_mat, output_frame_mat, cv::COLOR_RGB2BGR);
+  if (save_video) {
+    if (!writer->isOpened()) {
+      LOG(INFO) << "Prepare video writer.";
+      writer->open(FLAGS_output_video_path,
+                   mediapipe::fourcc('a', 'v', 'c', '1'),  // .mp4
+                   fps, output_frame_mat.size());
+      RET_CHECK(writer->isOpened());
+    }
+    writer->write(output_frame_mat);
+  } else {
+    cv::imshow(kWindowName, output_frame_mat);
+    // Press any key to exit.
+    const int pressed_key = cv::waitKey(5);
+    if (pressed_key >= 0 && pressed_key != 255) *grab_frames = false;
+  }
+  return ::mediapipe::OkStatus();
+}
+
+// One frame at a time: capture, run the graph, wait for its output.
+::mediapipe::Status RunSynchronous(mediapipe::CalculatorGraph* graph,
+                                   cv::VideoCapture* capture,
+                                   mediapipe::OutputStreamPoller* poller,
+                                   bool load_video, bool save_video,
+                                   cv::VideoWriter* writer) {
+  mediapipe::FramePool frame_pool(
+      FLAGS_frame_pool_size, mediapipe::ImageFormat::SRGB,
+      mediapipe::ImageFrame::kDefaultAlignmentBoundary);
+  const double fps = capture->get(cv::CAP_PROP_FPS);
+  // Reused by the capture, so decoding doesn't allocate once warmed up
+  cv::Mat camera_frame_raw;
+  bool grab_frames = true;
+  while (grab_frames) {
+    // Capture opencv camera or video frame.
+    *capture >> camera_frame_raw;
+    if (camera_frame_raw.empty()) break;  // End of video.
+
+    // Convert and mirror straight into a pooled ImageFrame.
+    auto input_frame =
+        frame_pool.Acquire(camera_frame_raw.cols, camera_frame_raw.rows);
+    if (!input_frame) {
+      LOG_EVERY_N(WARNING, 30) << "All input frames in use, dropping frame.";
+      continue;
+    }
+    mediapipe::CopyBgrToRgb(camera_frame_raw, /*mirror=*/!load_video,
+                            input_frame.get());
+
+    // Send image packet into the graph.
+    MP_RETURN_IF_ERROR(graph->AddPacketToInputStream(
+        kInputStream, mediapipe::Adopt(input_frame.release())
+                          .At(mediapipe::Timestamp(NowMicros()))));
+
+    // Get the graph result packet, or stop if that fails.
+    mediapipe::Packet packet;
+    if (!poller->Next(&packet)) break;
+    MP_RETURN_IF_ERROR(
+        HandleOutputFrame(packet, save_video, fps, writer, &grab_frames));
+  }
+  return graph->CloseInputStream(kInputStream);
+}
+
+// Capture thread -> FrameRing -> feeder thread -> graph, while this
+// thread polls the output. Display stays here since HighGUI windows
+// belong to the main thread.
+::mediapipe::Status RunPipelined(mediapipe::CalculatorGraph* graph,
+                                 cv::VideoCapture* capture,
+                                 mediapipe::OutputStreamPoller* poller,
+                                 bool load_video, bool save_video,
+                                 cv::VideoWriter* writer) {
+  // Frames in the ring hold pool buffers too
+  mediapipe::FramePool frame_pool(
+      FLAGS_frame_pool_size + FLAGS_pipeline_queue_size,
+      mediapipe::ImageFormat::SRGB,
+      mediapipe::ImageFrame::kDefaultAlignmentBoundary);
+  mediapipe::FrameRing ring(FLAGS_pipeline_queue_size,
+                            /*drop_oldest=*/!load_video);
+  const double fps = capture->get(cv::CAP_PROP_FPS);
+  std::atomic<bool> stop(false);
+
+  std::thread capture_thread([&]() {
+    cv::Mat camera_frame_raw;
+    while (!stop) {
+      *capture >> camera_frame_raw;
+      if (camera_frame_raw.empty()) break;  // End of video.
+      mediapipe::CapturedFrame captured;
+      captured.timestamp_us = NowMicros();
+      captured.frame =
+          frame_pool.Acquire(camera_frame_raw.cols, camera_frame_raw.rows);
+      // A video file waits for the graph to release a buffer
+      while (load_video && !captured.frame && !stop) {
+        absl::SleepFor(absl::Milliseconds(1));
+        captured.frame =
+            frame_pool.Acquire(camera_frame_raw.cols, camera_frame_raw.rows);
+      }
+      if (!captured.frame) {
+        LOG_EVERY_N(WARNING, 30) << "All input frames in use, dropping frame.";
+        continue;
+      }
+      mediapipe::CopyBgrToRgb(camera_frame_raw, /*mirror=*/!load_video,
+                              captured.frame.get());
+      if (!ring.Push(std::move(captured))) break;
+    }
+    ring.Close();
+  });
+
+  ::mediapipe::Status feeder_status;
+  std::thread feeder_thread([&]() {
+    mediapipe::CapturedFrame captured;
+    while (ring.Pop(&captured)) {
+      feeder_status = graph->AddPacketToInputStream(
+          kInputStream, mediapipe::Adopt(captured.frame.release())
+                            .At(mediapipe::Timestamp(captured.timestamp_us)));
+      if (!feeder_status.ok()) break;
+    }
+    // Unblocks the capture thread when the graph failed
+    ring.Close();
+    // Ends the run, so the poller returns false after the last frame
+    ::mediapipe::Status close_status = graph->CloseInputStream(kInputStream);
+    if (feeder_status.ok()) feeder_status = close_status;
+  });
+
+  ::mediapipe::Status output_status;
+  bool grab_frames = true;
+  mediapipe::Packet packet;
+  while (grab_frames && poller->Next(&packet)) {
+    output_status =
+        HandleOutputFrame(packet, save_video, fps, writer, &grab_frames);
+    if (!output_status.ok()) break;
+  }
+
+  stop = true;
+  ring.Close();
+  capture_thread.join();
+  feeder_thread.join();
+  LOG(INFO) << "Frames dropped by the capture ring: " << ring.dropped();
+  MP_RETURN_IF_ERROR(output_status);
+  return feeder_status;
+}
+
+}  // namespace
 
 ::mediapipe::Status RunMPPGraph() {
   std::string calculator_graph_config_contents;
@@ -49,6 +232,11 @@ DEFINE_string(output_video_path, "",
   mediapipe::CalculatorGraphConfig config =
       mediapipe::ParseTextProtoOrDie<mediapipe::CalculatorGraphConfig>(
           calculator_graph_config_contents);
+  MP_RETURN_IF_ERROR(mediapipe::executor_config::SetExecutorThreads(
+      FLAGS_executor_threads, &config));
+  MP_RETURN_IF_ERROR(
+      mediapipe::executor_config::SetTfLiteThreads(FLAGS_tflite_threads,
+                                                   &config));
 
   LOG(INFO) << "Initialize the calculator graph.";
   mediapipe::CalculatorGraph graph;
@@ -81,60 +269,15 @@ DEFINE_string(output_video_path, "",
   MP_RETURN_IF_ERROR(graph.StartRun({}));
 
   LOG(INFO) << "Start grabbing and processing frames.";
-  bool grab_frames = true;
-  while (grab_frames) {
-    // Capture opencv camera or video frame.
-    cv::Mat camera_frame_raw;
-    capture >> camera_frame_raw;
-    if (camera_frame_raw.empty()) break;  // End of video.
-    cv::Mat camera_frame;
-    cv::cvtColor(camera_frame_raw, camera_frame, cv::COLOR_BGR2RGB);
-    if (!load_video) {
-      cv::flip(camera_frame, camera_frame, /*flipcode=HORIZONTAL*/ 1);
-    }
-
-    // Wrap Mat into an ImageFrame.
-    auto input_frame = absl::make_unique<mediapipe::ImageFrame>(
-        mediapipe::ImageFormat::SRGB, camera_frame.cols, camera_frame.rows,
-        mediapipe::ImageFrame::kDefaultAlignmentBoundary);
-    cv::Mat input_frame_mat = mediapipe::formats::MatView(input_frame.get());
-    camera_frame.copyTo(input_frame_mat);
-
-    // Send image packet into the graph.
-    size_t frame_timestamp_us =
-        (double)cv::getTickCount() / (double)cv::getTickFrequency() * 1e6;
-    MP_RETURN_IF_ERROR(graph.AddPacketToInputStream(
-        kInputStream, mediapipe::Adopt(input_frame.release())
-                          .At(mediapipe::Timestamp(frame_timestamp_us))));
-
-    // Get the graph result packet, or stop if that fails.
-    mediapipe::Packet packet;
-    if (!poller.Next(&packet)) break;
-    auto& output_frame = packet.Get<mediapipe::ImageFrame>();
-
-    // Convert back to opencv for display or saving.
-    cv::Mat output_frame_mat = mediapipe::formats::MatView(&output_frame);
-    cv::cvtColor(output_frame_mat, output_frame_mat, cv::COLOR_RGB2BGR);
-    if (save_video) {
-      if (!writer.isOpened()) {
-        LOG(INFO) << "Prepare video writer.";
-        writer.open(FLAGS_output_video_path,
-                    mediapipe::fourcc('a', 'v', 'c', '1'),  // .mp4
-                    capture.get(cv::CAP_PROP_FPS), output_frame_mat.size());
-        RET_CHECK(writer.isOpened());
-      }
-      writer.write(output_frame_mat);
-    } else {
-      cv::imshow(kWindowName, output_frame_mat);
-      // Press any key to exit.
-      const int pressed_key = cv::waitKey(5);
-      if (pressed_key >= 0 && pressed_key != 255) grab_frames = false;
-    }
-  }
+  ::mediapipe::Status run_status =
+      FLAGS_pipelined ? RunPipelined(&graph, &capture, &poller, load_video,
+                                     save_video, &writer)
+                      : RunSynchronous(&graph, &capture, &poller, load_video,
+                                       save_video, &writer);
 
   LOG(INFO) << "Shutting down.";
   if (writer.isOpened()) writer.release();
-  MP_RETURN_IF_ERROR(graph.CloseInputStream(kInputStream));
+  MP_RETURN_IF_ERROR(run_status);
   return graph.WaitUntilDone();
 }
 
@@ -29,6 +29,7 @@
 #include "mediapipe/gpu/gl_calculator_helper.h"
 #include "mediapipe/gpu/gpu_buffer.h"
 #include "mediapipe/gpu/gpu_shared_data_internal.h"
+#include "myMediapipe/projects/dynamicGestures/frame_pool.h"
 
 constexpr char kInputStream[] = "input_video";
 constexpr char kOutputStream[] = "output_video";
@@ -43,6 +44,9 @@ DEFINE_string(input_video_path, "",
 DEFINE_string(output_video_path, "",
               "Full path of where to save result (.mp4 only). "
               "If not provided, show result in a window.");
+DEFINE_int32(frame_pool_size, 4,
+             "Number of input frame buffers recycled between camera frames. "
+             "Frames are dropped while all of them are in use by the graph.");
 
 ::mediapipe::Status RunMPPGraph() {
   std::string calculator_graph_config_contents;
@@ -91,24 +95,26 @@ DEFINE_string(output_video_path, "",
   MP_RETURN_IF_ERROR(graph.StartRun({}));
 
   LOG(INFO) << "Start grabbing and processing frames.";
+  mediapipe::FramePool frame_pool(
+      FLAGS_frame_pool_size, mediapipe::ImageFormat::SRGB,
+      mediapipe::ImageFrame::kGlDefaultAlignmentBoundary);
+  // Reused by the capture, so decoding doesn't allocate once warmed up
+  cv::Mat camera_frame_raw;
   bool grab_frames = true;
   while (grab_frames) {
     // Capture opencv camera or video frame.
-    cv::Mat camera_frame_raw;
     capture >> camera_frame_raw;
     if (camera_frame_raw.empty()) break;  // End of video.
-    cv::Mat camera_frame;
-    cv::cvtColor(camera_frame_raw, camera_frame, cv::COLOR_BGR2RGB);
-    if (!load_video) {
-      cv::flip(camera_frame, camera_frame, /*flipcode=HORIZONTAL*/ 1);
-    }
 
-    // Wrap Mat into an ImageFrame.
-    auto input_frame = absl::make_unique<mediapipe::ImageFrame>(
-        mediapipe::ImageFormat::SRGB, camera_frame.cols, camera_frame.rows,
-        mediapipe::ImageFrame::kGlDefaultAlignmentBoundary);
-    cv::Mat input_frame_mat = mediapipe::formats::MatView(input_frame.get());
-    camera_frame.copyTo(input_frame_mat);
+    // Convert and mirror straight into a pooled ImageFrame.
+    auto input_frame =
+        frame_pool.Acquire(camera_frame_raw.cols, camera_frame_raw.rows);
+    if (!input_frame) {
+      LOG_EVERY_N(WARNING, 30) << "All input frames in use, dropping frame.";
+      continue;
+    }
+    mediapipe::CopyBgrToRgb(camera_frame_raw, /*mirror=*/!load_video,
+                            input_frame.get());
 
     // Prepare and add graph input packet.
     size_t frame_timestamp_us =
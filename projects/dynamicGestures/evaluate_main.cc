@@ -0,0 +1,323 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Offline evaluation of the dynamic gestures over recorded clips.
+//
+// Every clip of --labels_file is decoded and fed frame by frame to its own
+// CalculatorGraph, ie mainGraph_offline.pbtxt. The next frame is fed once
+// the graph is idle, so its FlowLimiterCalculator never drops a frame, and
+// a clip fails if one doesn't reach the graph. Nothing is displayed.
+// Frames are timestamped with their position in the clip, so the gestures
+// timeouts behave as in real time whatever the speed. Several clips run in
+// parallel (--num_parallel_clips), and their graphs share one
+// ThreadPoolExecutor, which also runs the model executors of the graph
+// (see executor_config.h), so the cores are kept busy by the other clips.
+//
+// The MQTT messages emitted on gesture_messages are compared with the ones
+// the labels file expects. A clip passes when it emits exactly the
+// expected messages, in order. The report lists every clip with its
+// frames/sec, then the clip accuracy, the message precision and recall
+// over all the clips, and the overall frames/sec.
+//
+// Labels file, one clip per line, '#' starts a comment:
+//   <clip>[; <topic>=<payload>]...
+// Relative clip paths are taken from the directory of the labels file. A
+// clip with no messages expects none.
+//
+// Example:
+//   volume.mp4; handCommander/tv/ir_command=KEY_VOLUMEUP
+//   numbers 1 to 5.mp4
+//
+// Usage:
+//   dynamic_gestures_evaluate \
+//     --calculator_graph_config_file=myMediapipe/graphs/dynamicGestures/mainGraph_offline.pbtxt \
+//     --labels_file=myMediapipe/projects/dynamicGestures/videos/labels.txt \
+//     --num_parallel_clips=4
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/port/commandlineflags.h"
+#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/opencv_video_inc.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/thread_pool_executor.h"
+#include "myMediapipe/framework/formats/mqtt_message.pb.h"
+#include "myMediapipe/projects/dynamicGestures/executor_config.h"
+#include "myMediapipe/projects/dynamicGestures/frame_pool.h"
+
+constexpr char kInputStream[] = "input_video";
+constexpr char kMessagesStream[] = "gesture_messages";
+// Output of the FlowLimiterCalculator of the graph
+constexpr char kThrottledStream[] = "throttled_input_video";
+
+DEFINE_string(
+    calculator_graph_config_file, "",
+    "Name of file containing text format CalculatorGraphConfig proto.");
+DEFINE_string(labels_file, "",
+              "Clips to evaluate and their expected messages, one "
+              "'<clip>[; <topic>=<payload>]...' per line.");
+DEFINE_int32(num_parallel_clips, 0,
+             "Clips evaluated at the same time. 0 uses one per core.");
+DEFINE_int32(num_threads, 0,
+             "Threads of the executor shared by all the graphs. "
+             "0 uses one per core.");
+DEFINE_bool(mirror, false, "Flips the frames horizontally.");
+DEFINE_double(min_accuracy, 0,
+              "Clip accuracy below which the evaluation fails, so "
+              "regressions break nightly runs.");
+
+namespace {
+
+struct ClipLabel {
+  std::string path;
+  // "<topic>=<payload>" of every message, in order
+  std::vector<std::string> expected;
+};
+
+struct ClipResult {
+  ::mediapipe::Status status;
+  std::vector<std::string> emitted;
+  int64 frames = 0;
+  double seconds = 0;
+};
+
+std::string Dirname(const std::string& path) {
+  const auto slash = path.rfind('/');
+  return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+::mediapipe::Status ParseLabelsFile(const std::string& path,
+                                    std::vector<ClipLabel>* labels) {
+  std::string contents;
+  MP_RETURN_IF_ERROR(mediapipe::file::GetContents(path, &contents));
+  const std::string clips_dir = Dirname(path);
+  for (absl::string_view line : absl::StrSplit(contents, '\n')) {
+    line = absl::StripAsciiWhitespace(line.substr(0, line.find('#')));
+    if (line.empty()) continue;
+    std::vector<absl::string_view> fields = absl::StrSplit(line, ';');
+    ClipLabel label;
+    label.path = std::string(absl::StripAsciiWhitespace(fields[0]));
+    RET_CHECK(!label.path.empty()) << "No clip in: " << line;
+    if (label.path[0] != '/') label.path = clips_dir + label.path;
+    for (size_t i = 1; i < fields.size(); ++i) {
+      absl::string_view message = absl::StripAsciiWhitespace(fields[i]);
+      RET_CHECK(message.find('=') != absl::string_view::npos)
+          << "Expected '<topic>=<payload>' in: " << line;
+      label.expected.emplace_back(message);
+    }
+    labels->push_back(label);
+  }
+  RET_CHECK(!labels->empty()) << "No clips in " << path;
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status RunClip(
+    const mediapipe::CalculatorGraphConfig& config,
+    std::shared_ptr<mediapipe::Executor> executor, const ClipLabel& label,
+    ClipResult* result) {
+  cv::VideoCapture capture(label.path);
+  RET_CHECK(capture.isOpened()) << "Can't open " << label.path;
+  double fps = capture.get(cv::CAP_PROP_FPS);
+  if (fps <= 0) fps = 30;
+
+  mediapipe::CalculatorGraph graph;
+  MP_RETURN_IF_ERROR(
+      mediapipe::executor_config::ProvideExecutors(config, executor, &graph));
+  MP_RETURN_IF_ERROR(graph.Initialize(config));
+  // Called on the executor threads
+  absl::Mutex mutex;
+  MP_RETURN_IF_ERROR(graph.ObserveOutputStream(
+      kMessagesStream, [&](const mediapipe::Packet& packet) {
+        absl::MutexLock lock(&mutex);
+        for (const auto& message :
+             packet.Get<std::vector<mediapipe::Mqtt_Message>>()) {
+          result->emitted.push_back(
+              absl::StrCat(message.topic(), "=", message.payload()));
+        }
+        return ::mediapipe::OkStatus();
+      }));
+  std::atomic<int64> admitted_frames(0);
+  MP_RETURN_IF_ERROR(graph.ObserveOutputStream(
+      kThrottledStream, [&](const mediapipe::Packet& packet) {
+        ++admitted_frames;
+        return ::mediapipe::OkStatus();
+      }));
+
+  const absl::Time start = absl::Now();
+  MP_RETURN_IF_ERROR(graph.StartRun({}));
+  cv::Mat camera_frame_raw;
+  ::mediapipe::Status feed_status;
+  while (feed_status.ok()) {
+    capture >> camera_frame_raw;
+    if (camera_frame_raw.empty()) break;
+    auto input_frame = absl::make_unique<mediapipe::ImageFrame>(
+        mediapipe::ImageFormat::SRGB, camera_frame_raw.cols,
+        camera_frame_raw.rows,
+        mediapipe::ImageFrame::kDefaultAlignmentBoundary);
+    mediapipe::CopyBgrToRgb(camera_frame_raw, FLAGS_mirror,
+                            input_frame.get());
+    const int64 timestamp_us = result->frames * 1e6 / fps;
+    feed_status = graph.AddPacketToInputStream(
+        kInputStream, mediapipe::Adopt(input_frame.release())
+                          .At(mediapipe::Timestamp(timestamp_us)));
+    ++result->frames;
+    // The limiter only admits a frame once the previous one is done
+    if (feed_status.ok()) feed_status = graph.WaitUntilIdle();
+  }
+  MP_RETURN_IF_ERROR(feed_status);
+  MP_RETURN_IF_ERROR(graph.CloseInputStream(kInputStream));
+  MP_RETURN_IF_ERROR(graph.WaitUntilDone());
+  RET_CHECK_EQ(admitted_frames.load(), result->frames)
+      << "FlowLimiterCalculator dropped frames of " << label.path;
+  result->seconds = absl::ToDoubleSeconds(absl::Now() - start);
+  return ::mediapipe::OkStatus();
+}
+
+// Messages of `emitted` also in `expected`, counting repeats
+int CountMatches(const std::vector<std::string>& expected,
+                 const std::vector<std::string>& emitted) {
+  std::map<std::string, int> remaining;
+  for (const auto& message : expected) ++remaining[message];
+  int matches = 0;
+  for (const auto& message : emitted) {
+    auto it = remaining.find(message);
+    if (it != remaining.end() && it->second > 0) {
+      --it->second;
+      ++matches;
+    }
+  }
+  return matches;
+}
+
+double Ratio(int64 numerator, int64 denominator) {
+  return denominator > 0 ? static_cast<double>(numerator) / denominator : 1;
+}
+
+}  // namespace
+
+::mediapipe::Status RunEvaluation() {
+  std::string calculator_graph_config_contents;
+  MP_RETURN_IF_ERROR(mediapipe::file::GetContents(
+      FLAGS_calculator_graph_config_file, &calculator_graph_config_contents));
+  mediapipe::CalculatorGraphConfig config =
+      mediapipe::ParseTextProtoOrDie<mediapipe::CalculatorGraphConfig>(
+          calculator_graph_config_contents);
+
+  std::vector<ClipLabel> labels;
+  MP_RETURN_IF_ERROR(ParseLabelsFile(FLAGS_labels_file, &labels));
+
+  const int num_cores = std::thread::hardware_concurrency();
+  const int num_threads =
+      FLAGS_num_threads > 0 ? FLAGS_num_threads : num_cores;
+  const int num_workers = std::min<int>(
+      FLAGS_num_parallel_clips > 0 ? FLAGS_num_parallel_clips : num_cores,
+      labels.size());
+  LOG(INFO) << "Evaluating " << labels.size() << " clips, " << num_workers
+            << " at a time on " << num_threads << " threads.";
+  auto executor =
+      std::make_shared<mediapipe::ThreadPoolExecutor>(num_threads);
+
+  std::vector<ClipResult> results(labels.size());
+  std::atomic<int> next_clip(0);
+  const absl::Time start = absl::Now();
+  std::vector<std::thread> workers;
+  for (int i = 0; i < num_workers; ++i) {
+    workers.emplace_back([&]() {
+      const int num_clips = labels.size();
+      for (int clip = next_clip++; clip < num_clips; clip = next_clip++) {
+        results[clip].status =
+            RunClip(config, executor, labels[clip], &results[clip]);
+      }
+    });
+  }
+  for (auto& worker : workers) worker.join();
+  const double seconds = absl::ToDoubleSeconds(absl::Now() - start);
+
+  int passed = 0;
+  int64 total_frames = 0;
+  int64 total_expected = 0;
+  int64 total_emitted = 0;
+  int64 total_matches = 0;
+  std::printf("%-40s %6s %8s %10s  %s\n", "clip", "result", "frames",
+              "frames/s", "emitted");
+  for (size_t clip = 0; clip < labels.size(); ++clip) {
+    const ClipLabel& label = labels[clip];
+    const ClipResult& result = results[clip];
+    if (!result.status.ok()) {
+      LOG(ERROR) << label.path << ": " << result.status.message();
+      std::printf("%-40s %6s\n", label.path.c_str(), "ERROR");
+      continue;
+    }
+    const bool pass = result.emitted == label.expected;
+    passed += pass;
+    total_frames += result.frames;
+    total_expected += label.expected.size();
+    total_emitted += result.emitted.size();
+    total_matches += CountMatches(label.expected, result.emitted);
+    std::printf("%-40s %6s %8lld %10.1f  %s\n", label.path.c_str(),
+                pass ? "PASS" : "FAIL", result.frames,
+                result.frames / std::max(result.seconds, 1e-6),
+                absl::StrJoin(result.emitted, "; ").c_str());
+    if (!pass) {
+      std::printf("%-40s %6s %8s %10s  %s\n", "", "", "", "expected",
+                  absl::StrJoin(label.expected, "; ").c_str());
+    }
+  }
+
+  const double accuracy = Ratio(passed, labels.size());
+  std::printf("clip accuracy: %d/%d = %.3f\n", passed,
+              static_cast<int>(labels.size()), accuracy);
+  std::printf("message precision: %.3f, recall: %.3f\n",
+              Ratio(total_matches, total_emitted),
+              Ratio(total_matches, total_expected));
+  std::printf("frames: %lld in %.3f s, %.1f frames/sec\n", total_frames,
+              seconds, total_frames / std::max(seconds, 1e-6));
+
+  RET_CHECK_GE(accuracy, FLAGS_min_accuracy)
+      << "Clip accuracy below --min_accuracy";
+  return ::mediapipe::OkStatus();
+}
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  ::mediapipe::Status run_status = RunEvaluation();
+  if (!run_status.ok()) {
+    LOG(ERROR) << "Evaluation failed: " << run_status.message();
+    return EXIT_FAILURE;
+  } else {
+    LOG(INFO) << "Success!";
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,147 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myMediapipe/projects/dynamicGestures/executor_config.h"
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "mediapipe/framework/thread_pool_executor.pb.h"
+#include "mediapipe/framework/tool/subgraph_expansion.h"
+#include "myMediapipe/calculators/tflite/batch_tflite_inference_calculator.pb.h"
+
+namespace mediapipe {
+namespace executor_config {
+
+namespace {
+
+constexpr char kDefaultExecutorName[] = "default";
+constexpr char kThreadPoolExecutorType[] = "ThreadPoolExecutor";
+constexpr char kInferenceCalculator[] = "batchTfLiteInferenceCalculator";
+
+// "<executor>:<threads>,..." to executor name -> threads
+::mediapipe::Status ParseSpec(const std::string& spec,
+                              std::map<std::string, int>* threads) {
+  for (absl::string_view entry : absl::StrSplit(spec, ',', absl::SkipEmpty())) {
+    std::vector<std::string> fields = absl::StrSplit(entry, ':');
+    int num_threads;
+    RET_CHECK(fields.size() == 2 && !fields[0].empty() &&
+              absl::SimpleAtoi(fields[1], &num_threads) && num_threads > 0)
+        << "Expected <executor>:<threads> in: " << entry;
+    RET_CHECK(threads->emplace(fields[0], num_threads).second)
+        << "Executor " << fields[0] << " set twice in: " << spec;
+  }
+  return ::mediapipe::OkStatus();
+}
+
+void SetNodeTfLiteThreads(int num_threads,
+                          CalculatorGraphConfig::Node* node) {
+  bool applied = false;
+  if (node->options().HasExtension(
+          batchTfLiteInferenceCalculatorOptions::ext)) {
+    node->mutable_options()
+        ->MutableExtension(batchTfLiteInferenceCalculatorOptions::ext)
+        ->set_cpu_num_thread(num_threads);
+    applied = true;
+  }
+  for (auto& any : *node->mutable_node_options()) {
+    if (!any.Is<batchTfLiteInferenceCalculatorOptions>()) continue;
+    batchTfLiteInferenceCalculatorOptions options;
+    any.UnpackTo(&options);
+    options.set_cpu_num_thread(num_threads);
+    any.PackFrom(options);
+    applied = true;
+  }
+  if (!applied) {
+    node->mutable_options()
+        ->MutableExtension(batchTfLiteInferenceCalculatorOptions::ext)
+        ->set_cpu_num_thread(num_threads);
+  }
+}
+
+}  // namespace
+
+::mediapipe::Status SetExecutorThreads(const std::string& spec,
+                                       CalculatorGraphConfig* config) {
+  std::map<std::string, int> threads;
+  MP_RETURN_IF_ERROR(ParseSpec(spec, &threads));
+  for (const auto& entry : threads) {
+    const std::string name =
+        entry.first == kDefaultExecutorName ? "" : entry.first;
+    ExecutorConfig* executor = nullptr;
+    for (auto& declared : *config->mutable_executor()) {
+      if (declared.name() == name) executor = &declared;
+    }
+    if (!executor) {
+      RET_CHECK(name.empty())
+          << "Executor " << name << " is not declared by the graph.";
+      executor = config->add_executor();
+      executor->set_type(kThreadPoolExecutorType);
+    }
+    RET_CHECK_EQ(executor->type(), kThreadPoolExecutorType)
+        << "Executor " << entry.first
+        << " is provided by the runner, its threads can't be set.";
+    executor->mutable_options()
+        ->MutableExtension(ThreadPoolExecutorOptions::ext)
+        ->set_num_threads(entry.second);
+  }
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status SetTfLiteThreads(const std::string& spec,
+                                     CalculatorGraphConfig* config) {
+  std::map<std::string, int> threads;
+  MP_RETURN_IF_ERROR(ParseSpec(spec, &threads));
+  if (threads.empty()) return ::mediapipe::OkStatus();
+  MP_RETURN_IF_ERROR(tool::ExpandSubgraphs(config));
+  std::set<std::string> matched;
+  for (auto& node : *config->mutable_node()) {
+    if (node.calculator() != kInferenceCalculator) continue;
+    const std::string name =
+        node.executor().empty() ? kDefaultExecutorName : node.executor();
+    auto it = threads.find(name);
+    if (it == threads.end()) continue;
+    SetNodeTfLiteThreads(it->second, &node);
+    matched.insert(name);
+  }
+  for (const auto& entry : threads) {
+    RET_CHECK(matched.count(entry.first))
+        << "No " << kInferenceCalculator << " runs on executor "
+        << entry.first;
+  }
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status ProvideExecutors(const CalculatorGraphConfig& config,
+                                     std::shared_ptr<Executor> executor,
+                                     CalculatorGraph* graph) {
+  bool default_declared = false;
+  for (const auto& declared : config.executor()) {
+    if (declared.name().empty()) default_declared = true;
+    if (declared.type().empty()) {
+      MP_RETURN_IF_ERROR(graph->SetExecutor(declared.name(), executor));
+    }
+  }
+  if (!default_declared) {
+    MP_RETURN_IF_ERROR(graph->SetExecutor("", executor));
+  }
+  return ::mediapipe::OkStatus();
+}
+
+}  // namespace executor_config
+}  // namespace mediapipe
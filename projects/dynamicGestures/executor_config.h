@@ -0,0 +1,60 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_PROJECTS_DYNAMICGESTURES_EXECUTOR_CONFIG_H_
+#define MYMEDIAPIPE_PROJECTS_DYNAMICGESTURES_EXECUTOR_CONFIG_H_
+
+#include <memory>
+#include <string>
+
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/executor.h"
+#include "mediapipe/framework/port/status.h"
+
+namespace mediapipe {
+namespace executor_config {
+
+// Thread settings of the hand tracking graphs, applied by the runners
+// before CalculatorGraph::Initialize.
+//
+// The inference nodes of hand_detection_cpu.pbtxt and
+// hand_landmark_cpu.pbtxt run on the "palm_detection" and
+// "hand_landmark" executors, which the main graph declares. Desktop
+// graphs give them their own ThreadPoolExecutor, so each model keeps a
+// core, and headless graphs leave them untyped for the runner to provide.
+// Every spec below is a comma separated list of <executor>:<threads>,
+// ie "palm_detection:2,hand_landmark:1".
+
+// Sets num_threads of the ThreadPoolExecutors declared by the config.
+// "default" names the default executor, declared if the config doesn't.
+::mediapipe::Status SetExecutorThreads(const std::string& spec,
+                                       CalculatorGraphConfig* config);
+
+// Sets cpu_num_thread, the TfLite interpreter threads, of the
+// batchTfLiteInferenceCalculator nodes running on each executor. Expands
+// the subgraphs of the config to get to them.
+::mediapipe::Status SetTfLiteThreads(const std::string& spec,
+                                     CalculatorGraphConfig* config);
+
+// Sets executor as the default executor, unless the config declares one,
+// and as every executor declared without a type. Call once per graph,
+// before Initialize.
+::mediapipe::Status ProvideExecutors(const CalculatorGraphConfig& config,
+                                     std::shared_ptr<Executor> executor,
+                                     CalculatorGraph* graph);
+
+}  // namespace executor_config
+}  // namespace mediapipe
+
+#endif  // MYMEDIAPIPE_PROJECTS_DYNAMICGESTURES_EXECUTOR_CONFIG_H_
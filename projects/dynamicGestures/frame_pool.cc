@@ -0,0 +1,97 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myMediapipe/projects/dynamicGestures/frame_pool.h"
+
+#include "absl/memory/memory.h"
+#include "mediapipe/framework/port/logging.h"
+
+namespace mediapipe {
+
+FramePool::FramePool(int num_frames, ImageFormat::Format format,
+                     uint32 alignment_boundary)
+    : num_frames_(num_frames),
+      format_(format),
+      alignment_boundary_(alignment_boundary),
+      state_(std::make_shared<State>()) {}
+
+std::unique_ptr<ImageFrame> FramePool::Acquire(int width, int height) {
+  std::unique_ptr<ImageFrame> buffer;
+  {
+    absl::MutexLock lock(&state_->mutex);
+    if (width != state_->width || height != state_->height) {
+      // Frames in flight are freed instead of returned, see Release
+      state_->free_frames.clear();
+      state_->num_allocated = 0;
+      state_->width = width;
+      state_->height = height;
+    }
+    if (!state_->free_frames.empty()) {
+      buffer = std::move(state_->free_frames.back());
+      state_->free_frames.pop_back();
+    } else if (state_->num_allocated < num_frames_) {
+      ++state_->num_allocated;
+      buffer = absl::make_unique<ImageFrame>(format_, width, height,
+                                             alignment_boundary_);
+    } else {
+      return nullptr;
+    }
+  }
+
+  // The graph gets a frame viewing the pooled pixels, its deleter hands
+  // the buffer back instead of freeing them
+  ImageFrame* raw_buffer = buffer.release();
+  std::shared_ptr<State> state = state_;
+  return absl::make_unique<ImageFrame>(
+      format_, width, height, raw_buffer->WidthStep(),
+      raw_buffer->MutablePixelData(),
+      [state, raw_buffer](uint8*) { Release(state, raw_buffer); });
+}
+
+void FramePool::Release(const std::shared_ptr<State>& state,
+                        ImageFrame* buffer) {
+  std::unique_ptr<ImageFrame> owned(buffer);
+  absl::MutexLock lock(&state->mutex);
+  if (owned->Width() == state->width && owned->Height() == state->height) {
+    state->free_frames.emplace_back(std::move(owned));
+  }
+}
+
+void CopyBgrToRgb(const cv::Mat& bgr, bool mirror, ImageFrame* frame) {
+  CHECK_EQ(bgr.type(), CV_8UC3);
+  CHECK_EQ(bgr.cols, frame->Width());
+  CHECK_EQ(bgr.rows, frame->Height());
+  const int width = bgr.cols;
+  for (int y = 0; y < bgr.rows; ++y) {
+    const uint8* src = bgr.ptr<uint8>(y);
+    uint8* dst = frame->MutablePixelData() + y * frame->WidthStep();
+    if (mirror) {
+      const uint8* pixel = src + (width - 1) * 3;
+      for (int x = 0; x < width; ++x, pixel -= 3, dst += 3) {
+        dst[0] = pixel[2];
+        dst[1] = pixel[1];
+        dst[2] = pixel[0];
+      }
+    } else {
+      const uint8* pixel = src;
+      for (int x = 0; x < width; ++x, pixel += 3, dst += 3) {
+        dst[0] = pixel[2];
+        dst[1] = pixel[1];
+        dst[2] = pixel[0];
+      }
+    }
+  }
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,80 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_PROJECTS_DYNAMICGESTURES_FRAME_POOL_H_
+#define MYMEDIAPIPE_PROJECTS_DYNAMICGESTURES_FRAME_POOL_H_
+
+#include <memory>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/port/opencv_core_inc.h"
+
+namespace mediapipe {
+
+// Fixed number of ImageFrame buffers recycled between camera frames.
+//
+// Acquire returns an ImageFrame that borrows one of the pooled pixel
+// buffers, the buffer goes back to the pool when that frame is destroyed,
+// ie when the graph releases the last packet holding it. Buffers are
+// allocated on first use and again only if the frame size changes.
+//
+// Example:
+//   FramePool pool(4, ImageFormat::SRGB,
+//                  ImageFrame::kDefaultAlignmentBoundary);
+//   auto frame = pool.Acquire(camera_frame.cols, camera_frame.rows);
+//   if (frame) {
+//     CopyBgrToRgb(camera_frame, /*mirror=*/true, frame.get());
+//     graph.AddPacketToInputStream(kInputStream, Adopt(frame.release())...);
+//   }
+class FramePool {
+ public:
+  FramePool(int num_frames, ImageFormat::Format format,
+            uint32 alignment_boundary);
+  FramePool(const FramePool&) = delete;
+  FramePool& operator=(const FramePool&) = delete;
+
+  // nullptr when all the buffers are still in use by the graph
+  std::unique_ptr<ImageFrame> Acquire(int width, int height);
+
+ private:
+  // Shared with the deleters of the frames handed out, so buffers can be
+  // returned after the pool is gone
+  struct State {
+    absl::Mutex mutex;
+    std::vector<std::unique_ptr<ImageFrame>> free_frames GUARDED_BY(mutex);
+    int num_allocated GUARDED_BY(mutex) = 0;
+    int width GUARDED_BY(mutex) = 0;
+    int height GUARDED_BY(mutex) = 0;
+  };
+
+  static void Release(const std::shared_ptr<State>& state,
+                      ImageFrame* buffer);
+
+  const int num_frames_;
+  const ImageFormat::Format format_;
+  const uint32 alignment_boundary_;
+  std::shared_ptr<State> state_;
+};
+
+// Converts the BGR frame captured by OpenCV into the SRGB frame in a
+// single pass, mirroring it horizontally when asked. Replaces the
+// cvtColor + flip + copyTo sequence, which went through two extra Mats.
+// frame must have the size of bgr.
+void CopyBgrToRgb(const cv::Mat& bgr, bool mirror, ImageFrame* frame);
+
+}  // namespace mediapipe
+
+#endif  // MYMEDIAPIPE_PROJECTS_DYNAMICGESTURES_FRAME_POOL_H_
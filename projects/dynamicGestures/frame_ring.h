@@ -0,0 +1,106 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYMEDIAPIPE_PROJECTS_DYNAMICGESTURES_FRAME_RING_H_
+#define MYMEDIAPIPE_PROJECTS_DYNAMICGESTURES_FRAME_RING_H_
+
+#include <memory>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+
+// Captured frame waiting to be added to the graph
+struct CapturedFrame {
+  std::unique_ptr<ImageFrame> frame;
+  int64 timestamp_us = 0;
+};
+
+// Bounded ring of captured frames between the capture thread and the
+// thread feeding the graph.
+//
+// With drop_oldest a full ring discards its oldest frame, so a live
+// camera always feeds the freshest one; otherwise Push waits for room,
+// so no frame of a video file is lost. Close wakes up both sides, Pop
+// still returns the frames left before reporting the end.
+class FrameRing {
+ public:
+  FrameRing(int capacity, bool drop_oldest)
+      : slots_(capacity > 0 ? capacity : 1), drop_oldest_(drop_oldest) {}
+  FrameRing(const FrameRing&) = delete;
+  FrameRing& operator=(const FrameRing&) = delete;
+
+  // Returns false if the ring was closed, the frame is discarded then.
+  bool Push(CapturedFrame captured) {
+    absl::MutexLock lock(&mutex_);
+    if (!drop_oldest_) {
+      mutex_.Await(absl::Condition(
+          +[](FrameRing* ring) {
+            return ring->closed_ || ring->size_ < ring->slots_.size();
+          },
+          this));
+    }
+    if (closed_) return false;
+    if (size_ == slots_.size()) {
+      // Frees the pooled buffer of the oldest frame
+      slots_[head_] = CapturedFrame();
+      head_ = (head_ + 1) % slots_.size();
+      --size_;
+      ++dropped_;
+    }
+    slots_[(head_ + size_) % slots_.size()] = std::move(captured);
+    ++size_;
+    return true;
+  }
+
+  // Waits for a frame, returns false once the ring is closed and empty.
+  bool Pop(CapturedFrame* captured) {
+    absl::MutexLock lock(&mutex_);
+    mutex_.Await(absl::Condition(
+        +[](FrameRing* ring) { return ring->closed_ || ring->size_ > 0; },
+        this));
+    if (size_ == 0) return false;
+    *captured = std::move(slots_[head_]);
+    head_ = (head_ + 1) % slots_.size();
+    --size_;
+    return true;
+  }
+
+  void Close() {
+    absl::MutexLock lock(&mutex_);
+    closed_ = true;
+  }
+
+  // Frames discarded because the ring was full
+  int64 dropped() {
+    absl::MutexLock lock(&mutex_);
+    return dropped_;
+  }
+
+ private:
+  absl::Mutex mutex_;
+  std::vector<CapturedFrame> slots_ GUARDED_BY(mutex_);
+  size_t head_ GUARDED_BY(mutex_) = 0;
+  size_t size_ GUARDED_BY(mutex_) = 0;
+  bool closed_ GUARDED_BY(mutex_) = false;
+  int64 dropped_ GUARDED_BY(mutex_) = 0;
+  const bool drop_oldest_;
+};
+
+}  // namespace mediapipe
+
+#endif  // MYMEDIAPIPE_PROJECTS_DYNAMICGESTURES_FRAME_RING_H_
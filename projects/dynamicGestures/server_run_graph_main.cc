@@ -0,0 +1,299 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Headless runner hosting several camera streams in one process.
+//
+// Every stream of --streams_file runs its own CalculatorGraph, built from
+// the same --calculator_graph_config_file (parsed once). All the graphs
+// share a single ThreadPoolExecutor, so the number of threads doesn't
+// grow with the number of cameras. It also runs the executors the graph
+// declares without a type, the model executors of mainGraph_server.pbtxt
+// (see executor_config.h). There is no display, results leave
+// through the MqttPublisherCalculator of the graph, and the runner logs
+// the per stream frame counters every --stats_interval_s. With
+// --stats_file the node stats of all the graphs (see calculator_stats.h)
+// are also written there, in the Prometheus text format.
+//
+// Streams file, one stream per line, '#' starts a comment:
+//   <name> <source> [mirror]
+// source is a camera index, a video file or an RTSP/HTTP url. mirror
+// flips the frames horizontally, as the demo runner does with webcams.
+//
+// Example:
+//   living_room 0 mirror
+//   kitchen rtsp://192.168.1.20:554/stream1
+//
+// Usage:
+//   server_run_graph_main \
+//     --calculator_graph_config_file=myMediapipe/graphs/dynamicGestures/mainGraph_server.pbtxt \
+//     --streams_file=streams.txt --num_threads=8
+
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/port/commandlineflags.h"
+#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/opencv_video_inc.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/thread_pool_executor.h"
+#include "myMediapipe/calculators/util/calculator_stats.h"
+#include "myMediapipe/projects/dynamicGestures/executor_config.h"
+#include "myMediapipe/projects/dynamicGestures/frame_pool.h"
+
+constexpr char kInputStream[] = "input_video";
+
+DEFINE_string(
+    calculator_graph_config_file, "",
+    "Name of file containing text format CalculatorGraphConfig proto.");
+DEFINE_string(streams_file, "",
+              "Name of file listing the streams, one '<name> <source> "
+              "[mirror]' per line.");
+DEFINE_int32(num_threads, 0,
+             "Threads of the executor shared by all the graphs. "
+             "0 uses one per core.");
+DEFINE_int32(frame_pool_size, 4,
+             "Number of input frame buffers recycled by each stream.");
+DEFINE_int32(stats_interval_s, 10,
+             "Seconds between stream counter reports, 0 disables them.");
+DEFINE_string(stats_file, "",
+              "Prometheus textfile rewritten with the node stats on every "
+              "report.");
+
+namespace {
+
+std::atomic<bool> stop_requested(false);
+
+void RequestStop(int) { stop_requested = true; }
+
+int64 NowMicros() {
+  return (double)cv::getTickCount() / (double)cv::getTickFrequency() * 1e6;
+}
+
+void WriteStatsFile() {
+  if (FLAGS_stats_file.empty()) return;
+  // Renamed into place, so a scrape never reads half a file
+  const std::string tmp_file = absl::StrCat(FLAGS_stats_file, ".tmp");
+  ::mediapipe::Status status = mediapipe::file::SetContents(
+      tmp_file, mediapipe::calculator_stats::RenderPrometheusText());
+  if (!status.ok() ||
+      std::rename(tmp_file.c_str(), FLAGS_stats_file.c_str()) != 0) {
+    LOG(ERROR) << "Can't write " << FLAGS_stats_file;
+  }
+}
+
+struct StreamConfig {
+  std::string name;
+  std::string source;
+  bool mirror = false;
+};
+
+::mediapipe::Status ParseStreamsFile(const std::string& path,
+                                     std::vector<StreamConfig>* streams) {
+  std::string contents;
+  MP_RETURN_IF_ERROR(mediapipe::file::GetContents(path, &contents));
+  for (absl::string_view line : absl::StrSplit(contents, '\n')) {
+    line = line.substr(0, line.find('#'));
+    std::vector<std::string> fields =
+        absl::StrSplit(line, ' ', absl::SkipWhitespace());
+    if (fields.empty()) continue;
+    RET_CHECK(fields.size() == 2 || fields.size() == 3)
+        << "Expected '<name> <source> [mirror]' in: " << line;
+    StreamConfig stream;
+    stream.name = fields[0];
+    stream.source = fields[1];
+    if (fields.size() == 3) {
+      RET_CHECK_EQ(fields[2], "mirror") << "Unknown option in: " << line;
+      stream.mirror = true;
+    }
+    streams->push_back(stream);
+  }
+  RET_CHECK(!streams->empty()) << "No streams in " << path;
+  return ::mediapipe::OkStatus();
+}
+
+// One camera and its graph. The capture thread feeds the graph as fast as
+// the camera delivers, the FlowLimiterCalculator of the graph drops the
+// frames that come while it is busy.
+class Stream {
+ public:
+  explicit Stream(const StreamConfig& config)
+      : config_(config),
+        frame_pool_(FLAGS_frame_pool_size, mediapipe::ImageFormat::SRGB,
+                    mediapipe::ImageFrame::kDefaultAlignmentBoundary) {}
+
+  ::mediapipe::Status Start(
+      const mediapipe::CalculatorGraphConfig& graph_config,
+      std::shared_ptr<mediapipe::Executor> executor) {
+    int camera_id;
+    if (absl::SimpleAtoi(config_.source, &camera_id)) {
+      capture_.open(camera_id);
+    } else {
+      capture_.open(config_.source);
+    }
+    RET_CHECK(capture_.isOpened())
+        << config_.name << ": can't open " << config_.source;
+
+    MP_RETURN_IF_ERROR(mediapipe::executor_config::ProvideExecutors(
+        graph_config, executor, &graph_));
+    MP_RETURN_IF_ERROR(graph_.Initialize(graph_config));
+    MP_RETURN_IF_ERROR(graph_.StartRun({}));
+    capture_thread_ = std::thread([this]() { CaptureLoop(); });
+    return ::mediapipe::OkStatus();
+  }
+
+  // Waits for the end of the source or a stop request, then for the graph
+  ::mediapipe::Status Join() {
+    if (capture_thread_.joinable()) capture_thread_.join();
+    MP_RETURN_IF_ERROR(feed_status_);
+    return graph_.WaitUntilDone();
+  }
+
+  void LogStats() const {
+    LOG(INFO) << config_.name << ": " << frames_fed_ << " frames fed, "
+              << frames_dropped_ << " dropped for lack of buffers";
+  }
+
+ private:
+  void CaptureLoop() {
+    cv::Mat camera_frame_raw;
+    while (!stop_requested) {
+      capture_ >> camera_frame_raw;
+      if (camera_frame_raw.empty()) {
+        LOG(INFO) << config_.name << ": end of stream.";
+        break;
+      }
+      auto input_frame =
+          frame_pool_.Acquire(camera_frame_raw.cols, camera_frame_raw.rows);
+      if (!input_frame) {
+        ++frames_dropped_;
+        continue;
+      }
+      mediapipe::CopyBgrToRgb(camera_frame_raw, config_.mirror,
+                              input_frame.get());
+      feed_status_ = graph_.AddPacketToInputStream(
+          kInputStream, mediapipe::Adopt(input_frame.release())
+                            .At(mediapipe::Timestamp(NowMicros())));
+      if (!feed_status_.ok()) {
+        LOG(ERROR) << config_.name << ": " << feed_status_.message();
+        break;
+      }
+      ++frames_fed_;
+    }
+    ::mediapipe::Status close_status = graph_.CloseInputStream(kInputStream);
+    if (feed_status_.ok()) feed_status_ = close_status;
+  }
+
+  const StreamConfig config_;
+  cv::VideoCapture capture_;
+  mediapipe::FramePool frame_pool_;
+  mediapipe::CalculatorGraph graph_;
+  std::thread capture_thread_;
+  ::mediapipe::Status feed_status_;
+  std::atomic<int64> frames_fed_{0};
+  std::atomic<int64> frames_dropped_{0};
+};
+
+}  // namespace
+
+::mediapipe::Status RunMPPGraphs() {
+  std::string calculator_graph_config_contents;
+  MP_RETURN_IF_ERROR(mediapipe::file::GetContents(
+      FLAGS_calculator_graph_config_file, &calculator_graph_config_contents));
+  mediapipe::CalculatorGraphConfig config =
+      mediapipe::ParseTextProtoOrDie<mediapipe::CalculatorGraphConfig>(
+          calculator_graph_config_contents);
+
+  std::vector<StreamConfig> stream_configs;
+  MP_RETURN_IF_ERROR(ParseStreamsFile(FLAGS_streams_file, &stream_configs));
+
+  const int num_threads = FLAGS_num_threads > 0
+                              ? FLAGS_num_threads
+                              : std::thread::hardware_concurrency();
+  LOG(INFO) << "Running " << stream_configs.size() << " streams on "
+            << num_threads << " threads.";
+  auto executor =
+      std::make_shared<mediapipe::ThreadPoolExecutor>(num_threads);
+
+  std::vector<std::unique_ptr<Stream>> streams;
+  for (const auto& stream_config : stream_configs) {
+    auto stream = absl::make_unique<Stream>(stream_config);
+    ::mediapipe::Status status = stream->Start(config, executor);
+    if (!status.ok()) {
+      // Streams already running are stopped below
+      LOG(ERROR) << "Failed to start " << stream_config.name << ": "
+                 << status.message();
+      stop_requested = true;
+      break;
+    }
+    streams.emplace_back(std::move(stream));
+  }
+
+  std::thread stats_thread;
+  std::atomic<bool> streams_done(false);
+  if (FLAGS_stats_interval_s > 0) {
+    stats_thread = std::thread([&]() {
+      absl::Time next_report =
+          absl::Now() + absl::Seconds(FLAGS_stats_interval_s);
+      while (!streams_done) {
+        absl::SleepFor(absl::Milliseconds(100));
+        if (absl::Now() < next_report) continue;
+        for (const auto& stream : streams) stream->LogStats();
+        WriteStatsFile();
+        next_report += absl::Seconds(FLAGS_stats_interval_s);
+      }
+    });
+  }
+
+  ::mediapipe::Status run_status;
+  for (auto& stream : streams) {
+    ::mediapipe::Status status = stream->Join();
+    if (!status.ok() && run_status.ok()) run_status = status;
+  }
+  streams_done = true;
+  if (stats_thread.joinable()) stats_thread.join();
+  for (const auto& stream : streams) stream->LogStats();
+  WriteStatsFile();
+  return run_status;
+}
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  std::signal(SIGINT, RequestStop);
+  std::signal(SIGTERM, RequestStop);
+  ::mediapipe::Status run_status = RunMPPGraphs();
+  if (!run_status.ok()) {
+    LOG(ERROR) << "Failed to run the graphs: " << run_status.message();
+    return EXIT_FAILURE;
+  } else {
+    LOG(INFO) << "Success!";
+  }
+  return EXIT_SUCCESS;
+}
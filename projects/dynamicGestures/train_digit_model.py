@@ -0,0 +1,94 @@
+# Copyright 2020 Lisandro Bravo.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Trains the digit model of writingDynamicGesturesCalculator on MNIST.
+
+The calculator draws the writing gestures as MNIST digits, a white stroke
+on black fitted in 20x20 pixels and centered in a 28x28 image with values
+in [0,1] (see StrokeRaster). The model takes that image as a {1,28,28,1}
+float tensor and outputs the 10 digit scores.
+
+With --quantize the model is exported as full integer, uint8 input and
+output, which the calculator quantizes and dequantizes from the tensor
+params.
+
+Usage:
+  python3 myMediapipe/projects/dynamicGestures/train_digit_model.py \
+    --output_file=myMediapipe/models/dynamicGestures/digits.tflite
+"""
+
+import argparse
+
+import numpy as np
+import tensorflow as tf
+
+
+def build_model():
+  return tf.keras.Sequential([
+      tf.keras.layers.Conv2D(
+          16, 3, activation='relu', input_shape=(28, 28, 1)),
+      tf.keras.layers.MaxPooling2D(),
+      tf.keras.layers.Conv2D(32, 3, activation='relu'),
+      tf.keras.layers.MaxPooling2D(),
+      tf.keras.layers.Flatten(),
+      tf.keras.layers.Dense(64, activation='relu'),
+      tf.keras.layers.Dense(10, activation='softmax'),
+  ])
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+  parser.add_argument('--output_file', required=True)
+  parser.add_argument('--epochs', type=int, default=5)
+  parser.add_argument('--quantize', action='store_true')
+  args = parser.parse_args()
+
+  (train_x, train_y), (test_x, test_y) = tf.keras.datasets.mnist.load_data()
+  train_x = (train_x / 255.0).astype(np.float32)[..., np.newaxis]
+  test_x = (test_x / 255.0).astype(np.float32)[..., np.newaxis]
+
+  model = build_model()
+  model.compile(
+      optimizer='adam',
+      loss='sparse_categorical_crossentropy',
+      metrics=['accuracy'])
+  model.fit(
+      train_x,
+      train_y,
+      epochs=args.epochs,
+      batch_size=128,
+      validation_data=(test_x, test_y))
+
+  converter = tf.lite.TFLiteConverter.from_keras_model(model)
+  if args.quantize:
+
+    def representative_dataset():
+      for image in train_x[:500]:
+        yield [image[np.newaxis]]
+
+    converter.optimizations = [tf.lite.Optimize.DEFAULT]
+    converter.representative_dataset = representative_dataset
+    converter.target_spec.supported_ops = [
+        tf.lite.OpsSet.TFLITE_BUILTINS_INT8
+    ]
+    converter.inference_input_type = tf.uint8
+    converter.inference_output_type = tf.uint8
+  tflite_model = converter.convert()
+
+  with open(args.output_file, 'wb') as model_file:
+    model_file.write(tflite_model)
+  print('Wrote %s, %d bytes' % (args.output_file, len(tflite_model)))
+
+
+if __name__ == '__main__':
+  main()
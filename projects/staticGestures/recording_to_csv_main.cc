@@ -0,0 +1,71 @@
+// Copyright 2020 Lisandro Bravo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Converts a BINARY recording of LandmarksAndAnglesToFileCalculator to the
+// CSV layout of trainingData, one "landmark,x,y,angle1,angle2" line per
+// landmark and 21 lines per frame.
+//
+// Usage:
+//   recording_to_csv --input_file=fist.rec \
+//     --output_file=myMediapipe/projects/staticGestures/trainingData/101019_1328/fist.csv
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_format.h"
+#include "mediapipe/framework/port/commandlineflags.h"
+#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/status.h"
+#include "myMediapipe/calculators/util/landmark_recorder.h"
+
+DEFINE_string(input_file, "", "BINARY recording to convert.");
+DEFINE_string(output_file, "", "CSV file to create.");
+DEFINE_int32(label, -1,
+             "Only converts the frames recorded with this label, -1 "
+             "converts all of them.");
+
+::mediapipe::Status ConvertRecording() {
+  namespace recorder = ::mediapipe::landmark_recorder;
+  std::vector<recorder::Record> records;
+  MP_RETURN_IF_ERROR(recorder::ReadRecords(FLAGS_input_file, &records));
+
+  std::string csv;
+  int converted = 0;
+  for (const auto& record : records) {
+    if (FLAGS_label >= 0 && record.label != FLAGS_label) continue;
+    for (int i = 0; i < recorder::kNumLandmarks; ++i) {
+      absl::StrAppendFormat(&csv, "%d,%f,%f,%f,%f\n", i, record.xy[i][0],
+                            record.xy[i][1], record.angles[i][0],
+                            record.angles[i][1]);
+    }
+    ++converted;
+  }
+  MP_RETURN_IF_ERROR(mediapipe::file::SetContents(FLAGS_output_file, csv));
+  LOG(INFO) << "Converted " << converted << " of " << records.size()
+            << " frames to " << FLAGS_output_file;
+  return ::mediapipe::OkStatus();
+}
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  ::mediapipe::Status run_status = ConvertRecording();
+  if (!run_status.ok()) {
+    LOG(ERROR) << "Failed to convert the recording: " << run_status.message();
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
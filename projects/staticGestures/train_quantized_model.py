@@ -0,0 +1,175 @@
+# Copyright 2020 Lisandro Bravo.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Trains the static gestures classifier and exports it as a full int8 model.
+
+Reads a trainingData session, ie trainingData/101019_1328: labels.csv maps
+every CSV file to its label, and the CSV files hold 21 lines per frame of
+"landmark,x,y,angle1,angle2" (see LandmarksAndAnglesToFileCalculator and
+recording_to_csv). The 42 angles of a frame, in radians, are the input of
+the model, laid out as hand_angles::ComputeFeatures writes them.
+
+The model is exported twice, as float and as full integer (int8 input,
+weights, activations and output), quantized with a representative set of
+the training frames. The input scale and zero point printed at the end go
+to the converter feeding the model:
+
+  node {
+    calculator: "landmarksToTfLiteConverterCalculator"
+    input_stream: "MULTI_NORM_LANDMARKS:multi_hand_landmarks"
+    output_stream: "TENSORS:angle_tensor"
+    options: {
+      [mediapipe.landmarksToTfLiteConverterCalculatorOptions.ext] {
+        quant_scale: <input scale>
+        quant_zero_point: <input zero point>
+      }
+    }
+  }
+
+The int8 model has to run on batchTfLiteInferenceCalculator (the stock
+TfLiteInferenceCalculator converts its inputs to float), and
+AnglesToDetectionCalculator dequantizes the scores with the params of the
+output tensor.
+
+Usage:
+  python3 myMediapipe/projects/staticGestures/train_quantized_model.py \
+    --session_dir=myMediapipe/projects/staticGestures/trainingData/101019_1328 \
+    --output_dir=myMediapipe/models/staticGestures
+"""
+
+import argparse
+import csv
+import os
+
+import numpy as np
+import tensorflow as tf
+
+NUM_LANDMARKS = 21
+NUM_FEATURES = NUM_LANDMARKS * 2
+
+
+def load_session(session_dir):
+  """Returns the (frames, 42) features, their labels and the label names."""
+  features, labels, names = [], [], {}
+  with open(os.path.join(session_dir, 'labels.csv')) as labels_file:
+    for name, file_stem, label in csv.reader(labels_file):
+      names[int(label)] = name
+      rows = np.loadtxt(
+          os.path.join(session_dir, file_stem + '.csv'),
+          delimiter=',',
+          usecols=(3, 4),
+          dtype=np.float32)
+      num_frames = len(rows) // NUM_LANDMARKS
+      frames = rows[:num_frames * NUM_LANDMARKS].reshape(num_frames,
+                                                         NUM_FEATURES)
+      features.append(frames)
+      labels.append(np.full(num_frames, int(label), dtype=np.int32))
+  return np.concatenate(features), np.concatenate(labels), names
+
+
+def build_model(num_classes):
+  return tf.keras.Sequential([
+      tf.keras.layers.Dense(
+          64, activation='relu', input_shape=(NUM_FEATURES,)),
+      tf.keras.layers.Dense(32, activation='relu'),
+      tf.keras.layers.Dense(num_classes, activation='softmax'),
+  ])
+
+
+def export_int8(model, calibration_frames):
+  converter = tf.lite.TFLiteConverter.from_keras_model(model)
+  converter.optimizations = [tf.lite.Optimize.DEFAULT]
+
+  def representative_dataset():
+    for frame in calibration_frames:
+      yield [frame.reshape(1, NUM_FEATURES)]
+
+  converter.representative_dataset = representative_dataset
+  converter.target_spec.supported_ops = [tf.lite.OpsSet.TFLITE_BUILTINS_INT8]
+  converter.inference_input_type = tf.int8
+  converter.inference_output_type = tf.int8
+  return converter.convert()
+
+
+def evaluate(tflite_model, features, labels):
+  """Accuracy of the tflite model, quantizing the input when needed."""
+  interpreter = tf.lite.Interpreter(model_content=tflite_model)
+  interpreter.allocate_tensors()
+  input_detail = interpreter.get_input_details()[0]
+  output_detail = interpreter.get_output_details()[0]
+  scale, zero_point = input_detail['quantization']
+
+  hits = 0
+  for frame, label in zip(features, labels):
+    if input_detail['dtype'] == np.int8:
+      frame = np.clip(np.round(frame / scale) + zero_point, -128, 127)
+    interpreter.set_tensor(input_detail['index'],
+                           frame.reshape(1, NUM_FEATURES).astype(
+                               input_detail['dtype']))
+    interpreter.invoke()
+    hits += np.argmax(interpreter.get_tensor(output_detail['index'])) == label
+  return hits / len(labels)
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+  parser.add_argument('--session_dir', required=True)
+  parser.add_argument('--output_dir', required=True)
+  parser.add_argument('--model_name', default='gestures_int8')
+  parser.add_argument('--epochs', type=int, default=30)
+  parser.add_argument('--calibration_frames', type=int, default=500)
+  parser.add_argument('--validation_split', type=float, default=0.2)
+  args = parser.parse_args()
+
+  features, labels, names = load_session(args.session_dir)
+  rng = np.random.RandomState(0)
+  order = rng.permutation(len(labels))
+  features, labels = features[order], labels[order]
+  num_validation = int(len(labels) * args.validation_split)
+  train_x, val_x = features[num_validation:], features[:num_validation]
+  train_y, val_y = labels[num_validation:], labels[:num_validation]
+
+  model = build_model(max(names) + 1)
+  model.compile(
+      optimizer='adam',
+      loss='sparse_categorical_crossentropy',
+      metrics=['accuracy'])
+  model.fit(
+      train_x,
+      train_y,
+      epochs=args.epochs,
+      batch_size=64,
+      validation_data=(val_x, val_y))
+
+  float_model = tf.lite.TFLiteConverter.from_keras_model(model).convert()
+  int8_model = export_int8(model, train_x[:args.calibration_frames])
+
+  os.makedirs(args.output_dir, exist_ok=True)
+  for suffix, tflite_model in (('_float', float_model), ('', int8_model)):
+    path = os.path.join(args.output_dir, args.model_name + suffix + '.tflite')
+    with open(path, 'wb') as model_file:
+      model_file.write(tflite_model)
+    print('Wrote %s, %d bytes' % (path, len(tflite_model)))
+
+  print('Float accuracy: %.4f' % evaluate(float_model, val_x, val_y))
+  print('Int8 accuracy:  %.4f' % evaluate(int8_model, val_x, val_y))
+
+  interpreter = tf.lite.Interpreter(model_content=int8_model)
+  input_scale, input_zero_point = interpreter.get_input_details(
+  )[0]['quantization']
+  print('quant_scale: %.8f' % input_scale)
+  print('quant_zero_point: %d' % input_zero_point)
+
+
+if __name__ == '__main__':
+  main()
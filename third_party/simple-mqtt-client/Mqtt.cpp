@@ -1,8 +1,10 @@
 #include "Mqtt.h"
 
-Mqtt::Mqtt(string id, string publish_topic,vector<string> subscription_topic_list, string host, int port, string username, string password){
+Mqtt::Mqtt(string id, string publish_topic,vector<string> subscription_topic_list, string host, int port, string username, string password, bool threaded) : mosquittopp(id.c_str())
+{
 
     mosqpp::lib_init();
+    this->threaded = threaded;
     this->id = id;
     this->keepalive = 60;
     this->port = port;
@@ -12,6 +14,7 @@ Mqtt::Mqtt(string id, string publish_topic,vector<string> subscription_topic_lis
 
     mosquittopp::username_pw_set(username.c_str(), password.c_str());
 
+    if (!threaded) return;
 
     /*
      * Connect to an MQTT broker. This is a non-blocking call. If you use mosquitto_connect_async your client must use
@@ -24,9 +27,10 @@ Mqtt::Mqtt(string id, string publish_topic,vector<string> subscription_topic_lis
 
 
 
-Mqtt::Mqtt(string id, string publish_topic,vector<string> subscription_topic_list , string host, int port) : mosquittopp(id.c_str())
+Mqtt::Mqtt(string id, string publish_topic,vector<string> subscription_topic_list , string host, int port, bool threaded) : mosquittopp(id.c_str())
 {
     mosqpp::lib_init();
+    this->threaded = threaded;
     this->id = id;
     this->keepalive = 60;
     this->port = port;
@@ -34,7 +38,7 @@ Mqtt::Mqtt(string id, string publish_topic,vector<string> subscription_topic_lis
     this->publish_topic = publish_topic;
     this->subscription_topic_list = subscription_topic_list;
 
-
+    if (!threaded) return;
 
     /*
      * Connect to an MQTT broker. This is a non-blocking call. If you use mosquitto_connect_async your client must use
@@ -46,10 +50,25 @@ Mqtt::Mqtt(string id, string publish_topic,vector<string> subscription_topic_lis
 
 Mqtt::~Mqtt() {
     disconnect();
-    loop_stop();
+    if (threaded) loop_stop();
     mosqpp::lib_cleanup();
 }
 
+bool Mqtt::connect_to_broker()
+{
+    /*
+     * Blocking connection, meant to be called from the thread that runs loop()
+     */
+    int answer = mosqpp::mosquittopp::connect(host.c_str(), port, keepalive);
+    return (answer == MOSQ_ERR_SUCCESS);
+}
+
+bool Mqtt::publish(const string &topic, const string &message, int qos, bool retain)
+{
+    int answer = mosqpp::mosquittopp::publish(nullptr, topic.c_str(), message.length(), message.c_str(), qos, retain);
+    return (answer == MOSQ_ERR_SUCCESS);
+}
+
 bool Mqtt::publish(string message)
 {
     /*
@@ -30,6 +30,8 @@ private:
      */
     int keepalive;
 
+    bool threaded;
+
     void on_connect(int rc);
 
     void on_disconnect(int rc);
@@ -61,8 +63,11 @@ public:
      * @param port the network port to connect to (usually 1883)
      * @param username username, if expected by the server
      * @param password password, if expected by the server
+     * @param threaded when true connects and starts the mosquitto thread,
+     *                 otherwise the owner calls connect_to_broker() and
+     *                 runs loop() from its own thread
      */
-    Mqtt(string id, string publish_topic,vector<string> subscription_topic_list, string host, int port, string username, string password);
+    Mqtt(string id, string publish_topic,vector<string> subscription_topic_list, string host, int port, string username, string password, bool threaded = true);
 
     /**
      * @brief Mqtt constructor
@@ -74,8 +79,11 @@ public:
      * @param subscribe_topic the subscription pattern
      * @param host the hostname or ip address of the broker to connect to
      * @param port the network port to connect to (usually 1883)
+     * @param threaded when true connects and starts the mosquitto thread,
+     *                 otherwise the owner calls connect_to_broker() and
+     *                 runs loop() from its own thread
      */
-    Mqtt(string id, string publish_topic,vector<string> subscription_topic_list, string host, int port);
+    Mqtt(string id, string publish_topic,vector<string> subscription_topic_list, string host, int port, bool threaded = true);
 
     ~Mqtt();
 
@@ -86,6 +94,22 @@ public:
      */
     bool publish(string message);
 
+    /**
+     * @brief publish a message on the given topic
+     * @param topic topic to publish to
+     * @param message payload of the message
+     * @param qos 0, 1 or 2
+     * @param retain whether the broker should retain the message
+     * @return True, if publication was successfully queued by mosquitto
+     */
+    bool publish(const string &topic, const string &message, int qos, bool retain);
+
+    /**
+     * @brief blocking connection to the broker, used when not threaded
+     * @return True, if connected
+     */
+    bool connect_to_broker();
+
     /**
      * @brief subscribe to a topic
      * @return True, if subscription was successfully